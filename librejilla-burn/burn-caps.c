@@ -58,6 +58,10 @@ G_DEFINE_TYPE (RejillaBurnCaps, rejilla_burn_caps, G_TYPE_OBJECT);
 
 static GObjectClass *parent_class = NULL;
 
+/* Incremented each time the state of a plugin changes so that the planner
+ * cache knows its contents are stale */
+static volatile gint plan_serial = 0;
+
 
 static void
 rejilla_caps_link_free (RejillaCapsLink *link)
@@ -270,6 +274,161 @@ rejilla_burn_caps_find_start_caps (RejillaBurnCaps *self,
 	return NULL;
 }
 
+void
+rejilla_caps_plan_key_init (RejillaCapsPlanKey *key,
+                            RejillaCapsPlanType plan)
+{
+	/* Zero everything (padding included) so that unused fields never make
+	 * two identical queries look different. */
+	memset (key, 0, sizeof (RejillaCapsPlanKey));
+	key->plan = plan;
+}
+
+static guint
+rejilla_caps_plan_key_hash (gconstpointer data)
+{
+	const RejillaCapsPlanKey *key = data;
+	guint hash;
+
+	hash = key->plan;
+	hash = (hash << 5) - hash + key->input.type;
+	hash = (hash << 5) - hash + key->input.subtype.media;
+	hash = (hash << 5) - hash + key->output.type;
+	hash = (hash << 5) - hash + key->output.subtype.media;
+	hash = (hash << 5) - hash + key->media;
+	hash = (hash << 5) - hash + key->session_flags;
+	hash = (hash << 5) - hash + key->io_flags;
+	hash = (hash << 5) - hash + key->group_id;
+	hash = (hash << 2) + (key->ignore_plugin_errors << 1) + key->check_session_flags;
+	return hash;
+}
+
+static gboolean
+rejilla_caps_plan_key_equal (gconstpointer a,
+                             gconstpointer b)
+{
+	const RejillaCapsPlanKey *key1 = a;
+	const RejillaCapsPlanKey *key2 = b;
+
+	return key1->plan == key2->plan
+	    && key1->input.type == key2->input.type
+	    && key1->input.subtype.media == key2->input.subtype.media
+	    && key1->output.type == key2->output.type
+	    && key1->output.subtype.media == key2->output.subtype.media
+	    && key1->media == key2->media
+	    && key1->session_flags == key2->session_flags
+	    && key1->io_flags == key2->io_flags
+	    && key1->group_id == key2->group_id
+	    && key1->ignore_plugin_errors == key2->ignore_plugin_errors
+	    && key1->check_session_flags == key2->check_session_flags;
+}
+
+GSList *
+rejilla_caps_link_list_copy (GSList *path)
+{
+	GSList *retval = NULL;
+	GSList *iter;
+
+	for (iter = path; iter; iter = iter->next) {
+		RejillaCapsLinkList *node;
+
+		node = g_new0 (RejillaCapsLinkList, 1);
+		memcpy (node, iter->data, sizeof (RejillaCapsLinkList));
+		retval = g_slist_prepend (retval, node);
+	}
+
+	return g_slist_reverse (retval);
+}
+
+void
+rejilla_caps_link_list_free (GSList *path)
+{
+	g_slist_foreach (path, (GFunc) g_free, NULL);
+	g_slist_free (path);
+}
+
+static void
+rejilla_caps_plan_free (RejillaCapsPlan *plan)
+{
+	rejilla_caps_link_list_free (plan->path);
+	g_free (plan);
+}
+
+/**
+ * rejilla_burn_caps_plan_invalidate:
+ *
+ * Must be called whenever something that changes the results of a search
+ * through the caps graph is modified (plugin activation, errors, priority,
+ * registration). The cache is then emptied on next use.
+ **/
+
+void
+rejilla_burn_caps_plan_invalidate (void)
+{
+	g_atomic_int_inc (&plan_serial);
+}
+
+gboolean
+rejilla_burn_caps_plan_lookup (RejillaBurnCaps *self,
+                               const RejillaCapsPlanKey *key,
+                               RejillaCapsPlan *plan)
+{
+	RejillaCapsPlan *cached;
+	gint serial;
+
+	serial = g_atomic_int_get (&plan_serial);
+
+	g_mutex_lock (self->priv->plan_lock);
+
+	if (self->priv->plan_serial != serial) {
+		REJILLA_BURN_LOG ("Plugins changed; emptying planner cache");
+		g_hash_table_remove_all (self->priv->plans);
+		self->priv->plan_serial = serial;
+		g_mutex_unlock (self->priv->plan_lock);
+		return FALSE;
+	}
+
+	cached = g_hash_table_lookup (self->priv->plans, key);
+	if (!cached) {
+		g_mutex_unlock (self->priv->plan_lock);
+		return FALSE;
+	}
+
+	memcpy (plan, cached, sizeof (RejillaCapsPlan));
+	plan->path = rejilla_caps_link_list_copy (cached->path);
+
+	g_mutex_unlock (self->priv->plan_lock);
+	return TRUE;
+}
+
+void
+rejilla_burn_caps_plan_store (RejillaBurnCaps *self,
+                              const RejillaCapsPlanKey *key,
+                              const RejillaCapsPlan *plan)
+{
+	RejillaCapsPlanKey *key_copy;
+	RejillaCapsPlan *cached;
+
+	g_mutex_lock (self->priv->plan_lock);
+
+	/* Don't store results computed while a plugin was changing state */
+	if (self->priv->plan_serial != g_atomic_int_get (&plan_serial)) {
+		g_mutex_unlock (self->priv->plan_lock);
+		return;
+	}
+
+	key_copy = g_new0 (RejillaCapsPlanKey, 1);
+	memcpy (key_copy, key, sizeof (RejillaCapsPlanKey));
+
+	cached = g_new0 (RejillaCapsPlan, 1);
+	memcpy (cached, plan, sizeof (RejillaCapsPlan));
+	cached->path = rejilla_caps_link_list_copy (plan->path);
+
+	g_hash_table_replace (self->priv->plans, key_copy, cached);
+
+	g_mutex_unlock (self->priv->plan_lock);
+}
+
 static void
 rejilla_burn_caps_finalize (GObject *object)
 {
@@ -296,6 +455,16 @@ rejilla_burn_caps_finalize (GObject *object)
 		cobj->priv->tests = NULL;
 	}
 
+	if (cobj->priv->plans) {
+		g_hash_table_destroy (cobj->priv->plans);
+		cobj->priv->plans = NULL;
+	}
+
+	if (cobj->priv->plan_lock) {
+		g_mutex_free (cobj->priv->plan_lock);
+		cobj->priv->plan_lock = NULL;
+	}
+
 	g_free (cobj->priv);
 	G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -316,6 +485,13 @@ rejilla_burn_caps_init (RejillaBurnCaps *obj)
 
 	obj->priv = g_new0 (RejillaBurnCapsPrivate, 1);
 
+	obj->priv->plan_lock = g_mutex_new ();
+	obj->priv->plans = g_hash_table_new_full (rejilla_caps_plan_key_hash,
+	                                          rejilla_caps_plan_key_equal,
+	                                          g_free,
+	                                          (GDestroyNotify) rejilla_caps_plan_free);
+	obj->priv->plan_serial = g_atomic_int_get (&plan_serial);
+
 	settings = g_settings_new (REJILLA_SCHEMA_CONFIG);
 	obj->priv->group_str = g_settings_get_string (settings, REJILLA_ENGINE_GROUP_KEY);
 	g_object_unref (settings);
@@ -70,6 +70,48 @@ struct _RejillaCapsTest {
 };
 typedef struct _RejillaCapsTest RejillaCapsTest;
 
+typedef struct _RejillaCapsLinkList RejillaCapsLinkList;
+struct _RejillaCapsLinkList {
+	RejillaCapsLink *link;
+	RejillaPlugin *plugin;
+};
+
+/**
+ * The planner cache remembers the results of the graph searches done through
+ * the caps links so that repeated capability queries for the same session
+ * parameters do not walk the graph again. It is emptied whenever the state of
+ * a plugin changes.
+ */
+
+typedef enum {
+	REJILLA_CAPS_PLAN_LINK		= 1,
+	REJILLA_CAPS_PLAN_FLAGS,
+	REJILLA_CAPS_PLAN_PATH
+} RejillaCapsPlanType;
+
+struct _RejillaCapsPlanKey {
+	RejillaCapsPlanType plan;
+	RejillaTrackType input;
+	RejillaTrackType output;
+	RejillaMedia media;
+	RejillaBurnFlag session_flags;
+	RejillaPluginIOFlag io_flags;
+	gint group_id;
+
+	guint ignore_plugin_errors:1;
+	guint check_session_flags:1;
+};
+typedef struct _RejillaCapsPlanKey RejillaCapsPlanKey;
+
+struct _RejillaCapsPlan {
+	RejillaBurnResult result;
+	RejillaMedia media;
+	RejillaBurnFlag supported;
+	RejillaBurnFlag compulsory;
+	GSList *path;			/* RejillaCapsLinkList */
+};
+typedef struct _RejillaCapsPlan RejillaCapsPlan;
+
 typedef struct RejillaBurnCapsPrivate RejillaBurnCapsPrivate;
 struct RejillaBurnCapsPrivate {
 	GSList *caps_list;		/* RejillaCaps */
@@ -79,6 +121,10 @@ struct RejillaBurnCapsPrivate {
 
 	gchar *group_str;
 	guint group_id;
+
+	GMutex *plan_lock;
+	GHashTable *plans;		/* RejillaCapsPlanKey => RejillaCapsPlan */
+	gint plan_serial;
 };
 
 typedef struct {
@@ -117,6 +163,29 @@ RejillaBurnResult
 rejilla_caps_link_check_recorder_flags_for_input (RejillaCapsLink *link,
                                                   RejillaBurnFlag session_flags);
 
+void
+rejilla_caps_plan_key_init (RejillaCapsPlanKey *key,
+                            RejillaCapsPlanType plan);
+
+GSList *
+rejilla_caps_link_list_copy (GSList *path);
+
+void
+rejilla_caps_link_list_free (GSList *path);
+
+gboolean
+rejilla_burn_caps_plan_lookup (RejillaBurnCaps *self,
+                               const RejillaCapsPlanKey *key,
+                               RejillaCapsPlan *plan);
+
+void
+rejilla_burn_caps_plan_store (RejillaBurnCaps *self,
+                              const RejillaCapsPlanKey *key,
+                              const RejillaCapsPlan *plan);
+
+void
+rejilla_burn_caps_plan_invalidate (void);
+
 G_END_DECLS
 
 #endif /* BURN_CAPS_H */
@@ -0,0 +1,304 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * Librejilla-burn
+ * Copyright (C) Philippe Rouquier 2005-2009 <bonfire-app@wanadoo.fr>
+ *
+ * Librejilla-burn is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The Librejilla-burn authors hereby grant permission for non-GPL compatible
+ * GStreamer plugins to be used and distributed together with GStreamer
+ * and Librejilla-burn. This permission is above and beyond the permissions granted
+ * by the GPL license by which Librejilla-burn is covered. If you modify this code
+ * you may extend this exception to your version of the code, but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version.
+ * 
+ * Librejilla-burn is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to:
+ * 	The Free Software Foundation, Inc.,
+ * 	51 Franklin Street, Fifth Floor
+ * 	Boston, MA  02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "burn-debug.h"
+#include "burn-checksum-store.h"
+#include "rejilla-track.h"
+
+/* Beyond that the least recently used entries are forgotten */
+#define REJILLA_CHECKSUM_STORE_MAX	64
+
+#define REJILLA_CHECKSUM_STORE_KEY_SIZE		"size"
+#define REJILLA_CHECKSUM_STORE_KEY_MTIME	"mtime"
+#define REJILLA_CHECKSUM_STORE_KEY_INODE	"inode"
+#define REJILLA_CHECKSUM_STORE_KEY_DEVICE	"device"
+#define REJILLA_CHECKSUM_STORE_KEY_USED		"used"
+
+G_LOCK_DEFINE_STATIC (store_lock);
+static GKeyFile *store = NULL;
+
+static gchar *
+rejilla_burn_checksum_store_get_path (void)
+{
+	return g_build_filename (g_get_user_cache_dir (),
+				 "rejilla",
+				 "checksums",
+				 NULL);
+}
+
+static GKeyFile *
+rejilla_burn_checksum_store_load (void)
+{
+	gchar *path;
+
+	if (store)
+		return store;
+
+	store = g_key_file_new ();
+	path = rejilla_burn_checksum_store_get_path ();
+	if (!g_key_file_load_from_file (store, path, G_KEY_FILE_NONE, NULL))
+		REJILLA_BURN_LOG ("No checksum stored (%s)", path);
+
+	g_free (path);
+	return store;
+}
+
+static void
+rejilla_burn_checksum_store_save (void)
+{
+	GError *error = NULL;
+	gchar *directory;
+	gchar *data;
+	gsize size;
+	gchar *path;
+
+	data = g_key_file_to_data (store, &size, NULL);
+	if (!data)
+		return;
+
+	path = rejilla_burn_checksum_store_get_path ();
+	directory = g_path_get_dirname (path);
+	g_mkdir_with_parents (directory, S_IRWXU);
+	g_free (directory);
+
+	if (!g_file_set_contents (path, data, size, &error)) {
+		REJILLA_BURN_LOG ("Checksums could not be saved: %s", error->message);
+		g_error_free (error);
+	}
+
+	g_free (path);
+	g_free (data);
+}
+
+static const gchar *
+rejilla_burn_checksum_store_get_key (RejillaChecksumType type)
+{
+	if (type & REJILLA_CHECKSUM_MD5)
+		return "md5";
+	if (type & REJILLA_CHECKSUM_SHA1)
+		return "sha1";
+	if (type & REJILLA_CHECKSUM_SHA256)
+		return "sha256";
+
+	return NULL;
+}
+
+static gchar *
+rejilla_burn_checksum_store_get_group (const gchar *path)
+{
+	gchar *group;
+
+	group = g_strconcat ("Image ", path, NULL);
+
+	/* These can't be part of a group name */
+	g_strdelimit (group, "[]\n", '_');
+	return group;
+}
+
+/* Tells whether the entry describes the file as it is now */
+static gboolean
+rejilla_burn_checksum_store_match (GKeyFile *file,
+				   const gchar *group,
+				   struct stat *info)
+{
+	if (!g_key_file_has_group (file, group))
+		return FALSE;
+
+	if (g_key_file_get_uint64 (file, group, REJILLA_CHECKSUM_STORE_KEY_SIZE, NULL) != (guint64) info->st_size)
+		return FALSE;
+
+	if (g_key_file_get_int64 (file, group, REJILLA_CHECKSUM_STORE_KEY_MTIME, NULL) != (gint64) info->st_mtime)
+		return FALSE;
+
+	if (g_key_file_get_uint64 (file, group, REJILLA_CHECKSUM_STORE_KEY_INODE, NULL) != (guint64) info->st_ino)
+		return FALSE;
+
+	if (g_key_file_get_uint64 (file, group, REJILLA_CHECKSUM_STORE_KEY_DEVICE, NULL) != (guint64) info->st_dev)
+		return FALSE;
+
+	return TRUE;
+}
+
+static void
+rejilla_burn_checksum_store_trim (GKeyFile *file)
+{
+	gchar **groups;
+	gsize num = 0;
+
+	groups = g_key_file_get_groups (file, &num);
+	while (num > REJILLA_CHECKSUM_STORE_MAX) {
+		gint64 oldest_time = G_MAXINT64;
+		gint oldest = -1;
+		gsize i;
+
+		for (i = 0; groups [i]; i ++) {
+			gint64 used;
+
+			if (!groups [i][0])
+				continue;
+
+			used = g_key_file_get_int64 (file, groups [i], REJILLA_CHECKSUM_STORE_KEY_USED, NULL);
+			if (used < oldest_time) {
+				oldest_time = used;
+				oldest = i;
+			}
+		}
+
+		if (oldest < 0)
+			break;
+
+		g_key_file_remove_group (file, groups [oldest], NULL);
+		groups [oldest][0] = '\0';
+		num --;
+	}
+
+	g_strfreev (groups);
+}
+
+/**
+ * rejilla_burn_checksum_store_lookup:
+ * @path: the path of a local image file
+ * @type: a #RejillaChecksumType
+ *
+ * Returns the checksum of type @type computed during a previous run for
+ * @path provided that the file was not modified since then (that is, it has
+ * the same size, modification time, inode and device).
+ *
+ * Return value: a #gchar * or NULL. Free after use.
+ **/
+
+gchar *
+rejilla_burn_checksum_store_lookup (const gchar *path,
+				    RejillaChecksumType type)
+{
+	gchar *checksum = NULL;
+	struct stat info;
+	const gchar *key;
+	GKeyFile *file;
+	gchar *group;
+
+	key = rejilla_burn_checksum_store_get_key (type);
+	if (!key || !path)
+		return NULL;
+
+	if (g_stat (path, &info))
+		return NULL;
+
+	group = rejilla_burn_checksum_store_get_group (path);
+
+	G_LOCK (store_lock);
+
+	file = rejilla_burn_checksum_store_load ();
+	if (rejilla_burn_checksum_store_match (file, group, &info))
+		checksum = g_key_file_get_string (file, group, key, NULL);
+
+	if (checksum) {
+		g_key_file_set_int64 (file, group, REJILLA_CHECKSUM_STORE_KEY_USED, time (NULL));
+		rejilla_burn_checksum_store_save ();
+	}
+
+	G_UNLOCK (store_lock);
+
+	REJILLA_BURN_LOG ("Stored %s checksum for %s: %s", key, path, checksum);
+	g_free (group);
+	return checksum;
+}
+
+/**
+ * rejilla_burn_checksum_store_add:
+ * @path: the path of a local image file
+ * @info: the result of stat () for @path before its checksum was computed
+ * @type: a #RejillaChecksumType
+ * @checksum: the checksum computed
+ *
+ * Remembers @checksum for @path. Nothing is stored if the file was modified
+ * while its checksum was computed.
+ **/
+
+void
+rejilla_burn_checksum_store_add (const gchar *path,
+				 struct stat *info,
+				 RejillaChecksumType type,
+				 const gchar *checksum)
+{
+	struct stat now;
+	const gchar *key;
+	GKeyFile *file;
+	gchar *group;
+
+	key = rejilla_burn_checksum_store_get_key (type);
+	if (!key || !path || !checksum)
+		return;
+
+	if (g_stat (path, &now)
+	||  now.st_size != info->st_size
+	||  now.st_mtime != info->st_mtime
+	||  now.st_ino != info->st_ino
+	||  now.st_dev != info->st_dev) {
+		REJILLA_BURN_LOG ("%s was modified while its checksum was computed", path);
+		return;
+	}
+
+	group = rejilla_burn_checksum_store_get_group (path);
+
+	G_LOCK (store_lock);
+
+	file = rejilla_burn_checksum_store_load ();
+
+	/* Other types of checksum computed before are kept if still valid */
+	if (!rejilla_burn_checksum_store_match (file, group, info))
+		g_key_file_remove_group (file, group, NULL);
+
+	g_key_file_set_uint64 (file, group, REJILLA_CHECKSUM_STORE_KEY_SIZE, info->st_size);
+	g_key_file_set_int64 (file, group, REJILLA_CHECKSUM_STORE_KEY_MTIME, info->st_mtime);
+	g_key_file_set_uint64 (file, group, REJILLA_CHECKSUM_STORE_KEY_INODE, info->st_ino);
+	g_key_file_set_uint64 (file, group, REJILLA_CHECKSUM_STORE_KEY_DEVICE, info->st_dev);
+	g_key_file_set_int64 (file, group, REJILLA_CHECKSUM_STORE_KEY_USED, time (NULL));
+	g_key_file_set_string (file, group, key, checksum);
+
+	rejilla_burn_checksum_store_trim (file);
+	rejilla_burn_checksum_store_save ();
+
+	G_UNLOCK (store_lock);
+
+	REJILLA_BURN_LOG ("Stored %s checksum %s for %s", key, checksum, path);
+	g_free (group);
+}
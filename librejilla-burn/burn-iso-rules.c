@@ -0,0 +1,422 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * Librejilla-burn
+ * Copyright (C) Philippe Rouquier 2005-2009 <bonfire-app@wanadoo.fr>
+ *
+ * Librejilla-burn is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The Librejilla-burn authors hereby grant permission for non-GPL compatible
+ * GStreamer plugins to be used and distributed together with GStreamer
+ * and Librejilla-burn. This permission is above and beyond the permissions granted
+ * by the GPL license by which Librejilla-burn is covered. If you modify this code
+ * you may extend this exception to your version of the code, but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version.
+ * 
+ * Librejilla-burn is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to:
+ * 	The Free Software Foundation, Inc.,
+ * 	51 Franklin Street, Fifth Floor
+ * 	Boston, MA  02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "burn-iso-rules.h"
+
+static gchar
+_d_character (const gchar *character)
+{
+	if (*character >= 'a' && *character <= 'z')
+		return *character - 'a' + 'A';
+
+	if ((*character >= 'A' && *character <= 'Z')
+	||  (*character >= '0' && *character <= '9')
+	||   *character == '_')
+		return *character;
+
+	return '_';
+}
+
+/**
+ * Level 2 allows 30 characters for files (name and extension) and 31 for
+ * directories. @attempt is used to get another name when there is a
+ * collision in a directory.
+ */
+
+gchar *
+rejilla_iso_rules_get_name (const gchar *name,
+			    gboolean is_dir,
+			    guint attempt)
+{
+	const gchar *extension = NULL;
+	const gchar *character;
+	GString *iso_name;
+	GString *ext;
+	guint max;
+
+	if (!is_dir) {
+		extension = strrchr (name, '.');
+		if (extension == name)
+			extension = NULL;
+	}
+
+	iso_name = g_string_new (NULL);
+	for (character = name;
+	     *character && character != extension;
+	     character = g_utf8_next_char (character))
+		g_string_append_c (iso_name, _d_character (character));
+
+	ext = g_string_new (NULL);
+	if (extension) {
+		for (character = extension + 1; *character; character = g_utf8_next_char (character))
+			g_string_append_c (ext, _d_character (character));
+
+		if (ext->len > 8)
+			g_string_truncate (ext, 8);
+	}
+
+	max = is_dir ? 31:30 - ext->len;
+	if (attempt) {
+		gchar *suffix;
+
+		suffix = g_strdup_printf ("~%u", attempt);
+		g_string_truncate (iso_name, MIN (iso_name->len, max - strlen (suffix)));
+		g_string_append (iso_name, suffix);
+		g_free (suffix);
+	}
+	else if (iso_name->len > max)
+		g_string_truncate (iso_name, max);
+
+	if (!iso_name->len)
+		g_string_append_c (iso_name, '_');
+
+	if (!is_dir) {
+		g_string_append_c (iso_name, '.');
+		g_string_append (iso_name, ext->str);
+		g_string_append (iso_name, ";1");
+	}
+
+	g_string_free (ext, TRUE);
+	return g_string_free (iso_name, FALSE);
+}
+
+/**
+ * Joliet allows 64 UCS-2 characters
+ */
+
+gunichar2 *
+rejilla_iso_rules_get_joliet_name (const gchar *name,
+				   gboolean is_dir,
+				   guint attempt,
+				   guint *len)
+{
+	gunichar2 *utf16;
+	glong utf16_len;
+	gunichar2 *result;
+	gchar *suffix;
+	glong suffix_len;
+	glong ext_start;
+	glong ext_len;
+	glong base_len;
+	glong i;
+
+	utf16 = g_utf8_to_utf16 (name, -1, NULL, &utf16_len, NULL);
+	if (!utf16) {
+		/* not valid UTF-8; keep what's ASCII */
+		utf16_len = strlen (name);
+		utf16 = g_new0 (gunichar2, utf16_len + 1);
+		for (i = 0; i < utf16_len; i ++)
+			utf16 [i] = ((guchar) name [i] < 0x80) ? name [i]:'_';
+	}
+
+	for (i = 0; i < utf16_len; i ++) {
+		if (utf16 [i] < 0x20
+		||  utf16 [i] == '*'
+		||  utf16 [i] == '/'
+		||  utf16 [i] == ':'
+		||  utf16 [i] == ';'
+		||  utf16 [i] == '?'
+		||  utf16 [i] == '\\')
+			utf16 [i] = '_';
+	}
+
+	/* keep the extension if there is one (and it's reasonable) */
+	ext_start = utf16_len;
+	if (!is_dir) {
+		for (i = utf16_len - 1; i > 0 && utf16_len - i <= 16; i --) {
+			if (utf16 [i] == '.') {
+				ext_start = i;
+				break;
+			}
+		}
+	}
+	ext_len = utf16_len - ext_start;
+
+	suffix = attempt ? g_strdup_printf ("~%u", attempt):g_strdup ("");
+	suffix_len = strlen (suffix);
+
+	result = g_new0 (gunichar2, 64);
+	base_len = MIN (ext_start, 64 - ext_len - suffix_len);
+	memcpy (result, utf16, base_len * sizeof (gunichar2));
+
+	/* Don't cut a surrogate pair in half */
+	if (base_len && base_len < ext_start
+	&&  utf16 [base_len - 1] >= 0xD800 && utf16 [base_len - 1] < 0xDC00)
+		result [base_len - 1] = '_';
+
+	for (i = 0; i < suffix_len; i ++)
+		result [base_len + i] = suffix [i];
+	base_len += suffix_len;
+	g_free (suffix);
+
+	memcpy (result + base_len, utf16 + ext_start, ext_len * sizeof (gunichar2));
+	*len = base_len + ext_len;
+
+	g_free (utf16);
+	return result;
+}
+
+/* ECMA-119 9.3: names and extensions are compared as if padded with spaces */
+static gint
+_compare_padded (const gchar *str1, gsize len1,
+		 const gchar *str2, gsize len2)
+{
+	gsize i;
+
+	for (i = 0; i < MAX (len1, len2); i ++) {
+		guchar c1 = i < len1 ? str1 [i]:' ';
+		guchar c2 = i < len2 ? str2 [i]:' ';
+
+		if (c1 != c2)
+			return c1 - c2;
+	}
+
+	return 0;
+}
+
+gint
+rejilla_iso_rules_compare_names (const gchar *name1,
+				 const gchar *name2)
+{
+	gsize base1, base2;
+	gsize ext1, ext2;
+	gint result;
+
+	base1 = strcspn (name1, ".;");
+	base2 = strcspn (name2, ".;");
+	result = _compare_padded (name1, base1, name2, base2);
+	if (result)
+		return result;
+
+	name1 += base1;
+	name2 += base2;
+	if (*name1 == '.')
+		name1 ++;
+	if (*name2 == '.')
+		name2 ++;
+
+	ext1 = strcspn (name1, ";");
+	ext2 = strcspn (name2, ";");
+	return _compare_padded (name1, ext1, name2, ext2);
+}
+
+gint
+rejilla_iso_rules_compare_joliet_names (const gunichar2 *name1,
+					guint len1,
+					const gunichar2 *name2,
+					guint len2)
+{
+	guint i;
+
+	for (i = 0; i < MIN (len1, len2); i ++) {
+		if (name1 [i] != name2 [i])
+			return name1 [i] - name2 [i];
+	}
+
+	return (gint) len1 - (gint) len2;
+}
+
+/**
+ * Size of a directory record (without system use entries)
+ */
+
+guint
+rejilla_iso_rules_get_record_size (guint id_len)
+{
+	guint size;
+
+	size = 33 + id_len;
+	return size + (size & 1);
+}
+
+/**
+ * The following write Rock Ridge entries and return their size. If
+ * @buffer is NULL, only the size is returned.
+ */
+
+guint
+rejilla_iso_rules_write_nm (const gchar *name,
+			    guchar *buffer)
+{
+	guint name_len;
+	guint offset = 0;
+
+	/* 250 bytes at most per NM entry */
+	name_len = strlen (name);
+	while (1) {
+		guint len;
+
+		len = MIN (name_len, 250);
+		if (buffer) {
+			buffer [offset] = 'N';
+			buffer [offset + 1] = 'M';
+			buffer [offset + 2] = 5 + len;
+			buffer [offset + 3] = 1;
+			buffer [offset + 4] = (name_len > len) ? 0x01:0x00;
+			memcpy (buffer + offset + 5, name, len);
+		}
+		offset += 5 + len;
+
+		name += len;
+		name_len -= len;
+		if (!name_len)
+			break;
+	}
+
+	return offset;
+}
+
+static void
+_close_sl (guchar *buffer,
+	   guint entry_start,
+	   guint offset,
+	   gboolean continued)
+{
+	if (!buffer)
+		return;
+
+	buffer [entry_start] = 'S';
+	buffer [entry_start + 1] = 'L';
+	buffer [entry_start + 2] = offset - entry_start;
+	buffer [entry_start + 3] = 1;
+	buffer [entry_start + 4] = continued ? 0x01:0x00;
+}
+
+guint
+rejilla_iso_rules_write_sl (const gchar *target,
+			    guchar *buffer)
+{
+	gchar **components;
+	guint entry_start;
+	guint offset;
+	guint i;
+
+	/* Start the first SL entry */
+	entry_start = 0;
+	offset = 5;
+
+	components = g_strsplit (target, G_DIR_SEPARATOR_S, 0);
+	for (i = 0; components [i]; i ++) {
+		const gchar *component = components [i];
+		guint component_len;
+		guint flags;
+
+		if (!component [0]) {
+			/* Only the first one means root */
+			if (i)
+				continue;
+
+			flags = 0x08;
+		}
+		else if (!strcmp (component, "."))
+			flags = 0x02;
+		else if (!strcmp (component, ".."))
+			flags = 0x04;
+		else
+			flags = 0;
+
+		component_len = flags ? 0:strlen (component);
+		do {
+			guint len;
+
+			len = MIN (component_len, 248);
+			if (offset + 2 + len > entry_start + 255) {
+				/* close this SL entry and start another */
+				_close_sl (buffer, entry_start, offset, TRUE);
+				entry_start = offset;
+				offset += 5;
+			}
+
+			if (buffer) {
+				buffer [offset] = flags | ((component_len > len) ? 0x01:0x00);
+				buffer [offset + 1] = len;
+				memcpy (buffer + offset + 2, component, len);
+			}
+			offset += 2 + len;
+
+			component += len;
+			component_len -= len;
+		} while (component_len);
+	}
+	g_strfreev (components);
+
+	_close_sl (buffer, entry_start, offset, FALSE);
+	return offset;
+}
+
+/**
+ * Returns how many bytes of system use entries stay in a record of
+ * @record_size bytes. @fields are the offsets of the end of each entry
+ * (the last one is the total size) and the list ends with 0. What does not
+ * stay there goes to the continuation area, leaving room for a CE entry.
+ */
+
+guint
+rejilla_iso_rules_split_susp (guint record_size,
+			      const guint *fields)
+{
+	guint in_record = 0;
+	guint total = 0;
+	guint i;
+
+	for (i = 0; fields [i]; i ++)
+		total = fields [i];
+
+	if (record_size + total <= 254)
+		return total;
+
+	for (i = 0; fields [i] && record_size + fields [i] + REJILLA_ISO_RULES_CE_SIZE <= 254; i ++)
+		in_record = fields [i];
+
+	return in_record;
+}
+
+/**
+ * Records and continuation entries can't cross a sector boundary. Returns
+ * where something of @size bytes goes when the first free byte is @offset.
+ */
+
+guint32
+rejilla_iso_rules_place (guint32 offset,
+			 guint size)
+{
+	if ((offset % REJILLA_ISO_RULES_SECTOR_SIZE) + size > REJILLA_ISO_RULES_SECTOR_SIZE)
+		return REJILLA_ISO_RULES_BLOCKS (offset) * REJILLA_ISO_RULES_SECTOR_SIZE;
+
+	return offset;
+}
@@ -0,0 +1,110 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * Librejilla-burn
+ * Copyright (C) Philippe Rouquier 2005-2009 <bonfire-app@wanadoo.fr>
+ *
+ * Librejilla-burn is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The Librejilla-burn authors hereby grant permission for non-GPL compatible
+ * GStreamer plugins to be used and distributed together with GStreamer
+ * and Librejilla-burn. This permission is above and beyond the permissions granted
+ * by the GPL license by which Librejilla-burn is covered. If you modify this code
+ * you may extend this exception to your version of the code, but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version.
+ * 
+ * Librejilla-burn is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to:
+ * 	The Free Software Foundation, Inc.,
+ * 	51 Franklin Street, Fifth Floor
+ * 	Boston, MA  02110-1301, USA.
+ */
+
+#ifndef BURN_ISO_RULES_H
+#define BURN_ISO_RULES_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * These are the rules used to lay out ISO9660 level 2 images with Rock
+ * Ridge and Joliet by the iso-writer plugin. The data projects use some of
+ * them to know the largest size of an image.
+ */
+
+#define REJILLA_ISO_RULES_SECTOR_SIZE		2048
+
+/* Longest symlink target that SL entries are used for */
+#define REJILLA_ISO_RULES_MAX_LINK		1024
+
+/* Largest file without several extents (ISO9660 level 3) */
+#define REJILLA_ISO_RULES_MAX_EXTENT		G_GINT64_CONSTANT (0xFFFFF800)
+
+/* Sizes of the Rock Ridge entries */
+#define REJILLA_ISO_RULES_SP_SIZE		7
+#define REJILLA_ISO_RULES_PX_SIZE		36
+#define REJILLA_ISO_RULES_TF_SIZE		26
+#define REJILLA_ISO_RULES_CE_SIZE		28
+
+#define REJILLA_ISO_RULES_ER_ID			"RRIP_1991A"
+#define REJILLA_ISO_RULES_ER_DESCRIPTION	"THE ROCK RIDGE INTERCHANGE PROTOCOL PROVIDES SUPPORT FOR POSIX FILE SYSTEM SEMANTICS"
+#define REJILLA_ISO_RULES_ER_SOURCE		"PLEASE CONTACT DISC PUBLISHER FOR SPECIFICATION SOURCE.  SEE PUBLISHER IDENTIFIER IN PRIMARY VOLUME DESCRIPTOR FOR CONTACT INFORMATION."
+#define REJILLA_ISO_RULES_ER_SIZE		(8 + sizeof (REJILLA_ISO_RULES_ER_ID) - 1 +		\
+						 sizeof (REJILLA_ISO_RULES_ER_DESCRIPTION) - 1 +	\
+						 sizeof (REJILLA_ISO_RULES_ER_SOURCE) - 1)
+
+#define REJILLA_ISO_RULES_BLOCKS(MACRO_bytes)							\
+	((guint32) (((MACRO_bytes) + REJILLA_ISO_RULES_SECTOR_SIZE - 1) / REJILLA_ISO_RULES_SECTOR_SIZE))
+
+gchar *
+rejilla_iso_rules_get_name (const gchar *name,
+			    gboolean is_dir,
+			    guint attempt);
+
+gunichar2 *
+rejilla_iso_rules_get_joliet_name (const gchar *name,
+				   gboolean is_dir,
+				   guint attempt,
+				   guint *len);
+
+gint
+rejilla_iso_rules_compare_names (const gchar *name1,
+				 const gchar *name2);
+
+gint
+rejilla_iso_rules_compare_joliet_names (const gunichar2 *name1,
+					guint len1,
+					const gunichar2 *name2,
+					guint len2);
+
+guint
+rejilla_iso_rules_get_record_size (guint id_len);
+
+guint
+rejilla_iso_rules_write_nm (const gchar *name,
+			    guchar *buffer);
+
+guint
+rejilla_iso_rules_write_sl (const gchar *target,
+			    guchar *buffer);
+
+guint
+rejilla_iso_rules_split_susp (guint record_size,
+			      const guint *fields);
+
+guint32
+rejilla_iso_rules_place (guint32 offset,
+			 guint size);
+
+G_END_DECLS
+
+#endif /* BURN_ISO_RULES_H */
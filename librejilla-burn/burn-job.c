@@ -1908,6 +1908,19 @@ rejilla_job_set_rate (RejillaJob *self,
 	return rejilla_task_ctx_set_rate (priv->ctx, rate);
 }
 
+RejillaBurnResult
+rejilla_job_set_buffer_fill (RejillaJob *self,
+			     gint fill)
+{
+	RejillaJobPrivate *priv;
+
+	priv = REJILLA_JOB_PRIVATE (self);
+	if (priv->next)
+		return REJILLA_BURN_NOT_RUNNING;
+
+	return rejilla_task_ctx_set_buffer_fill (priv->ctx, fill);
+}
+
 RejillaBurnResult
 rejilla_job_set_output_size_for_current_track (RejillaJob *self,
 					       goffset sectors,
@@ -265,6 +265,9 @@ RejillaBurnResult
 rejilla_job_set_rate (RejillaJob *job,
 		      gint64 rate);
 RejillaBurnResult
+rejilla_job_set_buffer_fill (RejillaJob *job,
+			     gint fill);
+RejillaBurnResult
 rejilla_job_set_written_track (RejillaJob *job,
 			       goffset written);
 RejillaBurnResult
@@ -58,18 +58,19 @@ struct _RejillaMkisofsBase {
 	gint grafts_fd;
 	gint excluded_fd;
 
-	GHashTable *grafts;
+	/* Lines are escaped into these and written by large blocks */
+	GString *grafts_buffer;
+	GString *excluded_buffer;
+
+	GPtrArray *grafts;
 
 	guint found_video_ts:1;
 	guint use_joliet:1;
 };
 typedef struct _RejillaMkisofsBase RejillaMkisofsBase;
 
-struct _RejillaWriteGraftData {
-	RejillaMkisofsBase *base;
-	GError **error;
-};
-typedef struct _RejillaWriteGraftData RejillaWriteGraftData;
+/* Size from which a buffer is written to its file */
+#define REJILLA_MKISOFS_BASE_BUFFER_SIZE	65536
 
 static void
 rejilla_mkisofs_base_clean (RejillaMkisofsBase *base)
@@ -82,53 +83,119 @@ rejilla_mkisofs_base_clean (RejillaMkisofsBase *base)
 		close (base->grafts_fd);
 	if (base->excluded_fd)
 		close (base->excluded_fd);
+	if (base->grafts_buffer) {
+		g_string_free (base->grafts_buffer, TRUE);
+		base->grafts_buffer = NULL;
+	}
+	if (base->excluded_buffer) {
+		g_string_free (base->excluded_buffer, TRUE);
+		base->excluded_buffer = NULL;
+	}
 	if (base->grafts) {
-		g_hash_table_destroy (base->grafts);
+		g_ptr_array_free (base->grafts, TRUE);
 		base->grafts = NULL;
 	}
 }
 
 static RejillaBurnResult
-_write_line (int fd, const gchar *filepath, GError **error)
+_flush_lines (int fd, GString *buffer, GError **error)
 {
-	gint len;
-	gint w_len;
+	gsize written = 0;
+
+	while (written < buffer->len) {
+		gssize w_len;
+
+		w_len = write (fd, buffer->str + written, buffer->len - written);
+		if (w_len < 0) {
+			if (errno == EINTR)
+				continue;
+
+			g_set_error (error,
+				     REJILLA_BURN_ERROR,
+				     REJILLA_BURN_ERROR_GENERAL,
+				     "%s",
+				     g_strerror (errno));
+			return REJILLA_BURN_ERR;
+		}
 
-	if (lseek (fd, 0, SEEK_CUR)
-	&&  write (fd, "\n", 1) != 1) {
-		g_set_error (error,
-			     REJILLA_BURN_ERROR,
-			     REJILLA_BURN_ERROR_GENERAL,
-			     "%s",
-			     g_strerror (errno));
-		return REJILLA_BURN_ERR;
+		written += w_len;
 	}
 
-	len = strlen (filepath);
-	w_len = write (fd, filepath, len);
+	g_string_truncate (buffer, 0);
+	return REJILLA_BURN_OK;
+}
+
+static RejillaBurnResult
+_end_line (int fd, GString *buffer, GError **error)
+{
+	g_string_append_c (buffer, '\n');
+	if (buffer->len < REJILLA_MKISOFS_BASE_BUFFER_SIZE)
+		return REJILLA_BURN_OK;
 
-	if (w_len != len) {
-		g_set_error (error,
-			     REJILLA_BURN_ERROR,
-			     REJILLA_BURN_ERROR_GENERAL,
-			     "%s",
-			     g_strerror (errno));
-		return REJILLA_BURN_ERR;
+	return _flush_lines (fd, buffer, error);
+}
+
+/**
+ * Paths are sorted so that a directory is immediately followed by its
+ * contents, which is also the order of the files on the disc.
+ */
+
+static gint
+_compare_paths (const gchar *path1, const gchar *path2)
+{
+	while (*path1 && *path1 == *path2) {
+		path1 ++;
+		path2 ++;
 	}
 
-	return REJILLA_BURN_OK;
+	if (*path1 == *path2)
+		return 0;
+
+	/* The separator goes before any other character */
+	if (*path1 == G_DIR_SEPARATOR)
+		return *path2 ? -1:1;
+	if (*path2 == G_DIR_SEPARATOR)
+		return *path1 ? 1:-1;
+
+	return (guchar) *path1 - (guchar) *path2;
 }
 
-static RejillaBurnResult
-rejilla_mkisofs_base_write_excluded (RejillaMkisofsBase *base,
-				     const gchar *uri,
+static gint
+_compare_paths_cb (gconstpointer a, gconstpointer b)
+{
+	return _compare_paths (*(const gchar **) a, *(const gchar **) b);
+}
+
+static gint
+_compare_grafts_cb (gconstpointer a, gconstpointer b)
+{
+	const RejillaGraftPt *graft1 = *(const RejillaGraftPt **) a;
+	const RejillaGraftPt *graft2 = *(const RejillaGraftPt **) b;
+
+	/* This is an error which will be reported when writing */
+	if (!graft1->path || !graft2->path)
+		return (graft1->path != NULL) - (graft2->path != NULL);
+
+	return _compare_paths (graft1->path, graft2->path);
+}
+
+static gboolean
+_is_parent_path (const gchar *parent, const gchar *path)
+{
+	gsize len;
+
+	len = strlen (parent);
+	if (strncmp (parent, path, len))
+		return FALSE;
+
+	return (path [len] == G_DIR_SEPARATOR || parent [len - 1] == G_DIR_SEPARATOR);
+}
+
+static gchar *
+rejilla_mkisofs_base_get_local_path (const gchar *uri,
 				     GError **error)
 {
-	gint num;
-	gint forbidden;
-	gchar *character;
 	gchar *localpath;
-	RejillaBurnResult result = REJILLA_BURN_OK;
 
 	/* make sure uri is local: otherwise error out */
 	/* FIXME: uri can be path or URI? problem with graft->uri */
@@ -151,133 +218,48 @@ rejilla_mkisofs_base_write_excluded (RejillaMkisofsBase *base,
 			     REJILLA_BURN_ERROR,
 			     REJILLA_BURN_ERROR_FILE_NOT_LOCAL,
 			     _("The file is not stored locally"));
-		return REJILLA_BURN_ERR;
+		return NULL;
 	}
 
-	if (!localpath) {
+	if (!localpath)
 		REJILLA_BURN_LOG ("Localpath is NULL");
-		return REJILLA_BURN_ERR;
-	}
+
+	return localpath;
+}
+
+static RejillaBurnResult
+rejilla_mkisofs_base_write_excluded (RejillaMkisofsBase *base,
+				     const gchar *localpath,
+				     GError **error)
+{
+	const gchar *character;
 
 	/* we need to escape some characters like []\? since in this file we
 	 * can use glob like expressions. */
-	character = localpath;
-	forbidden = 0;
-	num = 0;
-
-	while (character [0]) {
+	for (character = localpath; character [0]; character ++) {
 		if (character [0] == '['
 		||  character [0] == ']'
 		||  character [0] == '?'
 		||  character [0] == '\\')
-			forbidden++;
-
-		num++;
-		character++;
-	}
-
-	if (forbidden) {
-		gchar *tmp;
-		gint i;
-
-		tmp = g_new0 (gchar, num + forbidden + 1);
-		character = tmp;
-
-		for (i = 0; i < num; i++) {
-			if (localpath [i] == '['
-			||  localpath [i] == ']'
-			||  localpath [i] == '?'
-			||  localpath [i] == '\\') {
-				character [i] = '\\';
-				character++;
-			}
-			character [i] = localpath [i];
-		}
+			g_string_append_c (base->excluded_buffer, '\\');
 
-		REJILLA_BURN_LOG ("Escaped path %s into %s", localpath, tmp);
-		g_free (localpath);
-		localpath = tmp;
+		g_string_append_c (base->excluded_buffer, character [0]);
 	}
 
-	/* we just ignore if localpath is NULL:
-	 * - it could be a non local whose graft point couldn't be downloaded */
-	if (localpath)
-		result = _write_line (base->excluded_fd, localpath, error);
-
-	g_free (localpath);
-	return result;
+	return _end_line (base->excluded_fd, base->excluded_buffer, error);
 }
 
-static gchar *
-_escape_path (const gchar *str)
+static void
+_append_escaped_path (GString *buffer, const gchar *str)
 {
-	gchar *escaped, *d;
 	const gchar *s;
-	gint len;
 
-	s = str;
-	len = 1;
-	while (*s != 0) {
-		if (*s == '\\' || *s == '=') {
-			len++;
-		}
+	for (s = str; *s != 0; s++) {
+		if (*s == '\\' || *s == '=')
+			g_string_append_c (buffer, '\\');
 
-		len++;
-		s++;
+		g_string_append_c (buffer, *s);
 	}
-
-	escaped = g_malloc (len);
-
-	s = str;
-	d = escaped;
-	while (*s != 0) {
-		if (*s == '\\' || *s == '=') {
-			*d++ = '\\';
-		}
-
-		*d++ = *s++;
-	}
-	*d = 0;
-
-	return escaped;
-}
-
-static gchar *
-_build_graft_point (const gchar *uri, const gchar *discpath)
-{
-	gchar *escaped_discpath;
-	gchar *graft_point;
-	gchar *path;
-
-	if (uri == NULL || discpath == NULL)
-		return NULL;
-
-	/* make up the graft point */
-	if (*uri != '/')
-		path = g_filename_from_uri (uri, NULL, NULL);
-	else
-		path = g_strdup (uri);
-
-	if (discpath) {
-		gchar *escaped_path;
-
-		/* There is a graft because either it's not at the root of the 
-		 * disc or because its name has changed. */
-		escaped_path = _escape_path (path);
-		g_free (path);
-
-		escaped_discpath = _escape_path (discpath);
-		graft_point = g_strconcat (escaped_discpath,
-					   "=",
-					   escaped_path,
-					   NULL);
-		g_free (escaped_path);
-		g_free (escaped_discpath);
-	}
-	else
-		graft_point = path;
-
-	return graft_point;
 }
 
 static RejillaBurnResult
@@ -286,12 +268,9 @@ rejilla_mkisofs_base_write_graft (RejillaMkisofsBase *base,
 				  const gchar *disc_path,
 				  GError **error)
 {
-	gchar *graft_point;
-	RejillaBurnResult result;
+	gchar *path;
 
-	/* build up graft and write it */
-	graft_point = _build_graft_point (uri, disc_path);
-	if (!graft_point) {
+	if (uri == NULL || disc_path == NULL) {
 		g_set_error (error,
 			     REJILLA_BURN_ERROR,
 			     REJILLA_BURN_ERROR_GENERAL,
@@ -303,65 +282,161 @@ rejilla_mkisofs_base_write_graft (RejillaMkisofsBase *base,
 		return REJILLA_BURN_ERR;
 	}
 
-	result = _write_line (base->grafts_fd, graft_point, error);
-	g_free (graft_point);
-	if (result != REJILLA_BURN_OK)
-		return result;
+	/* make up the graft point. There is a graft because either it's
+	 * not at the root of the disc or because its name has changed. */
+	if (*uri != '/')
+		path = g_filename_from_uri (uri, NULL, NULL);
+	else
+		path = g_strdup (uri);
 
-	return REJILLA_BURN_OK;
+	_append_escaped_path (base->grafts_buffer, disc_path);
+	g_string_append_c (base->grafts_buffer, '=');
+	if (path)
+		_append_escaped_path (base->grafts_buffer, path);
+	g_free (path);
+
+	return _end_line (base->grafts_fd, base->grafts_buffer, error);
 }
 
-static gboolean
-_foreach_write_grafts (const gchar *uri,
-		       GSList *grafts,
-		       RejillaWriteGraftData *data)
+static RejillaBurnResult
+rejilla_mkisofs_base_write_grafts (RejillaMkisofsBase *base,
+				   GError **error)
 {
-	RejillaBurnResult result;
-	RejillaGraftPt *graft;
-
-	for (; grafts; grafts = grafts->next) {
-		graft = grafts->data;
-
-		if (!graft->path) {
-			result = rejilla_mkisofs_base_write_graft (data->base,
-								   graft->uri,
-								   NULL,
-								   data->error);
-			if (result != REJILLA_BURN_OK)
-				return TRUE;
+	guint i;
 
-			continue;
-		}
+	g_ptr_array_sort (base->grafts, _compare_grafts_cb);
+	for (i = 0; i < base->grafts->len; i ++) {
+		RejillaGraftPt *graft;
+		RejillaBurnResult result;
 
-		result = rejilla_mkisofs_base_write_graft (data->base,
+		graft = g_ptr_array_index (base->grafts, i);
+		result = rejilla_mkisofs_base_write_graft (base,
 							   graft->uri,
 							   graft->path,
-							   data->error);
+							   error);
 		if (result != REJILLA_BURN_OK)
-			return TRUE;
+			return result;
+	}
+
+	return REJILLA_BURN_OK;
+}
+
+/**
+ * An excluded path doesn't need to be written if one of its parents is
+ * excluded as well unless a graft is this parent or is inside it (the
+ * graft would bring the path back).
+ */
+
+static gboolean
+_has_graft_inside (GPtrArray *graft_paths,
+		   const gchar *path)
+{
+	const gchar *graft;
+	guint start = 0;
+	guint end = graft_paths->len;
+
+	/* look for the first graft path which is not before path: it is
+	 * either path itself or, if any, the first path inside it */
+	while (start < end) {
+		guint middle;
+
+		middle = (start + end) / 2;
+		if (_compare_paths (g_ptr_array_index (graft_paths, middle), path) < 0)
+			start = middle + 1;
+		else
+			end = middle;
 	}
 
-	return FALSE;
+	if (start >= graft_paths->len)
+		return FALSE;
+
+	graft = g_ptr_array_index (graft_paths, start);
+	return (!strcmp (graft, path) || _is_parent_path (path, graft));
 }
 
 static RejillaBurnResult
-rejilla_mkisofs_base_write_grafts (RejillaMkisofsBase *base,
-				   GError **error)
+rejilla_mkisofs_base_write_excluded_list (RejillaMkisofsBase *base,
+					  GSList *grafts,
+					  GSList *excluded,
+					  GError **error)
 {
-	RejillaWriteGraftData callback_data;
-	gpointer result;
+	RejillaBurnResult result = REJILLA_BURN_OK;
+	GPtrArray *graft_paths;
+	GStringChunk *chunk;
+	const gchar *covering;
+	GPtrArray *paths;
+	guint skipped = 0;
+	guint i;
 
-	callback_data.error = error;
-	callback_data.base = base;
+	chunk = g_string_chunk_new (65536);
 
-	result = g_hash_table_find (base->grafts,
-				    (GHRFunc) _foreach_write_grafts,
-				    &callback_data);
+	paths = g_ptr_array_new ();
+	for (; excluded; excluded = excluded->next) {
+		gchar *localpath;
 
-	if (result)
-		return REJILLA_BURN_ERR;
+		if (!excluded->data) {
+			REJILLA_BURN_LOG ("NULL URI");
+			continue;
+		}
 
-	return REJILLA_BURN_OK;
+		localpath = rejilla_mkisofs_base_get_local_path (excluded->data, error);
+		if (!localpath) {
+			result = REJILLA_BURN_ERR;
+			goto end;
+		}
+
+		g_ptr_array_add (paths, g_string_chunk_insert (chunk, localpath));
+		g_free (localpath);
+	}
+
+	/* NOTE: video grafts are not in base->grafts */
+	graft_paths = g_ptr_array_new ();
+	for (; grafts; grafts = grafts->next) {
+		RejillaGraftPt *graft;
+		gchar *localpath;
+
+		graft = grafts->data;
+		if (!graft->uri)
+			continue;
+
+		localpath = rejilla_mkisofs_base_get_local_path (graft->uri, NULL);
+		if (localpath) {
+			g_ptr_array_add (graft_paths, g_string_chunk_insert (chunk, localpath));
+			g_free (localpath);
+		}
+	}
+
+	g_ptr_array_sort (paths, _compare_paths_cb);
+	g_ptr_array_sort (graft_paths, _compare_paths_cb);
+
+	covering = NULL;
+	for (i = 0; i < paths->len; i ++) {
+		const gchar *localpath;
+
+		localpath = g_ptr_array_index (paths, i);
+		if (covering
+		&& (!strcmp (covering, localpath) || _is_parent_path (covering, localpath))) {
+			skipped ++;
+			continue;
+		}
+
+		result = rejilla_mkisofs_base_write_excluded (base, localpath, error);
+		if (result != REJILLA_BURN_OK)
+			break;
+
+		/* If a graft lies inside, it can't be used to skip its
+		 * children since they could be included again. */
+		covering = _has_graft_inside (graft_paths, localpath)? NULL:localpath;
+	}
+
+	REJILLA_BURN_LOG ("%i excluded paths were not written (already excluded with a parent)", skipped);
+	g_ptr_array_free (graft_paths, TRUE);
+
+end:
+
+	g_ptr_array_free (paths, TRUE);
+	g_string_chunk_free (chunk);
+	return result;
 }
 
 static RejillaBurnResult
@@ -393,8 +468,6 @@ rejilla_mkisofs_base_empty_directory (RejillaMkisofsBase *base,
 				      const gchar *disc_path,
 				      GError **error)
 {
-	RejillaBurnResult result;
-	gchar *graft_point;
 
 	/* This is a special case when the URI is NULL which can happen mainly
 	 * when we have to deal with burn:// uri. */
@@ -414,11 +487,10 @@ rejilla_mkisofs_base_empty_directory (RejillaMkisofsBase *base,
 	}
 
 	/* Special case for uri = NULL; that is treated as if it were a directory */
-	graft_point = _build_graft_point (base->emptydir, disc_path);
-	result = _write_line (base->grafts_fd, graft_point, error);
-	g_free (graft_point);
-
-	return result;
+	return rejilla_mkisofs_base_write_graft (base,
+						 base->emptydir,
+						 disc_path,
+						 error);
 }
 
 static RejillaBurnResult
@@ -480,8 +552,6 @@ rejilla_mkisofs_base_add_graft (RejillaMkisofsBase *base,
 				RejillaGraftPt *graft,
 				GError **error)
 {
-	GSList *list;
-
 	/* check the file is local */
 	if (graft->uri
 	&&  graft->uri [0] != '/'
@@ -543,13 +613,7 @@ rejilla_mkisofs_base_add_graft (RejillaMkisofsBase *base,
 	}
 
 	/* add the graft point */
-	list = g_hash_table_lookup (base->grafts, graft->uri);
-	if (list)
-		g_hash_table_steal (base->grafts, graft->uri);
-
-	list = g_slist_prepend (list, graft);
-	g_hash_table_insert (base->grafts, graft->uri, list);
-
+	g_ptr_array_add (base->grafts, graft);
 	return REJILLA_BURN_OK;
 }
 
@@ -563,8 +627,7 @@ rejilla_mkisofs_base_write_to_files (GSList *grafts,
 				     const gchar *excluded_path,
 				     GError **error)
 {
-	gchar *uri;
-	GSList *grafts_excluded;
+	GSList *grafts_list = grafts;
 	RejillaMkisofsBase base;
 	RejillaBurnResult result;
 
@@ -601,19 +664,13 @@ rejilla_mkisofs_base_write_to_files (GSList *grafts,
 	base.emptydir = emptydir;
 	base.videodir = videodir;
 
-	base.grafts = g_hash_table_new_full (g_str_hash,
-					     g_str_equal,
-					     NULL,
-					    (GDestroyNotify) g_slist_free);
-
-	/* we analyse the graft points:
-	 * first add graft points and excluded. At the same time create a hash 
-	 * table in which key = uri and value = graft points, a list of all
-	 * the uris that have been excluded.
-	 * Once finished, for each excluded use the hash to see if there are not
-	 * other paths at which the excluded uri must appear. If so, create an
-	 * explicit graft point. */
-	grafts_excluded = NULL;
+	base.grafts_buffer = g_string_sized_new (REJILLA_MKISOFS_BASE_BUFFER_SIZE + 4096);
+	base.excluded_buffer = g_string_sized_new (REJILLA_MKISOFS_BASE_BUFFER_SIZE + 4096);
+	base.grafts = g_ptr_array_new ();
+
+	/* we analyse the graft points: first the special ones (empty
+	 * directories and video) are handled, the others are collected
+	 * to be written sorted by their path on the disc. */
 	for (; grafts; grafts = grafts->next) {
 		RejillaGraftPt *graft;
 
@@ -644,7 +701,8 @@ rejilla_mkisofs_base_write_to_files (GSList *grafts,
 			     REJILLA_BURN_ERROR,
 			     REJILLA_BURN_ERROR_GENERAL,
 			     _("VIDEO_TS directory is missing or invalid"));
-		return REJILLA_BURN_ERR;
+		result = REJILLA_BURN_ERR;
+		goto cleanup;
 	}
 
 	/* write the grafts list */
@@ -652,20 +710,18 @@ rejilla_mkisofs_base_write_to_files (GSList *grafts,
 	if (result != REJILLA_BURN_OK)
 		goto cleanup;
 
+	result = _flush_lines (base.grafts_fd, base.grafts_buffer, error);
+	if (result != REJILLA_BURN_OK)
+		goto cleanup;
+
 	/* write the global excluded files list */
-	for (; excluded; excluded = excluded->next) {
-		uri = excluded->data;
-		if (!uri) {
-			REJILLA_BURN_LOG ("NULL URI");
-			continue;
-		}
+	result = rejilla_mkisofs_base_write_excluded_list (&base, grafts_list, excluded, error);
+	if (result != REJILLA_BURN_OK)
+		goto cleanup;
 
-		result = rejilla_mkisofs_base_write_excluded (&base,
-							      uri,
-							      error);
-		if (result != REJILLA_BURN_OK)
-			goto cleanup;
-	}
+	result = _flush_lines (base.excluded_fd, base.excluded_buffer, error);
+	if (result != REJILLA_BURN_OK)
+		goto cleanup;
 
 	rejilla_mkisofs_base_clean (&base);
 	return REJILLA_BURN_OK;
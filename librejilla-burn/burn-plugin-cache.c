@@ -0,0 +1,362 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * Librejilla-burn
+ * Copyright (C) Philippe Rouquier 2005-2009 <bonfire-app@wanadoo.fr>
+ *
+ * Librejilla-burn is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The Librejilla-burn authors hereby grant permission for non-GPL compatible
+ * GStreamer plugins to be used and distributed together with GStreamer
+ * and Librejilla-burn. This permission is above and beyond the permissions granted
+ * by the GPL license by which Librejilla-burn is covered. If you modify this code
+ * you may extend this exception to your version of the code, but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version.
+ * 
+ * Librejilla-burn is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to:
+ * 	The Free Software Foundation, Inc.,
+ * 	51 Franklin Street, Fifth Floor
+ * 	Boston, MA  02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <gst/gst.h>
+
+#include "burn-debug.h"
+#include "burn-plugin-cache.h"
+#include "rejilla-plugin.h"
+#include "rejilla-plugin-information.h"
+#include "rejilla-plugin-registration.h"
+
+#define REJILLA_PLUGIN_CACHE_KEY_MODULE		"module"
+#define REJILLA_PLUGIN_CACHE_KEY_DEPENDENCIES	"dependencies"
+#define REJILLA_PLUGIN_CACHE_KEY_FINGERPRINTS	"fingerprints"
+#define REJILLA_PLUGIN_CACHE_KEY_ERROR_TYPES	"error-types"
+#define REJILLA_PLUGIN_CACHE_KEY_ERROR_DETAILS	"error-details"
+
+G_LOCK_DEFINE_STATIC (cache_lock);
+static GKeyFile *cache = NULL;
+static guint save_id = 0;
+
+static gchar *
+rejilla_plugin_cache_get_path (void)
+{
+	return g_build_filename (g_get_user_cache_dir (),
+				 "rejilla",
+				 "plugins",
+				 NULL);
+}
+
+static GKeyFile *
+rejilla_plugin_cache_load (void)
+{
+	gchar *path;
+
+	if (cache)
+		return cache;
+
+	cache = g_key_file_new ();
+	path = rejilla_plugin_cache_get_path ();
+	if (!g_key_file_load_from_file (cache, path, G_KEY_FILE_NONE, NULL))
+		REJILLA_BURN_LOG ("No plugin cache (%s)", path);
+
+	g_free (path);
+	return cache;
+}
+
+static gboolean
+rejilla_plugin_cache_save_cb (gpointer user_data)
+{
+	GError *error = NULL;
+	gchar *directory;
+	gchar *data;
+	gsize size;
+	gchar *path;
+
+	G_LOCK (cache_lock);
+	save_id = 0;
+	data = g_key_file_to_data (cache, &size, NULL);
+	G_UNLOCK (cache_lock);
+
+	if (!data)
+		return FALSE;
+
+	path = rejilla_plugin_cache_get_path ();
+	directory = g_path_get_dirname (path);
+	g_mkdir_with_parents (directory, S_IRWXU);
+	g_free (directory);
+
+	if (!g_file_set_contents (path, data, size, &error)) {
+		REJILLA_BURN_LOG ("Plugin cache could not be saved: %s", error->message);
+		g_error_free (error);
+	}
+
+	g_free (path);
+	g_free (data);
+	return FALSE;
+}
+
+static gchar *
+rejilla_plugin_cache_get_group (RejillaPlugin *plugin)
+{
+	return g_strconcat ("Plugin ", rejilla_plugin_get_name (plugin), NULL);
+}
+
+static gchar *
+rejilla_plugin_cache_file_fingerprint (const gchar *path)
+{
+	struct stat info;
+
+	/* Don't follow symlinks: rejilla_plugin_test_app () refuses them */
+	if (g_lstat (path, &info))
+		return g_strdup ("none");
+
+	return g_strdup_printf ("%s %" G_GINT64_FORMAT " %" G_GINT64_FORMAT,
+				path,
+				(gint64) info.st_mtime,
+				(gint64) info.st_size);
+}
+
+/**
+ * Returns a string summing up the state of a dependency as seen by
+ * rejilla_plugin_test_app () or rejilla_plugin_test_gstreamer_plugin ().
+ * Whenever it changes, the check must be run again. None of this requires
+ * spawning a program or loading a GStreamer plugin.
+ */
+
+static gchar *
+rejilla_plugin_cache_get_fingerprint (const gchar *dependency)
+{
+	if (g_str_has_prefix (dependency, "app:")) {
+		gchar *fingerprint;
+		gchar *prog_path;
+
+		prog_path = g_find_program_in_path (dependency + 4);
+		if (!prog_path)
+			return g_strdup ("none");
+
+		fingerprint = rejilla_plugin_cache_file_fingerprint (prog_path);
+		g_free (prog_path);
+		return fingerprint;
+	}
+
+	if (g_str_has_prefix (dependency, "gst:")) {
+		GstPluginFeature *feature;
+
+		feature = gst_registry_find_feature (gst_registry_get_default (),
+						     dependency + 4,
+						     GST_TYPE_ELEMENT_FACTORY);
+		if (!feature)
+			return g_strdup ("none");
+
+		gst_object_unref (feature);
+		return g_strdup ("found");
+	}
+
+	return NULL;
+}
+
+/**
+ * rejilla_plugin_cache_restore:
+ * @plugin: a #RejillaPlugin
+ * @path: the path of the module of @plugin
+ *
+ * If the cached result of the last configuration check of @plugin is still
+ * valid, sets the errors it found on @plugin.
+ *
+ * Returns: %TRUE if the cache could be used, %FALSE if the configuration
+ * must be checked.
+ **/
+
+gboolean
+rejilla_plugin_cache_restore (RejillaPlugin *plugin,
+			      const gchar *path)
+{
+	gchar **fingerprints = NULL;
+	gchar **dependencies = NULL;
+	gchar **details = NULL;
+	gboolean valid = FALSE;
+	gint *types = NULL;
+	gsize types_num = 0;
+	gsize details_num;
+	gchar *fingerprint;
+	gsize num;
+	GKeyFile *file;
+	gchar *group;
+	gchar *value;
+	gsize i;
+
+	G_LOCK (cache_lock);
+
+	file = rejilla_plugin_cache_load ();
+	group = rejilla_plugin_cache_get_group (plugin);
+	if (!g_key_file_has_group (file, group))
+		goto end;
+
+	/* The module itself must not have changed */
+	value = g_key_file_get_string (file, group, REJILLA_PLUGIN_CACHE_KEY_MODULE, NULL);
+	fingerprint = rejilla_plugin_cache_file_fingerprint (path);
+	valid = (value && !strcmp (value, fingerprint));
+	g_free (fingerprint);
+	g_free (value);
+
+	if (!valid)
+		goto end;
+
+	/* Nor any of the programs or elements it depends on */
+	dependencies = g_key_file_get_string_list (file, group, REJILLA_PLUGIN_CACHE_KEY_DEPENDENCIES, &num, NULL);
+	fingerprints = g_key_file_get_string_list (file, group, REJILLA_PLUGIN_CACHE_KEY_FINGERPRINTS, &i, NULL);
+	if (i != num) {
+		valid = FALSE;
+		goto end;
+	}
+
+	for (i = 0; i < num && valid; i++) {
+		fingerprint = rejilla_plugin_cache_get_fingerprint (dependencies [i]);
+		valid = (fingerprint && !strcmp (fingerprint, fingerprints [i]));
+		g_free (fingerprint);
+	}
+
+	if (!valid)
+		goto end;
+
+	if (g_key_file_has_key (file, group, REJILLA_PLUGIN_CACHE_KEY_ERROR_TYPES, NULL)) {
+		types = g_key_file_get_integer_list (file, group, REJILLA_PLUGIN_CACHE_KEY_ERROR_TYPES, &types_num, NULL);
+		details = g_key_file_get_string_list (file, group, REJILLA_PLUGIN_CACHE_KEY_ERROR_DETAILS, &details_num, NULL);
+		if (!types || !details || types_num != details_num) {
+			valid = FALSE;
+			goto end;
+		}
+	}
+
+	/* Errors are prepended so add them in reverse order to get the same
+	 * list as the one that was saved */
+	for (i = types_num; i > 0; i--)
+		rejilla_plugin_add_error (plugin,
+					  types [i - 1],
+					  details [i - 1][0] != '\0'? details [i - 1]:NULL);
+
+	REJILLA_BURN_LOG ("Configuration of %s restored from cache", rejilla_plugin_get_name (plugin));
+
+end:
+
+	G_UNLOCK (cache_lock);
+
+	g_strfreev (dependencies);
+	g_strfreev (fingerprints);
+	g_strfreev (details);
+	g_free (types);
+	g_free (group);
+
+	return valid;
+}
+
+/**
+ * rejilla_plugin_cache_store:
+ * @plugin: a #RejillaPlugin
+ * @path: the path of the module of @plugin
+ * @dependencies: a #GSList of strings naming what the check probed
+ *
+ * Saves the errors the last configuration check found for @plugin.
+ **/
+
+void
+rejilla_plugin_cache_store (RejillaPlugin *plugin,
+			    const gchar *path,
+			    GSList *dependencies)
+{
+	GPtrArray *fingerprints;
+	GPtrArray *names;
+	GPtrArray *details;
+	GArray *types;
+	GKeyFile *file;
+	gchar *group;
+	gchar *value;
+	GSList *iter;
+
+	names = g_ptr_array_new ();
+	fingerprints = g_ptr_array_new_with_free_func (g_free);
+	for (iter = dependencies; iter; iter = iter->next) {
+		gchar *fingerprint;
+
+		fingerprint = rejilla_plugin_cache_get_fingerprint (iter->data);
+		if (!fingerprint)
+			continue;
+
+		g_ptr_array_add (names, iter->data);
+		g_ptr_array_add (fingerprints, fingerprint);
+	}
+
+	types = g_array_new (FALSE, FALSE, sizeof (gint));
+	details = g_ptr_array_new ();
+	for (iter = rejilla_plugin_get_errors (plugin); iter; iter = iter->next) {
+		RejillaPluginError *error;
+		gint type;
+
+		error = iter->data;
+		type = error->type;
+		g_array_append_val (types, type);
+		g_ptr_array_add (details, error->detail? error->detail:"");
+	}
+
+	G_LOCK (cache_lock);
+
+	file = rejilla_plugin_cache_load ();
+	group = rejilla_plugin_cache_get_group (plugin);
+	g_key_file_remove_group (file, group, NULL);
+
+	value = rejilla_plugin_cache_file_fingerprint (path);
+	g_key_file_set_string (file, group, REJILLA_PLUGIN_CACHE_KEY_MODULE, value);
+	g_free (value);
+
+	g_key_file_set_string_list (file, group,
+				    REJILLA_PLUGIN_CACHE_KEY_DEPENDENCIES,
+				    (const gchar * const *) names->pdata,
+				    names->len);
+	g_key_file_set_string_list (file, group,
+				    REJILLA_PLUGIN_CACHE_KEY_FINGERPRINTS,
+				    (const gchar * const *) fingerprints->pdata,
+				    fingerprints->len);
+
+	if (types->len) {
+		g_key_file_set_integer_list (file, group,
+					     REJILLA_PLUGIN_CACHE_KEY_ERROR_TYPES,
+					     (gint *) types->data,
+					     types->len);
+		g_key_file_set_string_list (file, group,
+					    REJILLA_PLUGIN_CACHE_KEY_ERROR_DETAILS,
+					    (const gchar * const *) details->pdata,
+					    details->len);
+	}
+
+	/* Plugins are checked in a row so write them all at once */
+	if (!save_id)
+		save_id = g_idle_add (rejilla_plugin_cache_save_cb, NULL);
+
+	G_UNLOCK (cache_lock);
+
+	g_free (group);
+	g_array_free (types, TRUE);
+	g_ptr_array_free (details, TRUE);
+	g_ptr_array_free (names, TRUE);
+	g_ptr_array_free (fingerprints, TRUE);
+}
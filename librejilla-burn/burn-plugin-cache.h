@@ -0,0 +1,58 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * Librejilla-burn
+ * Copyright (C) Philippe Rouquier 2005-2009 <bonfire-app@wanadoo.fr>
+ *
+ * Librejilla-burn is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The Librejilla-burn authors hereby grant permission for non-GPL compatible
+ * GStreamer plugins to be used and distributed together with GStreamer
+ * and Librejilla-burn. This permission is above and beyond the permissions granted
+ * by the GPL license by which Librejilla-burn is covered. If you modify this code
+ * you may extend this exception to your version of the code, but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version.
+ * 
+ * Librejilla-burn is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to:
+ * 	The Free Software Foundation, Inc.,
+ * 	51 Franklin Street, Fifth Floor
+ * 	Boston, MA  02110-1301, USA.
+ */
+
+#ifndef _BURN_PLUGIN_CACHE_H_
+#define _BURN_PLUGIN_CACHE_H_
+
+#include <glib.h>
+
+#include "rejilla-plugin.h"
+
+G_BEGIN_DECLS
+
+/**
+ * Remembers the outcome of rejilla_plugin_check_config () between runs so
+ * that plugins need not spawn every external program they depend on each
+ * time the library is initialised. An entry is only used as long as the
+ * module and every program or GStreamer element it probed are unchanged.
+ */
+
+gboolean
+rejilla_plugin_cache_restore (RejillaPlugin *plugin,
+			      const gchar *path);
+
+void
+rejilla_plugin_cache_store (RejillaPlugin *plugin,
+			    const gchar *path,
+			    GSList *dependencies);
+
+G_END_DECLS
+
+#endif /* _BURN_PLUGIN_CACHE_H_ */
@@ -64,6 +64,15 @@ typedef struct _RejillaPluginManagerPrivate RejillaPluginManagerPrivate;
 struct _RejillaPluginManagerPrivate {
 	GSList *plugins;
 	GSettings *settings;
+
+	/* Plugins whose cached configuration is checked in a thread and
+	 * those whose check is over but not applied yet */
+	GMutex *revalidate_lock;
+	GThread *revalidate_thread;
+	GSList *revalidate;
+	GSList *revalidated;
+	guint revalidate_id;
+	guint revalidate_cancel:1;
 };
 
 #define REJILLA_PLUGIN_MANAGER_PRIVATE(o)  (G_TYPE_INSTANCE_GET_PRIVATE ((o), REJILLA_TYPE_PLUGIN_MANAGER, RejillaPluginManagerPrivate))
@@ -256,6 +265,91 @@ rejilla_plugin_manager_plugin_list_changed_cb (GSettings *settings,
 	rejilla_plugin_manager_set_plugins_state (REJILLA_PLUGIN_MANAGER (user_data));
 }
 
+static gboolean
+rejilla_plugin_manager_revalidate_cb (gpointer data)
+{
+	RejillaPluginManager *self = REJILLA_PLUGIN_MANAGER (data);
+	RejillaPluginManagerPrivate *priv;
+	GSList *revalidated;
+	GSList *iter;
+
+	priv = REJILLA_PLUGIN_MANAGER_PRIVATE (self);
+
+	g_mutex_lock (priv->revalidate_lock);
+	revalidated = priv->revalidated;
+	priv->revalidated = NULL;
+	priv->revalidate_id = 0;
+	g_mutex_unlock (priv->revalidate_lock);
+
+	for (iter = revalidated; iter; iter = iter->next) {
+		RejillaPlugin *plugin;
+		gchar *before;
+		gchar *after;
+
+		/* It may have been checked again in the meantime */
+		plugin = iter->data;
+		if (!rejilla_plugin_get_config_cached (plugin))
+			continue;
+
+		before = rejilla_plugin_get_error_string (plugin);
+		rejilla_plugin_apply_check_config (plugin);
+		after = rejilla_plugin_get_error_string (plugin);
+
+		if (g_strcmp0 (before, after)) {
+			REJILLA_BURN_LOG ("Configuration of %s changed since it was cached",
+					  rejilla_plugin_get_name (plugin));
+			g_signal_emit (self,
+				       caps_signals [CAPS_CHANGED_SIGNAL],
+				       0);
+		}
+
+		g_free (before);
+		g_free (after);
+	}
+	g_slist_free (revalidated);
+
+	return FALSE;
+}
+
+/**
+ * Checks spawn programs and load libraries so they are run in a thread;
+ * their results are applied in the main loop.
+ */
+
+static gpointer
+rejilla_plugin_manager_revalidate_thread (gpointer data)
+{
+	RejillaPluginManager *self = REJILLA_PLUGIN_MANAGER (data);
+	RejillaPluginManagerPrivate *priv;
+
+	priv = REJILLA_PLUGIN_MANAGER_PRIVATE (self);
+
+	while (1) {
+		RejillaPlugin *plugin;
+
+		g_mutex_lock (priv->revalidate_lock);
+		if (priv->revalidate_cancel || !priv->revalidate) {
+			g_mutex_unlock (priv->revalidate_lock);
+			break;
+		}
+
+		plugin = priv->revalidate->data;
+		priv->revalidate = g_slist_remove (priv->revalidate, plugin);
+		g_mutex_unlock (priv->revalidate_lock);
+
+		rejilla_plugin_run_check_config (plugin);
+
+		g_mutex_lock (priv->revalidate_lock);
+		priv->revalidated = g_slist_append (priv->revalidated, plugin);
+		if (!priv->revalidate_id)
+			priv->revalidate_id = g_idle_add (rejilla_plugin_manager_revalidate_cb, self);
+		g_mutex_unlock (priv->revalidate_lock);
+	}
+
+	REJILLA_BURN_LOG ("All cached plugin configurations checked");
+	return NULL;
+}
+
 #if 0
 
 /**
@@ -358,6 +452,7 @@ static void
 rejilla_plugin_manager_init (RejillaPluginManager *self)
 {
 	GDir *directory;
+	GSList *iter;
 	const gchar *name;
 	GError *error = NULL;
 	RejillaPluginManagerPrivate *priv;
@@ -439,6 +534,26 @@ rejilla_plugin_manager_init (RejillaPluginManager *self)
 	g_dir_close (directory);
 
 	rejilla_plugin_manager_set_plugins_state (self);
+
+	/* Plugins whose configuration came from the cache are checked again
+	 * once the application is idle */
+	for (iter = priv->plugins; iter; iter = iter->next) {
+		if (rejilla_plugin_get_config_cached (iter->data))
+			priv->revalidate = g_slist_prepend (priv->revalidate, iter->data);
+	}
+
+	if (priv->revalidate) {
+		priv->revalidate_lock = g_mutex_new ();
+		priv->revalidate_thread = g_thread_create (rejilla_plugin_manager_revalidate_thread,
+							   self,
+							   TRUE,
+							   NULL);
+		if (!priv->revalidate_thread) {
+			REJILLA_BURN_LOG ("Cached plugin configurations can't be checked");
+			g_slist_free (priv->revalidate);
+			priv->revalidate = NULL;
+		}
+	}
 }
 
 static void
@@ -448,6 +563,35 @@ rejilla_plugin_manager_finalize (GObject *object)
 
 	priv = REJILLA_PLUGIN_MANAGER_PRIVATE (object);
 
+	if (priv->revalidate_thread) {
+		g_mutex_lock (priv->revalidate_lock);
+		priv->revalidate_cancel = TRUE;
+		g_mutex_unlock (priv->revalidate_lock);
+
+		g_thread_join (priv->revalidate_thread);
+		priv->revalidate_thread = NULL;
+	}
+
+	if (priv->revalidate_id) {
+		g_source_remove (priv->revalidate_id);
+		priv->revalidate_id = 0;
+	}
+
+	if (priv->revalidate) {
+		g_slist_free (priv->revalidate);
+		priv->revalidate = NULL;
+	}
+
+	if (priv->revalidated) {
+		g_slist_free (priv->revalidated);
+		priv->revalidated = NULL;
+	}
+
+	if (priv->revalidate_lock) {
+		g_mutex_free (priv->revalidate_lock);
+		priv->revalidate_lock = NULL;
+	}
+
 	if (priv->settings) {
 		g_object_unref (priv->settings);
 		priv->settings = NULL;
@@ -52,6 +52,7 @@
 #include "rejilla-plugin-information.h"
 #include "rejilla-plugin-registration.h"
 #include "burn-caps.h"
+#include "burn-plugin-cache.h"
 
 #define REJILLA_SCHEMA_PLUGINS				"org.mate.rejilla.plugins"
 #define REJILLA_PROPS_PRIORITY_KEY			"priority"
@@ -99,6 +100,13 @@ struct _RejillaPluginPrivate
 
 	GSList *errors;
 
+	/* What rejilla_plugin_check_config () probed */
+	GSList *dependencies;
+
+	/* What the last check found, until it is applied */
+	GSList *checked_errors;
+	GSList *checked_dependencies;
+
 	GType type;
 	gchar *path;
 	GModule *handle;
@@ -120,6 +128,11 @@ struct _RejillaPluginPrivate
 	RejillaPluginProcessFlag process_flags;
 
 	guint compulsory:1;
+	guint config_cached:1;
+
+	guint checking:1;
+	guint checked:1;
+	guint checked_store:1;
 };
 
 static const gchar *default_icon = "gtk-cdrom";
@@ -144,6 +157,9 @@ enum
 static GTypeModuleClass* parent_class = NULL;
 static guint plugin_signals [LAST_SIGNAL] = { 0 };
 
+/* Only one configuration check at a time */
+G_LOCK_DEFINE_STATIC (check_lock);
+
 static void
 rejilla_plugin_error_free (RejillaPluginError *error)
 {
@@ -167,7 +183,30 @@ rejilla_plugin_add_error (RejillaPlugin *plugin,
 	error->detail = g_strdup (detail);
 	error->type = type;
 
+	/* During a check errors are kept aside until they are applied */
+	if (priv->checking) {
+		priv->checked_errors = g_slist_prepend (priv->checked_errors, error);
+		return;
+	}
+
 	priv->errors = g_slist_prepend (priv->errors, error);
+	rejilla_burn_caps_plan_invalidate ();
+}
+
+static void
+rejilla_plugin_add_dependency (RejillaPlugin *plugin,
+                               const gchar *prefix,
+                               const gchar *name)
+{
+	RejillaPluginPrivate *priv;
+
+	priv = REJILLA_PLUGIN_PRIVATE (plugin);
+	if (priv->checking)
+		priv->checked_dependencies = g_slist_prepend (priv->checked_dependencies,
+		                                              g_strconcat (prefix, name, NULL));
+	else
+		priv->dependencies = g_slist_prepend (priv->dependencies,
+		                                      g_strconcat (prefix, name, NULL));
 }
 
 void
@@ -176,6 +215,8 @@ rejilla_plugin_test_gstreamer_plugin (RejillaPlugin *plugin,
 {
 	GstElement *element;
 
+	rejilla_plugin_add_dependency (plugin, "gst:", name);
+
 	/* Let's see if we've got the plugins we need */
 	element = gst_element_factory_make (name, NULL);
 	if (!element)
@@ -201,6 +242,8 @@ rejilla_plugin_test_app (RejillaPlugin *plugin,
 	gboolean res;
 	int i;
 
+	rejilla_plugin_add_dependency (plugin, "app:", name);
+
 	/* First see if this plugin can be used, i.e. if cdrecord is in
 	 * the path */
 	prog_path = g_find_program_in_path (name);
@@ -328,6 +371,8 @@ rejilla_plugin_set_active (RejillaPlugin *self, gboolean active)
 	if (was_active == now_active)
 		return;
 
+	rejilla_burn_caps_plan_invalidate ();
+
 	REJILLA_BURN_LOG ("Plugin %s is %s",
 			  rejilla_plugin_get_name (self),
 			  now_active?"active":"inactive");
@@ -1186,6 +1231,7 @@ rejilla_plugin_priority_changed (GSettings *settings,
 
 	/* At the moment it can only be the priority key */
 	priv->priority = g_settings_get_int (settings, REJILLA_PROPS_PRIORITY_KEY);
+	rejilla_burn_caps_plan_invalidate ();
 
 	is_active = rejilla_plugin_get_active (self, FALSE);
 
@@ -1199,17 +1245,35 @@ rejilla_plugin_priority_changed (GSettings *settings,
 
 typedef void	(* RejillaPluginCheckConfig)	(RejillaPlugin *plugin);
 
+static void
+rejilla_plugin_free_checked (RejillaPluginPrivate *priv)
+{
+	if (priv->checked_errors) {
+		g_slist_foreach (priv->checked_errors, (GFunc) rejilla_plugin_error_free, NULL);
+		g_slist_free (priv->checked_errors);
+		priv->checked_errors = NULL;
+	}
+
+	if (priv->checked_dependencies) {
+		g_slist_foreach (priv->checked_dependencies, (GFunc) g_free, NULL);
+		g_slist_free (priv->checked_dependencies);
+		priv->checked_dependencies = NULL;
+	}
+
+	priv->checked = FALSE;
+}
+
 /**
- * rejilla_plugin_check_plugin_ready:
+ * rejilla_plugin_run_check_config:
  * @plugin: a #RejillaPlugin.
  *
- * Ask a plugin to check whether it can operate.
- * rejilla_plugin_can_operate () should be called
- * afterwards to know whether it can operate or not.
+ * Asks a plugin to check whether it can operate. What it finds is only set
+ * on @plugin by rejilla_plugin_apply_check_config () so this function can
+ * be called from another thread than the main one.
  *
  **/
 void
-rejilla_plugin_check_plugin_ready (RejillaPlugin *plugin)
+rejilla_plugin_run_check_config (RejillaPlugin *plugin)
 {
 	GModule *handle;
 	RejillaPluginPrivate *priv;
@@ -1218,27 +1282,116 @@ rejilla_plugin_check_plugin_ready (RejillaPlugin *plugin)
 	g_return_if_fail (REJILLA_IS_PLUGIN (plugin));
 	priv = REJILLA_PLUGIN_PRIVATE (plugin);
 
-	if (priv->errors) {
-		g_slist_foreach (priv->errors, (GFunc) rejilla_plugin_error_free, NULL);
-		g_slist_free (priv->errors);
-		priv->errors = NULL;
-	}
+	G_LOCK (check_lock);
+
+	rejilla_plugin_free_checked (priv);
+	priv->checking = TRUE;
+	priv->checked_store = TRUE;
 
 	handle = g_module_open (priv->path, 0);
 	if (!handle) {
 		rejilla_plugin_add_error (plugin, REJILLA_PLUGIN_ERROR_MODULE, g_module_error ());
 		REJILLA_BURN_LOG ("Module %s can't be loaded: g_module_open failed ()", priv->name);
-		return;
+		priv->checked_store = FALSE;
 	}
-
-	if (!g_module_symbol (handle, "rejilla_plugin_check_config", (gpointer) &function)) {
+	else if (!g_module_symbol (handle, "rejilla_plugin_check_config", (gpointer) &function)) {
 		g_module_close (handle);
 		REJILLA_BURN_LOG ("Module %s has no check config function", priv->name);
+	}
+	else {
+		function (REJILLA_PLUGIN (plugin));
+		g_module_close (handle);
+	}
+
+	priv->checking = FALSE;
+	priv->checked = TRUE;
+
+	G_UNLOCK (check_lock);
+}
+
+/**
+ * rejilla_plugin_apply_check_config:
+ * @plugin: a #RejillaPlugin.
+ *
+ * Sets on @plugin what the last rejilla_plugin_run_check_config () found.
+ * It must be called from the main thread.
+ *
+ **/
+void
+rejilla_plugin_apply_check_config (RejillaPlugin *plugin)
+{
+	RejillaPluginPrivate *priv;
+	gboolean store;
+
+	g_return_if_fail (REJILLA_IS_PLUGIN (plugin));
+	priv = REJILLA_PLUGIN_PRIVATE (plugin);
+
+	G_LOCK (check_lock);
+
+	if (!priv->checked) {
+		G_UNLOCK (check_lock);
 		return;
 	}
 
-	function (REJILLA_PLUGIN (plugin));
-	g_module_close (handle);
+	if (priv->errors) {
+		g_slist_foreach (priv->errors, (GFunc) rejilla_plugin_error_free, NULL);
+		g_slist_free (priv->errors);
+	}
+
+	if (priv->dependencies) {
+		g_slist_foreach (priv->dependencies, (GFunc) g_free, NULL);
+		g_slist_free (priv->dependencies);
+	}
+
+	priv->errors = priv->checked_errors;
+	priv->checked_errors = NULL;
+	priv->dependencies = priv->checked_dependencies;
+	priv->checked_dependencies = NULL;
+	priv->checked = FALSE;
+	priv->config_cached = FALSE;
+	store = priv->checked_store;
+
+	G_UNLOCK (check_lock);
+
+	rejilla_burn_caps_plan_invalidate ();
+
+	if (store)
+		rejilla_plugin_cache_store (plugin, priv->path, priv->dependencies);
+}
+
+/**
+ * rejilla_plugin_check_plugin_ready:
+ * @plugin: a #RejillaPlugin.
+ *
+ * Ask a plugin to check whether it can operate.
+ * rejilla_plugin_can_operate () should be called
+ * afterwards to know whether it can operate or not.
+ *
+ **/
+void
+rejilla_plugin_check_plugin_ready (RejillaPlugin *plugin)
+{
+	rejilla_plugin_run_check_config (plugin);
+	rejilla_plugin_apply_check_config (plugin);
+}
+
+/**
+ * rejilla_plugin_get_config_cached:
+ * @plugin: a #RejillaPlugin.
+ *
+ * Returns: %TRUE if the errors of @plugin were restored from the cache
+ * rather than found by rejilla_plugin_check_plugin_ready (). The check
+ * should then be run again when convenient to catch what the cache cannot
+ * see (libraries, custom tests).
+ **/
+gboolean
+rejilla_plugin_get_config_cached (RejillaPlugin *plugin)
+{
+	RejillaPluginPrivate *priv;
+
+	g_return_val_if_fail (REJILLA_IS_PLUGIN (plugin), FALSE);
+	priv = REJILLA_PLUGIN_PRIVATE (plugin);
+	return priv->config_cached;
 }
 
 static void
@@ -1267,6 +1420,10 @@ rejilla_plugin_init_real (RejillaPlugin *object)
 	}
 
 	priv->type = function (object);
+
+	/* Registration added links and flags to the caps graph */
+	rejilla_burn_caps_plan_invalidate ();
+
 	if (priv->type == G_TYPE_NONE) {
 		g_module_close (handle);
 		REJILLA_BURN_LOG ("Module %s encountered an error while registering its capabilities", priv->name);
@@ -1293,8 +1450,12 @@ rejilla_plugin_init_real (RejillaPlugin *object)
 	                  G_CALLBACK (rejilla_plugin_priority_changed),
 	                  object);
 
-	/* Check if it can operate */
-	rejilla_plugin_check_plugin_ready (object);
+	/* Check if it can operate; spawning all the programs plugins depend on
+	 * is slow so use the result of the last check if nothing changed */
+	if (rejilla_plugin_cache_restore (object, priv->path))
+		priv->config_cached = TRUE;
+	else
+		rejilla_plugin_check_plugin_ready (object);
 
 	g_module_close (handle);
 }
@@ -1344,6 +1505,14 @@ rejilla_plugin_finalize (GObject *object)
 		priv->errors = NULL;
 	}
 
+	if (priv->dependencies) {
+		g_slist_foreach (priv->dependencies, (GFunc) g_free, NULL);
+		g_slist_free (priv->dependencies);
+		priv->dependencies = NULL;
+	}
+
+	rejilla_plugin_free_checked (priv);
+
 	G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
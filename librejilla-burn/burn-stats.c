@@ -0,0 +1,354 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * Librejilla-burn
+ * Copyright (C) Philippe Rouquier 2005-2009 <bonfire-app@wanadoo.fr>
+ *
+ * Librejilla-burn is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The Librejilla-burn authors hereby grant permission for non-GPL compatible
+ * GStreamer plugins to be used and distributed together with GStreamer
+ * and Librejilla-burn. This permission is above and beyond the permissions granted
+ * by the GPL license by which Librejilla-burn is covered. If you modify this code
+ * you may extend this exception to your version of the code, but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version.
+ * 
+ * Librejilla-burn is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to:
+ * 	The Free Software Foundation, Inc.,
+ * 	51 Franklin Street, Fifth Floor
+ * 	Boston, MA  02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "burn-debug.h"
+#include "burn-caps.h"
+#include "burn-stats.h"
+#include "rejilla-plugin.h"
+#include "rejilla-medium.h"
+#include "rejilla-drive.h"
+
+/* Weight given to the latest measure when it is merged with older ones */
+#define REJILLA_BURN_STATS_WEIGHT	0.3
+
+/* Measures on very short operations are meaningless */
+#define REJILLA_BURN_STATS_MIN_TIME	2.0
+
+#define REJILLA_BURN_STATS_KEY_RATE	"rate"
+#define REJILLA_BURN_STATS_KEY_CPU	"cpu-load"
+#define REJILLA_BURN_STATS_KEY_SAMPLES	"samples"
+#define REJILLA_BURN_STATS_KEY_FAILURES	"failures"
+
+G_LOCK_DEFINE_STATIC (stats_lock);
+static GKeyFile *stats = NULL;
+
+static gchar *
+rejilla_burn_stats_get_path (void)
+{
+	return g_build_filename (g_get_user_cache_dir (),
+				 "rejilla",
+				 "burn-stats",
+				 NULL);
+}
+
+static GKeyFile *
+rejilla_burn_stats_load (void)
+{
+	gchar *path;
+
+	if (stats)
+		return stats;
+
+	stats = g_key_file_new ();
+	path = rejilla_burn_stats_get_path ();
+	if (!g_key_file_load_from_file (stats, path, G_KEY_FILE_NONE, NULL))
+		REJILLA_BURN_LOG ("No previous statistics (%s)", path);
+
+	g_free (path);
+	return stats;
+}
+
+static void
+rejilla_burn_stats_save (void)
+{
+	GError *error = NULL;
+	gchar *directory;
+	gchar *data;
+	gsize size;
+	gchar *path;
+
+	data = g_key_file_to_data (stats, &size, NULL);
+	if (!data)
+		return;
+
+	path = rejilla_burn_stats_get_path ();
+	directory = g_path_get_dirname (path);
+	g_mkdir_with_parents (directory, S_IRWXU);
+	g_free (directory);
+
+	if (!g_file_set_contents (path, data, size, &error)) {
+		REJILLA_BURN_LOG ("Statistics could not be saved: %s", error->message);
+		g_error_free (error);
+	}
+
+	g_free (path);
+	g_free (data);
+}
+
+static gchar *
+rejilla_burn_stats_get_plugin_group (RejillaPlugin *plugin)
+{
+	return g_strconcat ("Plugin ", rejilla_plugin_get_name (plugin), NULL);
+}
+
+/**
+ * rejilla_burn_stats_record_plugin:
+ * @plugin: a #RejillaPlugin
+ * @bytes: the number of bytes the plugin produced
+ * @elapsed: the time (in seconds) it took
+ * @cpu_time: the CPU time (in seconds) used meanwhile
+ *
+ * Merges a new measure with the ones from the previous runs.
+ **/
+
+void
+rejilla_burn_stats_record_plugin (RejillaPlugin *plugin,
+				  goffset bytes,
+				  gdouble elapsed,
+				  gdouble cpu_time)
+{
+	gdouble cpu_load;
+	GKeyFile *file;
+	gdouble rate;
+	gchar *group;
+	gint samples;
+
+	if (elapsed < REJILLA_BURN_STATS_MIN_TIME || bytes <= 0)
+		return;
+
+	rate = (gdouble) bytes / elapsed;
+	cpu_load = MAX (cpu_time, 0.0) / elapsed;
+	group = rejilla_burn_stats_get_plugin_group (plugin);
+
+	G_LOCK (stats_lock);
+
+	file = rejilla_burn_stats_load ();
+	samples = g_key_file_get_integer (file, group, REJILLA_BURN_STATS_KEY_SAMPLES, NULL);
+	if (samples > 0) {
+		gdouble old_rate;
+		gdouble old_cpu;
+
+		old_rate = g_key_file_get_double (file, group, REJILLA_BURN_STATS_KEY_RATE, NULL);
+		old_cpu = g_key_file_get_double (file, group, REJILLA_BURN_STATS_KEY_CPU, NULL);
+
+		rate = old_rate * (1.0 - REJILLA_BURN_STATS_WEIGHT) + rate * REJILLA_BURN_STATS_WEIGHT;
+		cpu_load = old_cpu * (1.0 - REJILLA_BURN_STATS_WEIGHT) + cpu_load * REJILLA_BURN_STATS_WEIGHT;
+	}
+
+	g_key_file_set_double (file, group, REJILLA_BURN_STATS_KEY_RATE, rate);
+	g_key_file_set_double (file, group, REJILLA_BURN_STATS_KEY_CPU, cpu_load);
+	g_key_file_set_integer (file, group, REJILLA_BURN_STATS_KEY_SAMPLES, samples + 1);
+	rejilla_burn_stats_save ();
+
+	G_UNLOCK (stats_lock);
+
+	REJILLA_BURN_LOG ("Plugin %s: %.0f B/s, cpu load %.2f (%i samples)",
+			  rejilla_plugin_get_name (plugin),
+			  rate,
+			  cpu_load,
+			  samples + 1);
+	g_free (group);
+
+	/* Paths chosen so far may not be the fastest anymore */
+	rejilla_burn_caps_plan_invalidate ();
+}
+
+/**
+ * rejilla_burn_stats_get_plugin_rate:
+ * @plugin: a #RejillaPlugin
+ * @rate: a #guint64 or NULL
+ * @cpu_load: a #gdouble or NULL
+ *
+ * Returns the average throughput (in bytes per second) and the average
+ * CPU load measured for @plugin.
+ *
+ * Return value: %FALSE if @plugin was never measured.
+ **/
+
+gboolean
+rejilla_burn_stats_get_plugin_rate (RejillaPlugin *plugin,
+				    guint64 *rate,
+				    gdouble *cpu_load)
+{
+	GKeyFile *file;
+	gchar *group;
+	gint samples;
+
+	group = rejilla_burn_stats_get_plugin_group (plugin);
+
+	G_LOCK (stats_lock);
+
+	file = rejilla_burn_stats_load ();
+	samples = g_key_file_get_integer (file, group, REJILLA_BURN_STATS_KEY_SAMPLES, NULL);
+	if (samples > 0) {
+		if (rate)
+			*rate = g_key_file_get_double (file, group, REJILLA_BURN_STATS_KEY_RATE, NULL);
+		if (cpu_load)
+			*cpu_load = g_key_file_get_double (file, group, REJILLA_BURN_STATS_KEY_CPU, NULL);
+	}
+
+	G_UNLOCK (stats_lock);
+
+	g_free (group);
+	return (samples > 0);
+}
+
+static gchar *
+rejilla_burn_stats_get_write_group (RejillaMedium *medium,
+				    guint64 rate)
+{
+	const gchar *media_id;
+	gchar *group;
+	gchar *name;
+
+	/* The same drive may not write all brands at the same speed */
+	media_id = rejilla_medium_get_media_id (medium);
+	if (!media_id)
+		media_id = rejilla_medium_get_type_string (medium);
+
+	name = rejilla_drive_get_display_name (rejilla_medium_get_drive (medium));
+	group = g_strdup_printf ("Write %s;%s;%" G_GUINT64_FORMAT,
+				 name,
+				 media_id,
+				 rate / 1000);
+	g_free (name);
+
+	/* These can't be part of a group name */
+	g_strdelimit (group, "[]\n", '_');
+	return group;
+}
+
+/**
+ * rejilla_burn_stats_record_write:
+ * @medium: the #RejillaMedium written
+ * @rate: the speed (in B/s) requested to the drive
+ * @bytes: the number of bytes written
+ * @elapsed: the time (in seconds) it took
+ * @success: whether the medium was written (and checked) successfully
+ *
+ * Merges a new measure of what a drive achieved with a type of media at
+ * @rate with the ones from the previous runs.
+ **/
+
+void
+rejilla_burn_stats_record_write (RejillaMedium *medium,
+				 guint64 rate,
+				 goffset bytes,
+				 gdouble elapsed,
+				 gboolean success)
+{
+	gdouble achieved = 0.0;
+	GKeyFile *file;
+	gchar *group;
+	gint failures;
+	gint samples;
+
+	if (!medium || !rate)
+		return;
+
+	/* A successful recording must be long enough to be meaningful */
+	if (success && (elapsed < REJILLA_BURN_STATS_MIN_TIME || bytes <= 0))
+		return;
+
+	group = rejilla_burn_stats_get_write_group (medium, rate);
+
+	G_LOCK (stats_lock);
+
+	file = rejilla_burn_stats_load ();
+	samples = g_key_file_get_integer (file, group, REJILLA_BURN_STATS_KEY_SAMPLES, NULL);
+	failures = g_key_file_get_integer (file, group, REJILLA_BURN_STATS_KEY_FAILURES, NULL);
+
+	if (success) {
+		achieved = (gdouble) bytes / elapsed;
+		if (g_key_file_has_key (file, group, REJILLA_BURN_STATS_KEY_RATE, NULL)) {
+			gdouble old_rate;
+
+			old_rate = g_key_file_get_double (file, group, REJILLA_BURN_STATS_KEY_RATE, NULL);
+			achieved = old_rate * (1.0 - REJILLA_BURN_STATS_WEIGHT) + achieved * REJILLA_BURN_STATS_WEIGHT;
+		}
+
+		g_key_file_set_double (file, group, REJILLA_BURN_STATS_KEY_RATE, achieved);
+	}
+	else
+		failures ++;
+
+	g_key_file_set_integer (file, group, REJILLA_BURN_STATS_KEY_SAMPLES, samples + 1);
+	g_key_file_set_integer (file, group, REJILLA_BURN_STATS_KEY_FAILURES, failures);
+	rejilla_burn_stats_save ();
+
+	G_UNLOCK (stats_lock);
+
+	REJILLA_BURN_LOG ("%s: %.0f B/s, %i failures (%i samples)",
+			  group,
+			  achieved,
+			  failures,
+			  samples + 1);
+	g_free (group);
+}
+
+/**
+ * rejilla_burn_stats_get_write_rate:
+ * @medium: a #RejillaMedium
+ * @rate: the speed (in B/s) that would be requested to the drive
+ * @achieved: a #guint64 or NULL
+ * @failures: a #guint or NULL
+ *
+ * Returns the average throughput (in bytes per second) achieved by the
+ * drive of @medium with this type of media at @rate (0 if there was no
+ * successful recording) and how many recordings failed.
+ *
+ * Return value: the number of recordings made with these parameters.
+ **/
+
+guint
+rejilla_burn_stats_get_write_rate (RejillaMedium *medium,
+				   guint64 rate,
+				   guint64 *achieved,
+				   guint *failures)
+{
+	GKeyFile *file;
+	gchar *group;
+	gint samples;
+
+	group = rejilla_burn_stats_get_write_group (medium, rate);
+
+	G_LOCK (stats_lock);
+
+	file = rejilla_burn_stats_load ();
+	samples = g_key_file_get_integer (file, group, REJILLA_BURN_STATS_KEY_SAMPLES, NULL);
+	if (samples > 0) {
+		if (achieved)
+			*achieved = g_key_file_get_double (file, group, REJILLA_BURN_STATS_KEY_RATE, NULL);
+		if (failures)
+			*failures = g_key_file_get_integer (file, group, REJILLA_BURN_STATS_KEY_FAILURES, NULL);
+	}
+
+	G_UNLOCK (stats_lock);
+
+	g_free (group);
+	return MAX (samples, 0);
+}
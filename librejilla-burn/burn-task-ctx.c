@@ -83,6 +83,10 @@ struct _RejillaTaskCtxPrivate
 	/* used for rates that certain jobs are able to report */
 	guint64 rate;
 
+	/* fill level (in %) of the buffer some jobs put between their
+	 * input and the drive; -1 when there is none */
+	gint buffer_fill;
+
 	/* the current action */
 	RejillaBurnAction current_action;
 	gchar *action_string;
@@ -177,6 +181,7 @@ rejilla_task_ctx_reset (RejillaTaskCtx *self)
 	priv->track_bytes = -1;
 	priv->session_bytes = -1;
 	priv->written_changed = 0;
+	priv->buffer_fill = -1;
 
 	priv->current_elapsed = 0;
 	priv->last_written = 0;
@@ -573,6 +578,32 @@ rejilla_task_ctx_set_rate (RejillaTaskCtx *self,
 	return REJILLA_BURN_OK;
 }
 
+/**
+ * This is used by jobs that buffer their input before sending it to the drive
+ * to tell how full that buffer is (in %, -1 if there is no buffer)
+ */
+
+RejillaBurnResult
+rejilla_task_ctx_set_buffer_fill (RejillaTaskCtx *self,
+				  gint fill)
+{
+	RejillaTaskCtxPrivate *priv;
+
+	g_return_val_if_fail (REJILLA_IS_TASK_CTX (self), REJILLA_BURN_ERR);
+
+	priv = REJILLA_TASK_CTX_PRIVATE (self);
+
+	/* Warn when the buffer runs low while writing as the drive
+	 * will likely have to slow down to protect itself */
+	if (fill >= 0 && fill < 10
+	&& (priv->buffer_fill < 0 || priv->buffer_fill >= 10)
+	&&  priv->current_action == REJILLA_BURN_ACTION_RECORDING)
+		REJILLA_BURN_LOG ("Buffer running low (%i%%)", fill);
+
+	priv->buffer_fill = fill;
+	return REJILLA_BURN_OK;
+}
+
 /**
  * This is used by jobs that are imaging to tell what's going to be the output 
  * size for a particular track
@@ -791,6 +822,24 @@ rejilla_task_ctx_set_use_average (RejillaTaskCtx *self,
  * Used to retrieve the values for a given task
  */
 
+RejillaBurnResult
+rejilla_task_ctx_get_buffer_fill (RejillaTaskCtx *self,
+				  gint *fill)
+{
+	RejillaTaskCtxPrivate *priv;
+
+	g_return_val_if_fail (REJILLA_IS_TASK_CTX (self), REJILLA_BURN_ERR);
+	g_return_val_if_fail (fill != NULL, REJILLA_BURN_ERR);
+
+	priv = REJILLA_TASK_CTX_PRIVATE (self);
+
+	*fill = priv->buffer_fill;
+	if (priv->buffer_fill < 0)
+		return REJILLA_BURN_NOT_SUPPORTED;
+
+	return REJILLA_BURN_OK;
+}
+
 RejillaBurnResult
 rejilla_task_ctx_get_rate (RejillaTaskCtx *self,
 			   guint64 *rate)
@@ -1056,6 +1105,7 @@ rejilla_task_ctx_init (RejillaTaskCtx *object)
 
 	priv = REJILLA_TASK_CTX_PRIVATE (object);
 	priv->lock = g_mutex_new ();
+	priv->buffer_fill = -1;
 }
 
 static void
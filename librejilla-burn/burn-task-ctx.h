@@ -152,6 +152,10 @@ RejillaBurnResult
 rejilla_task_ctx_set_rate (RejillaTaskCtx *ctx,
 			   gint64 rate);
 
+RejillaBurnResult
+rejilla_task_ctx_set_buffer_fill (RejillaTaskCtx *ctx,
+				  gint fill);
+
 RejillaBurnResult
 rejilla_task_ctx_set_written_session (RejillaTaskCtx *ctx,
 				      gint64 written);
@@ -184,6 +188,9 @@ RejillaBurnResult
 rejilla_task_ctx_get_rate (RejillaTaskCtx *ctx,
 			   guint64 *rate);
 RejillaBurnResult
+rejilla_task_ctx_get_buffer_fill (RejillaTaskCtx *ctx,
+				  gint *fill);
+RejillaBurnResult
 rejilla_task_ctx_get_remaining_time (RejillaTaskCtx *ctx,
 				     long *remaining);
 RejillaBurnResult
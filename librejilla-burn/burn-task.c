@@ -32,6 +32,9 @@
 #  include <config.h>
 #endif
 
+#include <sys/time.h>
+#include <sys/resource.h>
+
 #include <glib.h>
 #include <glib-object.h>
 #include <glib/gi18n-lib.h>
@@ -44,6 +47,8 @@
 #include "burn-task.h"
 #include "burn-task-item.h"
 #include "burn-task-ctx.h"
+#include "burn-stats.h"
+#include "rejilla-plugin.h"
 
 #include "rejilla-track-image.h"
 #include "rejilla-track-stream.h"
@@ -52,6 +57,8 @@ static void rejilla_task_class_init (RejillaTaskClass *klass);
 static void rejilla_task_init (RejillaTask *sp);
 static void rejilla_task_finalize (GObject *object);
 
+static gboolean rejilla_task_finished_cb (gpointer data);
+
 typedef struct _RejillaTaskPrivate RejillaTaskPrivate;
 
 struct _RejillaTaskPrivate {
@@ -67,6 +74,16 @@ struct _RejillaTaskPrivate {
 	/* result of the task */
 	RejillaBurnResult retval;
 	GError *error;
+
+	/* set when run without a loop by rejilla_task_run_async () */
+	RejillaTaskFinishedFunc callback;
+	gpointer user_data;
+	guint idle_id;
+
+	GTimer *timer;
+	gdouble cpu_time;
+
+	guint running:1;
 };
 
 #define REJILLA_TASK_PRIVATE(o)  (G_TYPE_INSTANCE_GET_PRIVATE ((o), REJILLA_TYPE_TASK, RejillaTaskPrivate))
@@ -359,6 +376,11 @@ rejilla_task_stop (RejillaTask *task,
 
 	if (priv->loop && g_main_loop_is_running (priv->loop))
 		g_main_loop_quit (priv->loop);
+	else if (priv->running) {
+		/* Don't call back from within the job */
+		priv->running = FALSE;
+		priv->idle_id = g_idle_add (rejilla_task_finished_cb, task);
+	}
 	else
 		REJILLA_BURN_LOG ("task was asked to stop (%i/%i) during ::init or ::start",
 				  result, retval);
@@ -384,7 +406,7 @@ rejilla_task_is_running (RejillaTask *task)
 	RejillaTaskPrivate *priv;
 
 	priv = REJILLA_TASK_PRIVATE (task);
-	return (priv->loop && g_main_loop_is_running (priv->loop));
+	return (priv->running || (priv->loop && g_main_loop_is_running (priv->loop)));
 }
 
 static void
@@ -423,6 +445,28 @@ rejilla_task_finished (RejillaTaskCtx *ctx,
 	rejilla_task_stop (self, retval, error);
 }
 
+static void
+rejilla_task_report_end (RejillaTask *self)
+{
+	RejillaTaskPrivate *priv;
+
+	priv = REJILLA_TASK_PRIVATE (self);
+
+	/* stop all progress reporting thing */
+	if (priv->clock_id) {
+		g_source_remove (priv->clock_id);
+		priv->clock_id = 0;
+	}
+
+	if (priv->retval == REJILLA_BURN_OK
+	&&  rejilla_task_ctx_get_progress (REJILLA_TASK_CTX (self), NULL) == REJILLA_BURN_OK) {
+		rejilla_task_ctx_set_progress (REJILLA_TASK_CTX (self), 1.0);
+		rejilla_task_ctx_report_progress (REJILLA_TASK_CTX (self));
+	}
+
+	rejilla_task_ctx_stop_progress (REJILLA_TASK_CTX (self));
+}
+
 static RejillaBurnResult
 rejilla_task_run_loop (RejillaTask *self,
 		       GError **error)
@@ -454,20 +498,27 @@ rejilla_task_run_loop (RejillaTask *self,
 		priv->error = NULL;
 	}
 
-	/* stop all progress reporting thing */
-	if (priv->clock_id) {
-		g_source_remove (priv->clock_id);
-		priv->clock_id = 0;
-	}
+	rejilla_task_report_end (self);
+	return priv->retval;	
+}
 
-	if (priv->retval == REJILLA_BURN_OK
-	&&  rejilla_task_ctx_get_progress (REJILLA_TASK_CTX (self), NULL) == REJILLA_BURN_OK) {
-		rejilla_task_ctx_set_progress (REJILLA_TASK_CTX (self), 1.0);
-		rejilla_task_ctx_report_progress (REJILLA_TASK_CTX (self));
-	}
+static RejillaBurnResult
+rejilla_task_run_no_loop (RejillaTask *self)
+{
+	RejillaTaskPrivate *priv;
 
-	rejilla_task_ctx_stop_progress (REJILLA_TASK_CTX (self));
-	return priv->retval;	
+	priv = REJILLA_TASK_PRIVATE (self);
+
+	rejilla_task_ctx_report_progress (REJILLA_TASK_CTX (self));
+
+	priv->clock_id = g_timeout_add (500,
+					rejilla_task_clock_tick,
+					self);
+
+	/* rejilla_task_stop () will call back from the main loop */
+	REJILLA_BURN_LOG ("running without loop");
+	priv->running = TRUE;
+	return REJILLA_BURN_RUNNING;
 }
 
 static RejillaBurnResult
@@ -582,14 +633,84 @@ rejilla_task_start_items (RejillaTask *self,
 		return REJILLA_BURN_NOT_RUNNING;
 	}
 
+	if (priv->callback)
+		return rejilla_task_run_no_loop (self);
+
 	return rejilla_task_run_loop (self, error);
 }
 
+static gdouble
+rejilla_task_get_cpu_time (void)
+{
+	struct rusage usage;
+	gdouble cpu_time = 0.0;
+
+	/* Include children since most of the work is done by the processes
+	 * that the jobs spawn */
+	if (!getrusage (RUSAGE_SELF, &usage))
+		cpu_time += usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1000000.0 +
+			    usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1000000.0;
+
+	if (!getrusage (RUSAGE_CHILDREN, &usage))
+		cpu_time += usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1000000.0 +
+			    usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1000000.0;
+
+	return cpu_time;
+}
+
+static void
+rejilla_task_record_stats (RejillaTask *self,
+			   gdouble elapsed,
+			   gdouble cpu_time)
+{
+	RejillaTaskPrivate *priv;
+	RejillaTaskItem *active = NULL;
+	RejillaTaskItem *item;
+	GTypePlugin *plugin;
+	goffset bytes = 0;
+
+	priv = REJILLA_TASK_PRIVATE (self);
+
+	if (rejilla_task_ctx_get_action (REJILLA_TASK_CTX (self)) != REJILLA_TASK_ACTION_NORMAL)
+		return;
+
+	/* When several jobs are linked together there is no way to tell how
+	 * much of the time and CPU each of them used nor how many bytes each
+	 * of them produced. So only tasks with a single job are measured. */
+	for (item = priv->first; item; item = rejilla_task_item_next (item)) {
+		if (!rejilla_task_item_is_active (item))
+			continue;
+
+		if (active)
+			return;
+
+		active = item;
+	}
+
+	if (!active)
+		return;
+
+	plugin = g_type_get_plugin (G_OBJECT_TYPE (active));
+	if (!plugin || !REJILLA_IS_PLUGIN (plugin))
+		return;
+
+	rejilla_task_ctx_get_session_output_size (REJILLA_TASK_CTX (self), NULL, &bytes);
+	if (bytes <= 0)
+		return;
+
+	rejilla_burn_stats_record_plugin (REJILLA_PLUGIN (plugin),
+					  bytes,
+					  elapsed,
+					  cpu_time);
+}
+
 static RejillaBurnResult
 rejilla_task_start (RejillaTask *self,
 		    gboolean fake,
 		    GError **error)
 {
+	gdouble cpu_time;
+	GTimer *timer;
 	RejillaBurnResult result = REJILLA_BURN_OK;
 	RejillaTaskPrivate *priv;
 
@@ -623,6 +744,9 @@ rejilla_task_start (RejillaTask *self,
 	if (result != REJILLA_BURN_OK)
 		return result;
 
+	timer = g_timer_new ();
+	cpu_time = rejilla_task_get_cpu_time ();
+
 	result = rejilla_task_start_items (self, error);
 	while (result == REJILLA_BURN_NOT_RUNNING) {
 		REJILLA_BURN_LOG ("current track skipped");
@@ -631,6 +755,7 @@ rejilla_task_start (RejillaTask *self,
 		 * there is another track and, if there is, start again */
 		result = rejilla_task_ctx_next_track (REJILLA_TASK_CTX (self));
 		if (result != REJILLA_BURN_RETRY) {
+			g_timer_destroy (timer);
 			rejilla_task_send_stop_signal (self, result, NULL);
 			return result;
 		}
@@ -638,9 +763,21 @@ rejilla_task_start (RejillaTask *self,
 		result = rejilla_task_start_items (self, error);
 	}
 
+	if (result == REJILLA_BURN_RUNNING && priv->running) {
+		/* Statistics are recorded once it is finished */
+		priv->timer = timer;
+		priv->cpu_time = cpu_time;
+		return result;
+	}
+
 	if (result != REJILLA_BURN_OK)
 		rejilla_task_send_stop_signal (self, result, NULL);
+	else if (!fake)
+		rejilla_task_record_stats (self,
+					   g_timer_elapsed (timer, NULL),
+					   rejilla_task_get_cpu_time () - cpu_time);
 
+	g_timer_destroy (timer);
 	return result;
 }
 
@@ -685,6 +822,103 @@ rejilla_task_run (RejillaTask *self,
 	return rejilla_task_start (self, FALSE, error);
 }
 
+static gboolean
+rejilla_task_finished_cb (gpointer data)
+{
+	RejillaTaskFinishedFunc callback;
+	RejillaTask *self = data;
+	RejillaTaskPrivate *priv;
+	gpointer user_data;
+	GError *error;
+
+	priv = REJILLA_TASK_PRIVATE (self);
+	priv->idle_id = 0;
+
+	rejilla_task_report_end (self);
+
+	if (priv->timer) {
+		if (priv->retval == REJILLA_BURN_OK)
+			rejilla_task_record_stats (self,
+						   g_timer_elapsed (priv->timer, NULL),
+						   rejilla_task_get_cpu_time () - priv->cpu_time);
+
+		g_timer_destroy (priv->timer);
+		priv->timer = NULL;
+	}
+
+	callback = priv->callback;
+	user_data = priv->user_data;
+	priv->callback = NULL;
+	priv->user_data = NULL;
+
+	error = priv->error;
+	priv->error = NULL;
+
+	/* NOTE: the task may be destroyed by the callback */
+	callback (self, priv->retval, error, user_data);
+	return FALSE;
+}
+
+/**
+ * rejilla_task_run_async:
+ * @task: a #RejillaTask
+ * @callback: a #RejillaTaskFinishedFunc
+ * @user_data: a #gpointer
+ * @error: a #GError
+ *
+ * Like rejilla_task_run () but returns as soon as the task is started instead
+ * of running a loop until it is finished. Several tasks can then be run at the
+ * same time from the main loop.
+ * If REJILLA_BURN_OK is returned @callback will be called once from the main
+ * loop (even if the task had nothing to do); the #GError it is passed must be
+ * freed by the callback. Otherwise @callback will never be called.
+ *
+ * Return value: a #RejillaBurnResult.
+ **/
+
+RejillaBurnResult
+rejilla_task_run_async (RejillaTask *self,
+			RejillaTaskFinishedFunc callback,
+			gpointer user_data,
+			GError **error)
+{
+	RejillaTaskPrivate *priv;
+	RejillaBurnResult result;
+
+	g_return_val_if_fail (REJILLA_IS_TASK (self), REJILLA_BURN_ERR);
+	g_return_val_if_fail (callback != NULL, REJILLA_BURN_ERR);
+
+	priv = REJILLA_TASK_PRIVATE (self);
+
+	if (rejilla_task_is_running (self) || priv->idle_id) {
+		REJILLA_BURN_LOG ("task is already running");
+		return REJILLA_BURN_ERR;
+	}
+
+	priv->callback = callback;
+	priv->user_data = user_data;
+
+	result = rejilla_task_start (self, FALSE, error);
+	if (result == REJILLA_BURN_RUNNING && priv->running)
+		return REJILLA_BURN_OK;
+
+	if (result != REJILLA_BURN_OK) {
+		priv->callback = NULL;
+		priv->user_data = NULL;
+
+		/* "no jobs" */
+		if (result == REJILLA_BURN_RUNNING)
+			result = REJILLA_BURN_ERR;
+
+		return result;
+	}
+
+	/* Nothing was run */
+	priv->retval = REJILLA_BURN_OK;
+	priv->idle_id = g_idle_add (rejilla_task_finished_cb, self);
+	return REJILLA_BURN_OK;
+}
+
 static void
 rejilla_task_class_init (RejillaTaskClass *klass)
 {
@@ -712,6 +946,26 @@ rejilla_task_finalize (GObject *object)
 	cobj = REJILLA_TASK (object);
 	priv = REJILLA_TASK_PRIVATE (cobj);
 
+	if (priv->idle_id) {
+		g_source_remove (priv->idle_id);
+		priv->idle_id = 0;
+	}
+
+	if (priv->clock_id) {
+		g_source_remove (priv->clock_id);
+		priv->clock_id = 0;
+	}
+
+	if (priv->timer) {
+		g_timer_destroy (priv->timer);
+		priv->timer = NULL;
+	}
+
+	if (priv->error) {
+		g_error_free (priv->error);
+		priv->error = NULL;
+	}
+
 	if (priv->leader) {
 		g_object_unref (priv->leader);
 		priv->leader = NULL;
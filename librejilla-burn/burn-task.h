@@ -61,6 +61,11 @@ struct _RejillaTaskClass {
 
 GType rejilla_task_get_type (void);
 
+typedef void	(*RejillaTaskFinishedFunc)	(RejillaTask *task,
+						 RejillaBurnResult result,
+						 GError *error,
+						 gpointer user_data);
+
 RejillaTask *rejilla_task_new (void);
 
 void
@@ -73,6 +78,12 @@ RejillaBurnResult
 rejilla_task_run (RejillaTask *task,
 		  GError **error);
 
+RejillaBurnResult
+rejilla_task_run_async (RejillaTask *task,
+			RejillaTaskFinishedFunc callback,
+			gpointer user_data,
+			GError **error);
+
 RejillaBurnResult
 rejilla_task_check (RejillaTask *task,
 		    GError **error);
@@ -0,0 +1,456 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * Librejilla-burn
+ * Copyright (C) Philippe Rouquier 2005-2009 <bonfire-app@wanadoo.fr>
+ *
+ * Librejilla-burn is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The Librejilla-burn authors hereby grant permission for non-GPL compatible
+ * GStreamer plugins to be used and distributed together with GStreamer
+ * and Librejilla-burn. This permission is above and beyond the permissions granted
+ * by the GPL license by which Librejilla-burn is covered. If you modify this code
+ * you may extend this exception to your version of the code, but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version.
+ * 
+ * Librejilla-burn is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to:
+ * 	The Free Software Foundation, Inc.,
+ * 	51 Franklin Street, Fifth Floor
+ * 	Boston, MA  02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <glib.h>
+#include <glib/gi18n-lib.h>
+
+#include "burn-debug.h"
+#include "burn-verify.h"
+#include "rejilla-error.h"
+#include "rejilla-drive.h"
+
+#include "scsi-device.h"
+#include "scsi-sbc.h"
+
+/* Size of the blocks in a BIN image */
+#define REJILLA_BURN_VERIFY_BLOCK	2048
+
+/* Number of blocks compared at once */
+#define REJILLA_BURN_VERIFY_CHUNK	32
+
+/* What was given to the recorder may still be in its buffer or in the one of
+ * the drive; keep that far away from the writing position */
+#define REJILLA_BURN_VERIFY_MARGIN	(32 * 1024 * 1024)
+
+/* Number of seconds to wait for the drive to be ready after recording */
+#define REJILLA_BURN_VERIFY_TIMEOUT	60
+
+struct _RejillaBurnVerify {
+	GThread *thread;
+	GMutex *lock;
+	GCond *cond;
+
+	gchar *device;
+	gchar *image;
+
+	/* Address of the first block on the disc and size of the image */
+	goffset start;
+	goffset size;
+
+	goffset written;
+	goffset verified;
+
+	RejillaBurnResult result;
+	GError *error;
+
+	GSourceFunc callback;
+	gpointer user_data;
+	guint idle_id;
+
+	guint finished:1;
+	guint cancel:1;
+	guint done:1;
+};
+
+/**
+ * Reading while recording is only possible with some drives. Once it failed
+ * the remaining part is left for the end.
+ */
+
+static gboolean
+rejilla_burn_verify_wait (RejillaBurnVerify *self,
+			  gboolean parallel)
+{
+	goffset needed;
+
+	needed = MIN (self->verified + REJILLA_BURN_VERIFY_CHUNK * REJILLA_BURN_VERIFY_BLOCK, self->size);
+
+	g_mutex_lock (self->lock);
+	while (!self->cancel
+	&&     !self->finished
+	&&     (!parallel || needed + REJILLA_BURN_VERIFY_MARGIN > self->written))
+		g_cond_wait (self->cond, self->lock);
+	g_mutex_unlock (self->lock);
+
+	return !self->cancel;
+}
+
+static RejillaBurnResult
+rejilla_burn_verify_compare (RejillaBurnVerify *self,
+			     RejillaDeviceHandle *handle,
+			     int fd,
+			     guchar *disc_buffer,
+			     guchar *image_buffer,
+			     RejillaScsiErrCode *code)
+{
+	RejillaScsiResult res;
+	goffset block;
+	gint blocks;
+	gint len;
+
+	len = MIN (REJILLA_BURN_VERIFY_CHUNK * REJILLA_BURN_VERIFY_BLOCK, self->size - self->verified);
+	blocks = (len + REJILLA_BURN_VERIFY_BLOCK - 1) / REJILLA_BURN_VERIFY_BLOCK;
+	block = self->start + self->verified / REJILLA_BURN_VERIFY_BLOCK;
+
+	res = rejilla_sbc_read10_block (handle,
+					block,
+					blocks,
+					disc_buffer,
+					blocks * REJILLA_BURN_VERIFY_BLOCK,
+					code);
+	if (res != REJILLA_SCSI_OK)
+		return REJILLA_BURN_RETRY;
+
+	if (pread (fd, image_buffer, len, self->verified) != len) {
+		int errsv = errno;
+
+		g_set_error (&self->error,
+			     REJILLA_BURN_ERROR,
+			     REJILLA_BURN_ERROR_GENERAL,
+			     _("Data could not be read (%s)"),
+			     g_strerror (errsv));
+		return REJILLA_BURN_ERR;
+	}
+
+	if (memcmp (disc_buffer, image_buffer, len)) {
+		REJILLA_BURN_LOG ("Difference found in blocks %"G_GOFFSET_FORMAT" to %"G_GOFFSET_FORMAT,
+				  block,
+				  block + blocks);
+		g_set_error (&self->error,
+			     REJILLA_BURN_ERROR,
+			     REJILLA_BURN_ERROR_BAD_CHECKSUM,
+			     _("Some files may be corrupted on the disc"));
+		return REJILLA_BURN_ERR;
+	}
+
+	g_mutex_lock (self->lock);
+	self->verified += len;
+	g_mutex_unlock (self->lock);
+
+	return REJILLA_BURN_OK;
+}
+
+static gboolean
+rejilla_burn_verify_done (gpointer data)
+{
+	RejillaBurnVerify *self = data;
+
+	self->idle_id = 0;
+	return self->callback (self->user_data);
+}
+
+static gpointer
+rejilla_burn_verify_thread (gpointer data)
+{
+	RejillaBurnVerify *self = data;
+	RejillaDeviceHandle *handle = NULL;
+	RejillaBurnResult result = REJILLA_BURN_OK;
+	gboolean parallel = TRUE;
+	guchar *image_buffer;
+	guchar *disc_buffer;
+	guint retries = 0;
+	int fd;
+
+	fd = open (self->image, O_RDONLY);
+	if (fd < 0) {
+		int errsv = errno;
+
+		g_set_error (&self->error,
+			     REJILLA_BURN_ERROR,
+			     REJILLA_BURN_ERROR_GENERAL,
+			     _("\"%s\" could not be opened (%s)"),
+			     self->image,
+			     g_strerror (errsv));
+		result = REJILLA_BURN_ERR;
+		goto end;
+	}
+
+	disc_buffer = g_malloc (REJILLA_BURN_VERIFY_CHUNK * REJILLA_BURN_VERIFY_BLOCK);
+	image_buffer = g_malloc (REJILLA_BURN_VERIFY_CHUNK * REJILLA_BURN_VERIFY_BLOCK);
+
+	while (self->verified < self->size) {
+		RejillaScsiErrCode code = REJILLA_SCSI_ERROR_NONE;
+
+		if (!rejilla_burn_verify_wait (self, parallel)) {
+			result = REJILLA_BURN_CANCEL;
+			break;
+		}
+
+		if (!handle) {
+			handle = rejilla_device_handle_open (self->device, FALSE, &code);
+			if (!handle) {
+				if (!self->finished) {
+					REJILLA_BURN_LOG ("Drive can't be opened while recording");
+					parallel = FALSE;
+					continue;
+				}
+
+				if (retries ++ < REJILLA_BURN_VERIFY_TIMEOUT) {
+					g_usleep (G_USEC_PER_SEC);
+					continue;
+				}
+
+				g_set_error (&self->error,
+					     REJILLA_BURN_ERROR,
+					     REJILLA_BURN_ERROR_GENERAL,
+					     _("The drive is busy"));
+				result = REJILLA_BURN_ERR;
+				break;
+			}
+		}
+
+		result = rejilla_burn_verify_compare (self,
+						      handle,
+						      fd,
+						      disc_buffer,
+						      image_buffer,
+						      &code);
+		if (result == REJILLA_BURN_OK) {
+			retries = 0;
+			continue;
+		}
+
+		if (result != REJILLA_BURN_RETRY)
+			break;
+
+		/* Don't get in the way of the recorder anymore */
+		rejilla_device_handle_close (handle);
+		handle = NULL;
+
+		if (!self->finished) {
+			REJILLA_BURN_LOG ("Drive can't read while recording (%i); %"G_GOFFSET_FORMAT" bytes verified so far",
+					  code,
+					  self->verified);
+			parallel = FALSE;
+			continue;
+		}
+
+		/* The drive may still be busy closing the disc */
+		if (retries ++ < REJILLA_BURN_VERIFY_TIMEOUT) {
+			g_usleep (G_USEC_PER_SEC);
+			continue;
+		}
+
+		g_set_error (&self->error,
+			     REJILLA_BURN_ERROR,
+			     REJILLA_BURN_ERROR_GENERAL,
+			     _("The disc could not be read back"));
+		result = REJILLA_BURN_ERR;
+		break;
+	}
+
+	if (result == REJILLA_BURN_RETRY)
+		result = REJILLA_BURN_OK;
+
+	if (handle)
+		rejilla_device_handle_close (handle);
+
+	g_free (disc_buffer);
+	g_free (image_buffer);
+	close (fd);
+
+end:
+
+	REJILLA_BURN_LOG ("Verification finished (%i) %"G_GOFFSET_FORMAT"/%"G_GOFFSET_FORMAT" bytes",
+			  result,
+			  self->verified,
+			  self->size);
+
+	g_mutex_lock (self->lock);
+	self->result = result;
+	self->done = TRUE;
+	if (self->callback)
+		self->idle_id = g_idle_add (rejilla_burn_verify_done, self);
+	g_mutex_unlock (self->lock);
+
+	return NULL;
+}
+
+/**
+ * rejilla_burn_verify_new:
+ * @drive: the #RejillaDrive recording
+ * @image: the path of the BIN image recorded
+ * @start: the address of the first block recorded
+ * @size: the size of the image in bytes
+ *
+ * Starts comparing the blocks as they are recorded with @image.
+ *
+ * Return value: a #RejillaBurnVerify or NULL.
+ **/
+
+RejillaBurnVerify *
+rejilla_burn_verify_new (RejillaDrive *drive,
+			 const gchar *image,
+			 goffset start,
+			 goffset size)
+{
+	RejillaBurnVerify *self;
+	GError *error = NULL;
+
+	self = g_new0 (RejillaBurnVerify, 1);
+	self->lock = g_mutex_new ();
+	self->cond = g_cond_new ();
+	self->device = g_strdup (rejilla_drive_get_device (drive));
+	self->image = g_strdup (image);
+	self->start = start;
+	self->size = size;
+
+	self->thread = g_thread_create (rejilla_burn_verify_thread,
+					self,
+					TRUE,
+					&error);
+	if (error) {
+		REJILLA_BURN_LOG ("Verification thread could not be created: %s", error->message);
+		g_error_free (error);
+
+		self->thread = NULL;
+		rejilla_burn_verify_free (self);
+		return NULL;
+	}
+
+	REJILLA_BURN_LOG ("Verifying %s while recording (from %"G_GOFFSET_FORMAT", %"G_GOFFSET_FORMAT" bytes)",
+			  image,
+			  start,
+			  size);
+	return self;
+}
+
+void
+rejilla_burn_verify_set_written (RejillaBurnVerify *self,
+				 goffset written)
+{
+	g_mutex_lock (self->lock);
+	self->written = written;
+	g_cond_signal (self->cond);
+	g_mutex_unlock (self->lock);
+}
+
+goffset
+rejilla_burn_verify_get_verified (RejillaBurnVerify *self)
+{
+	goffset verified;
+
+	g_mutex_lock (self->lock);
+	verified = self->verified;
+	g_mutex_unlock (self->lock);
+
+	return verified;
+}
+
+goffset
+rejilla_burn_verify_get_size (RejillaBurnVerify *self)
+{
+	return self->size;
+}
+
+/**
+ * rejilla_burn_verify_finish:
+ * @verify: a #RejillaBurnVerify
+ * @callback: a #GSourceFunc
+ * @user_data: a #gpointer
+ *
+ * Tells @verify that recording is over and that the part of the disc not yet
+ * checked must be read. @callback is called from the main loop once it is
+ * done.
+ **/
+
+void
+rejilla_burn_verify_finish (RejillaBurnVerify *self,
+			    GSourceFunc callback,
+			    gpointer user_data)
+{
+	g_mutex_lock (self->lock);
+
+	self->callback = callback;
+	self->user_data = user_data;
+	self->finished = TRUE;
+
+	if (self->done)
+		self->idle_id = g_idle_add (rejilla_burn_verify_done, self);
+	else
+		g_cond_signal (self->cond);
+
+	g_mutex_unlock (self->lock);
+}
+
+void
+rejilla_burn_verify_cancel (RejillaBurnVerify *self)
+{
+	g_mutex_lock (self->lock);
+	self->cancel = TRUE;
+	g_cond_signal (self->cond);
+	g_mutex_unlock (self->lock);
+}
+
+RejillaBurnResult
+rejilla_burn_verify_get_result (RejillaBurnVerify *self,
+				GError **error)
+{
+	if (self->error)
+		g_propagate_error (error, g_error_copy (self->error));
+
+	return self->result;
+}
+
+void
+rejilla_burn_verify_free (RejillaBurnVerify *self)
+{
+	if (self->thread) {
+		rejilla_burn_verify_cancel (self);
+		g_thread_join (self->thread);
+		self->thread = NULL;
+	}
+
+	if (self->idle_id) {
+		g_source_remove (self->idle_id);
+		self->idle_id = 0;
+	}
+
+	if (self->error)
+		g_error_free (self->error);
+
+	g_mutex_free (self->lock);
+	g_cond_free (self->cond);
+
+	g_free (self->device);
+	g_free (self->image);
+	g_free (self);
+}
@@ -0,0 +1,82 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * Librejilla-burn
+ * Copyright (C) Philippe Rouquier 2005-2009 <bonfire-app@wanadoo.fr>
+ *
+ * Librejilla-burn is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The Librejilla-burn authors hereby grant permission for non-GPL compatible
+ * GStreamer plugins to be used and distributed together with GStreamer
+ * and Librejilla-burn. This permission is above and beyond the permissions granted
+ * by the GPL license by which Librejilla-burn is covered. If you modify this code
+ * you may extend this exception to your version of the code, but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version.
+ * 
+ * Librejilla-burn is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to:
+ * 	The Free Software Foundation, Inc.,
+ * 	51 Franklin Street, Fifth Floor
+ * 	Boston, MA  02110-1301, USA.
+ */
+
+#ifndef _BURN_VERIFY_H_
+#define _BURN_VERIFY_H_
+
+#include <glib.h>
+
+#include "rejilla-drive.h"
+#include "rejilla-enums.h"
+
+G_BEGIN_DECLS
+
+/**
+ * Compares what is written on a disc with the image being recorded, while it
+ * is being recorded when the drive lets it read the areas already written,
+ * so that only the end of the disc remains to be checked afterwards.
+ */
+
+typedef struct _RejillaBurnVerify RejillaBurnVerify;
+
+RejillaBurnVerify *
+rejilla_burn_verify_new (RejillaDrive *drive,
+			 const gchar *image,
+			 goffset start,
+			 goffset size);
+
+void
+rejilla_burn_verify_free (RejillaBurnVerify *verify);
+
+void
+rejilla_burn_verify_set_written (RejillaBurnVerify *verify,
+				 goffset written);
+
+goffset
+rejilla_burn_verify_get_verified (RejillaBurnVerify *verify);
+
+goffset
+rejilla_burn_verify_get_size (RejillaBurnVerify *verify);
+
+void
+rejilla_burn_verify_finish (RejillaBurnVerify *verify,
+			    GSourceFunc callback,
+			    gpointer user_data);
+
+void
+rejilla_burn_verify_cancel (RejillaBurnVerify *verify);
+
+RejillaBurnResult
+rejilla_burn_verify_get_result (RejillaBurnVerify *verify,
+				GError **error);
+
+G_END_DECLS
+
+#endif /* _BURN_VERIFY_H_ */
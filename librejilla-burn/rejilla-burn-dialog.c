@@ -60,6 +60,8 @@
 
 #include "burn-basics.h"
 #include "burn-debug.h"
+#include "burn-caps.h"
+#include "rejilla-caps-burn.h"
 #include "rejilla-progress.h"
 #include "rejilla-cover.h"
 #include "rejilla-track-type-private.h"
@@ -70,6 +72,7 @@
 
 #include "rejilla-medium.h"
 #include "rejilla-drive.h"
+#include "rejilla-medium-monitor.h"
 
 #include "rejilla-misc.h"
 #include "rejilla-pk.h"
@@ -1587,6 +1590,8 @@ rejilla_burn_dialog_setup_session (RejillaBurnDialog *dialog,
 				   GError **error)
 {
 	RejillaBurnDialogPrivate *priv;
+	RejillaBurnCaps *caps;
+	glong estimate = -1;
 
 	priv = REJILLA_BURN_DIALOG_PRIVATE (dialog);
 
@@ -1679,6 +1684,12 @@ rejilla_burn_dialog_setup_session (RejillaBurnDialog *dialog,
 				      NULL);
 #endif /* HAVE_APP_INDICATOR */
 
+	/* Tell the user how long it should take given previous runs */
+	caps = rejilla_burn_caps_get_default ();
+	if (rejilla_burn_caps_estimate_time (caps, priv->session, &estimate) == REJILLA_BURN_OK)
+		rejilla_burn_progress_set_estimate (REJILLA_BURN_PROGRESS (priv->progress), estimate);
+	g_object_unref (caps);
+
 	g_timer_continue (priv->total_time);
 
 	return REJILLA_BURN_OK;
@@ -2235,6 +2246,265 @@ rejilla_burn_dialog_record_spanned_session (RejillaBurnDialog *dialog,
 	return result;
 }
 
+static GSList *
+rejilla_burn_dialog_get_copy_drives (RejillaBurnDialog *dialog,
+				     gboolean inserted_only)
+{
+	RejillaMediumMonitor *monitor;
+	RejillaBurnDialogPrivate *priv;
+	goffset session_sec = 0;
+	RejillaBurnResult result;
+	RejillaDrive *burner;
+	GSList *drives;
+	GSList *iter;
+	GSList *list;
+
+	priv = REJILLA_BURN_DIALOG_PRIVATE (dialog);
+
+	burner = rejilla_burn_session_get_burner (priv->session);
+	drives = g_slist_prepend (NULL, burner);
+
+	/* The medium would have to be swapped in the burner */
+	if (rejilla_burn_session_same_src_dest_drive (priv->session))
+		return drives;
+
+	rejilla_burn_session_get_size (priv->session, &session_sec, NULL);
+
+	/* Use the other burners (with a blank disc big enough) as well */
+	monitor = rejilla_medium_monitor_get_default ();
+	list = rejilla_medium_monitor_get_drives (monitor, REJILLA_DRIVE_TYPE_WRITER);
+	g_object_unref (monitor);
+
+	for (iter = list; iter; iter = iter->next) {
+		RejillaDrive *drive;
+		RejillaMedium *medium;
+		goffset medium_sec = 0;
+
+		drive = iter->data;
+		if (drive == burner
+		||  rejilla_drive_is_locked (drive, NULL))
+			continue;
+
+		if (!inserted_only) {
+			drives = g_slist_append (drives, drive);
+			continue;
+		}
+
+		medium = rejilla_drive_get_medium (drive);
+		if (!medium
+		|| !(rejilla_medium_get_status (medium) & REJILLA_MEDIUM_BLANK))
+			continue;
+
+		rejilla_medium_get_capacity (medium, NULL, &medium_sec);
+		if (session_sec > medium_sec)
+			continue;
+
+		/* The disc must be of a type this session can be burnt to */
+		rejilla_burn_session_push_settings (priv->session);
+		rejilla_burn_session_set_burner (priv->session, drive);
+		result = rejilla_burn_session_can_burn (priv->session, FALSE);
+		rejilla_burn_session_pop_settings (priv->session);
+		if (result != REJILLA_BURN_OK)
+			continue;
+
+		drives = g_slist_append (drives, drive);
+	}
+
+	g_slist_foreach (list, (GFunc) g_object_unref, NULL);
+	g_slist_free (list);
+
+	return drives;
+}
+
+static RejillaBurnResult
+rejilla_burn_dialog_ask_copies (RejillaBurnDialog *dialog,
+				guint *copies)
+{
+	GtkWidget *message;
+	GtkWidget *label;
+	GtkWidget *spin;
+	GtkWidget *box;
+	gint answer;
+
+	message = rejilla_burn_dialog_create_message (dialog,
+						      GTK_MESSAGE_QUESTION,
+						      GTK_BUTTONS_NONE,
+						      _("How many copies do you want to make?"));
+	gtk_message_dialog_format_secondary_text (GTK_MESSAGE_DIALOG (message),
+						  "%s",
+						  _("Each writable disc inserted in one of the burners will be used until all the copies are made."));
+
+	gtk_dialog_add_button (GTK_DIALOG (message),
+			       _("Only Use the _Inserted Discs"),
+			       GTK_RESPONSE_NO);
+	gtk_dialog_add_button (GTK_DIALOG (message),
+			       _("_Make Copies"),
+			       GTK_RESPONSE_OK);
+	gtk_dialog_set_default_response (GTK_DIALOG (message), GTK_RESPONSE_OK);
+
+	box = gtk_hbox_new (FALSE, 6);
+	gtk_container_set_border_width (GTK_CONTAINER (box), 6);
+
+	label = gtk_label_new_with_mnemonic (_("_Number of copies:"));
+	gtk_box_pack_start (GTK_BOX (box), label, FALSE, FALSE, 0);
+
+	spin = gtk_spin_button_new_with_range (2.0, 999.0, 1.0);
+	gtk_spin_button_set_value (GTK_SPIN_BUTTON (spin), 2.0);
+	gtk_entry_set_activates_default (GTK_ENTRY (spin), TRUE);
+	gtk_label_set_mnemonic_widget (GTK_LABEL (label), spin);
+	gtk_box_pack_start (GTK_BOX (box), spin, FALSE, FALSE, 0);
+
+	gtk_box_pack_end (GTK_BOX (gtk_dialog_get_content_area (GTK_DIALOG (message))),
+			  box,
+			  FALSE,
+			  FALSE,
+			  0);
+	gtk_widget_show_all (box);
+
+	answer = gtk_dialog_run (GTK_DIALOG (message));
+	*copies = gtk_spin_button_get_value_as_int (GTK_SPIN_BUTTON (spin));
+	gtk_widget_destroy (message);
+
+	if (answer == GTK_RESPONSE_OK)
+		return REJILLA_BURN_OK;
+
+	if (answer == GTK_RESPONSE_NO) {
+		*copies = 0;
+		return REJILLA_BURN_OK;
+	}
+
+	return REJILLA_BURN_CANCEL;
+}
+
+static RejillaBurnResult
+rejilla_burn_dialog_record_queue (RejillaBurnDialog *dialog,
+				  GSList *drives,
+				  guint copies,
+				  GError **error)
+{
+	RejillaBurnDialogPrivate *priv;
+	RejillaBurnResult result;
+
+	priv = REJILLA_BURN_DIALOG_PRIVATE (dialog);
+
+	/* Blank discs are used as they are inserted in any of the burners */
+	result = rejilla_burn_record_queue (priv->burn,
+					    priv->session,
+					    drives,
+					    copies,
+					    error);
+
+	/* All copies were made: no need to ask for another one */
+	if (result == REJILLA_BURN_OK)
+		priv->num_copies = 0;
+
+	return result;
+}
+
+static void
+rejilla_burn_dialog_copy_finished_cb (RejillaBurn *burn,
+				      RejillaDrive *drive,
+				      RejillaBurnResult result,
+				      GSList **failed)
+{
+	if (result != REJILLA_BURN_OK && result != REJILLA_BURN_CANCEL)
+		*failed = g_slist_append (*failed, drive);
+}
+
+static void
+rejilla_burn_dialog_copies_failed (RejillaBurnDialog *dialog,
+				   GSList *failed)
+{
+	GtkWidget *message;
+	GString *names;
+	GSList *iter;
+
+	names = g_string_new (NULL);
+	for (iter = failed; iter; iter = iter->next) {
+		gchar *name;
+
+		name = rejilla_drive_get_display_name (iter->data);
+		if (names->len)
+			g_string_append (names, ", ");
+		g_string_append (names, name);
+		g_free (name);
+	}
+
+	message = rejilla_burn_dialog_create_message (dialog,
+						      GTK_MESSAGE_WARNING,
+						      GTK_BUTTONS_CLOSE,
+						      _("Some copies could not be made."));
+	gtk_message_dialog_format_secondary_text (GTK_MESSAGE_DIALOG (message),
+						  _("The discs in the following burners could not be written: %s."),
+						  names->str);
+	gtk_dialog_run (GTK_DIALOG (message));
+	gtk_widget_destroy (message);
+
+	g_string_free (names, TRUE);
+}
+
+static RejillaBurnResult
+rejilla_burn_dialog_record_copies (RejillaBurnDialog *dialog,
+				   GError **error)
+{
+	RejillaBurnDialogPrivate *priv;
+	RejillaBurnResult result;
+	GSList *failed = NULL;
+	GSList *drives;
+	gulong sig;
+
+	priv = REJILLA_BURN_DIALOG_PRIVATE (dialog);
+
+	/* Before the first copy, with several burners connected, the number
+	 * of copies can be set to keep all the burners busy */
+	if (priv->num_copies == 1) {
+		drives = rejilla_burn_dialog_get_copy_drives (dialog, FALSE);
+		if (drives->next) {
+			guint copies = 0;
+
+			result = rejilla_burn_dialog_ask_copies (dialog, &copies);
+			if (result != REJILLA_BURN_OK || copies) {
+				if (result == REJILLA_BURN_OK)
+					result = rejilla_burn_dialog_record_queue (dialog,
+										   drives,
+										   copies,
+										   error);
+				g_slist_free (drives);
+				return result;
+			}
+		}
+
+		g_slist_free (drives);
+	}
+
+	/* Record all the discs inserted at the same time. Only the result
+	 * for the burner of the session counts; the other drives that
+	 * failed are listed afterwards. */
+	drives = rejilla_burn_dialog_get_copy_drives (dialog, TRUE);
+	sig = g_signal_connect (priv->burn,
+				"drive-finished",
+				G_CALLBACK (rejilla_burn_dialog_copy_finished_cb),
+				&failed);
+	result = rejilla_burn_record_multi (priv->burn,
+					    priv->session,
+					    drives,
+					    error);
+	g_signal_handler_disconnect (priv->burn, sig);
+
+	failed = g_slist_remove (failed, drives->data);
+	if (result == REJILLA_BURN_OK) {
+		/* So the number of the last copy is shown */
+		priv->num_copies += g_slist_length (drives) - 1 - g_slist_length (failed);
+
+		if (failed)
+			rejilla_burn_dialog_copies_failed (dialog, failed);
+	}
+
+	g_slist_free (failed);
+	g_slist_free (drives);
+	return result;
+}
+
 static RejillaBurnResult
 rejilla_burn_dialog_record_session (RejillaBurnDialog *dialog)
 {
@@ -2259,6 +2529,9 @@ rejilla_burn_dialog_record_session (RejillaBurnDialog *dialog)
 
 	if (REJILLA_IS_SESSION_SPAN (priv->session))
 		result = rejilla_burn_dialog_record_spanned_session (dialog, &error);
+	else if (priv->num_copies
+	     && !rejilla_burn_session_is_dest_file (priv->session))
+		result = rejilla_burn_dialog_record_copies (dialog, &error);
 	else
 		result = rejilla_burn_record (priv->burn,
 					      priv->session,
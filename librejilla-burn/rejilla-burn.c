@@ -53,12 +53,15 @@
 #include "burn-dbus.h"
 #include "burn-task-ctx.h"
 #include "burn-task.h"
+#include "burn-stats.h"
+#include "burn-verify.h"
 #include "rejilla-caps-burn.h"
 
 #include "rejilla-drive-priv.h"
 
 #include "rejilla-volume.h"
 #include "rejilla-drive.h"
+#include "rejilla-medium-monitor.h"
 
 #include "rejilla-tags.h"
 #include "rejilla-track.h"
@@ -89,7 +92,80 @@ struct _RejillaBurnPrivate {
 	guint64 session_start;
 	guint64 session_end;
 
+	/* Speed requested for the last recording (for statistics) and the
+	 * result of that recording until the disc is checked */
+	guint64 write_rate;
+	goffset write_bytes;
+	gdouble write_elapsed;
+
+	/* Comparison of the disc with the image while recording */
+	RejillaBurnVerify *verify;
+	GMainLoop *verify_loop;
+
+	/* Recordings run in parallel by rejilla_burn_record_multi () */
+	GSList *children;
+	GMainLoop *children_loop;
+	guint children_running;
+
+	/* rejilla_burn_record_queue (): copies to make, assigned to a medium
+	 * and successfully made */
+	GSList *queue_drives;
+	GTimer *queue_timer;
+	guint queue_copies;
+	guint queue_assigned;
+	guint queue_done;
+	guint queue_failed;
+
 	guint mounted_by_us:1;
+	guint children_cancelled:1;
+	guint write_pending:1;
+};
+
+typedef enum {
+	REJILLA_BURN_CHILD_WAITING,
+	REJILLA_BURN_CHILD_LOCKING,
+	REJILLA_BURN_CHILD_ERASING,
+	REJILLA_BURN_CHILD_IMAGING,
+	REJILLA_BURN_CHILD_RECORDING,
+	REJILLA_BURN_CHILD_VERIFYING,
+	REJILLA_BURN_CHILD_CHECKING,
+	REJILLA_BURN_CHILD_FINISHED
+} RejillaBurnChildState;
+
+typedef struct _RejillaBurnChild RejillaBurnChild;
+typedef void (*RejillaBurnChildStep) (RejillaBurnChild *child);
+
+struct _RejillaBurnChild {
+	RejillaBurn *parent;
+
+	RejillaBurn *burn;
+	RejillaBurnSession *session;
+	RejillaDrive *drive;
+
+	RejillaBurnResult result;
+	GError *error;
+
+	gdouble overall_progress;
+	gdouble action_progress;
+	glong time_remaining;
+
+	/* Number of the copy in queue mode */
+	guint copy;
+
+	/* Children never run a loop: each step is started from the main loop
+	 * once the previous one is over (see rejilla_burn_child_start ()) */
+	RejillaBurnChildState state;
+	RejillaBurnChildStep next_step;
+	GSList *tasks;
+	GTimer *timer;
+	guint wait_id;
+	guint progress_id;
+
+	guint wait_exclusive:1;
+	guint settings_pushed:1;
+	guint tracks_pushed:1;
+	guint dummy_done:1;
+	guint done:1;
 };
 
 #define REJILLA_BURN_NOT_SUPPORTED_LOG(burn)					\
@@ -138,6 +214,8 @@ typedef enum {
 	EJECT_FAILURE_SIGNAL,
 	BLANK_FAILURE_SIGNAL,
 	INSTALL_MISSING_SIGNAL,
+	DRIVE_PROGRESS_CHANGED_SIGNAL,
+	DRIVE_FINISHED_SIGNAL,
 	LAST_SIGNAL
 } RejillaBurnSignalType;
 
@@ -1079,6 +1157,13 @@ rejilla_burn_progress_changed (RejillaTaskCtx *task,
 		overall_progress =  (gdouble) priv->tasks_done /
 				    (gdouble) priv->task_nb;
 
+	if (priv->verify) {
+		gint64 written = 0;
+
+		rejilla_task_ctx_get_written (task, &written);
+		rejilla_burn_verify_set_written (priv->verify, written);
+	}
+
 	g_signal_emit (burn,
 		       rejilla_burn_signals [PROGRESS_CHANGED_SIGNAL],
 		       0,
@@ -1146,6 +1231,13 @@ rejilla_burn_get_action_string (RejillaBurn *burn,
  * an ongoing operation; REJILLA_BURN_NOT_READY otherwise.
  **/
 
+static RejillaBurnResult
+rejilla_burn_children_status (RejillaBurn *self,
+			      RejillaMedia *media,
+			      goffset *isosize,
+			      goffset *written,
+			      guint64 *rate);
+
 RejillaBurnResult
 rejilla_burn_status (RejillaBurn *burn,
 		     RejillaMedia *media,
@@ -1160,6 +1252,9 @@ rejilla_burn_status (RejillaBurn *burn,
 	
 	priv = REJILLA_BURN_PRIVATE (burn);
 
+	if (priv->children)
+		return rejilla_burn_children_status (burn, media, isosize, written, rate);
+
 	if (!priv->task)
 		return REJILLA_BURN_NOT_READY;
 
@@ -1469,10 +1564,126 @@ rejilla_burn_can_use_drive_exclusively (RejillaBurn *burn,
 	return REJILLA_BURN_OK;
 }
 
+static void
+rejilla_burn_verify_prepare (RejillaBurn *self)
+{
+	RejillaBurnPrivate *priv;
+	RejillaTrack *track;
+	goffset bytes = 0;
+	GSList *tracks;
+	gchar *path;
+
+	priv = REJILLA_BURN_PRIVATE (self);
+
+	if (priv->verify) {
+		rejilla_burn_verify_free (priv->verify);
+		priv->verify = NULL;
+	}
+
+	if (!rejilla_burn_session_tag_lookup_int (priv->session, REJILLA_SESSION_VERIFY_WHILE_WRITING))
+		return;
+
+	if (rejilla_burn_session_get_flags (priv->session) & REJILLA_BURN_FLAG_DUMMY)
+		return;
+
+	/* Only an image whose blocks are those written on the disc can be
+	 * compared with it; otherwise the checksum is checked afterwards */
+	tracks = rejilla_burn_session_get_tracks (priv->session);
+	if (g_slist_length (tracks) != 1)
+		return;
+
+	track = tracks->data;
+	if (!REJILLA_IS_TRACK_IMAGE (track)
+	||   rejilla_track_image_get_format (REJILLA_TRACK_IMAGE (track)) != REJILLA_IMAGE_FORMAT_BIN)
+		return;
+
+	path = rejilla_track_image_get_source (REJILLA_TRACK_IMAGE (track), FALSE);
+	if (!path)
+		return;
+
+	rejilla_track_get_size (track, NULL, &bytes);
+	if (bytes > 0)
+		priv->verify = rejilla_burn_verify_new (rejilla_burn_session_get_burner (priv->session),
+							path,
+							priv->session_start,
+							bytes);
+	g_free (path);
+}
+
+/**
+ * Whether a recording went well is only known once the disc was checked so
+ * a successful one is only recorded in the statistics after that, once per
+ * attempt, by rejilla_burn_record_write_checked ().
+ */
+
+static void
+rejilla_burn_record_write (RejillaBurn *self,
+			   RejillaBurnResult result,
+			   GError *error,
+			   gdouble elapsed)
+{
+	RejillaBurnPrivate *priv;
+
+	priv = REJILLA_BURN_PRIVATE (self);
+
+	priv->write_pending = FALSE;
+
+	/* Simulations don't say whether a medium can be written at a speed */
+	if (rejilla_burn_session_get_flags (priv->session) & REJILLA_BURN_FLAG_DUMMY)
+		return;
+
+	if (result == REJILLA_BURN_OK) {
+		priv->write_bytes = 0;
+		rejilla_burn_session_get_size (priv->session, NULL, &priv->write_bytes);
+		priv->write_elapsed = elapsed;
+		priv->write_pending = TRUE;
+	}
+	else if (result == REJILLA_BURN_ERR
+	     &&  error
+	     &&  error->domain == REJILLA_BURN_ERROR
+	     && (error->code == REJILLA_BURN_ERROR_WRITE_MEDIUM
+	     ||  error->code == REJILLA_BURN_ERROR_SLOW_DMA))
+		rejilla_burn_stats_record_write (rejilla_drive_get_medium (rejilla_burn_session_get_burner (priv->session)),
+						 priv->write_rate,
+						 0,
+						 elapsed,
+						 FALSE);
+}
+
+static void
+rejilla_burn_record_write_checked (RejillaBurn *self,
+				   RejillaBurnResult result,
+				   GError *error)
+{
+	RejillaBurnPrivate *priv;
+	gboolean success;
+
+	priv = REJILLA_BURN_PRIVATE (self);
+
+	if (!priv->write_pending)
+		return;
+
+	priv->write_pending = FALSE;
+
+	/* A disc that can't be read back was not written at the right speed */
+	success = (result != REJILLA_BURN_ERR
+	       ||  !error
+	       ||   error->domain != REJILLA_BURN_ERROR
+	       ||   error->code != REJILLA_BURN_ERROR_BAD_CHECKSUM);
+
+	rejilla_burn_stats_record_write (rejilla_drive_get_medium (rejilla_burn_session_get_burner (priv->session)),
+					 priv->write_rate,
+					 success? priv->write_bytes:0,
+					 priv->write_elapsed,
+					 success);
+}
+
 static RejillaBurnResult
 rejilla_burn_run_recorder (RejillaBurn *burn, GError **error)
 {
 	gint error_code;
+	GTimer *timer;
+	gdouble elapsed;
 	RejillaDrive *src;
 	gboolean has_slept;
 	RejillaDrive *burner;
@@ -1513,8 +1724,22 @@ start:
 	if (result != REJILLA_BURN_OK)
 		return result;
 
+	priv->write_rate = rejilla_burn_session_get_rate (priv->session);
+
+	rejilla_burn_verify_prepare (burn);
+
 	/* actual running of task */
+	timer = g_timer_new ();
 	result = rejilla_task_run (priv->task, &ret_error);
+	elapsed = g_timer_elapsed (timer, NULL);
+	g_timer_destroy (timer);
+
+	if (result != REJILLA_BURN_OK && priv->verify) {
+		rejilla_burn_verify_free (priv->verify);
+		priv->verify = NULL;
+	}
+
+	rejilla_burn_record_write (burn, result, ret_error, elapsed);
 
 	/* let's see the results */
 	if (result == REJILLA_BURN_OK) {
@@ -2032,6 +2257,103 @@ reload:
 	return REJILLA_BURN_RETRY;
 }
 
+/* Probability for an unmeasured speed to fail at the maximum speed */
+#define REJILLA_BURN_AUTO_FAILURE_PRIOR		0.05
+
+/* Weight (in recordings) of the prior above */
+#define REJILLA_BURN_AUTO_PRIOR_WEIGHT		2.0
+
+static void
+rejilla_burn_auto_write_strategy (RejillaBurn *self)
+{
+	gdouble best_time = G_MAXDOUBLE;
+	RejillaBurnPrivate *priv;
+	RejillaMedium *medium;
+	RejillaBurnFlag flags;
+	guint64 best_rate = 0;
+	gdouble verify_time;
+	goffset bytes = 0;
+	guint64 *rates;
+	guint i;
+
+	priv = REJILLA_BURN_PRIVATE (self);
+
+	medium = rejilla_drive_get_medium (rejilla_burn_session_get_burner (priv->session));
+	if (!medium)
+		return;
+
+	rejilla_burn_session_get_size (priv->session, NULL, &bytes);
+	if (bytes <= 0)
+		return;
+
+	/* NOTE: speeds are sorted in decreasing order */
+	rates = rejilla_medium_get_write_speeds (medium);
+	if (!rates)
+		return;
+
+	/* Reading back is at least as fast as writing at the highest speed */
+	verify_time = (gdouble) bytes / rates [0];
+
+	for (i = 0; rates [i] != 0; i ++) {
+		guint64 achieved = 0;
+		gdouble failure;
+		guint failures = 0;
+		gdouble time;
+		guint samples;
+
+		/* Slower speeds are supposed to be safer until proven wrong */
+		failure = REJILLA_BURN_AUTO_FAILURE_PRIOR * rates [i] / rates [0];
+
+		samples = rejilla_burn_stats_get_write_rate (medium,
+							     rates [i],
+							     &achieved,
+							     &failures);
+		if (samples)
+			failure = (failures + failure * REJILLA_BURN_AUTO_PRIOR_WEIGHT) /
+				  (samples + REJILLA_BURN_AUTO_PRIOR_WEIGHT);
+
+		if (!achieved)
+			achieved = rates [i];
+
+		/* A failed disc means the whole recording and check again */
+		time = ((gdouble) bytes / achieved + verify_time) / (1.0 - MIN (failure, 0.9));
+
+		REJILLA_BURN_LOG ("Speed %" G_GUINT64_FORMAT " B/s: %.0f B/s achieved, %.2f failures (%i samples), %.0f s",
+				  rates [i],
+				  (gdouble) achieved,
+				  failure,
+				  samples,
+				  time);
+
+		if (time < best_time) {
+			best_time = time;
+			best_rate = rates [i];
+		}
+	}
+	g_free (rates);
+
+	rejilla_burn_session_set_rate (priv->session, best_rate);
+
+	/* These are safer and cost nothing when supported; the flags will be
+	 * removed by rejilla_burn_check_session_consistency () otherwise. */
+	flags = rejilla_burn_session_get_flags (priv->session);
+	if (rejilla_medium_can_use_burnfree (medium))
+		flags |= REJILLA_BURN_FLAG_BURNPROOF;
+
+	/* DAO writes the disc in one go without link blocks between tracks */
+	if (rejilla_medium_can_use_sao (medium)
+	&& !(flags & (REJILLA_BURN_FLAG_APPEND|REJILLA_BURN_FLAG_MERGE|REJILLA_BURN_FLAG_MULTI)))
+		flags |= REJILLA_BURN_FLAG_DAO;
+
+	rejilla_burn_session_set_flags (priv->session, flags);
+
+	REJILLA_BURN_LOG_FLAGS (flags, "Automatic write strategy: speed %" G_GUINT64_FORMAT " B/s (%.0f s expected)", best_rate, best_time);
+	rejilla_burn_session_log (priv->session,
+				  "Automatic write strategy: speed %" G_GUINT64_FORMAT " B/s (%.0f s expected)",
+				  best_rate,
+				  best_time);
+}
+
 /* FIXME: at the moment we don't allow for mixed CD type */
 static RejillaBurnResult
 rejilla_burn_run_tasks (RejillaBurn *burn,
@@ -2047,6 +2369,11 @@ rejilla_burn_run_tasks (RejillaBurn *burn,
 	/* push the session settings to keep the original session untainted */
 	rejilla_burn_session_push_settings (priv->session);
 
+	if (!temp_output
+	&&  !rejilla_burn_session_is_dest_file (priv->session)
+	&&   rejilla_burn_session_tag_lookup_int (priv->session, REJILLA_SESSION_AUTO_WRITE_STRATEGY))
+		rejilla_burn_auto_write_strategy (burn);
+
 	/* check flags consistency */
 	result = rejilla_burn_check_session_consistency (burn, temp_output, error);
 	if (result != REJILLA_BURN_OK) {
@@ -2363,11 +2690,87 @@ rejilla_burn_unset_checksums (RejillaBurn *self)
 	rejilla_track_type_free (type);
 }
 
+static gboolean
+rejilla_burn_verify_finished_cb (gpointer data)
+{
+	RejillaBurnPrivate *priv = REJILLA_BURN_PRIVATE (data);
+
+	if (priv->verify_loop)
+		g_main_loop_quit (priv->verify_loop);
+
+	return FALSE;
+}
+
+static gboolean
+rejilla_burn_verify_progress_cb (gpointer data)
+{
+	RejillaBurnPrivate *priv = REJILLA_BURN_PRIVATE (data);
+	gdouble progress;
+	goffset size;
+
+	size = rejilla_burn_verify_get_size (priv->verify);
+	progress = (gdouble) rejilla_burn_verify_get_verified (priv->verify) / size;
+
+	g_signal_emit (data,
+		       rejilla_burn_signals [PROGRESS_CHANGED_SIGNAL],
+		       0,
+		       progress,
+		       progress,
+		       -1L);
+	return TRUE;
+}
+
+static RejillaBurnResult
+rejilla_burn_verify_written (RejillaBurn *self,
+			     GError **error)
+{
+	RejillaBurnPrivate *priv;
+	RejillaBurnResult result;
+	guint progress_id;
+
+	priv = REJILLA_BURN_PRIVATE (self);
+
+	REJILLA_BURN_LOG ("%"G_GOFFSET_FORMAT" bytes out of %"G_GOFFSET_FORMAT" verified while recording",
+			  rejilla_burn_verify_get_verified (priv->verify),
+			  rejilla_burn_verify_get_size (priv->verify));
+
+	rejilla_burn_action_changed_real (self, REJILLA_BURN_ACTION_CHECKSUM);
+
+	/* Only what could not be read while recording remains */
+	priv->verify_loop = g_main_loop_new (NULL, FALSE);
+	progress_id = g_timeout_add (500, rejilla_burn_verify_progress_cb, self);
+	rejilla_burn_verify_finish (priv->verify, rejilla_burn_verify_finished_cb, self);
+
+	g_main_loop_run (priv->verify_loop);
+
+	g_source_remove (progress_id);
+	g_main_loop_unref (priv->verify_loop);
+	priv->verify_loop = NULL;
+
+	result = rejilla_burn_verify_get_result (priv->verify, error);
+	rejilla_burn_verify_free (priv->verify);
+	priv->verify = NULL;
+
+	g_signal_emit (self,
+		       rejilla_burn_signals [PROGRESS_CHANGED_SIGNAL],
+		       0,
+		       1.0,
+		       1.0,
+		       -1L);
+	return result;
+}
+
 static RejillaBurnResult
 rejilla_burn_record_session (RejillaBurn *burn,
 			     gboolean erase_allowed,
                              RejillaTrackType *temp_output,
-			     GError **error)
+			     GError **error);
+
+static RejillaBurnResult
+rejilla_burn_record_session_real (RejillaBurn *burn,
+				  gboolean erase_allowed,
+				  RejillaTrackType *temp_output,
+				  GError **error)
 {
 	gboolean dummy_session = FALSE;
 	const gchar *checksum = NULL;
@@ -2376,7 +2779,6 @@ rejilla_burn_record_session (RejillaBurn *burn,
 	RejillaBurnPrivate *priv;
 	RejillaBurnResult result;
 	GError *ret_error = NULL;
-	RejillaMedium *medium;
 	GSList *tracks;
 
 	priv = REJILLA_BURN_PRIVATE (burn);
@@ -2405,6 +2807,11 @@ rejilla_burn_record_session (RejillaBurn *burn,
 			ret_error = NULL;
 		}
 
+		if (priv->verify) {
+			rejilla_burn_verify_free (priv->verify);
+			priv->verify = NULL;
+		}
+
 		return result;
 	}
 
@@ -2442,6 +2849,15 @@ rejilla_burn_record_session (RejillaBurn *burn,
 		return result;
 	}
 
+	/* The disc was compared with the image while it was recorded. There
+	 * is no need to read it all again to compute its checksum. */
+	if (priv->verify) {
+		rejilla_burn_action_changed_real (burn, REJILLA_BURN_ACTION_FINISHED);
+
+		result = rejilla_burn_verify_written (burn, error);
+		goto checked;
+	}
+
 	/* see if we have a checksum generated for the session if so use
 	 * it to check if the recording went well remaining on the top of
 	 * the session should be the last track burnt/imaged */
@@ -2493,8 +2909,6 @@ rejilla_burn_record_session (RejillaBurn *burn,
 		return result;
 	}
 
-	medium = rejilla_drive_get_medium (priv->dest);
-
 	/* Why do we do this?
 	 * Because for a lot of medium types the size
 	 * of the track return is not the real size of the
@@ -2531,6 +2945,8 @@ rejilla_burn_record_session (RejillaBurn *burn,
 	result = rejilla_burn_check_real (burn, track, error);
 	rejilla_burn_session_pop_tracks (priv->session);
 
+checked:
+
 	if (result == REJILLA_BURN_CANCEL) {
 		/* change the result value so we won't stop here if there are 
 		 * other copies to be made */
@@ -2540,6 +2956,29 @@ rejilla_burn_record_session (RejillaBurn *burn,
 	return result;
 }
 
+static RejillaBurnResult
+rejilla_burn_record_session (RejillaBurn *burn,
+			     gboolean erase_allowed,
+                             RejillaTrackType *temp_output,
+			     GError **error)
+{
+	GError *ret_error = NULL;
+	RejillaBurnResult result;
+
+	result = rejilla_burn_record_session_real (burn,
+						   erase_allowed,
+						   temp_output,
+						   &ret_error);
+
+	/* The recording (if any) is over and checked */
+	rejilla_burn_record_write_checked (burn, result, ret_error);
+
+	if (ret_error)
+		g_propagate_error (error, ret_error);
+
+	return result;
+}
+
 /**
  * rejilla_burn_check:
  * @burn: a #RejillaBurn
@@ -2879,104 +3318,1677 @@ end:
 	return result;
 }
 
-static RejillaBurnResult
-rejilla_burn_blank_real (RejillaBurn *burn, GError **error)
+/**
+ * Multi-drive recording: the image is created once and then each drive gets
+ * its own RejillaBurn object to record it.
+ */
+
+static void
+rejilla_burn_child_free (RejillaBurnChild *child)
+{
+	g_signal_handlers_disconnect_matched (child->burn,
+					      G_SIGNAL_MATCH_DATA,
+					      0,
+					      0,
+					      NULL,
+					      NULL,
+					      child);
+
+	g_object_unref (child->burn);
+	g_object_unref (child->session);
+	g_object_unref (child->drive);
+
+	if (child->error)
+		g_error_free (child->error);
+
+	g_free (child);
+}
+
+static void
+rejilla_burn_child_progress_changed (RejillaBurn *burn,
+				     gdouble overall_progress,
+				     gdouble action_progress,
+				     glong time_remaining,
+				     RejillaBurnChild *child)
 {
-	RejillaBurnResult result;
 	RejillaBurnPrivate *priv;
+	gdouble overall = 0.0;
+	gdouble action = 0.0;
+	glong remaining = -1;
+	guint children_num;
+	GSList *iter;
 
-	priv = REJILLA_BURN_PRIVATE (burn);
+	priv = REJILLA_BURN_PRIVATE (child->parent);
 
-	priv->task = rejilla_burn_caps_new_blanking_task (priv->caps,
-							  priv->session,
-							  error);
-	if (!priv->task)
-		return REJILLA_BURN_NOT_SUPPORTED;
+	child->overall_progress = overall_progress;
+	child->action_progress = action_progress;
+	child->time_remaining = time_remaining;
 
-	g_signal_connect (priv->task,
-			  "progress-changed",
-			  G_CALLBACK (rejilla_burn_progress_changed),
-			  burn);
-	g_signal_connect (priv->task,
-			  "action-changed",
-			  G_CALLBACK (rejilla_burn_action_changed),
-			  burn);
+	g_signal_emit (child->parent,
+		       rejilla_burn_signals [DRIVE_PROGRESS_CHANGED_SIGNAL],
+		       0,
+		       child->drive,
+		       overall_progress,
+		       action_progress,
+		       time_remaining);
 
-	result = rejilla_burn_run_eraser (burn, error);
-	g_object_unref (priv->task);
-	priv->task = NULL;
+	if (priv->queue_copies) {
+		/* Progress is the number of copies made */
+		overall = priv->queue_done;
+		for (iter = priv->children; iter; iter = iter->next) {
+			RejillaBurnChild *other;
 
-	return result;
-}
+			other = iter->data;
+			if (!other->done)
+				overall += MAX (other->overall_progress, 0.0);
+		}
 
-/**
- * rejilla_burn_blank:
- * @burn: a #RejillaBurn
- * @session: a #RejillaBurnSession
- * @error: a #GError
- *
- * Blanks a medium according to the parameters
- * set in @session. The medium must be inserted in the #RejillaDrive
- * set with rejilla_burn_session_set_burner ().
- *
- * Return value: a #RejillaBurnResult. The result of the operation. 
- * REJILLA_BURN_OK if it was successful.
- **/
+		g_signal_emit (child->parent,
+			       rejilla_burn_signals [PROGRESS_CHANGED_SIGNAL],
+			       0,
+			       MIN (overall / priv->queue_copies, 1.0),
+			       action_progress,
+			       (glong) -1);
+		return;
+	}
 
-RejillaBurnResult
-rejilla_burn_blank (RejillaBurn *burn,
-		    RejillaBurnSession *session,
-		    GError **error)
-{
-	RejillaBurnPrivate *priv;
-	RejillaBurnResult result;
-	GError *ret_error = NULL;
+	/* The session ends with the slowest drive */
+	children_num = 0;
+	for (iter = priv->children; iter; iter = iter->next) {
+		RejillaBurnChild *other;
 
-	g_return_val_if_fail (burn != NULL, REJILLA_BURN_ERR);
-	g_return_val_if_fail (session != NULL, REJILLA_BURN_ERR);
+		other = iter->data;
+		if (other->done) {
+			overall += 1.0;
+			action += 1.0;
+		}
+		else {
+			overall += MAX (other->overall_progress, 0.0);
+			action += MAX (other->action_progress, 0.0);
+			remaining = MAX (remaining, other->time_remaining);
+		}
 
-	priv = REJILLA_BURN_PRIVATE (burn);
+		children_num ++;
+	}
 
-	g_object_ref (session);
-	priv->session = session;
+	g_signal_emit (child->parent,
+		       rejilla_burn_signals [PROGRESS_CHANGED_SIGNAL],
+		       0,
+		       overall / children_num,
+		       action / children_num,
+		       remaining);
+}
 
-	rejilla_burn_powermanagement (burn, TRUE);
+static void
+rejilla_burn_child_finished (RejillaBurnChild *child,
+			     RejillaBurnResult result)
+{
+	RejillaBurnPrivate *priv;
 
-	/* we wait for the insertion of a media and lock it */
-	result = rejilla_burn_lock_rewritable_media (burn, error);
-	if (result != REJILLA_BURN_OK)
-		goto end;
+	priv = REJILLA_BURN_PRIVATE (child->parent);
 
-	result = rejilla_burn_blank_real (burn, &ret_error);
-	while (result == REJILLA_BURN_ERR &&
-	       ret_error &&
-	       ret_error->code == REJILLA_BURN_ERROR_MEDIUM_NOT_REWRITABLE) {
-		g_error_free (ret_error);
-		ret_error = NULL;
+	child->done = TRUE;
+	child->result = result;
 
-		result = rejilla_burn_ask_for_dest_media (burn,
-							  REJILLA_BURN_ERROR_MEDIUM_NOT_REWRITABLE,
-							  REJILLA_MEDIUM_REWRITABLE|
-							  REJILLA_MEDIUM_HAS_DATA,
-							  error);
-		if (result != REJILLA_BURN_OK)
-			break;
+	REJILLA_BURN_LOG ("Recording with %s finished (%i)",
+			  rejilla_drive_get_device (child->drive),
+			  child->result);
 
-		result = rejilla_burn_lock_rewritable_media (burn, error);
-		if (result != REJILLA_BURN_OK)
-			break;
+	if (priv->queue_copies) {
+		if (result == REJILLA_BURN_OK)
+			priv->queue_done ++;
+		else {
+			/* Another medium will be needed */
+			priv->queue_failed ++;
+			priv->queue_assigned --;
+		}
 
-		result = rejilla_burn_blank_real (burn, &ret_error);
+		rejilla_burn_session_log (priv->session,
+					  "Copy %i on %s: %s%s%s",
+					  child->copy,
+					  rejilla_drive_get_device (child->drive),
+					  result == REJILLA_BURN_OK ? "success":(result == REJILLA_BURN_CANCEL ? "cancelled":"failure"),
+					  child->error ? " - ":"",
+					  child->error ? child->error->message:"");
 	}
 
-end:
-	if (ret_error)
-		g_propagate_error (error, ret_error);
+	g_signal_emit (child->parent,
+		       rejilla_burn_signals [DRIVE_FINISHED_SIGNAL],
+		       0,
+		       child->drive,
+		       child->result);
 
-	if (result == REJILLA_BURN_OK && !ret_error)
-		result = rejilla_burn_unlock_medias (burn, error);
-	else
-		rejilla_burn_unlock_medias (burn, NULL);
+	priv->children_running --;
+
+	/* In queue mode wait for the next medium to be inserted */
+	if (priv->queue_copies
+	&&  priv->queue_done < priv->queue_copies
+	&& !priv->children_cancelled)
+		return;
+
+	if (!priv->children_running && priv->children_loop)
+		g_main_loop_quit (priv->children_loop);
+}
+
+static void
+rejilla_burn_child_action_changed (RejillaBurn *burn,
+				   RejillaBurnAction action,
+				   RejillaBurnChild *child)
+{
+	/* The parent is finished once all drives are */
+	if (action != REJILLA_BURN_ACTION_FINISHED)
+		rejilla_burn_action_changed_real (child->parent, action);
+}
+
+static RejillaBurnResult
+rejilla_burn_child_question (RejillaBurn *burn,
+			     RejillaBurnChild *child)
+{
+	GSignalInvocationHint *hint;
+	RejillaBurnPrivate *priv;
+	guint signal;
+
+	/* Children are RejillaBurn objects too so the signal ids are the same */
+	hint = g_signal_get_invocation_hint (burn);
+	for (signal = 0; signal < LAST_SIGNAL; signal ++) {
+		if (rejilla_burn_signals [signal] == hint->signal_id)
+			break;
+	}
+
+	if (signal == LAST_SIGNAL)
+		return REJILLA_BURN_CANCEL;
+
+	/* Nobody is there to answer in queue mode; the medium is skipped.
+	 * Rewritable discs are only accepted when they are to be blanked (see
+	 * rejilla_burn_queue_medium_usable ()) so the user already agreed to
+	 * lose their contents. */
+	priv = REJILLA_BURN_PRIVATE (child->parent);
+	if (priv->queue_copies)
+		return (signal == DUMMY_SUCCESS_SIGNAL
+		    ||  signal == WARN_DATA_LOSS_SIGNAL
+		    ||  signal == WARN_REWRITABLE_SIGNAL) ? REJILLA_BURN_OK:REJILLA_BURN_CANCEL;
+
+	return rejilla_burn_emit_signal (child->parent,
+					 signal,
+					 signal == DUMMY_SUCCESS_SIGNAL ? REJILLA_BURN_OK:REJILLA_BURN_CANCEL);
+}
+
+static RejillaBurnResult
+rejilla_burn_child_insert_media (RejillaBurn *burn,
+				 RejillaDrive *drive,
+				 RejillaBurnError error,
+				 RejillaMedia required_media,
+				 RejillaBurnChild *child)
+{
+	RejillaBurnPrivate *priv;
+
+	/* In queue mode the next medium inserted will be used instead */
+	priv = REJILLA_BURN_PRIVATE (child->parent);
+	if (priv->queue_copies)
+		return REJILLA_BURN_CANCEL;
+
+	return rejilla_burn_ask_for_media (child->parent,
+					   drive,
+					   error,
+					   required_media,
+					   NULL);
+}
+
+static RejillaBurnResult
+rejilla_burn_child_eject_failure (RejillaBurn *burn,
+				  RejillaDrive *drive,
+				  RejillaBurnChild *child)
+{
+	RejillaBurnResult result = REJILLA_BURN_CANCEL;
+
+	g_signal_emit (child->parent,
+		       rejilla_burn_signals [EJECT_FAILURE_SIGNAL],
+		       0,
+		       drive,
+		       &result);
+	return result;
+}
+
+static RejillaBurnResult
+rejilla_burn_child_install_missing (RejillaBurn *burn,
+				    RejillaPluginErrorType type,
+				    const gchar *detail,
+				    RejillaBurnChild *child)
+{
+	RejillaBurnResult result = REJILLA_BURN_ERR;
+
+	g_signal_emit (child->parent,
+		       rejilla_burn_signals [INSTALL_MISSING_SIGNAL],
+		       0,
+		       type,
+		       detail,
+		       &result);
+	return result;
+}
+
+static RejillaBurnChild *
+rejilla_burn_child_new (RejillaBurn *self,
+			RejillaDrive *drive)
+{
+	const gchar *questions [] = { "warn_data_loss",
+				      "warn_previous_session_loss",
+				      "warn_audio_to_appendable",
+				      "warn_rewritable",
+				      "dummy_success",
+				      "blank_failure",
+				      NULL };
+	RejillaBurnPrivate *priv;
+	RejillaBurnChild *child;
+	GSList *tracks;
+	int i;
+
+	priv = REJILLA_BURN_PRIVATE (self);
+
+	child = g_new0 (RejillaBurnChild, 1);
+	child->parent = self;
+	child->drive = g_object_ref (drive);
+	child->overall_progress = -1.0;
+	child->action_progress = -1.0;
+	child->time_remaining = -1;
+	child->result = REJILLA_BURN_NOT_RUNNING;
+
+	/* All sessions share the same (image) tracks */
+	child->session = rejilla_burn_session_new ();
+	tracks = rejilla_burn_session_get_tracks (priv->session);
+	for (; tracks; tracks = tracks->next)
+		rejilla_burn_session_add_track (child->session, tracks->data, NULL);
+
+	rejilla_burn_session_set_burner (child->session, drive);
+	rejilla_burn_session_set_flags (child->session, rejilla_burn_session_get_flags (priv->session));
+	if (priv->queue_copies) {
+		/* Make room for the next medium and never stop to ask */
+		rejilla_burn_session_add_flag (child->session, REJILLA_BURN_FLAG_EJECT);
+		rejilla_burn_session_remove_flag (child->session, REJILLA_BURN_FLAG_DUMMY);
+	}
+
+	rejilla_burn_session_set_rate (child->session, rejilla_burn_session_get_rate (priv->session));
+	if (rejilla_burn_session_tag_lookup_int (priv->session, REJILLA_SESSION_AUTO_WRITE_STRATEGY))
+		rejilla_burn_session_tag_add_int (child->session, REJILLA_SESSION_AUTO_WRITE_STRATEGY, TRUE);
+	if (rejilla_burn_session_tag_lookup_int (priv->session, REJILLA_SESSION_VERIFY_WHILE_WRITING))
+		rejilla_burn_session_tag_add_int (child->session, REJILLA_SESSION_VERIFY_WHILE_WRITING, TRUE);
+
+	rejilla_burn_session_set_tmpdir (child->session, rejilla_burn_session_get_tmpdir (priv->session));
+
+	child->burn = rejilla_burn_new ();
+	g_signal_connect (child->burn,
+			  "progress_changed",
+			  G_CALLBACK (rejilla_burn_child_progress_changed),
+			  child);
+	g_signal_connect (child->burn,
+			  "action_changed",
+			  G_CALLBACK (rejilla_burn_child_action_changed),
+			  child);
+	g_signal_connect (child->burn,
+			  "insert_media",
+			  G_CALLBACK (rejilla_burn_child_insert_media),
+			  child);
+	g_signal_connect (child->burn,
+			  "eject_failure",
+			  G_CALLBACK (rejilla_burn_child_eject_failure),
+			  child);
+	g_signal_connect (child->burn,
+			  "install_missing",
+			  G_CALLBACK (rejilla_burn_child_install_missing),
+			  child);
+
+	for (i = 0; questions [i]; i ++)
+		g_signal_connect (child->burn,
+				  questions [i],
+				  G_CALLBACK (rejilla_burn_child_question),
+				  child);
+
+	return child;
+}
+
+static void
+rejilla_burn_child_end (RejillaBurnChild *child,
+			RejillaBurnResult result)
+{
+	RejillaBurnPrivate *priv;
+
+	priv = REJILLA_BURN_PRIVATE (child->burn);
+
+	/* The recording (if any) is over and checked */
+	if (priv->session)
+		rejilla_burn_record_write_checked (child->burn, result, child->error);
+
+	if (child->wait_id) {
+		g_source_remove (child->wait_id);
+		child->wait_id = 0;
+	}
+
+	if (child->progress_id) {
+		g_source_remove (child->progress_id);
+		child->progress_id = 0;
+	}
+
+	if (child->timer) {
+		g_timer_destroy (child->timer);
+		child->timer = NULL;
+	}
+
+	if (priv->task) {
+		g_object_unref (priv->task);
+		priv->task = NULL;
+	}
+
+	g_slist_foreach (child->tasks, (GFunc) g_object_unref, NULL);
+	g_slist_free (child->tasks);
+	child->tasks = NULL;
+
+	if (priv->verify) {
+		rejilla_burn_verify_free (priv->verify);
+		priv->verify = NULL;
+	}
+
+	if (child->tracks_pushed) {
+		rejilla_burn_session_pop_tracks (priv->session);
+		child->tracks_pushed = FALSE;
+	}
+
+	if (child->settings_pushed) {
+		rejilla_burn_session_pop_settings (priv->session);
+		child->settings_pushed = FALSE;
+	}
+
+	if (priv->session) {
+		if (result == REJILLA_BURN_OK)
+			result = rejilla_burn_unlock_medias (child->burn, &child->error);
+		else
+			rejilla_burn_unlock_medias (child->burn, NULL);
+
+		g_object_unref (priv->session);
+		priv->session = NULL;
+	}
+
+	if (!child->error
+	&& (result == REJILLA_BURN_NOT_READY
+	||  result == REJILLA_BURN_NOT_SUPPORTED
+	||  result == REJILLA_BURN_RUNNING
+	||  result == REJILLA_BURN_NOT_RUNNING)) {
+		REJILLA_BURN_LOG ("Internal error with result %i", result);
+		g_set_error (&child->error,
+			     REJILLA_BURN_ERROR,
+			     REJILLA_BURN_ERROR_GENERAL,
+			     "%s", _("An internal error occurred"));
+		result = REJILLA_BURN_ERR;
+	}
+
+	child->state = REJILLA_BURN_CHILD_FINISHED;
+	rejilla_burn_child_finished (child, result);
+}
+
+static gboolean
+rejilla_burn_child_wait_cb (gpointer data)
+{
+	RejillaBurnChild *child = data;
+
+	if (rejilla_drive_probing (child->drive))
+		return TRUE;
+
+	if (child->wait_exclusive
+	&& !rejilla_drive_can_use_exclusively (child->drive)) {
+		REJILLA_BURN_LOG ("Device %s busy, retrying in 250 ms",
+				  rejilla_drive_get_device (child->drive));
+		return TRUE;
+	}
+
+	child->wait_id = 0;
+	child->next_step (child);
+	return FALSE;
+}
+
+static void
+rejilla_burn_child_wait (RejillaBurnChild *child,
+			 gboolean exclusive,
+			 RejillaBurnChildStep next_step)
+{
+	/* A task may have been finished when it was cancelled */
+	if (REJILLA_BURN_PRIVATE (child->parent)->children_cancelled) {
+		rejilla_burn_child_end (child, REJILLA_BURN_CANCEL);
+		return;
+	}
+
+	/* Like rejilla_burn_sleep () but without any loop so that the other
+	 * drives go on meanwhile */
+	child->next_step = next_step;
+	child->wait_exclusive = exclusive;
+	if (rejilla_burn_child_wait_cb (child))
+		child->wait_id = g_timeout_add (250,
+						rejilla_burn_child_wait_cb,
+						child);
+}
+
+static void
+rejilla_burn_child_run_task (RejillaBurnChild *child,
+			     RejillaTaskFinishedFunc callback)
+{
+	RejillaBurnPrivate *priv;
+	RejillaBurnResult result;
+
+	if (REJILLA_BURN_PRIVATE (child->parent)->children_cancelled) {
+		rejilla_burn_child_end (child, REJILLA_BURN_CANCEL);
+		return;
+	}
+
+	priv = REJILLA_BURN_PRIVATE (child->burn);
+	result = rejilla_task_run_async (priv->task,
+					 callback,
+					 child,
+					 &child->error);
+	if (result != REJILLA_BURN_OK)
+		rejilla_burn_child_end (child, result);
+}
+
+static void
+rejilla_burn_child_checked (RejillaBurnChild *child,
+			    RejillaBurnResult result)
+{
+	RejillaBurnPrivate *priv;
+
+	priv = REJILLA_BURN_PRIVATE (child->burn);
+
+	g_signal_emit (child->burn,
+		       rejilla_burn_signals [PROGRESS_CHANGED_SIGNAL],
+		       0,
+		       1.0,
+		       1.0,
+		       -1L);
+
+	/* Same as rejilla_burn_record_session () */
+	if (result == REJILLA_BURN_CANCEL)
+		result = REJILLA_BURN_OK;
+
+	rejilla_burn_child_end (child, result);
+}
+
+static void
+rejilla_burn_child_check_done (RejillaTask *task,
+			       RejillaBurnResult result,
+			       GError *error,
+			       gpointer data)
+{
+	RejillaBurnChild *child = data;
+	RejillaBurnPrivate *priv;
+
+	priv = REJILLA_BURN_PRIVATE (child->burn);
+
+	g_object_unref (priv->task);
+	priv->task = NULL;
+
+	if (error)
+		g_propagate_error (&child->error, error);
+
+	rejilla_burn_child_checked (child, result);
+}
+
+static void
+rejilla_burn_child_check (RejillaBurnChild *child)
+{
+	RejillaBurnPrivate *priv;
+
+	priv = REJILLA_BURN_PRIVATE (child->burn);
+
+	priv->task = rejilla_burn_caps_new_checksuming_task (priv->caps,
+							     priv->session,
+							     NULL);
+	if (!priv->task) {
+		REJILLA_BURN_LOG ("The track cannot be checked");
+		rejilla_burn_child_end (child, REJILLA_BURN_OK);
+		return;
+	}
+
+	priv->task_nb = 1;
+	priv->tasks_done = 0;
+	g_signal_connect (priv->task,
+			  "progress-changed",
+			  G_CALLBACK (rejilla_burn_progress_changed),
+			  child->burn);
+	g_signal_connect (priv->task,
+			  "action-changed",
+			  G_CALLBACK (rejilla_burn_action_changed),
+			  child->burn);
+
+	child->state = REJILLA_BURN_CHILD_CHECKING;
+	rejilla_burn_child_run_task (child, rejilla_burn_child_check_done);
+}
+
+static gboolean
+rejilla_burn_child_verified (gpointer data)
+{
+	RejillaBurnChild *child = data;
+	RejillaBurnPrivate *priv;
+	RejillaBurnResult result;
+
+	priv = REJILLA_BURN_PRIVATE (child->burn);
+
+	if (child->progress_id) {
+		g_source_remove (child->progress_id);
+		child->progress_id = 0;
+	}
+
+	result = rejilla_burn_verify_get_result (priv->verify, &child->error);
+	rejilla_burn_verify_free (priv->verify);
+	priv->verify = NULL;
+
+	rejilla_burn_child_checked (child, result);
+	return FALSE;
+}
+
+static void
+rejilla_burn_child_prepare (RejillaBurnChild *child);
+
+static void
+rejilla_burn_child_recorded (RejillaTask *task,
+			     RejillaBurnResult result,
+			     GError *error,
+			     gpointer data)
+{
+	RejillaBurnChild *child = data;
+	const gchar *checksum = NULL;
+	RejillaChecksumType type;
+	RejillaBurnPrivate *priv;
+	RejillaTrack *track;
+	gboolean dummy;
+	gdouble elapsed;
+	GSList *tracks;
+
+	priv = REJILLA_BURN_PRIVATE (child->burn);
+
+	elapsed = g_timer_elapsed (child->timer, NULL);
+	g_timer_destroy (child->timer);
+	child->timer = NULL;
+
+	g_object_unref (priv->task);
+	priv->task = NULL;
+
+	if (error)
+		g_propagate_error (&child->error, error);
+
+	/* Statistics as in rejilla_burn_run_recorder () */
+	rejilla_burn_record_write (child->burn, result, child->error, elapsed);
+	dummy = (rejilla_burn_session_get_flags (priv->session) & REJILLA_BURN_FLAG_DUMMY) != 0;
+
+	/* Errors are not recovered from: the medium is replaced in queue mode
+	 * and the drive is reported as failed otherwise */
+	if (result != REJILLA_BURN_OK) {
+		rejilla_burn_child_end (child, result);
+		return;
+	}
+
+	priv->tasks_done ++;
+	g_signal_emit (child->burn,
+		       rejilla_burn_signals [PROGRESS_CHANGED_SIGNAL],
+		       0,
+		       1.0,
+		       1.0,
+		       -1L);
+
+	rejilla_burn_session_pop_settings (priv->session);
+	child->settings_pushed = FALSE;
+
+	if (dummy) {
+		REJILLA_BURN_LOG ("Dummy session successfully finished on %s",
+				  rejilla_drive_get_device (child->drive));
+
+		result = rejilla_burn_emit_signal (child->burn,
+						   DUMMY_SUCCESS_SIGNAL,
+						   REJILLA_BURN_OK);
+		if (result != REJILLA_BURN_OK) {
+			rejilla_burn_child_end (child, result);
+			return;
+		}
+
+		/* The session belongs to the child; no need to restore it */
+		rejilla_burn_session_remove_flag (priv->session, REJILLA_BURN_FLAG_DUMMY);
+		child->dummy_done = TRUE;
+		rejilla_burn_child_prepare (child);
+		return;
+	}
+
+	if (priv->verify) {
+		REJILLA_BURN_LOG ("%"G_GOFFSET_FORMAT" bytes out of %"G_GOFFSET_FORMAT" verified while recording",
+				  rejilla_burn_verify_get_verified (priv->verify),
+				  rejilla_burn_verify_get_size (priv->verify));
+
+		child->state = REJILLA_BURN_CHILD_VERIFYING;
+		rejilla_burn_action_changed_real (child->burn, REJILLA_BURN_ACTION_CHECKSUM);
+		child->progress_id = g_timeout_add (500,
+						    rejilla_burn_verify_progress_cb,
+						    child->burn);
+		rejilla_burn_verify_finish (priv->verify,
+					    rejilla_burn_child_verified,
+					    child);
+		return;
+	}
+
+	/* Same as rejilla_burn_record_session () */
+	tracks = rejilla_burn_session_get_tracks (priv->session);
+	if (g_slist_length (tracks) != 1) {
+		rejilla_burn_child_end (child, REJILLA_BURN_OK);
+		return;
+	}
+
+	track = tracks->data;
+	type = rejilla_track_get_checksum_type (track);
+	if (type == REJILLA_CHECKSUM_MD5
+	||  type == REJILLA_CHECKSUM_SHA1
+	||  type == REJILLA_CHECKSUM_SHA256)
+		checksum = rejilla_track_get_checksum (track);
+	else if (type == REJILLA_CHECKSUM_MD5_FILE)
+		checksum = REJILLA_MD5_FILE;
+	else if (type == REJILLA_CHECKSUM_SHA1_FILE)
+		checksum = REJILLA_SHA1_FILE;
+	else if (type == REJILLA_CHECKSUM_SHA256_FILE)
+		checksum = REJILLA_SHA256_FILE;
+	else {
+		rejilla_burn_child_end (child, REJILLA_BURN_OK);
+		return;
+	}
+
+	rejilla_burn_session_push_tracks (priv->session);
+	child->tracks_pushed = TRUE;
+
+	track = REJILLA_TRACK (rejilla_track_disc_new ());
+	rejilla_track_set_checksum (track, type, checksum);
+	rejilla_track_disc_set_drive (REJILLA_TRACK_DISC (track), child->drive);
+	rejilla_burn_session_add_track (priv->session, track, NULL);
+	g_object_unref (track);
+
+	if (type == REJILLA_CHECKSUM_MD5
+	||  type == REJILLA_CHECKSUM_SHA1
+	||  type == REJILLA_CHECKSUM_SHA256) {
+		GValue *value;
+
+		value = g_new0 (GValue, 1);
+		g_value_init (value, G_TYPE_UINT64);
+		g_value_set_uint64 (value, priv->session_start);
+		rejilla_track_tag_add (track,
+				       REJILLA_TRACK_MEDIUM_ADDRESS_START_TAG,
+				       value);
+
+		value = g_new0 (GValue, 1);
+		g_value_init (value, G_TYPE_UINT64);
+		g_value_set_uint64 (value, priv->session_end);
+		rejilla_track_tag_add (track,
+				       REJILLA_TRACK_MEDIUM_ADDRESS_END_TAG,
+				       value);
+	}
+
+	REJILLA_BURN_LOG ("Preparing to checksum (type %i %s)", type, checksum);
+
+	/* reprobe the medium and wait for it to be probed */
+	child->state = REJILLA_BURN_CHILD_CHECKING;
+	rejilla_drive_reprobe (child->drive);
+	rejilla_burn_child_wait (child, FALSE, rejilla_burn_child_check);
+}
+
+static void
+rejilla_burn_child_record (RejillaBurnChild *child)
+{
+	RejillaBurnPrivate *priv;
+	RejillaBurnResult result;
+
+	priv = REJILLA_BURN_PRIVATE (child->burn);
+
+	result = rejilla_burn_unmount (child->burn,
+				       rejilla_drive_get_medium (child->drive),
+				       &child->error);
+	if (result != REJILLA_BURN_OK) {
+		rejilla_burn_child_end (child, result);
+		return;
+	}
+
+	priv->write_rate = rejilla_burn_session_get_rate (priv->session);
+	rejilla_burn_verify_prepare (child->burn);
+
+	child->state = REJILLA_BURN_CHILD_RECORDING;
+	child->timer = g_timer_new ();
+	rejilla_burn_child_run_task (child, rejilla_burn_child_recorded);
+}
+
+static void
+rejilla_burn_child_next_task (RejillaBurnChild *child);
+
+static void
+rejilla_burn_child_imaged (RejillaTask *task,
+			   RejillaBurnResult result,
+			   GError *error,
+			   gpointer data)
+{
+	RejillaBurnChild *child = data;
+	RejillaBurnPrivate *priv;
+
+	priv = REJILLA_BURN_PRIVATE (child->burn);
+
+	g_object_unref (priv->task);
+	priv->task = NULL;
+
+	if (result != REJILLA_BURN_OK) {
+		if (error)
+			g_propagate_error (&child->error, error);
+
+		rejilla_burn_child_end (child, result);
+		return;
+	}
+
+	priv->tasks_done ++;
+	rejilla_burn_child_next_task (child);
+}
+
+static void
+rejilla_burn_child_erased_probed (RejillaBurnChild *child)
+{
+	RejillaBurnPrivate *priv;
+	RejillaBurnResult result;
+
+	priv = REJILLA_BURN_PRIVATE (child->burn);
+
+	/* Recheck the flags with the new medium (see
+	 * rejilla_burn_run_tasks ()) */
+	rejilla_burn_session_pop_settings (priv->session);
+	rejilla_burn_session_push_settings (priv->session);
+	result = rejilla_burn_check_session_consistency (child->burn,
+							 NULL,
+							 &child->error);
+	if (result != REJILLA_BURN_OK) {
+		rejilla_burn_child_end (child, result);
+		return;
+	}
+
+	rejilla_burn_child_next_task (child);
+}
+
+static void
+rejilla_burn_child_erased (RejillaTask *task,
+			   RejillaBurnResult result,
+			   GError *error,
+			   gpointer data)
+{
+	RejillaBurnChild *child = data;
+	RejillaBurnPrivate *priv;
+
+	priv = REJILLA_BURN_PRIVATE (child->burn);
+
+	g_object_unref (priv->task);
+	priv->task = NULL;
+
+	if (result != REJILLA_BURN_OK) {
+		if (error)
+			g_propagate_error (&child->error, error);
+
+		rejilla_burn_child_end (child, result);
+		return;
+	}
+
+	priv->tasks_done ++;
+
+	/* Wait for the medium to reappear (see rejilla_burn_run_eraser ()) */
+	rejilla_drive_reprobe (child->drive);
+	rejilla_burn_child_wait (child, FALSE, rejilla_burn_child_erased_probed);
+}
+
+static void
+rejilla_burn_child_next_task (RejillaBurnChild *child)
+{
+	RejillaTaskAction action;
+	RejillaBurnPrivate *priv;
+	RejillaBurnResult result;
+	RejillaMedium *medium;
+	goffset len = 0;
+
+	priv = REJILLA_BURN_PRIVATE (child->burn);
+
+	priv->task = child->tasks->data;
+	child->tasks = g_slist_remove (child->tasks, priv->task);
+
+	g_signal_connect (priv->task,
+			  "progress-changed",
+			  G_CALLBACK (rejilla_burn_progress_changed),
+			  child->burn);
+	g_signal_connect (priv->task,
+			  "action-changed",
+			  G_CALLBACK (rejilla_burn_action_changed),
+			  child->burn);
+
+	medium = rejilla_drive_get_medium (child->drive);
+
+	action = rejilla_task_ctx_get_action (REJILLA_TASK_CTX (priv->task));
+	if (action == REJILLA_TASK_ACTION_ERASE) {
+		goffset session_sec = 0;
+		goffset medium_sec = 0;
+
+		/* The medium was blanked by the simulation */
+		if (child->dummy_done) {
+			g_object_unref (priv->task);
+			priv->task = NULL;
+			priv->tasks_done ++;
+
+			rejilla_burn_child_next_task (child);
+			return;
+		}
+
+		/* The input is always an image: see rejilla_burn_run_tasks () */
+		rejilla_medium_get_capacity (medium, NULL, &medium_sec);
+		rejilla_burn_session_get_size (priv->session, &session_sec, NULL);
+		if (session_sec > medium_sec) {
+			REJILLA_BURN_LOG ("Not enough space on medium %"G_GOFFSET_FORMAT"/%"G_GOFFSET_FORMAT, session_sec, medium_sec);
+			g_set_error (&child->error,
+				     REJILLA_BURN_ERROR,
+				     REJILLA_BURN_ERROR_MEDIUM_SPACE,
+				     "%s", _("Not enough space available on the disc"));
+			rejilla_burn_child_end (child, REJILLA_BURN_ERR);
+			return;
+		}
+
+		result = rejilla_burn_unmount (child->burn, medium, &child->error);
+		if (result != REJILLA_BURN_OK) {
+			rejilla_burn_child_end (child, result);
+			return;
+		}
+
+		child->state = REJILLA_BURN_CHILD_ERASING;
+		rejilla_burn_child_run_task (child, rejilla_burn_child_erased);
+		return;
+	}
+
+	/* Init the task and set the task output size */
+	result = rejilla_burn_run_imager (child->burn, TRUE, &child->error);
+	if (result != REJILLA_BURN_OK) {
+		rejilla_burn_child_end (child, result);
+		return;
+	}
+
+	rejilla_task_ctx_get_session_output_size (REJILLA_TASK_CTX (priv->task),
+						  &len,
+						  NULL);
+
+	if (rejilla_burn_session_get_flags (priv->session) & (REJILLA_BURN_FLAG_MERGE|REJILLA_BURN_FLAG_APPEND))
+		priv->session_start = rejilla_medium_get_next_writable_address (medium);
+	else
+		priv->session_start = 0;
+
+	priv->session_end = priv->session_start + len;
+
+	REJILLA_BURN_LOG ("Burning from %"G_GUINT64_FORMAT" to %"G_GUINT64_FORMAT" on %s",
+			  priv->session_start,
+			  priv->session_end,
+			  rejilla_drive_get_device (child->drive));
+
+	if (child->tasks) {
+		child->state = REJILLA_BURN_CHILD_IMAGING;
+		rejilla_burn_child_run_task (child, rejilla_burn_child_imaged);
+		return;
+	}
+
+	/* That's the recording task: make sure the drive can be used (see
+	 * rejilla_burn_run_recorder ()) */
+	child->state = REJILLA_BURN_CHILD_RECORDING;
+	rejilla_burn_child_wait (child, TRUE, rejilla_burn_child_record);
+}
+
+static void
+rejilla_burn_child_prepare (RejillaBurnChild *child)
+{
+	RejillaBurnPrivate *priv;
+	RejillaBurnResult result;
+
+	priv = REJILLA_BURN_PRIVATE (child->burn);
+
+	/* Same as rejilla_burn_run_tasks () */
+	rejilla_burn_session_push_settings (priv->session);
+	child->settings_pushed = TRUE;
+
+	if (rejilla_burn_session_tag_lookup_int (priv->session, REJILLA_SESSION_AUTO_WRITE_STRATEGY))
+		rejilla_burn_auto_write_strategy (child->burn);
+
+	result = rejilla_burn_check_session_consistency (child->burn,
+							 NULL,
+							 &child->error);
+	if (result != REJILLA_BURN_OK) {
+		rejilla_burn_child_end (child, result);
+		return;
+	}
+
+	result = rejilla_burn_check_data_loss (child->burn, &child->error);
+	if (result != REJILLA_BURN_OK) {
+		rejilla_burn_child_end (child, result);
+		return;
+	}
+
+	child->tasks = rejilla_burn_caps_new_task (priv->caps,
+						   priv->session,
+						   NULL,
+						   &child->error);
+	if (!child->tasks) {
+		rejilla_burn_child_end (child, REJILLA_BURN_NOT_SUPPORTED);
+		return;
+	}
+
+	priv->tasks_done = 0;
+	priv->task_nb = g_slist_length (child->tasks);
+	REJILLA_BURN_LOG ("%i tasks to perform on %s",
+			  priv->task_nb,
+			  rejilla_drive_get_device (child->drive));
+
+	rejilla_burn_child_next_task (child);
+}
+
+static void
+rejilla_burn_child_lock (RejillaBurnChild *child)
+{
+	RejillaBurnError berror = REJILLA_BURN_ERROR_NONE;
+	RejillaBurnPrivate *priv;
+	RejillaBurnResult result;
+
+	priv = REJILLA_BURN_PRIVATE (child->burn);
+
+	result = rejilla_burn_lock_dest_media (child->burn, &berror, &child->error);
+	if (result == REJILLA_BURN_NEED_RELOAD) {
+		RejillaMedia required_media;
+
+		required_media = rejilla_burn_session_get_required_media_type (priv->session);
+		if (required_media == REJILLA_MEDIUM_NONE)
+			required_media = REJILLA_MEDIUM_WRITABLE;
+
+		/* Always cancelled in queue mode */
+		result = rejilla_burn_ask_for_dest_media (child->burn,
+							  berror,
+							  required_media,
+							  &child->error);
+		if (result == REJILLA_BURN_OK) {
+			rejilla_burn_child_wait (child, FALSE, rejilla_burn_child_lock);
+			return;
+		}
+	}
+
+	if (result != REJILLA_BURN_OK) {
+		rejilla_burn_child_end (child, result);
+		return;
+	}
+
+	/* unset checksum since no image has the exact
+	 * same even if it is created from the same files */
+	rejilla_burn_unset_checksums (child->burn);
+	rejilla_burn_child_prepare (child);
+}
+
+static gboolean
+rejilla_burn_child_start (gpointer data)
+{
+	RejillaBurnChild *child = data;
+	RejillaBurnPrivate *priv;
+
+	priv = REJILLA_BURN_PRIVATE (child->parent);
+
+	if (priv->children_cancelled) {
+		rejilla_burn_child_finished (child, REJILLA_BURN_CANCEL);
+		return FALSE;
+	}
+
+	REJILLA_BURN_LOG ("Starting recording with %s",
+			  rejilla_drive_get_device (child->drive));
+
+	/* NOTE: this replaces rejilla_burn_record () whose loops would have to
+	 * be nested for the drives to record at the same time. Each step is
+	 * started once the previous one is finished so this returns at once. */
+	priv = REJILLA_BURN_PRIVATE (child->burn);
+	priv->session = g_object_ref (child->session);
+
+	rejilla_burn_action_changed_real (child->burn, REJILLA_BURN_ACTION_PREPARING);
+
+	child->state = REJILLA_BURN_CHILD_LOCKING;
+	rejilla_burn_child_wait (child, FALSE, rejilla_burn_child_lock);
+	return FALSE;
+}
+
+static RejillaBurnResult
+rejilla_burn_child_cancel (RejillaBurnChild *child,
+			   gboolean protect)
+{
+	/* Nothing is running while waiting for the drive */
+	if (child->wait_id) {
+		rejilla_burn_child_end (child, REJILLA_BURN_CANCEL);
+		return REJILLA_BURN_OK;
+	}
+
+	/* The step running will end the child */
+	return rejilla_burn_cancel (child->burn, protect);
+}
+
+static gboolean
+rejilla_burn_children_dangerous (RejillaBurn *self)
+{
+	RejillaBurnPrivate *priv;
+	GSList *iter;
+
+	priv = REJILLA_BURN_PRIVATE (self);
+	for (iter = priv->children; iter; iter = iter->next) {
+		RejillaBurnPrivate *child_priv;
+		RejillaBurnChild *child;
+
+		child = iter->data;
+		if (child->done || child->wait_id)
+			continue;
+
+		child_priv = REJILLA_BURN_PRIVATE (child->burn);
+		if (child_priv->task
+		&&  rejilla_task_is_running (child_priv->task)
+		&&  rejilla_task_ctx_get_dangerous (REJILLA_TASK_CTX (child_priv->task)))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static RejillaBurnResult
+rejilla_burn_children_status (RejillaBurn *self,
+			      RejillaMedia *media,
+			      goffset *isosize,
+			      goffset *written,
+			      guint64 *rate)
+{
+	RejillaBurnResult result = REJILLA_BURN_NOT_READY;
+	RejillaBurnPrivate *priv;
+	GSList *iter;
+
+	priv = REJILLA_BURN_PRIVATE (self);
+
+	if (media)
+		*media = REJILLA_MEDIUM_NONE;
+	if (isosize)
+		*isosize = -1;
+	if (written)
+		*written = -1;
+	if (rate)
+		*rate = 0;
+
+	/* The rate is the aggregated throughput of all drives, the written
+	 * size the one of the slowest drive */
+	for (iter = priv->children; iter; iter = iter->next) {
+		RejillaBurnChild *child;
+		RejillaMedia child_media = REJILLA_MEDIUM_NONE;
+		goffset child_isosize = -1;
+		goffset child_written = -1;
+		guint64 child_rate = 0;
+
+		child = iter->data;
+		if (child->done)
+			continue;
+
+		if (rejilla_burn_status (child->burn,
+					 &child_media,
+					 &child_isosize,
+					 &child_written,
+					 &child_rate) != REJILLA_BURN_OK)
+			continue;
+
+		if (media && *media == REJILLA_MEDIUM_NONE)
+			*media = child_media;
+
+		if (isosize)
+			*isosize = MAX (*isosize, child_isosize);
+
+		if (written && child_written >= 0 && (*written < 0 || child_written < *written))
+			*written = child_written;
+
+		if (rate)
+			*rate += child_rate;
+
+		result = REJILLA_BURN_OK;
+	}
+
+	return result;
+}
+
+static RejillaBurnResult
+rejilla_burn_multi_image (RejillaBurn *self,
+			  GError **error)
+{
+	RejillaBurnResult result;
+	RejillaBurnPrivate *priv;
+	RejillaTrackType *output;
+	RejillaTrackType *input;
+
+	priv = REJILLA_BURN_PRIVATE (self);
+
+	/* Find an intermediate image type that can be burnt by the drive
+	 * set as burner. */
+	output = rejilla_track_type_new ();
+	result = rejilla_burn_session_get_tmp_image_type_same_src_dest (priv->session, output);
+	if (result != REJILLA_BURN_OK) {
+		rejilla_track_type_free (output);
+		g_set_error (error,
+			     REJILLA_BURN_ERROR,
+			     REJILLA_BURN_ERROR_GENERAL,
+			     "%s", _("No format for the temporary image could be found"));
+		return result;
+	}
+
+	input = rejilla_track_type_new ();
+	rejilla_burn_session_get_input_type (priv->session, input);
+	if (rejilla_track_type_get_has_medium (input)) {
+		result = rejilla_burn_lock_src_media (self, error);
+		if (result != REJILLA_BURN_OK)
+			goto end;
+	}
+
+	result = rejilla_burn_record_session (self, TRUE, output, error);
+
+	if (rejilla_track_type_get_has_medium (input))
+		rejilla_burn_unlock_src_media (self, NULL);
+
+end:
+
+	rejilla_track_type_free (output);
+	rejilla_track_type_free (input);
+	return result;
+}
+
+/**
+ * rejilla_burn_record_multi:
+ * @burn: a #RejillaBurn
+ * @session: a #RejillaBurnSession
+ * @drives: a #GSList of #RejillaDrive
+ * @error: a #GError
+ *
+ * Burns the contents of @session to the media inserted in all of @drives at
+ * the same time. Unless @session input is already an image, an image is
+ * created once beforehand and then recorded by each drive.
+ * The progress of each drive is reported with the "drive-progress-changed"
+ * signal, the overall progress being the one of the slowest drive.
+ * The result for each drive is reported with the "drive-finished" signal and
+ * written to the session log.
+ *
+ * Return value: a #RejillaBurnResult. The result for the first drive of
+ * @drives; a failure of any other drive doesn't make the whole run fail.
+ **/
+
+RejillaBurnResult
+rejilla_burn_record_multi (RejillaBurn *burn,
+			   RejillaBurnSession *session,
+			   GSList *drives,
+			   GError **error)
+{
+	RejillaTrackType *input = NULL;
+	RejillaBurnChild *first;
+	gboolean prepared = FALSE;
+	RejillaBurnResult result;
+	RejillaBurnPrivate *priv;
+	GSList *iter;
+
+	g_return_val_if_fail (REJILLA_IS_BURN (burn), REJILLA_BURN_ERR);
+	g_return_val_if_fail (REJILLA_IS_BURN_SESSION (session), REJILLA_BURN_ERR);
+	g_return_val_if_fail (drives != NULL, REJILLA_BURN_ERR);
+
+	priv = REJILLA_BURN_PRIVATE (burn);
+
+	/* The burner of the session is used for the intermediate image */
+	rejilla_burn_session_push_settings (session);
+	rejilla_burn_session_set_burner (session, drives->data);
+
+	if (!drives->next) {
+		result = rejilla_burn_record (burn, session, error);
+		rejilla_burn_session_pop_settings (session);
+		return result;
+	}
+
+	/* make sure we're ready */
+	if (rejilla_burn_session_get_status (session, NULL) != REJILLA_BURN_OK) {
+		rejilla_burn_session_pop_settings (session);
+		return REJILLA_BURN_ERR;
+	}
+
+	g_object_ref (session);
+	priv->session = session;
+
+	rejilla_burn_powermanagement (burn, TRUE);
+	rejilla_burn_action_changed_real (burn, REJILLA_BURN_ACTION_PREPARING);
+
+	input = rejilla_track_type_new ();
+	rejilla_burn_session_get_input_type (session, input);
+	if (!rejilla_track_type_get_has_image (input)) {
+		result = rejilla_burn_multi_image (burn, error);
+		if (result != REJILLA_BURN_OK)
+			goto end;
+
+		/* The image tracks are now on the top of the session stack */
+		prepared = TRUE;
+	}
+
+	priv->children_cancelled = FALSE;
+	for (iter = drives; iter; iter = iter->next) {
+		RejillaBurnChild *child;
+
+		child = rejilla_burn_child_new (burn, iter->data);
+		priv->children = g_slist_append (priv->children, child);
+		priv->children_running ++;
+
+		g_idle_add (rejilla_burn_child_start, child);
+	}
+
+	priv->children_loop = g_main_loop_new (NULL, FALSE);
+	g_main_loop_run (priv->children_loop);
+	g_main_loop_unref (priv->children_loop);
+	priv->children_loop = NULL;
+
+	/* The other drives only make extra copies: their results were given
+	 * with "drive-finished" and are only logged */
+	for (iter = priv->children; iter; iter = iter->next) {
+		RejillaBurnChild *child;
+
+		child = iter->data;
+		rejilla_burn_session_log (session,
+					  "Recording on %s: %s%s%s",
+					  rejilla_drive_get_device (child->drive),
+					  child->result == REJILLA_BURN_OK ? "success":(child->result == REJILLA_BURN_CANCEL ? "cancelled":"failure"),
+					  child->error ? " - ":"",
+					  child->error ? child->error->message:"");
+	}
+
+	/* The result is the one of the burner of the session */
+	first = priv->children->data;
+	result = first->result;
+	if (result != REJILLA_BURN_OK && first->error) {
+		g_propagate_error (error, first->error);
+		first->error = NULL;
+	}
+
+end:
+
+	g_slist_foreach (priv->children, (GFunc) rejilla_burn_child_free, NULL);
+	g_slist_free (priv->children);
+	priv->children = NULL;
+	priv->children_running = 0;
+
+	if (prepared)
+		rejilla_burn_session_pop_tracks (session);
+
+	rejilla_burn_session_pop_settings (session);
+
+	if (input)
+		rejilla_track_type_free (input);
+
+	if (result == REJILLA_BURN_OK) {
+		REJILLA_BURN_DEBUG (burn, "Session successfully finished on %i drives", g_slist_length (drives));
+		rejilla_burn_action_changed_real (burn, REJILLA_BURN_ACTION_FINISHED);
+	}
+	else if (result != REJILLA_BURN_CANCEL && error && (*error)) {
+		REJILLA_BURN_DEBUG (burn,
+				    "Session error : %s",
+				    (*error)->message);
+	}
+
+	rejilla_burn_powermanagement (burn, FALSE);
+
+	/* release session */
+	g_object_unref (priv->session);
+	priv->session = NULL;
+
+	return result;
+}
+
+/**
+ * Queue mode: each blank medium inserted in one of the drives is used for the
+ * next copy until they are all made.
+ */
+
+static gboolean
+rejilla_burn_queue_medium_usable (RejillaBurn *self,
+				  RejillaMedium *medium)
+{
+	RejillaBurnPrivate *priv;
+	RejillaBurnResult result;
+	RejillaMedia media;
+	goffset medium_sec = 0;
+	goffset session_sec = 0;
+
+	priv = REJILLA_BURN_PRIVATE (self);
+
+	media = rejilla_medium_get_status (medium);
+	if (!(media & REJILLA_MEDIUM_BLANK)
+	&& !((media & REJILLA_MEDIUM_REWRITABLE)
+	&&   (rejilla_burn_session_get_flags (priv->session) & REJILLA_BURN_FLAG_BLANK_BEFORE_WRITE)))
+		return FALSE;
+
+	rejilla_medium_get_capacity (medium, NULL, &medium_sec);
+	rejilla_burn_session_get_size (priv->session, &session_sec, NULL);
+	if (session_sec > medium_sec) {
+		REJILLA_BURN_LOG ("Not enough space on medium %"G_GOFFSET_FORMAT"/%"G_GOFFSET_FORMAT, session_sec, medium_sec);
+		return FALSE;
+	}
+
+	/* The image must be one that can be burnt to this type of medium */
+	rejilla_burn_session_push_settings (priv->session);
+	rejilla_burn_session_set_burner (priv->session, rejilla_medium_get_drive (medium));
+	result = rejilla_burn_session_can_burn (priv->session, FALSE);
+	rejilla_burn_session_pop_settings (priv->session);
+
+	return (result == REJILLA_BURN_OK);
+}
+
+static void
+rejilla_burn_queue_try_drive (RejillaBurn *self,
+			      RejillaDrive *drive)
+{
+	RejillaBurnPrivate *priv;
+	RejillaBurnChild *child;
+	RejillaMedium *medium;
+	GSList *iter;
+
+	priv = REJILLA_BURN_PRIVATE (self);
+
+	if (priv->children_cancelled)
+		return;
+
+	/* The result of finished children was logged; free them so that long
+	 * runs don't keep one RejillaBurn object per copy */
+	iter = priv->children;
+	while (iter) {
+		child = iter->data;
+		iter = iter->next;
+
+		if (child->done) {
+			priv->children = g_slist_remove (priv->children, child);
+			rejilla_burn_child_free (child);
+		}
+	}
+
+	if (priv->queue_assigned >= priv->queue_copies)
+		return;
+
+	/* Only one copy at a time per drive */
+	for (iter = priv->children; iter; iter = iter->next) {
+		child = iter->data;
+		if (child->drive == drive)
+			return;
+	}
+
+	medium = rejilla_drive_get_medium (drive);
+	if (!medium || rejilla_drive_is_locked (drive, NULL))
+		return;
+
+	if (!rejilla_burn_queue_medium_usable (self, medium)) {
+		REJILLA_BURN_LOG ("Medium in %s can't be used", rejilla_drive_get_device (drive));
+		return;
+	}
+
+	child = rejilla_burn_child_new (self, drive);
+	child->copy = ++ priv->queue_assigned;
+	priv->children = g_slist_append (priv->children, child);
+	priv->children_running ++;
+
+	REJILLA_BURN_LOG ("Copy %i assigned to %s", child->copy, rejilla_drive_get_device (drive));
+	g_idle_add (rejilla_burn_child_start, child);
+}
+
+static void
+rejilla_burn_queue_medium_added (RejillaMediumMonitor *monitor,
+				 RejillaMedium *medium,
+				 RejillaBurn *self)
+{
+	RejillaBurnPrivate *priv;
+	RejillaDrive *drive;
+
+	priv = REJILLA_BURN_PRIVATE (self);
+
+	drive = rejilla_medium_get_drive (medium);
+	if (!g_slist_find (priv->queue_drives, drive))
+		return;
+
+	rejilla_burn_queue_try_drive (self, drive);
+}
+
+/**
+ * rejilla_burn_record_queue:
+ * @burn: a #RejillaBurn
+ * @session: a #RejillaBurnSession
+ * @drives: a #GSList of #RejillaDrive
+ * @copies: a #guint
+ * @error: a #GError
+ *
+ * Makes @copies copies of the contents of @session using all of @drives. The
+ * image is created once; then each blank medium inserted in any of @drives
+ * is recorded (and checked if a checksum is available) before being ejected.
+ * Failed media are ejected as well and replaced by the next ones inserted.
+ * The result for each medium is reported with the "drive-finished" signal
+ * and written to the session log.
+ *
+ * Return value: a #RejillaBurnResult. REJILLA_BURN_OK if all copies were
+ * made.
+ **/
+
+RejillaBurnResult
+rejilla_burn_record_queue (RejillaBurn *burn,
+			   RejillaBurnSession *session,
+			   GSList *drives,
+			   guint copies,
+			   GError **error)
+{
+	RejillaMediumMonitor *monitor;
+	RejillaTrackType *input = NULL;
+	gboolean prepared = FALSE;
+	RejillaBurnResult result;
+	RejillaBurnPrivate *priv;
+	gdouble elapsed;
+	gulong added_sig;
+	GSList *iter;
+
+	g_return_val_if_fail (REJILLA_IS_BURN (burn), REJILLA_BURN_ERR);
+	g_return_val_if_fail (REJILLA_IS_BURN_SESSION (session), REJILLA_BURN_ERR);
+	g_return_val_if_fail (drives != NULL, REJILLA_BURN_ERR);
+	g_return_val_if_fail (copies > 0, REJILLA_BURN_ERR);
+
+	priv = REJILLA_BURN_PRIVATE (burn);
+
+	/* make sure we're ready */
+	if (rejilla_burn_session_get_status (session, NULL) != REJILLA_BURN_OK)
+		return REJILLA_BURN_ERR;
+
+	/* The burner of the session is used for the intermediate image */
+	rejilla_burn_session_push_settings (session);
+	rejilla_burn_session_set_burner (session, drives->data);
+
+	g_object_ref (session);
+	priv->session = session;
+
+	rejilla_burn_powermanagement (burn, TRUE);
+	rejilla_burn_action_changed_real (burn, REJILLA_BURN_ACTION_PREPARING);
+
+	input = rejilla_track_type_new ();
+	rejilla_burn_session_get_input_type (session, input);
+	if (!rejilla_track_type_get_has_image (input)) {
+		result = rejilla_burn_multi_image (burn, error);
+		if (result != REJILLA_BURN_OK)
+			goto end;
+
+		/* The image tracks remain on the top of the session stack
+		 * until all copies are made */
+		prepared = TRUE;
+	}
+
+	priv->children_cancelled = FALSE;
+	priv->queue_copies = copies;
+	priv->queue_assigned = 0;
+	priv->queue_done = 0;
+	priv->queue_failed = 0;
+	priv->queue_drives = g_slist_copy (drives);
+	priv->queue_timer = g_timer_new ();
+
+	monitor = rejilla_medium_monitor_get_default ();
+	added_sig = g_signal_connect (monitor,
+				      "medium-added",
+				      G_CALLBACK (rejilla_burn_queue_medium_added),
+				      burn);
+
+	/* Use the media already inserted */
+	for (iter = drives; iter; iter = iter->next)
+		rejilla_burn_queue_try_drive (burn, iter->data);
+
+	rejilla_burn_action_changed_real (burn, REJILLA_BURN_ACTION_RECORDING);
+
+	priv->children_loop = g_main_loop_new (NULL, FALSE);
+	g_main_loop_run (priv->children_loop);
+	g_main_loop_unref (priv->children_loop);
+	priv->children_loop = NULL;
+
+	g_signal_handler_disconnect (monitor, added_sig);
+	g_object_unref (monitor);
+
+	elapsed = g_timer_elapsed (priv->queue_timer, NULL);
+	rejilla_burn_session_log (session,
+				  "%i copies made, %i failed media in %.0f s (%.1f copies per hour)",
+				  priv->queue_done,
+				  priv->queue_failed,
+				  elapsed,
+				  elapsed > 0.0 ? priv->queue_done * 3600.0 / elapsed:0.0);
+	REJILLA_BURN_LOG ("%i copies made, %i failed media in %.0f s",
+			  priv->queue_done,
+			  priv->queue_failed,
+			  elapsed);
+
+	if (priv->queue_done >= copies)
+		result = REJILLA_BURN_OK;
+	else
+		result = REJILLA_BURN_CANCEL;
+
+	g_timer_destroy (priv->queue_timer);
+	priv->queue_timer = NULL;
+
+	g_slist_free (priv->queue_drives);
+	priv->queue_drives = NULL;
+	priv->queue_copies = 0;
+
+end:
+
+	g_slist_foreach (priv->children, (GFunc) rejilla_burn_child_free, NULL);
+	g_slist_free (priv->children);
+	priv->children = NULL;
+	priv->children_running = 0;
+
+	if (prepared)
+		rejilla_burn_session_pop_tracks (session);
+
+	rejilla_burn_session_pop_settings (session);
+
+	if (input)
+		rejilla_track_type_free (input);
+
+	if (result == REJILLA_BURN_OK)
+		rejilla_burn_action_changed_real (burn, REJILLA_BURN_ACTION_FINISHED);
+
+	rejilla_burn_powermanagement (burn, FALSE);
+
+	/* release session */
+	g_object_unref (priv->session);
+	priv->session = NULL;
+
+	return result;
+}
+
+static RejillaBurnResult
+rejilla_burn_blank_real (RejillaBurn *burn, GError **error)
+{
+	RejillaBurnResult result;
+	RejillaBurnPrivate *priv;
+
+	priv = REJILLA_BURN_PRIVATE (burn);
+
+	priv->task = rejilla_burn_caps_new_blanking_task (priv->caps,
+							  priv->session,
+							  error);
+	if (!priv->task)
+		return REJILLA_BURN_NOT_SUPPORTED;
+
+	g_signal_connect (priv->task,
+			  "progress-changed",
+			  G_CALLBACK (rejilla_burn_progress_changed),
+			  burn);
+	g_signal_connect (priv->task,
+			  "action-changed",
+			  G_CALLBACK (rejilla_burn_action_changed),
+			  burn);
+
+	result = rejilla_burn_run_eraser (burn, error);
+	g_object_unref (priv->task);
+	priv->task = NULL;
+
+	return result;
+}
+
+/**
+ * rejilla_burn_blank:
+ * @burn: a #RejillaBurn
+ * @session: a #RejillaBurnSession
+ * @error: a #GError
+ *
+ * Blanks a medium according to the parameters
+ * set in @session. The medium must be inserted in the #RejillaDrive
+ * set with rejilla_burn_session_set_burner ().
+ *
+ * Return value: a #RejillaBurnResult. The result of the operation. 
+ * REJILLA_BURN_OK if it was successful.
+ **/
+
+RejillaBurnResult
+rejilla_burn_blank (RejillaBurn *burn,
+		    RejillaBurnSession *session,
+		    GError **error)
+{
+	RejillaBurnPrivate *priv;
+	RejillaBurnResult result;
+	GError *ret_error = NULL;
+
+	g_return_val_if_fail (burn != NULL, REJILLA_BURN_ERR);
+	g_return_val_if_fail (session != NULL, REJILLA_BURN_ERR);
+
+	priv = REJILLA_BURN_PRIVATE (burn);
+
+	g_object_ref (session);
+	priv->session = session;
+
+	rejilla_burn_powermanagement (burn, TRUE);
+
+	/* we wait for the insertion of a media and lock it */
+	result = rejilla_burn_lock_rewritable_media (burn, error);
+	if (result != REJILLA_BURN_OK)
+		goto end;
+
+	result = rejilla_burn_blank_real (burn, &ret_error);
+	while (result == REJILLA_BURN_ERR &&
+	       ret_error &&
+	       ret_error->code == REJILLA_BURN_ERROR_MEDIUM_NOT_REWRITABLE) {
+		g_error_free (ret_error);
+		ret_error = NULL;
+
+		result = rejilla_burn_ask_for_dest_media (burn,
+							  REJILLA_BURN_ERROR_MEDIUM_NOT_REWRITABLE,
+							  REJILLA_MEDIUM_REWRITABLE|
+							  REJILLA_MEDIUM_HAS_DATA,
+							  error);
+		if (result != REJILLA_BURN_OK)
+			break;
+
+		result = rejilla_burn_lock_rewritable_media (burn, error);
+		if (result != REJILLA_BURN_OK)
+			break;
+
+		result = rejilla_burn_blank_real (burn, &ret_error);
+	}
+
+end:
+	if (ret_error)
+		g_propagate_error (error, ret_error);
+
+	if (result == REJILLA_BURN_OK && !ret_error)
+		result = rejilla_burn_unlock_medias (burn, error);
+	else
+		rejilla_burn_unlock_medias (burn, NULL);
 
 	if (result == REJILLA_BURN_OK)
 		rejilla_burn_action_changed_real (burn, REJILLA_BURN_ACTION_FINISHED);
@@ -3013,6 +5025,12 @@ rejilla_burn_cancel (RejillaBurn *burn, gboolean protect)
 
 	priv = REJILLA_BURN_PRIVATE (burn);
 
+	/* When several drives record, either they are all cancelled or none
+	 * of them is: otherwise the steps after the dangerous one would be
+	 * skipped if the user doesn't confirm. */
+	if (protect && rejilla_burn_children_dangerous (burn))
+		return REJILLA_BURN_DANGEROUS;
+
 	if (priv->timeout_id) {
 		g_source_remove (priv->timeout_id);
 		priv->timeout_id = 0;
@@ -3032,6 +5050,31 @@ rejilla_burn_cancel (RejillaBurn *burn, gboolean protect)
 	if (priv->task && rejilla_task_is_running (priv->task))
 		result = rejilla_task_cancel (priv->task, protect);
 
+	if (priv->verify)
+		rejilla_burn_verify_cancel (priv->verify);
+
+	if (priv->children) {
+		GSList *iter;
+
+		/* Those not started yet won't be */
+		priv->children_cancelled = TRUE;
+		for (iter = priv->children; iter; iter = iter->next) {
+			RejillaBurnChild *child;
+
+			child = iter->data;
+			if (!child->done
+			&&   rejilla_burn_child_cancel (child, protect) == REJILLA_BURN_DANGEROUS)
+				result = REJILLA_BURN_DANGEROUS;
+		}
+	}
+
+	/* A queue may be waiting for media with no recording going on */
+	if (priv->queue_copies) {
+		priv->children_cancelled = TRUE;
+		if (!priv->children_running && priv->children_loop)
+			g_main_loop_quit (priv->children_loop);
+	}
+
 	return result;
 }
 
@@ -3055,6 +5098,11 @@ rejilla_burn_finalize (GObject *object)
 		priv->task = NULL;
 	}
 
+	if (priv->verify) {
+		rejilla_burn_verify_free (priv->verify);
+		priv->verify = NULL;
+	}
+
 	if (priv->session) {
 		g_object_unref (priv->session);
 		priv->session = NULL;
@@ -3199,6 +5247,32 @@ rejilla_burn_class_init (RejillaBurnClass *klass)
 			      rejilla_marshal_INT__VOID,
 			      G_TYPE_INT, 0,
 		              G_TYPE_NONE);
+	rejilla_burn_signals [DRIVE_PROGRESS_CHANGED_SIGNAL] =
+		g_signal_new ("drive_progress_changed",
+			      G_TYPE_FROM_CLASS (klass),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (RejillaBurnClass,
+					       drive_progress_changed),
+			      NULL, NULL,
+			      rejilla_marshal_VOID__OBJECT_DOUBLE_DOUBLE_LONG,
+			      G_TYPE_NONE,
+			      4,
+			      REJILLA_TYPE_DRIVE,
+			      G_TYPE_DOUBLE,
+			      G_TYPE_DOUBLE,
+			      G_TYPE_LONG);
+	rejilla_burn_signals [DRIVE_FINISHED_SIGNAL] =
+		g_signal_new ("drive_finished",
+			      G_TYPE_FROM_CLASS (klass),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (RejillaBurnClass,
+					       drive_finished),
+			      NULL, NULL,
+			      rejilla_marshal_VOID__OBJECT_INT,
+			      G_TYPE_NONE,
+			      2,
+			      REJILLA_TYPE_DRIVE,
+			      G_TYPE_INT);
 	rejilla_burn_signals [INSTALL_MISSING_SIGNAL] =
 		g_signal_new ("install_missing",
 			      G_TYPE_FROM_CLASS (klass),
@@ -90,6 +90,16 @@ typedef struct {
 	RejillaBurnResult		(*install_missing)		(RejillaBurn *obj,
 									 RejillaPluginErrorType error,
 									 const gchar *detail);
+
+	/* Only emitted by rejilla_burn_record_multi () */
+	void				(*drive_progress_changed)	(RejillaBurn *obj,
+									 RejillaDrive *drive,
+									 gdouble overall_progress,
+									 gdouble action_progress,
+									 glong time_remaining);
+	void				(*drive_finished)		(RejillaBurn *obj,
+									 RejillaDrive *drive,
+									 RejillaBurnResult result);
 } RejillaBurnClass;
 
 GType rejilla_burn_get_type (void);
@@ -100,6 +110,19 @@ rejilla_burn_record (RejillaBurn *burn,
 		     RejillaBurnSession *session,
 		     GError **error);
 
+RejillaBurnResult
+rejilla_burn_record_multi (RejillaBurn *burn,
+			   RejillaBurnSession *session,
+			   GSList *drives,
+			   GError **error);
+
+RejillaBurnResult
+rejilla_burn_record_queue (RejillaBurn *burn,
+			   RejillaBurnSession *session,
+			   GSList *drives,
+			   guint copies,
+			   GError **error);
+
 RejillaBurnResult
 rejilla_burn_check (RejillaBurn *burn,
 		    RejillaBurnSession *session,
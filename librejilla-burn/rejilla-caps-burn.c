@@ -44,6 +44,7 @@
 #include "rejilla-plugin-private.h"
 #include "rejilla-plugin-information.h"
 #include "burn-task.h"
+#include "burn-stats.h"
 #include "rejilla-session-helper.h"
 
 /**
@@ -57,6 +58,12 @@
 	return NULL;								\
 }
 
+/**
+ * Measured costs of two paths with the same priorities must differ by more
+ * than that (relatively) for the cheapest to be preferred.
+ */
+#define REJILLA_CAPS_COST_MARGIN		0.2
+
 #define REJILLA_BURN_CAPS_NOT_SUPPORTED_LOG_ERROR(session, error)		\
 {										\
 	if (error)								\
@@ -146,12 +153,6 @@ rejilla_caps_link_find_plugin (RejillaCapsLink *link,
 	return candidate;
 }
 
-typedef struct _RejillaCapsLinkList RejillaCapsLinkList;
-struct _RejillaCapsLinkList {
-	RejillaCapsLink *link;
-	RejillaPlugin *plugin;
-};
-
 static gint
 rejilla_caps_link_list_sort (gconstpointer a,
                              gconstpointer b)
@@ -162,11 +163,39 @@ rejilla_caps_link_list_sort (gconstpointer a,
 	       rejilla_plugin_get_priority (node1->plugin);
 }
 
+/**
+ * Returns the expected time (in seconds) to go through a whole path for each
+ * byte of input, using the throughput measured for each plugin during previous
+ * runs. Every step is considered to be done through a temporary file.
+ */
+
+static gboolean
+rejilla_caps_link_list_get_cost (GSList *path,
+                                 gdouble *cost)
+{
+	GSList *iter;
+
+	*cost = 0.0;
+	for (iter = path; iter; iter = iter->next) {
+		RejillaCapsLinkList *node;
+		guint64 rate = 0;
+
+		node = iter->data;
+		if (!rejilla_burn_stats_get_plugin_rate (node->plugin, &rate, NULL) || !rate)
+			return FALSE;
+
+		*cost += 1.0 / (gdouble) rate;
+	}
+
+	return TRUE;
+}
+
 static GSList *
 rejilla_caps_get_best_path (GSList *path1,
                             GSList *path2)
 {
 	GSList *iter1, *iter2;
+	gdouble cost1, cost2;
 
 	iter1 = path1;
 	iter2 = path2;
@@ -192,7 +221,24 @@ rejilla_caps_get_best_path (GSList *path1,
 		}
 	}
 
-	/* equality all along or one of them is shorter. Keep the shorter or
+	/* Equality all along: if we know how both paths performed in the past,
+	 * prefer the fastest one provided the difference is significant. */
+	if (rejilla_caps_link_list_get_cost (path1, &cost1)
+	&&  rejilla_caps_link_list_get_cost (path2, &cost2)
+	&&  ABS (cost1 - cost2) > MIN (cost1, cost2) * REJILLA_CAPS_COST_MARGIN) {
+		REJILLA_BURN_LOG ("Choosing path according to measured costs (%e / %e)", cost1, cost2);
+		if (cost1 < cost2) {
+			g_slist_foreach (path2, (GFunc) g_free, NULL);
+			g_slist_free (path2);
+			return path1;
+		}
+
+		g_slist_foreach (path1, (GFunc) g_free, NULL);
+		g_slist_free (path1);
+		return path2;
+	}
+
+	/* One of them is shorter or they cost the same. Keep the shorter or
 	 * path1 in case of complete equality. */
 	if (!iter2 && iter1) {
 		/* This one seems shorter */
@@ -526,6 +572,48 @@ end:
 	return results;
 }
 
+/**
+ * Same as above but the result of the search is kept in the planner cache so
+ * that the graph is only walked once for a given set of parameters.
+ */
+
+static GSList *
+rejilla_caps_find_best_link_cached (RejillaBurnCaps *self,
+                                    RejillaCaps *caps,
+                                    RejillaBurnFlag session_flags,
+                                    RejillaMedia media,
+                                    RejillaTrackType *input,
+                                    RejillaPluginIOFlag io_flags)
+{
+	RejillaCapsPlanKey key;
+	RejillaCapsPlan plan;
+
+	rejilla_caps_plan_key_init (&key, REJILLA_CAPS_PLAN_PATH);
+	memcpy (&key.input, input, sizeof (RejillaTrackType));
+	memcpy (&key.output, &caps->type, sizeof (RejillaTrackType));
+	key.media = media;
+	key.session_flags = session_flags;
+	key.io_flags = io_flags;
+	key.group_id = self->priv->group_id;
+
+	if (rejilla_burn_caps_plan_lookup (self, &key, &plan)) {
+		REJILLA_BURN_LOG ("Using cached path (%i links)", g_slist_length (plan.path));
+		return plan.path;
+	}
+
+	memset (&plan, 0, sizeof (RejillaCapsPlan));
+	plan.path = rejilla_caps_find_best_link (caps,
+	                                         self->priv->group_id,
+	                                         NULL,
+	                                         session_flags,
+	                                         media,
+	                                         input,
+	                                         io_flags);
+	plan.result = plan.path? REJILLA_BURN_OK:REJILLA_BURN_NOT_SUPPORTED;
+	rejilla_burn_caps_plan_store (self, &key, &plan);
+	return plan.path;
+}
+
 static gboolean
 rejilla_burn_caps_sort_modifiers (gconstpointer a,
 				  gconstpointer b)
@@ -666,13 +754,12 @@ rejilla_burn_caps_new_task (RejillaBurnCaps *self,
 	if (!res)
 		REJILLA_BURN_CAPS_NOT_SUPPORTED_LOG (session);
 
-	list = rejilla_caps_find_best_link (last_caps,
-					    self->priv->group_id,
-					    NULL,
-					    session_flags,
-					    media,
-					    &input,
-					    flags);
+	list = rejilla_caps_find_best_link_cached (self,
+						   last_caps,
+						   session_flags,
+						   media,
+						   &input,
+						   flags);
 	if (!list) {
 		/* we reached this point in two cases:
 		 * - if the disc cannot be handled
@@ -715,13 +802,12 @@ rejilla_burn_caps_new_task (RejillaBurnCaps *self,
 		 * we are actually blanking. Simply the record plugin won't have
 		 * to do it. */
 		session_flags &= ~REJILLA_BURN_FLAG_BLANK_BEFORE_WRITE;
-		list = rejilla_caps_find_best_link (last_caps,
-						    self->priv->group_id,
-						    NULL,
-						    session_flags,
-						    media,
-						    &input,
-						    flags);
+		list = rejilla_caps_find_best_link_cached (self,
+							   last_caps,
+							   session_flags,
+							   media,
+							   &input,
+							   flags);
 		if (!list)
 			REJILLA_BURN_CAPS_NOT_SUPPORTED_LOG_ERROR (session, error);
 
@@ -1109,3 +1195,110 @@ rejilla_burn_caps_new_blanking_task (RejillaBurnCaps *self,
 
 	REJILLA_BURN_CAPS_NOT_SUPPORTED_LOG_ERROR (session, error);
 }
+
+/**
+ * rejilla_burn_caps_estimate_time:
+ * @self: a #RejillaBurnCaps
+ * @session: a #RejillaBurnSession
+ * @seconds: a #glong
+ *
+ * Estimates how long it will take to carry out @session with the path that
+ * would be chosen, using the throughput measured for each of its plugins
+ * during previous runs and the write speed of the drive.
+ *
+ * Return value: REJILLA_BURN_OK if an estimate could be made and
+ * REJILLA_BURN_NOT_READY if a plugin of the path has never been measured.
+ **/
+
+RejillaBurnResult
+rejilla_burn_caps_estimate_time (RejillaBurnCaps *self,
+                                 RejillaBurnSession *session,
+                                 glong *seconds)
+{
+	RejillaBurnFlag session_flags;
+	RejillaPluginIOFlag flags;
+	RejillaTrackType output;
+	RejillaTrackType input;
+	RejillaCaps *last_caps;
+	guint64 write_rate = 0;
+	guint64 task_rate = 0;
+	gboolean on_the_fly;
+	gdouble total = 0.0;
+	GSList *list, *iter;
+	RejillaMedia media;
+	goffset bytes = 0;
+
+	rejilla_burn_session_get_output_type (session, &output);
+	if (rejilla_track_type_get_has_medium (&output)) {
+		media = rejilla_track_type_get_medium_type (&output);
+		write_rate = rejilla_burn_session_get_rate (session);
+	}
+	else
+		media = REJILLA_MEDIUM_FILE;
+
+	if (rejilla_burn_session_get_size (session, NULL, &bytes) != REJILLA_BURN_OK
+	||  bytes <= 0)
+		return REJILLA_BURN_NOT_READY;
+
+	last_caps = rejilla_burn_caps_find_start_caps (self, &output);
+	if (!last_caps)
+		return REJILLA_BURN_NOT_SUPPORTED;
+
+	on_the_fly = (REJILLA_BURN_SESSION_NO_TMP_FILE (session) != 0);
+	flags = on_the_fly? REJILLA_PLUGIN_IO_ACCEPT_PIPE:REJILLA_PLUGIN_IO_ACCEPT_FILE;
+
+	rejilla_burn_session_get_input_type (session, &input);
+	session_flags = rejilla_burn_session_get_flags (session);
+	list = rejilla_caps_find_best_link_cached (self,
+	                                           last_caps,
+	                                           session_flags,
+	                                           media,
+	                                           &input,
+	                                           flags);
+	if (!list)
+		return REJILLA_BURN_NOT_SUPPORTED;
+
+	/* Go through the path in the order the plugins will be run and group
+	 * them into tasks the same way rejilla_burn_caps_new_task () does. All
+	 * plugins of a task run at the speed of the slowest one; tasks run one
+	 * after the other. */
+	list = g_slist_reverse (list);
+	for (iter = list; iter; iter = iter->next) {
+		RejillaCapsLinkList *node;
+		guint64 rate = 0;
+
+		node = iter->data;
+
+		if (task_rate
+		&& (!(node->link->caps->flags & REJILLA_PLUGIN_IO_ACCEPT_PIPE) || !on_the_fly)) {
+			total += (gdouble) bytes / (gdouble) task_rate;
+			task_rate = 0;
+		}
+
+		if (!rejilla_burn_stats_get_plugin_rate (node->plugin, &rate, NULL) || !rate) {
+			/* A recorder that was never measured is assumed to
+			 * go at the speed set for the drive */
+			if (iter->next || !write_rate) {
+				REJILLA_BURN_LOG ("No statistics for %s", rejilla_plugin_get_name (node->plugin));
+				rejilla_caps_link_list_free (list);
+				return REJILLA_BURN_NOT_READY;
+			}
+
+			rate = write_rate;
+		}
+
+		if (!iter->next && write_rate)
+			rate = MIN (rate, write_rate);
+
+		task_rate = task_rate? MIN (task_rate, rate):rate;
+	}
+	rejilla_caps_link_list_free (list);
+
+	total += (gdouble) bytes / (gdouble) task_rate;
+
+	REJILLA_BURN_LOG ("Estimated time for session %.0f seconds", total);
+	if (seconds)
+		*seconds = total;
+
+	return REJILLA_BURN_OK;
+}
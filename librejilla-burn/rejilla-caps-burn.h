@@ -57,6 +57,11 @@ rejilla_burn_caps_new_checksuming_task (RejillaBurnCaps *caps,
 					RejillaBurnSession *session,
 					GError **error);
 
+RejillaBurnResult
+rejilla_burn_caps_estimate_time (RejillaBurnCaps *caps,
+				 RejillaBurnSession *session,
+				 glong *seconds);
+
 
 G_END_DECLS
 
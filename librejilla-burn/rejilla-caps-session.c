@@ -740,6 +740,49 @@ rejilla_caps_try_output_with_blanking (RejillaBurnCaps *self,
 	return rejilla_caps_find_link (last_caps, ctx);
 }
 
+static RejillaBurnResult
+rejilla_caps_try_output_with_blanking_cached (RejillaBurnCaps *self,
+                                              RejillaBurnSession *session,
+                                              RejillaFindLinkCtx *ctx,
+                                              RejillaTrackType *output)
+{
+	RejillaCapsPlanKey key;
+	RejillaCapsPlan plan;
+
+	/* When errors are reported through a callback the search can't be
+	 * skipped as it is the search itself which calls it. */
+	if (ctx->callback)
+		return rejilla_caps_try_output_with_blanking (self, session, ctx, output);
+
+	rejilla_caps_plan_key_init (&key, REJILLA_CAPS_PLAN_LINK);
+	memcpy (&key.input, ctx->input, sizeof (RejillaTrackType));
+	memcpy (&key.output, output, sizeof (RejillaTrackType));
+	key.media = rejilla_burn_session_get_dest_media (session);
+	key.io_flags = ctx->io_flags;
+	key.ignore_plugin_errors = ctx->ignore_plugin_errors;
+	key.check_session_flags = ctx->check_session_flags;
+
+	/* Even if they are not checked, flags matter for blanking */
+	key.session_flags = rejilla_burn_session_get_flags (session);
+
+	if (rejilla_burn_caps_plan_lookup (self, &key, &plan)) {
+		/* Restore what the search would have changed */
+		if (rejilla_track_type_get_has_medium (output))
+			rejilla_track_type_set_medium_type (output, plan.media);
+
+		REJILLA_BURN_LOG ("Using cached result (%i)", plan.result);
+		return plan.result;
+	}
+
+	memset (&plan, 0, sizeof (RejillaCapsPlan));
+	plan.result = rejilla_caps_try_output_with_blanking (self, session, ctx, output);
+	if (rejilla_track_type_get_has_medium (output))
+		plan.media = rejilla_track_type_get_medium_type (output);
+	rejilla_burn_caps_plan_store (self, &key, &plan);
+
+	return plan.result;
+}
+
 /**
  * rejilla_burn_session_input_supported:
  * @session: a #RejillaBurnSession
@@ -789,10 +832,10 @@ rejilla_burn_session_input_supported (RejillaBurnSession *session,
 	}
 
 	self = rejilla_burn_caps_get_default ();
-	result = rejilla_caps_try_output_with_blanking (self,
-							session,
-	                                                &ctx,
-							&output);
+	result = rejilla_caps_try_output_with_blanking_cached (self,
+	                                                       session,
+	                                                       &ctx,
+	                                                       &output);
 	g_object_unref (self);
 
 	if (result != REJILLA_BURN_OK) {
@@ -837,10 +880,10 @@ rejilla_burn_session_output_supported (RejillaBurnSession *session,
 	REJILLA_BURN_LOG_FLAGS (rejilla_burn_session_get_flags (session), "with flags");
 	
 	self = rejilla_burn_caps_get_default ();
-	result = rejilla_caps_try_output_with_blanking (self,
-							session,
-	                                                &ctx,
-							output);
+	result = rejilla_caps_try_output_with_blanking_cached (self,
+	                                                       session,
+	                                                       &ctx,
+	                                                       output);
 	g_object_unref (self);
 
 	if (result != REJILLA_BURN_OK) {
@@ -1084,10 +1127,10 @@ rejilla_burn_session_supported (RejillaBurnSession *session,
 	}
 
 	self = rejilla_burn_caps_get_default ();
-	result = rejilla_caps_try_output_with_blanking (self,
-							session,
-	                                                ctx,
-							&output);
+	result = rejilla_caps_try_output_with_blanking_cached (self,
+	                                                       session,
+	                                                       ctx,
+	                                                       &output);
 	g_object_unref (self);
 
 	if (result != REJILLA_BURN_OK) {
@@ -1800,6 +1843,50 @@ rejilla_burn_caps_get_flags_for_medium (RejillaBurnCaps *self,
 	return REJILLA_BURN_OK;
 }
 
+static RejillaBurnResult
+rejilla_burn_caps_get_flags_for_medium_cached (RejillaBurnCaps *self,
+                                               RejillaBurnSession *session,
+                                               RejillaMedia media,
+                                               RejillaBurnFlag session_flags,
+                                               RejillaTrackType *input,
+                                               RejillaBurnFlag *supported_flags,
+                                               RejillaBurnFlag *compulsory_flags)
+{
+	RejillaCapsPlanKey key;
+	RejillaCapsPlan plan;
+
+	rejilla_caps_plan_key_init (&key, REJILLA_CAPS_PLAN_FLAGS);
+	memcpy (&key.input, input, sizeof (RejillaTrackType));
+	key.media = media;
+	key.session_flags = session_flags;
+	key.ignore_plugin_errors = (rejilla_burn_session_get_strict_support (session) == FALSE);
+
+	if (!rejilla_burn_caps_plan_lookup (self, &key, &plan)) {
+		/* Start from empty sets so that the cached flags do not depend
+		 * on what the caller already set. */
+		memset (&plan, 0, sizeof (RejillaCapsPlan));
+		plan.supported = REJILLA_BURN_FLAG_NONE;
+		plan.compulsory = REJILLA_BURN_FLAG_NONE;
+		plan.result = rejilla_burn_caps_get_flags_for_medium (self,
+		                                                      session,
+		                                                      media,
+		                                                      session_flags,
+		                                                      input,
+		                                                      &plan.supported,
+		                                                      &plan.compulsory);
+		rejilla_burn_caps_plan_store (self, &key, &plan);
+	}
+	else
+		REJILLA_BURN_LOG ("FLAGS: using cached flags");
+
+	if (plan.result != REJILLA_BURN_OK)
+		return plan.result;
+
+	(*supported_flags) |= plan.supported;
+	(*compulsory_flags) |= plan.compulsory;
+	return REJILLA_BURN_OK;
+}
+
 static RejillaBurnResult
 rejilla_burn_caps_get_flags_same_src_dest_for_types (RejillaBurnCaps *self,
                                                      RejillaBurnSession *session,
@@ -2150,13 +2237,13 @@ rejilla_burn_session_get_burn_flags (RejillaBurnSession *session,
 	
 	/* Let's get flags for recording */
 	media = rejilla_burn_session_get_dest_media (session);
-	result = rejilla_burn_caps_get_flags_for_medium (self,
-	                                                 session,
-							 media,
-							 session_flags,
-							 input,
-							 &supported_flags,
-							 &compulsory_flags);
+	result = rejilla_burn_caps_get_flags_for_medium_cached (self,
+	                                                        session,
+	                                                        media,
+	                                                        session_flags,
+	                                                        input,
+	                                                        &supported_flags,
+	                                                        &compulsory_flags);
 
 	rejilla_track_type_free (input);
 	g_object_unref (self);
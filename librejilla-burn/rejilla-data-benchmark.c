@@ -0,0 +1,717 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * Librejilla-burn
+ * Copyright (C) Philippe Rouquier 2005-2009 <bonfire-app@wanadoo.fr>
+ *
+ * Librejilla-burn is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The Librejilla-burn authors hereby grant permission for non-GPL compatible
+ * GStreamer plugins to be used and distributed together with GStreamer
+ * and Librejilla-burn. This permission is above and beyond the permissions granted
+ * by the GPL license by which Librejilla-burn is covered. If you modify this code
+ * you may extend this exception to your version of the code, but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version.
+ *
+ * Librejilla-burn is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to:
+ * 	The Free Software Foundation, Inc.,
+ * 	51 Franklin Street, Fifth Floor
+ * 	Boston, MA  02110-1301, USA.
+ */
+
+/**
+ * Headless benchmark of the data project tree. It builds a synthetic project
+ * of the requested shape in memory (no file is read) and times the operations
+ * the UI performs on it. With --uri it loads real directories through a
+ * RejillaTrackDataCfg instead.
+ *
+ * For each operation it prints the wall time, the number and size of the
+ * allocations made through GLib and the peak resident set size so far.
+ * Allocations can only be counted with a GLib that honours
+ * g_mem_set_vtable (); otherwise "n/a" is printed.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <gtk/gtk.h>
+
+#include "rejilla-burn-lib.h"
+#include "rejilla-enums.h"
+#include "rejilla-status.h"
+#include "rejilla-track.h"
+#include "rejilla-track-data.h"
+#include "rejilla-track-data-cfg.h"
+
+#include "rejilla-data-project.h"
+#include "rejilla-file-node.h"
+
+#define REJILLA_BENCHMARK_URI		"file:///rejilla-data-benchmark"
+
+static gint depth = 3;
+static gint fanout = 8;
+static gint files = 10000;
+static gint operations = 1000;
+static gint queries = 100;
+static gint seed = 0;
+static gchar **uris = NULL;
+
+static const GOptionEntry options [] = {
+	{ "depth", 'd', 0, G_OPTION_ARG_INT, &depth,
+	  "Number of directory levels (default 3)", "N" },
+	{ "fanout", 'f', 0, G_OPTION_ARG_INT, &fanout,
+	  "Number of subdirectories per directory (default 8)", "N" },
+	{ "files", 'n', 0, G_OPTION_ARG_INT, &files,
+	  "Number of files spread over the directories (default 10000)", "N" },
+	{ "operations", 'o', 0, G_OPTION_ARG_INT, &operations,
+	  "Number of moves, renames and removals (default 1000)", "N" },
+	{ "queries", 'q', 0, G_OPTION_ARG_INT, &queries,
+	  "Number of size queries (default 100)", "N" },
+	{ "seed", 's', 0, G_OPTION_ARG_INT, &seed,
+	  "Seed for the random choices (default 0)", "N" },
+	{ "uri", 'u', 0, G_OPTION_ARG_STRING_ARRAY, &uris,
+	  "Load this file or directory from disk instead (may be repeated)", "URI" },
+	{ NULL }
+};
+
+/**
+ * Allocation accounting; the counters are not locked, so they are only
+ * exact when a single thread allocates (which is the case for the
+ * synthetic project).
+ */
+
+static guint64 alloc_count = 0;
+static guint64 alloc_bytes = 0;
+static gboolean alloc_tracking = FALSE;
+
+static gpointer
+rejilla_benchmark_malloc (gsize size)
+{
+	alloc_count ++;
+	alloc_bytes += size;
+	return malloc (size);
+}
+
+static gpointer
+rejilla_benchmark_realloc (gpointer mem,
+			   gsize size)
+{
+	alloc_count ++;
+	alloc_bytes += size;
+	return realloc (mem, size);
+}
+
+static gpointer
+rejilla_benchmark_calloc (gsize num,
+			  gsize size)
+{
+	alloc_count ++;
+	alloc_bytes += num * size;
+	return calloc (num, size);
+}
+
+static GMemVTable benchmark_vtable = {
+	rejilla_benchmark_malloc,
+	rejilla_benchmark_realloc,
+	free,
+	rejilla_benchmark_calloc,
+	NULL,
+	NULL
+};
+
+/**
+ * Measures
+ */
+
+struct _RejillaBenchmarkMark {
+	GTimer *timer;
+	guint64 allocs;
+	guint64 bytes;
+};
+typedef struct _RejillaBenchmarkMark RejillaBenchmarkMark;
+
+static void
+rejilla_benchmark_flush (void)
+{
+	/* Some updates are deferred to idle callbacks: count them with the
+	 * operation that queued them */
+	while (g_main_context_pending (NULL))
+		g_main_context_iteration (NULL, FALSE);
+}
+
+static void
+rejilla_benchmark_start (RejillaBenchmarkMark *mark)
+{
+	rejilla_benchmark_flush ();
+
+	mark->timer = g_timer_new ();
+	mark->allocs = alloc_count;
+	mark->bytes = alloc_bytes;
+	g_timer_start (mark->timer);
+}
+
+static void
+rejilla_benchmark_stop (RejillaBenchmarkMark *mark,
+			const gchar *operation,
+			guint count)
+{
+	struct rusage usage;
+	gdouble elapsed;
+	guint64 allocs;
+	guint64 bytes;
+
+	rejilla_benchmark_flush ();
+
+	g_timer_stop (mark->timer);
+	allocs = alloc_count - mark->allocs;
+	bytes = alloc_bytes - mark->bytes;
+
+	elapsed = g_timer_elapsed (mark->timer, NULL);
+	g_timer_destroy (mark->timer);
+	mark->timer = NULL;
+
+	memset (&usage, 0, sizeof (usage));
+	getrusage (RUSAGE_SELF, &usage);
+
+	g_print ("%-14s %10u %12.2f %12.2f",
+		 operation,
+		 count,
+		 elapsed * 1000.0,
+		 count ? elapsed * 1000000.0 / count : 0.0);
+
+	if (alloc_tracking)
+		g_print (" %12" G_GUINT64_FORMAT " %12" G_GUINT64_FORMAT,
+			 allocs,
+			 bytes / 1024);
+	else
+		g_print (" %12s %12s", "n/a", "n/a");
+
+	g_print (" %12li\n", usage.ru_maxrss);
+}
+
+static void
+rejilla_benchmark_header (void)
+{
+	g_print ("%-14s %10s %12s %12s %12s %12s %12s\n",
+		 "operation",
+		 "count",
+		 "total ms",
+		 "per op us",
+		 "allocs",
+		 "alloc KiB",
+		 "peak RSS KiB");
+}
+
+/**
+ * Synthetic project
+ */
+
+struct _RejillaBenchmarkTree {
+	RejillaDataProject *project;
+	GRand *rand;
+
+	/* Directories and their URIs (same index) */
+	GPtrArray *dirs;
+	GPtrArray *dir_uris;
+
+	GPtrArray *files;
+
+	/* Used to make up unique names */
+	guint serial;
+};
+typedef struct _RejillaBenchmarkTree RejillaBenchmarkTree;
+
+static RejillaFileNode *
+rejilla_benchmark_tree_add (RejillaBenchmarkTree *tree,
+			    RejillaFileNode *parent,
+			    const gchar *parent_uri,
+			    gboolean isdir,
+			    gchar **uri)
+{
+	RejillaFileNode *node;
+	GFileInfo *info;
+	gchar *node_uri;
+	gchar *name;
+
+	name = g_strdup_printf ("%c%u", isdir? 'd':'f', tree->serial ++);
+	node_uri = g_strconcat (parent_uri, "/", name, NULL);
+
+	info = g_file_info_new ();
+	g_file_info_set_name (info, name);
+	g_file_info_set_is_symlink (info, FALSE);
+	if (isdir) {
+		g_file_info_set_file_type (info, G_FILE_TYPE_DIRECTORY);
+		g_file_info_set_size (info, 0);
+	}
+	else {
+		g_file_info_set_file_type (info, G_FILE_TYPE_REGULAR);
+		g_file_info_set_size (info, g_rand_int_range (tree->rand, 0, 1 << 20));
+	}
+
+	node = rejilla_data_project_add_node_from_info (tree->project,
+							 node_uri,
+							 info,
+							 parent);
+	g_object_unref (info);
+	g_free (name);
+
+	if (node && uri)
+		*uri = node_uri;
+	else
+		g_free (node_uri);
+
+	return node;
+}
+
+static void
+rejilla_benchmark_tree_add_dirs (RejillaBenchmarkTree *tree)
+{
+	RejillaBenchmarkMark mark;
+	guint level_start = 0;
+	guint level_end = 0;
+	gint level;
+
+	rejilla_benchmark_start (&mark);
+
+	for (level = 0; level < depth; level ++) {
+		guint i;
+
+		/* Directories of the previous level are the parents; the
+		 * root is the parent of the first level */
+		for (i = level_start; i < level_end || (level == 0 && i == 0); i ++) {
+			RejillaFileNode *parent = NULL;
+			const gchar *parent_uri;
+			gint j;
+
+			if (level) {
+				parent = g_ptr_array_index (tree->dirs, i);
+				parent_uri = g_ptr_array_index (tree->dir_uris, i);
+			}
+			else
+				parent_uri = REJILLA_BENCHMARK_URI;
+
+			for (j = 0; j < fanout; j ++) {
+				RejillaFileNode *node;
+				gchar *uri = NULL;
+
+				node = rejilla_benchmark_tree_add (tree,
+								   parent,
+								   parent_uri,
+								   TRUE,
+								   &uri);
+				if (!node)
+					continue;
+
+				g_ptr_array_add (tree->dirs, node);
+				g_ptr_array_add (tree->dir_uris, uri);
+			}
+		}
+
+		level_start = level_end;
+		level_end = tree->dirs->len;
+	}
+
+	rejilla_benchmark_stop (&mark, "add-dir", tree->dirs->len);
+}
+
+static void
+rejilla_benchmark_tree_add_files (RejillaBenchmarkTree *tree)
+{
+	RejillaBenchmarkMark mark;
+	gint i;
+
+	rejilla_benchmark_start (&mark);
+
+	for (i = 0; i < files; i ++) {
+		RejillaFileNode *parent = NULL;
+		const gchar *parent_uri;
+		RejillaFileNode *node;
+
+		if (tree->dirs->len) {
+			parent = g_ptr_array_index (tree->dirs, i % tree->dirs->len);
+			parent_uri = g_ptr_array_index (tree->dir_uris, i % tree->dirs->len);
+		}
+		else
+			parent_uri = REJILLA_BENCHMARK_URI;
+
+		node = rejilla_benchmark_tree_add (tree,
+						   parent,
+						   parent_uri,
+						   FALSE,
+						   NULL);
+		if (node)
+			g_ptr_array_add (tree->files, node);
+	}
+
+	rejilla_benchmark_stop (&mark, "add-file", files);
+}
+
+static RejillaFileNode *
+rejilla_benchmark_tree_random_file (RejillaBenchmarkTree *tree)
+{
+	if (!tree->files->len)
+		return NULL;
+
+	return g_ptr_array_index (tree->files, g_rand_int_range (tree->rand, 0, tree->files->len));
+}
+
+static goffset
+rejilla_benchmark_tree_size (RejillaBenchmarkTree *tree)
+{
+	goffset sectors;
+
+	sectors = rejilla_data_project_get_sectors (tree->project);
+	return rejilla_data_project_get_image_blocks (tree->project,
+						      NULL,
+						      sectors,
+						      REJILLA_IMAGE_FS_ISO|
+						      REJILLA_IMAGE_FS_JOLIET);
+}
+
+static void
+rejilla_benchmark_tree_rename (RejillaBenchmarkTree *tree,
+			       gboolean query_size)
+{
+	RejillaBenchmarkMark mark;
+	gint i;
+
+	rejilla_benchmark_start (&mark);
+
+	for (i = 0; i < (query_size? queries:operations); i ++) {
+		RejillaFileNode *node;
+		gchar *name;
+
+		/* one rename in eight is a directory */
+		if (tree->dirs->len && !(i % 8))
+			node = g_ptr_array_index (tree->dirs, g_rand_int_range (tree->rand, 0, tree->dirs->len));
+		else
+			node = rejilla_benchmark_tree_random_file (tree);
+
+		if (!node)
+			break;
+
+		name = g_strdup_printf ("r%u", tree->serial ++);
+		rejilla_data_project_rename_node (tree->project, node, name);
+		g_free (name);
+
+		if (query_size)
+			rejilla_benchmark_tree_size (tree);
+	}
+
+	rejilla_benchmark_stop (&mark,
+				query_size? "rename+size":"rename",
+				i);
+}
+
+static void
+rejilla_benchmark_tree_move (RejillaBenchmarkTree *tree)
+{
+	RejillaBenchmarkMark mark;
+	gint i;
+
+	if (!tree->dirs->len)
+		return;
+
+	rejilla_benchmark_start (&mark);
+
+	for (i = 0; i < operations; i ++) {
+		RejillaFileNode *parent;
+		RejillaFileNode *node;
+
+		node = rejilla_benchmark_tree_random_file (tree);
+		if (!node)
+			break;
+
+		parent = g_ptr_array_index (tree->dirs, g_rand_int_range (tree->rand, 0, tree->dirs->len));
+		rejilla_data_project_move_node (tree->project, node, parent);
+	}
+
+	rejilla_benchmark_stop (&mark, "move", i);
+}
+
+static void
+rejilla_benchmark_tree_remove (RejillaBenchmarkTree *tree)
+{
+	RejillaBenchmarkMark mark;
+	gint i;
+
+	rejilla_benchmark_start (&mark);
+
+	/* Only files are removed so that no pointer in the arrays dangles */
+	for (i = 0; i < operations && tree->files->len; i ++) {
+		RejillaFileNode *node;
+		guint index;
+
+		index = g_rand_int_range (tree->rand, 0, tree->files->len);
+		node = g_ptr_array_index (tree->files, index);
+		g_ptr_array_remove_index_fast (tree->files, index);
+
+		rejilla_data_project_remove_node (tree->project, node);
+	}
+
+	rejilla_benchmark_stop (&mark, "remove", i);
+}
+
+static void
+rejilla_benchmark_tree_size_queries (RejillaBenchmarkTree *tree)
+{
+	RejillaBenchmarkMark mark;
+	goffset blocks = 0;
+	gint i;
+
+	/* The first query after a change is the expensive one */
+	rejilla_benchmark_start (&mark);
+	blocks = rejilla_benchmark_tree_size (tree);
+	rejilla_benchmark_stop (&mark, "size-first", 1);
+
+	rejilla_benchmark_start (&mark);
+	for (i = 0; i < queries; i ++)
+		blocks = rejilla_benchmark_tree_size (tree);
+	rejilla_benchmark_stop (&mark, "size", queries);
+
+	g_print ("# image size: %" G_GOFFSET_FORMAT " blocks\n", blocks);
+}
+
+static void
+rejilla_benchmark_tree_contents (RejillaBenchmarkTree *tree)
+{
+	RejillaBenchmarkMark mark;
+	GSList *grafts = NULL;
+
+	rejilla_benchmark_start (&mark);
+	rejilla_data_project_get_contents (tree->project,
+					   &grafts,
+					   NULL,
+					   FALSE,
+					   TRUE,
+					   FALSE);
+	rejilla_benchmark_stop (&mark, "contents", g_slist_length (grafts));
+
+	g_slist_foreach (grafts, (GFunc) rejilla_graft_point_free, NULL);
+	g_slist_free (grafts);
+}
+
+static void
+rejilla_benchmark_tree_span (RejillaBenchmarkTree *tree)
+{
+	RejillaBenchmarkMark mark;
+	RejillaBurnResult result;
+	goffset max_sectors;
+	guint parts = 0;
+
+	/* Split the project in about three discs */
+	max_sectors = rejilla_benchmark_tree_size (tree) / 3 + 1;
+
+	rejilla_benchmark_start (&mark);
+	do {
+		RejillaTrackData *track;
+
+		track = rejilla_track_data_new ();
+		result = rejilla_data_project_span (tree->project,
+						    max_sectors,
+						    TRUE,
+						    TRUE,
+						    track);
+		g_object_unref (track);
+
+		if (result == REJILLA_BURN_RETRY)
+			parts ++;
+	} while (result == REJILLA_BURN_RETRY);
+	rejilla_data_project_span_stop (tree->project);
+	rejilla_benchmark_stop (&mark, "span", parts);
+
+	if (result != REJILLA_BURN_OK)
+		g_print ("# spanning failed (a top directory is bigger than %" G_GOFFSET_FORMAT " blocks)\n", max_sectors);
+}
+
+static void
+rejilla_benchmark_tree_reset (RejillaBenchmarkTree *tree)
+{
+	RejillaBenchmarkMark mark;
+	guint count;
+
+	count = tree->dirs->len + tree->files->len;
+
+	rejilla_benchmark_start (&mark);
+	rejilla_data_project_reset (tree->project);
+	rejilla_benchmark_stop (&mark, "reset", count);
+
+	g_ptr_array_set_size (tree->dirs, 0);
+	g_ptr_array_set_size (tree->files, 0);
+}
+
+static void
+rejilla_benchmark_synthetic (void)
+{
+	RejillaBenchmarkTree tree;
+
+	memset (&tree, 0, sizeof (tree));
+	tree.project = g_object_new (REJILLA_TYPE_DATA_PROJECT, NULL);
+	tree.rand = g_rand_new_with_seed (seed);
+	tree.dirs = g_ptr_array_new ();
+	tree.dir_uris = g_ptr_array_new ();
+	tree.files = g_ptr_array_new ();
+
+	g_print ("# synthetic project: depth %i, fan-out %i, %i files\n",
+		 depth,
+		 fanout,
+		 files);
+	rejilla_benchmark_header ();
+
+	rejilla_benchmark_tree_add_dirs (&tree);
+	rejilla_benchmark_tree_add_files (&tree);
+	rejilla_benchmark_tree_size_queries (&tree);
+	rejilla_benchmark_tree_rename (&tree, FALSE);
+	rejilla_benchmark_tree_rename (&tree, TRUE);
+	rejilla_benchmark_tree_move (&tree);
+	rejilla_benchmark_tree_size_queries (&tree);
+	rejilla_benchmark_tree_contents (&tree);
+	rejilla_benchmark_tree_span (&tree);
+	rejilla_benchmark_tree_remove (&tree);
+	rejilla_benchmark_tree_size_queries (&tree);
+	rejilla_benchmark_tree_reset (&tree);
+
+	g_ptr_array_foreach (tree.dir_uris, (GFunc) g_free, NULL);
+	g_ptr_array_free (tree.dir_uris, TRUE);
+	g_ptr_array_free (tree.dirs, TRUE);
+	g_ptr_array_free (tree.files, TRUE);
+	g_rand_free (tree.rand);
+	g_object_unref (tree.project);
+}
+
+/**
+ * Real files through a RejillaTrackDataCfg
+ */
+
+static void
+rejilla_benchmark_track (void)
+{
+	RejillaTrackDataCfg *track;
+	RejillaBenchmarkMark mark;
+	RejillaBurnResult result;
+	RejillaStatus *status;
+	goffset max_sectors;
+	goffset blocks = 0;
+	guint parts = 0;
+	guint i;
+
+	track = rejilla_track_data_cfg_new ();
+	status = rejilla_status_new ();
+
+	rejilla_benchmark_header ();
+
+	rejilla_benchmark_start (&mark);
+	for (i = 0; uris [i]; i ++) {
+		GFile *file;
+		gchar *uri;
+
+		file = g_file_new_for_commandline_arg (uris [i]);
+		uri = g_file_get_uri (file);
+		g_object_unref (file);
+
+		rejilla_track_data_cfg_add (track, uri, NULL);
+		g_free (uri);
+	}
+
+	while (rejilla_track_get_status (REJILLA_TRACK (track), status) == REJILLA_BURN_NOT_READY)
+		g_main_context_iteration (NULL, TRUE);
+	rejilla_benchmark_stop (&mark, "load", i);
+
+	rejilla_benchmark_start (&mark);
+	rejilla_track_get_size (REJILLA_TRACK (track), &blocks, NULL);
+	rejilla_benchmark_stop (&mark, "size-first", 1);
+
+	rejilla_benchmark_start (&mark);
+	for (i = 0; i < queries; i ++)
+		rejilla_track_get_size (REJILLA_TRACK (track), &blocks, NULL);
+	rejilla_benchmark_stop (&mark, "size", queries);
+
+	g_print ("# image size: %" G_GOFFSET_FORMAT " blocks\n", blocks);
+
+	max_sectors = blocks / 3 + 1;
+	rejilla_benchmark_start (&mark);
+	do {
+		RejillaTrackData *new_track;
+
+		new_track = rejilla_track_data_new ();
+		result = rejilla_track_data_cfg_span (track, max_sectors, new_track);
+		g_object_unref (new_track);
+
+		if (result == REJILLA_BURN_RETRY)
+			parts ++;
+	} while (result == REJILLA_BURN_RETRY);
+	rejilla_track_data_cfg_span_stop (track);
+	rejilla_benchmark_stop (&mark, "span", parts);
+
+	g_object_unref (status);
+	g_object_unref (track);
+}
+
+int
+main (int argc, char **argv)
+{
+	GOptionContext *context;
+	GError *error = NULL;
+	gpointer test;
+
+	/* Allocations made through g_slice would escape the accounting */
+	setenv ("G_SLICE", "always-malloc", TRUE);
+	g_mem_set_vtable (&benchmark_vtable);
+
+	g_thread_init (NULL);
+	g_type_init ();
+
+	test = g_malloc (1);
+	g_free (test);
+	alloc_tracking = (alloc_count > 0);
+
+	context = g_option_context_new (NULL);
+	g_option_context_set_summary (context, "Measures the operations on a data project");
+	g_option_context_add_main_entries (context, options, NULL);
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+		g_option_context_free (context);
+		return EXIT_FAILURE;
+	}
+	g_option_context_free (context);
+
+	if (depth < 0 || fanout < 0 || files < 0 || operations < 0 || queries < 0) {
+		g_printerr ("Values must be positive\n");
+		return EXIT_FAILURE;
+	}
+
+	if (uris) {
+		gtk_init_check (&argc, &argv);
+		if (!rejilla_burn_library_start (&argc, &argv)) {
+			g_printerr ("Could not initialize the burn library\n");
+			return EXIT_FAILURE;
+		}
+
+		rejilla_benchmark_track ();
+		rejilla_burn_library_stop ();
+		g_strfreev (uris);
+	}
+	else
+		rejilla_benchmark_synthetic ();
+
+	return EXIT_SUCCESS;
+}
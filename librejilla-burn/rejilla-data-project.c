@@ -34,11 +34,14 @@
 
 #include <string.h>
 #include <stdio.h>
+#include <unistd.h>
 #include <libgen.h>
 #include <sys/param.h>
+#include <sys/stat.h>
 
 #include <glib.h>
 #include <glib/gi18n-lib.h>
+#include <glib/gstdio.h>
 
 #include <gio/gio.h>
 
@@ -49,6 +52,7 @@
 
 #include "rejilla-misc.h"
 #include "rejilla-io.h"
+#include "rejilla-iso-size.h"
 
 #include "burn-debug.h"
 #include "rejilla-track-data.h"
@@ -2287,6 +2291,38 @@ rejilla_data_project_directory_node_loaded (RejillaDataProject *self,
 	}
 }
 
+/**
+ * Sets the size of a directory whose contents were not explored yet. Since
+ * it has no children, its size is only this estimate. It is propagated to
+ * the parents like the size of any other node.
+ */
+void
+rejilla_data_project_directory_node_estimated (RejillaDataProject *self,
+					       RejillaFileNode *node,
+					       guint sectors)
+{
+	RejillaFileNode *parent;
+	gint sectors_diff;
+
+	sectors_diff = sectors - REJILLA_FILE_NODE_SECTORS (node);
+	if (!sectors_diff)
+		return;
+
+	node->union3.sectors += sectors_diff;
+	if (!node->is_grafted) {
+		for (parent = node->parent; parent && !parent->is_root; parent = parent->parent) {
+			parent->union3.sectors += sectors_diff;
+			if (parent->is_grafted)
+				break;
+		}
+	}
+
+	rejilla_data_project_node_changed (self, node);
+	g_signal_emit (self,
+		       rejilla_data_project_signals [SIZE_CHANGED_SIGNAL],
+		       0);
+}
+
 /**
  * This function is only used by rejilla-data-vfs.c to add the contents of a 
  * directory. That's why if a node with the same name is already grafted we 
@@ -2819,34 +2855,24 @@ rejilla_data_project_span_generate (RejillaDataProject *self,
 }
 
 goffset
-rejilla_data_project_improve_image_size_accuracy (goffset sectors,
-						  guint64 dir_num,
-						  RejillaImageFS fs_type)
+rejilla_data_project_get_image_blocks (RejillaDataProject *self,
+				       GSList *children,
+				       goffset sectors,
+				       RejillaImageFS fs_type)
 {
-	/* sector number should be increased in the following way to get
-	 * a more accurate number:
-	 * - the first (empty most of the time) 16 sectors
-	 * - primary volume descriptor block
-	 * - terminator volume descriptor block
-	 * - one sector for root (and one more if there is joliet)
-	 * - 4 sectors for the path table (at least!!)
-	 * - for every directory add a block (for all entry records)
-	 *   and another one if there is joliet on
-	 */
-	sectors += 23;
-	sectors += dir_num * 1;
-	
-	if (fs_type & REJILLA_IMAGE_FS_JOLIET) {
-		/* For joliet :
-		 * - 1 sector for the volume descriptor
-		 * - 1 sector for the root descriptor
-		 * - 4 sectors for the path table (at least!!)
-		 */
-		sectors += 6;
+	RejillaDataProjectPrivate *priv;
+	RejillaFileTreeStats *stats;
 
-		/* For joliet 2 sectors per directory (at least!!) */
-		sectors += dir_num * 2;
-	}
+	priv = REJILLA_DATA_PROJECT_PRIVATE (self);
+
+	/* @sectors are the contents of the files. Add what the volume
+	 * descriptors, the path tables and the directories can take
+	 * whatever backend makes the image. */
+	stats = REJILLA_FILE_NODE_STATS (priv->root);
+	sectors += rejilla_iso_size_get_blocks (stats->iso_size,
+						priv->root,
+						children,
+						fs_type);
 
 	/* Finally there is a 150 pad block at the end (only with mkisofs !!).
 	 * That was probably done to avoid getting an image whose size would be
@@ -2901,7 +2927,10 @@ rejilla_data_project_span (RejillaDataProject *self,
 	MakeTrackDataSpan callback_data;
 	RejillaDataProjectPrivate *priv;
 	RejillaFileNode *children;
+	RejillaImageFS size_fs_type;
 	goffset total_sectors = 0;
+	GSList *selected = NULL;
+	GSList *item;
 
 	priv = REJILLA_DATA_PROJECT_PRIVATE (self);
 
@@ -2917,6 +2946,11 @@ rejilla_data_project_span (RejillaDataProject *self,
 	if (joliet)
 		callback_data.fs_type |= REJILLA_IMAGE_FS_JOLIET;
 
+	/* Symlinks are only known once the children are explored */
+	size_fs_type = callback_data.fs_type;
+	if (rejilla_data_project_has_symlinks (self))
+		size_fs_type |= REJILLA_IMAGE_FS_SYMLINK;
+
 	children = REJILLA_FILE_NODE_CHILDREN (priv->root);
 	while (children) {
 		goffset child_sectors;
@@ -2931,8 +2965,14 @@ rejilla_data_project_span (RejillaDataProject *self,
 		else
 			child_sectors = rejilla_data_project_get_folder_sectors (self, children);
 
-		/* if the top directory is too large, continue */
-		if (child_sectors + total_sectors > max_sectors) {
+		/* if the top directory is too large (with the directories and
+		 * the other structures it brings in the image), continue */
+		selected = g_slist_prepend (selected, children);
+		if (rejilla_data_project_get_image_blocks (self,
+							   selected,
+							   total_sectors + child_sectors,
+							   size_fs_type) > max_sectors) {
+			selected = g_slist_delete_link (selected, selected);
 			children = children->next;
 			continue;
 		}
@@ -2941,6 +2981,12 @@ rejilla_data_project_span (RejillaDataProject *self,
 		 * the biggest top folders/files and that would try to fill as
 		 * much as possible the disc. */
 		total_sectors += child_sectors;
+		children = children->next;
+	}
+
+	selected = g_slist_reverse (selected);
+	for (item = selected; item; item = item->next) {
+		children = item->data;
 
 		/* Take care of joliet non compliant nodes */
 		if (callback_data.fs_type & REJILLA_IMAGE_FS_JOLIET) {
@@ -2989,11 +3035,11 @@ rejilla_data_project_span (RejillaDataProject *self,
 		}
 
 		priv->spanned = g_slist_prepend (priv->spanned, children);
-		children = children->next;
 	}
 
 	/* This means it's finished */
 	if (!callback_data.grafts) {
+		g_slist_free (selected);
 		REJILLA_BURN_LOG ("No graft found for spanning");
 		return REJILLA_BURN_OK;
 	}
@@ -3003,9 +3049,11 @@ rejilla_data_project_span (RejillaDataProject *self,
 					    append_slash,
 					    track);
 
-	total_sectors = rejilla_data_project_improve_image_size_accuracy (total_sectors,
-									  callback_data.dir_num,
-									  callback_data.fs_type);
+	total_sectors = rejilla_data_project_get_image_blocks (self,
+							       selected,
+							       total_sectors,
+							       callback_data.fs_type);
+	g_slist_free (selected);
 
 	rejilla_track_data_set_data_blocks (track, total_sectors);
 	rejilla_track_data_add_fs (track, callback_data.fs_type);
@@ -3951,6 +3999,334 @@ rejilla_data_project_finalize (GObject *object)
 	G_OBJECT_CLASS (rejilla_data_project_parent_class)->finalize (object);
 }
 
+/**
+ * Used when a file was removed from disk behind our back
+ */
+
+static void
+rejilla_data_project_remove_vanished_node (RejillaDataProject *self,
+					   RejillaFileNode *node)
+{
+	RejillaDataProjectPrivate *priv;
+	RejillaURINode *uri_node;
+	gchar *uri;
+
+	priv = REJILLA_DATA_PROJECT_PRIVATE (self);
+
+	uri = rejilla_data_project_node_to_uri (self, node);
+	rejilla_data_project_remove_node (self, node);
+
+	/* a graft must have been created or already existed. */
+	uri_node = g_hash_table_lookup (priv->grafts, uri);
+	g_free (uri);
+
+	/* check if we can remove it (no more nodes) */
+	if (!uri_node || uri_node->nodes)
+		return;
+
+	g_hash_table_remove (priv->grafts, uri_node->uri);
+	rejilla_utils_unregister_string (uri_node->uri);
+	g_free (uri_node);
+}
+
+/**
+ * Revalidation of the whole tree against the disk.
+ * All nodes are stat'ed by a few threads while the main loop waits. This
+ * is safe since nothing can change the tree in the meantime; the threads
+ * only read nodes.
+ */
+
+typedef enum {
+	REJILLA_REVALIDATE_OK,
+	REJILLA_REVALIDATE_MISSING,
+	REJILLA_REVALIDATE_CHANGED
+} RejillaRevalidateStatus;
+
+struct _RejillaRevalidateEntry {
+	RejillaFileNode *node;
+
+	/* Either the path of the parent directory (shared) or, for grafted
+	 * nodes, the whole path. */
+	const gchar *path;
+
+	guint status;
+};
+typedef struct _RejillaRevalidateEntry RejillaRevalidateEntry;
+
+struct _RejillaRevalidateData {
+	RejillaRevalidateEntry *entries;
+	guint num;
+
+	volatile gint next;
+};
+typedef struct _RejillaRevalidateData RejillaRevalidateData;
+
+/* Number of entries a thread handles before taking the next ones */
+#define REJILLA_REVALIDATE_BATCH	256
+
+static void
+rejilla_data_project_revalidate_entry (RejillaRevalidateEntry *entry)
+{
+	RejillaFileNode *node = entry->node;
+	struct stat buffer;
+	gchar *path;
+	int res;
+
+	if (node->is_grafted)
+		path = (gchar *) entry->path;
+	else
+		path = g_build_filename (entry->path, REJILLA_FILE_NODE_NAME (node), NULL);
+
+	/* Symlinks that are not followed are written as such */
+	if (node->is_symlink)
+		res = g_lstat (path, &buffer);
+	else
+		res = g_stat (path, &buffer);
+
+	if (path != entry->path)
+		g_free (path);
+
+	if (res) {
+		entry->status = REJILLA_REVALIDATE_MISSING;
+		return;
+	}
+
+	if (node->is_symlink)
+		return;
+
+	/* A file replaced by a directory (or the reverse) is gone too */
+	if ((S_ISDIR (buffer.st_mode) != 0) == (node->is_file != 0)) {
+		entry->status = REJILLA_REVALIDATE_MISSING;
+		return;
+	}
+
+	if (node->is_file
+	&&  REJILLA_BYTES_TO_SECTORS (buffer.st_size, 2048) != REJILLA_FILE_NODE_SECTORS (node))
+		entry->status = REJILLA_REVALIDATE_CHANGED;
+}
+
+static gpointer
+rejilla_data_project_revalidate_thread (gpointer user_data)
+{
+	RejillaRevalidateData *data = user_data;
+
+	while (1) {
+		guint start;
+		guint end;
+		guint i;
+
+		start = g_atomic_int_exchange_and_add (&data->next, REJILLA_REVALIDATE_BATCH);
+		if (start >= data->num)
+			break;
+
+		end = MIN (start + REJILLA_REVALIDATE_BATCH, data->num);
+		for (i = start; i < end; i ++)
+			rejilla_data_project_revalidate_entry (data->entries + i);
+	}
+
+	return NULL;
+}
+
+static void
+rejilla_data_project_revalidate_collect (RejillaDataProject *self,
+					 RejillaFileNode *parent,
+					 const gchar *parent_path,
+					 GStringChunk *paths,
+					 GArray *entries)
+{
+	RejillaFileNode *node;
+
+	for (node = REJILLA_FILE_NODE_CHILDREN (parent); node; node = node->next) {
+		RejillaRevalidateEntry entry;
+		const gchar *path = NULL;
+
+		/* Fake (created) and imported nodes are not on disk though
+		 * some of their children can be. */
+		if (REJILLA_FILE_NODE_VIRTUAL (node))
+			continue;
+
+		if (node->is_grafted) {
+			gchar *tmp;
+
+			tmp = g_filename_from_uri (REJILLA_FILE_NODE_GRAFT (node)->node->uri, NULL, NULL);
+			if (tmp) {
+				path = g_string_chunk_insert (paths, tmp);
+				g_free (tmp);
+			}
+		}
+		else if (!node->is_fake && !node->is_imported && parent_path)
+			path = parent_path;
+
+		/* Nodes still loading are being checked right now */
+		if (path && !node->is_loading && !node->is_reloading) {
+			entry.node = node;
+			entry.path = path;
+			entry.status = REJILLA_REVALIDATE_OK;
+			g_array_append_val (entries, entry);
+		}
+
+		if (node->is_file)
+			continue;
+
+		/* Children of natural nodes need the path of their parent */
+		if (path && !node->is_grafted) {
+			gchar *tmp;
+
+			tmp = g_build_filename (path, REJILLA_FILE_NODE_NAME (node), NULL);
+			path = g_string_chunk_insert (paths, tmp);
+			g_free (tmp);
+		}
+
+		rejilla_data_project_revalidate_collect (self,
+							 node,
+							 path,
+							 paths,
+							 entries);
+	}
+}
+
+/**
+ * Checks that all the files of the project still exist and have the same
+ * size. Files whose size changed are reloaded and those missing removed.
+ * @missing and @changed are set to the list of URIs concerned.
+ * Returns TRUE if something changed.
+ */
+
+gboolean
+rejilla_data_project_revalidate (RejillaDataProject *self,
+				 GSList **missing,
+				 GSList **changed)
+{
+	RejillaDataProjectPrivate *priv;
+	RejillaDataProjectClass *klass;
+	RejillaRevalidateData data;
+	GStringChunk *paths;
+	GSList *references;
+	GSList *threads;
+	GArray *entries;
+	GSList *iter;
+	guint num_threads;
+	guint i;
+
+	priv = REJILLA_DATA_PROJECT_PRIVATE (self);
+
+	entries = g_array_new (FALSE, FALSE, sizeof (RejillaRevalidateEntry));
+	paths = g_string_chunk_new (4096);
+	rejilla_data_project_revalidate_collect (self,
+						 priv->root,
+						 NULL,
+						 paths,
+						 entries);
+
+	data.entries = (RejillaRevalidateEntry *) entries->data;
+	data.num = entries->len;
+	data.next = 0;
+
+	/* stat () mostly waits for the disk so use more threads than
+	 * there are processors. */
+	num_threads = CLAMP (sysconf (_SC_NPROCESSORS_ONLN) * 2, 2, 16);
+	num_threads = MIN (num_threads, data.num / REJILLA_REVALIDATE_BATCH + 1);
+
+	threads = NULL;
+	for (i = 1; i < num_threads; i ++) {
+		GThread *thread;
+
+		thread = g_thread_create (rejilla_data_project_revalidate_thread,
+					  &data,
+					  TRUE,
+					  NULL);
+		if (!thread)
+			break;
+
+		threads = g_slist_prepend (threads, thread);
+	}
+
+	REJILLA_BURN_LOG ("Revalidating %i nodes with %i threads",
+			  data.num,
+			  g_slist_length (threads) + 1);
+
+	/* This thread takes its share as well */
+	rejilla_data_project_revalidate_thread (&data);
+
+	for (iter = threads; iter; iter = iter->next)
+		g_thread_join (iter->data);
+	g_slist_free (threads);
+
+	/* Report what changed and take references as removing nodes may
+	 * destroy others that we still have to deal with. */
+	references = NULL;
+	for (i = 0; i < data.num; i ++) {
+		RejillaRevalidateEntry *entry;
+		gchar *uri;
+
+		entry = data.entries + i;
+		if (entry->status == REJILLA_REVALIDATE_OK)
+			continue;
+
+		uri = rejilla_data_project_node_to_uri (self, entry->node);
+		if (entry->status == REJILLA_REVALIDATE_MISSING) {
+			if (missing)
+				*missing = g_slist_prepend (*missing, uri);
+			else
+				g_free (uri);
+		}
+		else if (changed)
+			*changed = g_slist_prepend (*changed, uri);
+		else
+			g_free (uri);
+
+		/* The list holds pairs of status and reference */
+		references = g_slist_prepend (references,
+					      GINT_TO_POINTER (rejilla_data_project_reference_new (self, entry->node)));
+		references = g_slist_prepend (references,
+					      GINT_TO_POINTER (entry->status));
+	}
+
+	g_array_free (entries, TRUE);
+	g_string_chunk_free (paths);
+
+	if (!references)
+		return FALSE;
+
+	klass = REJILLA_DATA_PROJECT_GET_CLASS (self);
+	for (iter = references; iter; iter = iter->next->next) {
+		RejillaFileNode *node;
+		guint reference;
+		guint status;
+
+		status = GPOINTER_TO_INT (iter->data);
+		reference = GPOINTER_TO_INT (iter->next->data);
+
+		node = rejilla_data_project_reference_get (self, reference);
+		rejilla_data_project_reference_free (self, reference);
+
+		/* it was removed with its parent */
+		if (!node)
+			continue;
+
+		if (status == REJILLA_REVALIDATE_MISSING) {
+			rejilla_data_project_remove_vanished_node (self, node);
+			continue;
+		}
+
+		/* Reload the node; the new size will be set by node_reloaded */
+		if (node->is_loading || node->is_reloading)
+			continue;
+
+		node->is_reloading = TRUE;
+		if (klass->node_added) {
+			gchar *uri;
+
+			uri = rejilla_data_project_node_to_uri (self, node);
+			klass->node_added (self, node, uri);
+			g_free (uri);
+		}
+	}
+	g_slist_free (references);
+
+	return TRUE;
+}
+
 /**
  * Callbacks for inotify backend
  */
@@ -4318,12 +4694,7 @@ rejilla_data_project_file_removed (RejillaFileMonitor *monitor,
 				   gpointer callback_data,
 				   const gchar *name)
 {
-	RejillaDataProjectPrivate *priv;
-	RejillaURINode *uri_node;
 	RejillaFileNode *node;
-	gchar *uri;
-
-	priv = REJILLA_DATA_PROJECT_PRIVATE (monitor);
 
 	/* If name is NULL then it means the event is against callback.
 	 * Otherwise that's against one of the children of callback. */
@@ -4335,20 +4706,7 @@ rejilla_data_project_file_removed (RejillaFileMonitor *monitor,
 	if (!node)
 		return;
 
-	uri = rejilla_data_project_node_to_uri (REJILLA_DATA_PROJECT (monitor), node);
-	rejilla_data_project_remove_node (REJILLA_DATA_PROJECT (monitor), node);
-
-	/* a graft must have been created or already existed. */
-	uri_node = g_hash_table_lookup (priv->grafts, uri);
-	g_free (uri);
-
-	/* check if we can remove it (no more nodes) */
-	if (!uri_node || uri_node->nodes)
-		return;
-
-	g_hash_table_remove (priv->grafts, uri_node->uri);
-	rejilla_utils_unregister_string (uri_node->uri);
-	g_free (uri_node);
+	rejilla_data_project_remove_vanished_node (REJILLA_DATA_PROJECT (monitor), node);
 }
 
 static void
@@ -4384,6 +4742,111 @@ rejilla_data_project_file_modified (RejillaFileMonitor *monitor,
 	g_free (uri);
 }
 
+/**
+ * This is called for directories that the monitor could not afford to
+ * watch when their modification time changed. Compare what's on disk
+ * with the children of the node and add/remove what's needed.
+ */
+
+static void
+rejilla_data_project_directory_changed (RejillaFileMonitor *monitor,
+					gpointer callback_data)
+{
+	RejillaFileNode *node = callback_data;
+	RejillaDataProjectPrivate *priv;
+	GFileEnumerator *enumerator;
+	RejillaFileNode *child;
+	GHashTable *names;
+	GSList *removed;
+	GFileInfo *info;
+	GSList *iter;
+	GFile *file;
+	gchar *uri;
+
+	priv = REJILLA_DATA_PROJECT_PRIVATE (monitor);
+
+	/* Nodes whose contents are still to be (re)loaded will get them
+	 * from the disk as they are now anyway. */
+	if (node->is_file
+	||  node->is_loading
+	||  node->is_reloading
+	||  node->is_exploring
+	||  node->is_deferred)
+		return;
+
+	uri = rejilla_data_project_node_to_uri (REJILLA_DATA_PROJECT (monitor), node);
+	file = g_file_new_for_uri (uri);
+	enumerator = g_file_enumerate_children (file,
+						G_FILE_ATTRIBUTE_STANDARD_NAME,
+						G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+						NULL,
+						NULL);
+	g_object_unref (file);
+
+	if (!enumerator) {
+		g_free (uri);
+		return;
+	}
+
+	names = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	while ((info = g_file_enumerator_next_file (enumerator, NULL, NULL))) {
+		g_hash_table_insert (names, g_strdup (g_file_info_get_name (info)), GINT_TO_POINTER (1));
+		g_object_unref (info);
+	}
+	g_file_enumerator_close (enumerator, NULL, NULL);
+	g_object_unref (enumerator);
+
+	/* Children that disappeared; grafted, fake or imported children
+	 * are not in the directory on disk in the first place. */
+	removed = NULL;
+	for (child = REJILLA_FILE_NODE_CHILDREN (node); child; child = child->next) {
+		const gchar *name;
+
+		if (child->is_grafted || child->is_fake || child->is_imported)
+			continue;
+
+		name = REJILLA_FILE_NODE_NAME (child);
+		if (!g_hash_table_remove (names, name))
+			removed = g_slist_prepend (removed, g_strdup (name));
+	}
+
+	for (iter = removed; iter; iter = iter->next)
+		rejilla_data_project_file_removed (monitor,
+						   REJILLA_FILE_MONITOR_FOLDER,
+						   node,
+						   iter->data);
+
+	g_slist_foreach (removed, (GFunc) g_free, NULL);
+	g_slist_free (removed);
+
+	/* What is left in the table is new unless it was excluded (or
+	 * grafted elsewhere in which case it's excluded here). */
+	if (g_hash_table_size (names)) {
+		GHashTableIter hash_iter;
+		gpointer key;
+
+		g_hash_table_iter_init (&hash_iter, names);
+		while (g_hash_table_iter_next (&hash_iter, &key, NULL)) {
+			gchar *escaped_name;
+			gchar *child_uri;
+
+			escaped_name = g_uri_escape_string (key,
+							    G_URI_RESERVED_CHARS_ALLOWED_IN_PATH,
+							    FALSE);
+			child_uri = g_strconcat (uri, G_DIR_SEPARATOR_S, escaped_name, NULL);
+			g_free (escaped_name);
+
+			if (!g_hash_table_lookup (priv->grafts, child_uri))
+				rejilla_data_project_file_added (monitor, node, key);
+
+			g_free (child_uri);
+		}
+	}
+
+	g_hash_table_destroy (names);
+	g_free (uri);
+}
+
 #endif
 
 static void
@@ -4477,6 +4940,7 @@ rejilla_data_project_class_init (RejillaDataProjectClass *klass)
 	monitor_class->file_removed = rejilla_data_project_file_removed;
 	monitor_class->file_renamed = rejilla_data_project_file_renamed;
 	monitor_class->file_modified = rejilla_data_project_file_modified;
+	monitor_class->directory_changed = rejilla_data_project_directory_changed;
 
 #endif
 }
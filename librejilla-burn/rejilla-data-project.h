@@ -126,9 +126,10 @@ goffset
 rejilla_data_project_get_sectors (RejillaDataProject *project);
 
 goffset
-rejilla_data_project_improve_image_size_accuracy (goffset blocks,
-						  guint64 dir_num,
-						  RejillaImageFS fs_type);
+rejilla_data_project_get_image_blocks (RejillaDataProject *project,
+				       GSList *children,
+				       goffset sectors,
+				       RejillaImageFS fs_type);
 goffset
 rejilla_data_project_get_folder_sectors (RejillaDataProject *project,
 					 RejillaFileNode *node);
@@ -203,6 +204,16 @@ void
 rejilla_data_project_directory_node_loaded (RejillaDataProject *project,
 					    RejillaFileNode *parent);
 
+void
+rejilla_data_project_directory_node_estimated (RejillaDataProject *project,
+					       RejillaFileNode *node,
+					       guint sectors);
+
+gboolean
+rejilla_data_project_revalidate (RejillaDataProject *project,
+				 GSList **missing,
+				 GSList **changed);
+
 gboolean
 rejilla_data_project_rename_node (RejillaDataProject *project,
 				  RejillaFileNode *node,
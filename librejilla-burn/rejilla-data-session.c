@@ -32,6 +32,8 @@
 #  include <config.h>
 #endif
 
+#include <string.h>
+
 #include <glib.h>
 #include <glib/gi18n-lib.h>
 
@@ -40,9 +42,11 @@
 #include "scsi-device.h"
 
 #include "rejilla-drive.h"
+#include "rejilla-drive-priv.h"
 #include "rejilla-medium.h"
 #include "rejilla-medium-monitor.h"
 #include "burn-volume.h"
+#include "burn-iso9660.h"
 
 #include "rejilla-burn-lib.h"
 
@@ -87,11 +91,260 @@ struct _RejillaIOImageContentsData {
 	RejillaIOJob job;
 	gchar *dev_image;
 
+	/* Identity of the medium; NULL if its listings can't be cached */
+	gchar *identity;
+
 	gint64 session_block;
 	gint64 block;
 };
 typedef struct _RejillaIOImageContentsData RejillaIOImageContentsData;
 
+/**
+ * Listings of the directories of the last session of a few media. Reading
+ * them from a drive is slow so each directory is read only once per medium
+ * (as long as its contents do not change) and all of them are read in the
+ * background once a session is imported so that expanding a directory does
+ * not have to wait for the drive.
+ */
+
+struct _RejillaImageDirEntry {
+	gchar *name;
+
+	/* address for directories, size for files */
+	gint64 value;
+	guint isdir:1;
+};
+typedef struct _RejillaImageDirEntry RejillaImageDirEntry;
+
+struct _RejillaImageListing {
+	/* Identity of the medium and checksum of the session descriptor */
+	gchar *identity;
+	gint64 session_block;
+
+	/* directory address => GSList of RejillaImageDirEntry */
+	GHashTable *dirs;
+};
+typedef struct _RejillaImageListing RejillaImageListing;
+
+#define REJILLA_IMAGE_LISTING_MAX	4
+
+static GSList *image_listings = NULL;
+G_LOCK_DEFINE_STATIC (image_listings_lock);
+
+static void
+rejilla_image_dir_entries_free (GSList *entries)
+{
+	GSList *iter;
+
+	for (iter = entries; iter; iter = iter->next) {
+		RejillaImageDirEntry *entry;
+
+		entry = iter->data;
+		g_free (entry->name);
+		g_free (entry);
+	}
+	g_slist_free (entries);
+}
+
+static GSList *
+rejilla_image_dir_entries_copy (GSList *entries)
+{
+	GSList *retval = NULL;
+	GSList *iter;
+
+	for (iter = entries; iter; iter = iter->next) {
+		RejillaImageDirEntry *entry;
+		RejillaImageDirEntry *copy;
+
+		entry = iter->data;
+		copy = g_new0 (RejillaImageDirEntry, 1);
+		copy->name = g_strdup (entry->name);
+		copy->value = entry->value;
+		copy->isdir = entry->isdir;
+		retval = g_slist_prepend (retval, copy);
+	}
+
+	return g_slist_reverse (retval);
+}
+
+static GSList *
+rejilla_image_dir_entries_new (GList *children)
+{
+	GSList *retval = NULL;
+	GList *iter;
+
+	for (iter = children; iter; iter = iter->next) {
+		RejillaImageDirEntry *entry;
+		RejillaVolFile *file;
+
+		file = iter->data;
+
+		entry = g_new0 (RejillaImageDirEntry, 1);
+		entry->name = g_strdup (REJILLA_VOLUME_FILE_NAME (file));
+		entry->isdir = file->isdir;
+		if (file->isdir)
+			entry->value = file->specific.dir.address;
+		else
+			entry->value = REJILLA_VOLUME_FILE_SIZE (file);
+
+		retval = g_slist_prepend (retval, entry);
+	}
+
+	return g_slist_reverse (retval);
+}
+
+static void
+rejilla_image_listing_free (RejillaImageListing *listing)
+{
+	g_hash_table_destroy (listing->dirs);
+	g_free (listing->identity);
+	g_free (listing);
+}
+
+/* image_listings_lock must be held */
+static RejillaImageListing *
+rejilla_image_listing_find (const gchar *identity,
+			    gint64 session_block,
+			    gboolean create)
+{
+	RejillaImageListing *listing;
+	GSList *iter;
+
+	for (iter = image_listings; iter; iter = iter->next) {
+		listing = iter->data;
+		if (listing->session_block == session_block
+		&& !strcmp (listing->identity, identity)) {
+			/* Most recently used first */
+			image_listings = g_slist_delete_link (image_listings, iter);
+			image_listings = g_slist_prepend (image_listings, listing);
+			return listing;
+		}
+	}
+
+	if (!create)
+		return NULL;
+
+	if (g_slist_length (image_listings) >= REJILLA_IMAGE_LISTING_MAX) {
+		iter = g_slist_last (image_listings);
+		rejilla_image_listing_free (iter->data);
+		image_listings = g_slist_delete_link (image_listings, iter);
+	}
+
+	listing = g_new0 (RejillaImageListing, 1);
+	listing->identity = g_strdup (identity);
+	listing->session_block = session_block;
+	listing->dirs = g_hash_table_new_full (g_direct_hash,
+					       g_direct_equal,
+					       NULL,
+					       (GDestroyNotify) rejilla_image_dir_entries_free);
+	image_listings = g_slist_prepend (image_listings, listing);
+	return listing;
+}
+
+static gboolean
+rejilla_image_listing_get (const gchar *identity,
+			   gint64 session_block,
+			   gint64 block,
+			   GSList **entries)
+{
+	RejillaImageListing *listing;
+	gpointer value = NULL;
+	gboolean found = FALSE;
+
+	G_LOCK (image_listings_lock);
+
+	listing = rejilla_image_listing_find (identity, session_block, FALSE);
+	if (listing)
+		found = g_hash_table_lookup_extended (listing->dirs,
+						      GINT_TO_POINTER ((gint) block),
+						      NULL,
+						      &value);
+	if (found)
+		*entries = rejilla_image_dir_entries_copy (value);
+
+	G_UNLOCK (image_listings_lock);
+
+	return found;
+}
+
+static void
+rejilla_image_listing_set (const gchar *identity,
+			   gint64 session_block,
+			   gint64 block,
+			   GSList *entries)
+{
+	RejillaImageListing *listing;
+
+	G_LOCK (image_listings_lock);
+
+	listing = rejilla_image_listing_find (identity, session_block, TRUE);
+	g_hash_table_insert (listing->dirs,
+			     GINT_TO_POINTER ((gint) block),
+			     rejilla_image_dir_entries_copy (entries));
+
+	G_UNLOCK (image_listings_lock);
+}
+
+/**
+ * Two media can have the same identity (two CD-Rs of the same batch for
+ * example) so the listings of a session are also kept with the primary
+ * volume descriptor of the session.
+ */
+
+static gchar *
+rejilla_image_listing_get_key (RejillaVolSrc *vol,
+			       const gchar *identity,
+			       gint64 session_block)
+{
+	gchar buffer [ISO9660_BLOCK_SIZE];
+	gchar *checksum;
+	gchar *key;
+
+	if (!identity)
+		return NULL;
+
+	if (!rejilla_volume_get_primary (vol, session_block, buffer, NULL))
+		return NULL;
+
+	checksum = g_compute_checksum_for_data (G_CHECKSUM_MD5,
+						(guchar *) buffer,
+						sizeof (buffer));
+	key = g_strdup_printf ("%s %s", identity, checksum);
+	g_free (checksum);
+
+	return key;
+}
+
+static GSList *
+rejilla_image_listing_read (RejillaVolSrc *vol,
+			    const gchar *identity,
+			    gint64 session_block,
+			    gint64 block,
+			    GError **error)
+{
+	GError *local_error = NULL;
+	GList *children;
+	GSList *entries;
+
+	children = rejilla_volume_load_directory_contents (vol,
+							   session_block,
+							   block,
+							   &local_error);
+	if (local_error) {
+		g_propagate_error (error, local_error);
+		return NULL;
+	}
+
+	entries = rejilla_image_dir_entries_new (children);
+	g_list_foreach (children, (GFunc) rejilla_volume_file_free, NULL);
+	g_list_free (children);
+
+	if (identity)
+		rejilla_image_listing_set (identity, session_block, block, entries);
+
+	return entries;
+}
+
 static void
 rejilla_io_image_directory_contents_destroy (RejillaAsyncTaskManager *manager,
 					     gboolean cancelled,
@@ -100,6 +353,7 @@ rejilla_io_image_directory_contents_destroy (RejillaAsyncTaskManager *manager,
 	RejillaIOImageContentsData *data = callback_data;
 
 	g_free (data->dev_image);
+	g_free (data->identity);
 	rejilla_io_job_free (cancelled, REJILLA_IO_JOB (data));
 }
 
@@ -110,9 +364,11 @@ rejilla_io_image_directory_contents_thread (RejillaAsyncTaskManager *manager,
 {
 	RejillaIOImageContentsData *data = callback_data;
 	RejillaDeviceHandle *handle;
-	GList *children, *iter;
+	GSList *entries = NULL;
 	GError *error = NULL;
 	RejillaVolSrc *vol;
+	GSList *iter;
+	gchar *key;
 
 	handle = rejilla_device_handle_open (data->job.uri, FALSE, NULL);
 	if (!handle) {
@@ -141,29 +397,45 @@ rejilla_io_image_directory_contents_thread (RejillaAsyncTaskManager *manager,
 		return REJILLA_ASYNC_TASK_FINISHED;
 	}
 
-	children = rejilla_volume_load_directory_contents (vol,
-							   data->session_block,
-							   data->block,
-							   &error);
+	key = rejilla_image_listing_get_key (vol,
+					    data->identity,
+					    data->session_block);
+	if (key
+	&&  rejilla_image_listing_get (key,
+				       data->session_block,
+				       data->block,
+				       &entries)) {
+		REJILLA_MEDIA_LOG ("Directory listing found in cache");
+	}
+	else
+		entries = rejilla_image_listing_read (vol,
+						      key,
+						      data->session_block,
+						      data->block,
+						      &error);
 	rejilla_volume_source_close (vol);
 	rejilla_device_handle_close (handle);
+	g_free (key);
 
-	for (iter = children; iter; iter = iter->next) {
-		RejillaVolFile *file;
+	if (error)
+		g_error_free (error);
+
+	for (iter = entries; iter; iter = iter->next) {
+		RejillaImageDirEntry *entry;
 		GFileInfo *info;
 
-		file = iter->data;
+		entry = iter->data;
 
 		info = g_file_info_new ();
-		g_file_info_set_file_type (info, file->isdir? G_FILE_TYPE_DIRECTORY:G_FILE_TYPE_REGULAR);
-		g_file_info_set_name (info, REJILLA_VOLUME_FILE_NAME (file));
+		g_file_info_set_file_type (info, entry->isdir? G_FILE_TYPE_DIRECTORY:G_FILE_TYPE_REGULAR);
+		g_file_info_set_name (info, entry->name);
 
-		if (file->isdir)
+		if (entry->isdir)
 			g_file_info_set_attribute_int64 (info,
 							 REJILLA_IO_DIR_CONTENTS_ADDR,
-							 file->specific.dir.address);
+							 entry->value);
 		else
-			g_file_info_set_size (info, REJILLA_VOLUME_FILE_SIZE (file));
+			g_file_info_set_size (info, entry->value);
 
 		rejilla_io_return_result (data->job.base,
 					  data->job.uri,
@@ -172,8 +444,7 @@ rejilla_io_image_directory_contents_thread (RejillaAsyncTaskManager *manager,
 					  data->job.callback_data);
 	}
 
-	g_list_foreach (children, (GFunc) rejilla_volume_file_free, NULL);
-	g_list_free (children);
+	rejilla_image_dir_entries_free (entries);
 
 	return REJILLA_ASYNC_TASK_FINISHED;
 }
@@ -183,8 +454,128 @@ static const RejillaAsyncTaskType image_contents_type = {
 	rejilla_io_image_directory_contents_destroy
 };
 
+/**
+ * Reads all the directories of a session breadth first to fill the cache.
+ * It does not return any result.
+ */
+
+static RejillaAsyncTaskResult
+rejilla_io_image_prefetch_thread (RejillaAsyncTaskManager *manager,
+				  GCancellable *cancel,
+				  gpointer callback_data)
+{
+	RejillaIOImageContentsData *data = callback_data;
+	RejillaDeviceHandle *handle;
+	GHashTable *visited;
+	RejillaVolSrc *vol;
+	GQueue *queue;
+	gchar *key;
+
+	handle = rejilla_device_handle_open (data->job.uri, FALSE, NULL);
+	if (!handle)
+		return REJILLA_ASYNC_TASK_FINISHED;
+
+	vol = rejilla_volume_source_open_device_handle (handle, NULL);
+	if (!vol) {
+		rejilla_device_handle_close (handle);
+		return REJILLA_ASYNC_TASK_FINISHED;
+	}
+
+	key = rejilla_image_listing_get_key (vol,
+					    data->identity,
+					    data->session_block);
+	if (!key) {
+		rejilla_volume_source_close (vol);
+		rejilla_device_handle_close (handle);
+		return REJILLA_ASYNC_TASK_FINISHED;
+	}
+
+	/* A corrupted disc could have directories pointing at each other */
+	visited = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+	queue = g_queue_new ();
+	g_queue_push_tail (queue, GINT_TO_POINTER (data->block));
+
+	while (!g_queue_is_empty (queue) && !g_cancellable_is_cancelled (cancel)) {
+		GSList *entries = NULL;
+		GError *error = NULL;
+		gpointer block;
+		GSList *iter;
+
+		block = g_queue_pop_head (queue);
+		if (g_hash_table_lookup (visited, block))
+			continue;
+
+		g_hash_table_insert (visited, block, GINT_TO_POINTER (1));
+
+		if (!rejilla_image_listing_get (key,
+						data->session_block,
+						GPOINTER_TO_INT (block),
+						&entries)) {
+			entries = rejilla_image_listing_read (vol,
+							      key,
+							      data->session_block,
+							      GPOINTER_TO_INT (block),
+							      &error);
+			if (error) {
+				REJILLA_MEDIA_LOG ("Directory prefetching stopped (%s)", error->message);
+				g_error_free (error);
+				break;
+			}
+		}
+
+		for (iter = entries; iter; iter = iter->next) {
+			RejillaImageDirEntry *entry;
+
+			entry = iter->data;
+			if (entry->isdir)
+				g_queue_push_tail (queue, GINT_TO_POINTER ((gint) entry->value));
+		}
+
+		rejilla_image_dir_entries_free (entries);
+	}
+
+	g_queue_free (queue);
+	g_hash_table_destroy (visited);
+	g_free (key);
+
+	rejilla_volume_source_close (vol);
+	rejilla_device_handle_close (handle);
+
+	return REJILLA_ASYNC_TASK_FINISHED;
+}
+
+static const RejillaAsyncTaskType image_prefetch_type = {
+	rejilla_io_image_prefetch_thread,
+	rejilla_io_image_directory_contents_destroy
+};
+
+static void
+rejilla_io_prefetch_image_directories (const gchar *dev_image,
+				       const gchar *identity,
+				       gint64 session_block,
+				       const RejillaIOJobBase *base)
+{
+	RejillaIOImageContentsData *data;
+
+	data = g_new0 (RejillaIOImageContentsData, 1);
+	data->block = -1;
+	data->session_block = session_block;
+	data->identity = g_strdup (identity);
+
+	rejilla_io_set_job (REJILLA_IO_JOB (data),
+			    base,
+			    dev_image,
+			    REJILLA_IO_INFO_IDLE,
+			    NULL);
+
+	rejilla_io_push_job (REJILLA_IO_JOB (data),
+			     &image_prefetch_type);
+}
+
 static void
 rejilla_io_load_image_directory (const gchar *dev_image,
+				 const gchar *identity,
 				 gint64 session_block,
 				 gint64 block,
 				 const RejillaIOJobBase *base,
@@ -202,6 +593,7 @@ rejilla_io_load_image_directory (const gchar *dev_image,
 	data = g_new0 (RejillaIOImageContentsData, 1);
 	data->block = block;
 	data->session_block = session_block;
+	data->identity = g_strdup (identity);
 
 	rejilla_io_set_job (REJILLA_IO_JOB (data),
 			    base,
@@ -337,6 +729,7 @@ rejilla_data_session_load_directory_contents_real (RejillaDataSession *self,
 						   GError **error)
 {
 	RejillaDataSessionPrivate *priv;
+	const gchar *identity;
 	goffset session_block;
 	const gchar *device;
 	gint reference = -1;
@@ -362,7 +755,9 @@ rejilla_data_session_load_directory_contents_real (RejillaDataSession *self,
 		node->is_exploring = TRUE;
 	}
 
+	identity = rejilla_medium_get_probe_identity (priv->loaded);
 	rejilla_io_load_image_directory (device,
+					 identity,
 					 session_block,
 					 REJILLA_FILE_NODE_IMPORTED_ADDRESS (node),
 					 priv->load_dir,
@@ -371,6 +766,11 @@ rejilla_data_session_load_directory_contents_real (RejillaDataSession *self,
 
 	if (node)
 		node->is_fake = FALSE;
+	else if (identity)
+		rejilla_io_prefetch_image_directories (device,
+						       identity,
+						       session_block,
+						       priv->load_dir);
 
 	return TRUE;
 }
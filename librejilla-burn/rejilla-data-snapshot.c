@@ -0,0 +1,463 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * Librejilla-burn
+ * Copyright (C) Philippe Rouquier 2005-2009 <bonfire-app@wanadoo.fr>
+ *
+ * Librejilla-burn is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The Librejilla-burn authors hereby grant permission for non-GPL compatible
+ * GStreamer plugins to be used and distributed together with GStreamer
+ * and Librejilla-burn. This permission is above and beyond the permissions granted
+ * by the GPL license by which Librejilla-burn is covered. If you modify this code
+ * you may extend this exception to your version of the code, but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version.
+ * 
+ * Librejilla-burn is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to:
+ * 	The Free Software Foundation, Inc.,
+ * 	51 Franklin Street, Fifth Floor
+ * 	Boston, MA  02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include "rejilla-data-snapshot.h"
+#include "rejilla-data-project.h"
+#include "rejilla-file-node.h"
+
+#include "burn-debug.h"
+
+/**
+ * The file starts with REJILLA_DATA_SNAPSHOT_MAGIC followed by one record per
+ * directory. Integers are little endian.
+ * - directory: uri length (32 bits), uri, modification time (64 bits),
+ *   number of entries (32 bits)
+ * - entry: type (8 bits), size in sectors (32 bits), name length (16 bits),
+ *   name, MIME type length (16 bits), MIME type
+ */
+
+#define REJILLA_DATA_SNAPSHOT_MAGIC		"RJSNAP01"
+#define REJILLA_DATA_SNAPSHOT_MAGIC_LEN		8
+
+typedef enum {
+	REJILLA_DATA_SNAPSHOT_FILE,
+	REJILLA_DATA_SNAPSHOT_DIRECTORY,
+	REJILLA_DATA_SNAPSHOT_SYMLINK
+} RejillaDataSnapshotType;
+
+struct _RejillaDataSnapshotDir {
+	gint64 mtime;
+	guint32 num;
+
+	/* Points to the entries in the mapped file */
+	const guchar *entries;
+	const guchar *end;
+};
+typedef struct _RejillaDataSnapshotDir RejillaDataSnapshotDir;
+
+struct _RejillaDataSnapshot {
+	GMappedFile *file;
+
+	/* uri (pointing into the mapped file) => RejillaDataSnapshotDir */
+	GHashTable *directories;
+};
+
+/**
+ * Reading
+ */
+
+static gboolean
+rejilla_data_snapshot_read (const guchar **ptr,
+			    const guchar *end,
+			    gpointer buffer,
+			    gsize size)
+{
+	if (*ptr + size > end)
+		return FALSE;
+
+	memcpy (buffer, *ptr, size);
+	*ptr += size;
+	return TRUE;
+}
+
+static gboolean
+rejilla_data_snapshot_read_string (const guchar **ptr,
+				   const guchar *end,
+				   gsize len,
+				   gchar **string)
+{
+	if (*ptr + len > end)
+		return FALSE;
+
+	*string = g_strndup ((const gchar *) *ptr, len);
+	*ptr += len;
+	return TRUE;
+}
+
+/**
+ * rejilla_data_snapshot_load:
+ * @path: the path of the snapshot file
+ *
+ * Return value: a #RejillaDataSnapshot or NULL if there is no valid
+ * snapshot at @path.
+ **/
+
+RejillaDataSnapshot *
+rejilla_data_snapshot_load (const gchar *path)
+{
+	RejillaDataSnapshot *snapshot;
+	GMappedFile *file;
+	const guchar *ptr;
+	const guchar *end;
+
+	file = g_mapped_file_new (path, FALSE, NULL);
+	if (!file)
+		return NULL;
+
+	ptr = (const guchar *) g_mapped_file_get_contents (file);
+	end = ptr + g_mapped_file_get_length (file);
+
+	if (end - ptr < REJILLA_DATA_SNAPSHOT_MAGIC_LEN
+	||  memcmp (ptr, REJILLA_DATA_SNAPSHOT_MAGIC, REJILLA_DATA_SNAPSHOT_MAGIC_LEN)) {
+		REJILLA_BURN_LOG ("Invalid snapshot %s", path);
+		g_mapped_file_unref (file);
+		return NULL;
+	}
+	ptr += REJILLA_DATA_SNAPSHOT_MAGIC_LEN;
+
+	snapshot = g_new0 (RejillaDataSnapshot, 1);
+	snapshot->file = file;
+	snapshot->directories = g_hash_table_new_full (g_str_hash,
+						       g_str_equal,
+						       g_free,
+						       g_free);
+
+	/* Only the directories are indexed; their entries are decoded when
+	 * they are needed */
+	while (ptr < end) {
+		RejillaDataSnapshotDir *dir;
+		guint32 uri_len;
+		gchar *uri;
+		guint32 i;
+
+		dir = g_new0 (RejillaDataSnapshotDir, 1);
+		if (!rejilla_data_snapshot_read (&ptr, end, &uri_len, sizeof (uri_len))
+		||  !rejilla_data_snapshot_read_string (&ptr, end, GUINT32_FROM_LE (uri_len), &uri)) {
+			g_free (dir);
+			goto error;
+		}
+
+		g_hash_table_insert (snapshot->directories, uri, dir);
+
+		if (!rejilla_data_snapshot_read (&ptr, end, &dir->mtime, sizeof (dir->mtime))
+		||  !rejilla_data_snapshot_read (&ptr, end, &dir->num, sizeof (dir->num)))
+			goto error;
+
+		dir->mtime = GINT64_FROM_LE (dir->mtime);
+		dir->num = GUINT32_FROM_LE (dir->num);
+		dir->entries = ptr;
+
+		/* Skip the entries */
+		for (i = 0; i < dir->num; i ++) {
+			guint16 len;
+
+			ptr += sizeof (guint8) + sizeof (guint32);
+			if (!rejilla_data_snapshot_read (&ptr, end, &len, sizeof (len)))
+				goto error;
+
+			ptr += GUINT16_FROM_LE (len);
+			if (!rejilla_data_snapshot_read (&ptr, end, &len, sizeof (len)))
+				goto error;
+
+			ptr += GUINT16_FROM_LE (len);
+			if (ptr > end)
+				goto error;
+		}
+
+		dir->end = ptr;
+	}
+
+	REJILLA_BURN_LOG ("Snapshot %s with %i directories",
+			  path,
+			  g_hash_table_size (snapshot->directories));
+	return snapshot;
+
+error:
+
+	REJILLA_BURN_LOG ("Truncated snapshot %s", path);
+	rejilla_data_snapshot_free (snapshot);
+	return NULL;
+}
+
+void
+rejilla_data_snapshot_free (RejillaDataSnapshot *snapshot)
+{
+	g_hash_table_destroy (snapshot->directories);
+	g_mapped_file_unref (snapshot->file);
+	g_free (snapshot);
+}
+
+static gint64
+rejilla_data_snapshot_get_mtime (const gchar *uri)
+{
+	struct stat info;
+	gchar *path;
+	int res;
+
+	path = g_filename_from_uri (uri, NULL, NULL);
+	if (!path)
+		return -1;
+
+	res = g_stat (path, &info);
+	g_free (path);
+
+	if (res || !S_ISDIR (info.st_mode))
+		return -1;
+
+	return info.st_mtime;
+}
+
+/**
+ * rejilla_data_snapshot_take_directory:
+ * @snapshot: a #RejillaDataSnapshot
+ * @uri: the URI of a directory
+ *
+ * Returns the contents of the directory at @uri as they were recorded in
+ * @snapshot provided the directory was not modified since. The directory is
+ * then forgotten by @snapshot.
+ *
+ * Return value: a #GSList of #GFileInfo or NULL if the directory has to be
+ * explored. Free the list and unref its contents after use.
+ **/
+
+GSList *
+rejilla_data_snapshot_take_directory (RejillaDataSnapshot *snapshot,
+				      const gchar *uri)
+{
+	RejillaDataSnapshotDir *dir;
+	GSList *infos = NULL;
+	const guchar *ptr;
+	guint32 i;
+
+	dir = g_hash_table_lookup (snapshot->directories, uri);
+	if (!dir)
+		return NULL;
+
+	/* Only local directories can be checked cheaply. A directory whose
+	 * entries were added, removed or renamed has a new modification time. */
+	if (rejilla_data_snapshot_get_mtime (uri) != dir->mtime) {
+		REJILLA_BURN_LOG ("Directory %s changed since snapshot", uri);
+		g_hash_table_remove (snapshot->directories, uri);
+		return NULL;
+	}
+
+	ptr = dir->entries;
+	for (i = 0; i < dir->num; i ++) {
+		GFileInfo *info;
+		guint32 sectors;
+		guint16 len;
+		guint8 type;
+		gchar *name;
+		gchar *mime;
+
+		rejilla_data_snapshot_read (&ptr, dir->end, &type, sizeof (type));
+		rejilla_data_snapshot_read (&ptr, dir->end, &sectors, sizeof (sectors));
+		rejilla_data_snapshot_read (&ptr, dir->end, &len, sizeof (len));
+		rejilla_data_snapshot_read_string (&ptr, dir->end, GUINT16_FROM_LE (len), &name);
+		rejilla_data_snapshot_read (&ptr, dir->end, &len, sizeof (len));
+		rejilla_data_snapshot_read_string (&ptr, dir->end, GUINT16_FROM_LE (len), &mime);
+
+		info = g_file_info_new ();
+		g_file_info_set_name (info, name);
+		g_free (name);
+
+		if (type == REJILLA_DATA_SNAPSHOT_DIRECTORY)
+			g_file_info_set_file_type (info, G_FILE_TYPE_DIRECTORY);
+		else if (type == REJILLA_DATA_SNAPSHOT_SYMLINK)
+			g_file_info_set_file_type (info, G_FILE_TYPE_SYMBOLIC_LINK);
+		else
+			g_file_info_set_file_type (info, G_FILE_TYPE_REGULAR);
+
+		g_file_info_set_size (info, (goffset) GUINT32_FROM_LE (sectors) * 2048);
+		if (mime [0] != '\0')
+			g_file_info_set_content_type (info, mime);
+		g_free (mime);
+
+		infos = g_slist_prepend (infos, info);
+	}
+
+	g_hash_table_remove (snapshot->directories, uri);
+	return g_slist_reverse (infos);
+}
+
+/**
+ * Writing
+ */
+
+static void
+rejilla_data_snapshot_append_entry (GByteArray *data,
+				    RejillaFileNode *node)
+{
+	const gchar *mime;
+	guint32 sectors;
+	guint16 len;
+	guint8 type;
+
+	if (!node->is_file)
+		type = REJILLA_DATA_SNAPSHOT_DIRECTORY;
+	else if (node->is_symlink)
+		type = REJILLA_DATA_SNAPSHOT_SYMLINK;
+	else
+		type = REJILLA_DATA_SNAPSHOT_FILE;
+
+	sectors = GUINT32_TO_LE (node->is_file ? REJILLA_FILE_NODE_SECTORS (node):0);
+	g_byte_array_append (data, &type, sizeof (type));
+	g_byte_array_append (data, (guint8 *) &sectors, sizeof (sectors));
+
+	len = GUINT16_TO_LE (strlen (REJILLA_FILE_NODE_NAME (node)));
+	g_byte_array_append (data, (guint8 *) &len, sizeof (len));
+	g_byte_array_append (data, (guint8 *) REJILLA_FILE_NODE_NAME (node), GUINT16_FROM_LE (len));
+
+	mime = node->is_file ? REJILLA_FILE_NODE_MIME (node):NULL;
+	len = GUINT16_TO_LE (mime ? strlen (mime):0);
+	g_byte_array_append (data, (guint8 *) &len, sizeof (len));
+	if (mime)
+		g_byte_array_append (data, (guint8 *) mime, GUINT16_FROM_LE (len));
+}
+
+/* Tells whether all the children of a directory come from its exploration
+ * and were completely loaded */
+static gboolean
+rejilla_data_snapshot_directory_is_complete (RejillaFileNode *parent)
+{
+	RejillaFileNode *child;
+
+	if (parent->is_loading || parent->is_reloading || parent->is_exploring)
+		return FALSE;
+
+	for (child = REJILLA_FILE_NODE_CHILDREN (parent); child; child = child->next) {
+		if (child->is_loading || child->is_reloading)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void
+rejilla_data_snapshot_append_directory (RejillaDataProject *project,
+					GByteArray *data,
+					RejillaFileNode *parent)
+{
+	RejillaFileNode *child;
+	gchar *uri = NULL;
+
+	if (!parent->is_root
+	&&  !parent->is_fake
+	&&  !parent->is_imported
+	&&   rejilla_data_snapshot_directory_is_complete (parent))
+		uri = rejilla_data_project_node_to_uri (project, parent);
+
+	if (uri) {
+		gint64 mtime;
+
+		mtime = rejilla_data_snapshot_get_mtime (uri);
+		if (mtime >= 0) {
+			guint num_offset;
+			guint32 num = 0;
+			guint32 len;
+
+			len = GUINT32_TO_LE (strlen (uri));
+			g_byte_array_append (data, (guint8 *) &len, sizeof (len));
+			g_byte_array_append (data, (guint8 *) uri, strlen (uri));
+
+			mtime = GINT64_TO_LE (mtime);
+			g_byte_array_append (data, (guint8 *) &mtime, sizeof (mtime));
+
+			num_offset = data->len;
+			g_byte_array_append (data, (guint8 *) &num, sizeof (num));
+
+			/* Grafted children come from the project itself and
+			 * not from the exploration of the directory */
+			for (child = REJILLA_FILE_NODE_CHILDREN (parent); child; child = child->next) {
+				if (child->is_grafted || child->is_fake || child->is_imported)
+					continue;
+
+				rejilla_data_snapshot_append_entry (data, child);
+				num ++;
+			}
+
+			num = GUINT32_TO_LE (num);
+			memcpy (data->data + num_offset, &num, sizeof (num));
+		}
+
+		g_free (uri);
+	}
+
+	for (child = REJILLA_FILE_NODE_CHILDREN (parent); child; child = child->next) {
+		if (!child->is_file)
+			rejilla_data_snapshot_append_directory (project, data, child);
+	}
+}
+
+/**
+ * rejilla_data_snapshot_save:
+ * @project: a #RejillaDataProject
+ * @path: the path of the snapshot file
+ * @error: a #GError or NULL
+ *
+ * Records the contents of all the local directories of @project that were
+ * completely explored.
+ *
+ * Return value: FALSE if the snapshot could not be written.
+ **/
+
+gboolean
+rejilla_data_snapshot_save (RejillaDataProject *project,
+			    const gchar *path,
+			    GError **error)
+{
+	GByteArray *data;
+	gchar *directory;
+	gboolean result;
+
+	data = g_byte_array_new ();
+	g_byte_array_append (data,
+			     (guint8 *) REJILLA_DATA_SNAPSHOT_MAGIC,
+			     REJILLA_DATA_SNAPSHOT_MAGIC_LEN);
+
+	rejilla_data_snapshot_append_directory (project,
+						data,
+						rejilla_data_project_get_root (project));
+
+	directory = g_path_get_dirname (path);
+	g_mkdir_with_parents (directory, S_IRWXU);
+	g_free (directory);
+
+	result = g_file_set_contents (path,
+				      (gchar *) data->data,
+				      data->len,
+				      error);
+
+	REJILLA_BURN_LOG ("Snapshot %s saved (%u bytes)", path, data->len);
+	g_byte_array_free (data, TRUE);
+	return result;
+}
@@ -38,12 +38,14 @@
 #include <glib/gi18n-lib.h>
 
 #include "rejilla-misc.h"
+#include "rejilla-units.h"
 
 #include "rejilla-data-vfs.h"
 #include "rejilla-data-project.h"
 #include "rejilla-file-node.h"
 #include "rejilla-io.h"
 #include "rejilla-filtered-uri.h"
+#include "rejilla-data-snapshot.h"
 
 #include "librejilla-marshal.h"
 
@@ -64,11 +66,27 @@ struct _RejillaDataVFSPrivate
 	RejillaIOJobBase *load_uri;
 	RejillaIOJobBase *load_contents;
 
+	/* Directories whose contents are known from a snapshot are not
+	 * explored; their contents are added from an idle callback */
+	RejillaDataSnapshot *snapshot;
+	GSList *snapshot_dirs;
+	guint snapshot_id;
+
+	/* With lazy exploration, the subdirectories of added directories are
+	 * only explored when they are needed. In the mean time their size is
+	 * estimated by counting their contents. */
+	GSList *deferred;
+	RejillaIOJobBase *count_size;
+
+
 	GSettings *settings;
 
 	guint replace_sym:1;
 	guint filter_hidden:1;
 	guint filter_broken_sym:1;
+
+	guint lazy:1;
+	guint explore_all:1;
 };
 
 #define REJILLA_DATA_VFS_PRIVATE(o)  (G_TYPE_INSTANCE_GET_PRIVATE ((o), REJILLA_TYPE_DATA_VFS, RejillaDataVFSPrivate))
@@ -280,6 +298,9 @@ rejilla_data_vfs_directory_load_end (GObject *object,
 	rejilla_data_vfs_remove_from_hash (self, priv->directories, uri);
 	rejilla_utils_unregister_string (uri);
 
+	if (!g_hash_table_size (priv->directories))
+		priv->explore_all = FALSE;
+
 	if (cancelled)
 		return;
 
@@ -483,6 +504,134 @@ rejilla_data_vfs_directory_load_result (GObject *owner,
 	}
 }
 
+struct _RejillaDataVFSSnapshotDir {
+	gchar *uri;
+	GSList *infos;
+};
+typedef struct _RejillaDataVFSSnapshotDir RejillaDataVFSSnapshotDir;
+
+static void
+rejilla_data_vfs_snapshot_dir_free (RejillaDataVFSSnapshotDir *dir)
+{
+	g_slist_foreach (dir->infos, (GFunc) g_object_unref, NULL);
+	g_slist_free (dir->infos);
+	g_free (dir);
+}
+
+#define REJILLA_DATA_VFS_SNAPSHOT_BATCH		512
+
+static gboolean
+rejilla_data_vfs_snapshot_cb (gpointer data)
+{
+	RejillaDataVFS *self = REJILLA_DATA_VFS (data);
+	RejillaDataVFSSnapshotDir *dir;
+	RejillaDataVFSPrivate *priv;
+	GFile *parent;
+	guint num = 0;
+
+	priv = REJILLA_DATA_VFS_PRIVATE (self);
+
+	/* Add a limited number of entries each time so that the UI stays
+	 * responsive with big projects. Adding entries can queue new
+	 * directories (those that are children of the current one). */
+	while (priv->snapshot_dirs && num < REJILLA_DATA_VFS_SNAPSHOT_BATCH) {
+		dir = priv->snapshot_dirs->data;
+
+		parent = g_file_new_for_uri (dir->uri);
+		while (dir->infos && num < REJILLA_DATA_VFS_SNAPSHOT_BATCH) {
+			GFileInfo *info;
+			GFile *file;
+			gchar *uri;
+
+			info = dir->infos->data;
+			dir->infos = g_slist_delete_link (dir->infos, dir->infos);
+
+			file = g_file_get_child (parent, g_file_info_get_name (info));
+			uri = g_file_get_uri (file);
+			g_object_unref (file);
+
+			rejilla_data_vfs_directory_load_result (G_OBJECT (self),
+								NULL,
+								uri,
+								info,
+								dir->uri);
+			g_object_unref (info);
+			g_free (uri);
+			num ++;
+		}
+		g_object_unref (parent);
+
+		if (dir->infos)
+			break;
+
+		priv->snapshot_dirs = g_slist_remove (priv->snapshot_dirs, dir);
+		rejilla_data_vfs_directory_load_end (G_OBJECT (self),
+						     FALSE,
+						     dir->uri);
+		rejilla_data_vfs_snapshot_dir_free (dir);
+	}
+
+	if (priv->snapshot_dirs)
+		return TRUE;
+
+	priv->snapshot_id = 0;
+	return FALSE;
+}
+
+static gboolean
+rejilla_data_vfs_load_directory_from_snapshot (RejillaDataVFS *self,
+					       gchar *registered)
+{
+	RejillaDataVFSSnapshotDir *dir;
+	RejillaDataVFSPrivate *priv;
+	GSList *infos;
+
+	priv = REJILLA_DATA_VFS_PRIVATE (self);
+	if (!priv->snapshot)
+		return FALSE;
+
+	infos = rejilla_data_snapshot_take_directory (priv->snapshot, registered);
+	if (!infos)
+		return FALSE;
+
+	REJILLA_BURN_LOG ("Contents of %s taken from snapshot", registered);
+
+	dir = g_new0 (RejillaDataVFSSnapshotDir, 1);
+	dir->uri = registered;
+	dir->infos = infos;
+
+	/* Append so that directories are added in the order they were
+	 * requested as it is the case with rejilla-io */
+	priv->snapshot_dirs = g_slist_append (priv->snapshot_dirs, dir);
+	if (!priv->snapshot_id)
+		priv->snapshot_id = g_idle_add (rejilla_data_vfs_snapshot_cb, self);
+
+	return TRUE;
+}
+
+/**
+ * rejilla_data_vfs_set_snapshot:
+ * @vfs: a #RejillaDataVFS
+ * @snapshot: a #RejillaDataSnapshot or NULL
+ *
+ * Sets the snapshot used to add the contents of directories without
+ * exploring them. @vfs takes ownership of @snapshot.
+ **/
+
+void
+rejilla_data_vfs_set_snapshot (RejillaDataVFS *vfs,
+			       RejillaDataSnapshot *snapshot)
+{
+	RejillaDataVFSPrivate *priv;
+
+	priv = REJILLA_DATA_VFS_PRIVATE (vfs);
+
+	if (priv->snapshot)
+		rejilla_data_snapshot_free (priv->snapshot);
+
+	priv->snapshot = snapshot;
+}
+
 static gboolean
 rejilla_data_vfs_load_directory (RejillaDataVFS *self,
 				 RejillaFileNode *node,
@@ -511,6 +660,9 @@ rejilla_data_vfs_load_directory (RejillaDataVFS *self,
 			     registered,
 			     g_slist_prepend (NULL, GINT_TO_POINTER (reference)));
 
+	if (rejilla_data_vfs_load_directory_from_snapshot (self, registered))
+		goto end;
+
 	if (!priv->load_contents)
 		priv->load_contents = rejilla_io_register (G_OBJECT (self),
 							   rejilla_data_vfs_directory_load_result,
@@ -524,6 +676,8 @@ rejilla_data_vfs_load_directory (RejillaDataVFS *self,
 				  (priv->replace_sym ? REJILLA_IO_INFO_FOLLOW_SYMLINK:REJILLA_IO_INFO_NONE),
 				   registered);
 
+end:
+
 	/* Only emit a signal if state changed. Some widgets need to know if 
 	 * either directories loading or uri loading state has changed to signal
 	 * it even if there were some uri loading. */
@@ -787,6 +941,151 @@ rejilla_data_vfs_loading_node (RejillaDataVFS *self,
 					   uri);
 }
 
+/**
+ * Lazy exploration
+ */
+
+static void
+rejilla_data_vfs_count_size_result (GObject *owner,
+				    GError *error,
+				    const gchar *uri,
+				    GFileInfo *info,
+				    gpointer data)
+{
+	RejillaDataVFS *self = REJILLA_DATA_VFS (owner);
+	RejillaFileNode *node;
+	guint64 sectors;
+
+	if (error || !info)
+		return;
+
+	/* The directory may have been explored in the mean time */
+	node = rejilla_data_project_reference_get (REJILLA_DATA_PROJECT (self), GPOINTER_TO_INT (data));
+	if (!node || !node->is_deferred)
+		return;
+
+	/* Each file is padded to a whole sector; count half a sector for
+	 * each of them on average */
+	sectors = REJILLA_BYTES_TO_SECTORS (g_file_info_get_attribute_uint64 (info, REJILLA_IO_COUNT_SIZE), 2048);
+	sectors += g_file_info_get_attribute_uint32 (info, REJILLA_IO_COUNT_NUM) / 2;
+
+	REJILLA_BURN_LOG ("Estimated size of deferred directory %s: %" G_GUINT64_FORMAT " sectors",
+			  REJILLA_FILE_NODE_NAME (node),
+			  sectors);
+	rejilla_data_project_directory_node_estimated (REJILLA_DATA_PROJECT (self),
+						       node,
+						       sectors);
+}
+
+static void
+rejilla_data_vfs_count_size_end (GObject *object,
+				 gboolean cancelled,
+				 gpointer data)
+{
+	rejilla_data_project_reference_free (REJILLA_DATA_PROJECT (object), GPOINTER_TO_INT (data));
+}
+
+static void
+rejilla_data_vfs_defer_directory (RejillaDataVFS *self,
+				  RejillaFileNode *node,
+				  const gchar *uri)
+{
+	RejillaDataVFSPrivate *priv;
+	guint reference;
+	GSList *uris;
+
+	priv = REJILLA_DATA_VFS_PRIVATE (self);
+
+	/* NOTE: the node stays is_exploring so that it is displayed as loading
+	 * until it is explored */
+	node->is_deferred = TRUE;
+	reference = rejilla_data_project_reference_new (REJILLA_DATA_PROJECT (self), node);
+	priv->deferred = g_slist_prepend (priv->deferred, GINT_TO_POINTER (reference));
+
+	if (!priv->count_size)
+		priv->count_size = rejilla_io_register (G_OBJECT (self),
+							rejilla_data_vfs_count_size_result,
+							rejilla_data_vfs_count_size_end,
+							NULL);
+
+	/* Symlinks are not followed here to avoid loops; the estimate is a
+	 * little lower than the real size in this case. Explorations come
+	 * first. */
+	reference = rejilla_data_project_reference_new (REJILLA_DATA_PROJECT (self), node);
+	uris = g_slist_prepend (NULL, (gchar *) uri);
+	rejilla_io_get_file_count (uris,
+				   priv->count_size,
+				   REJILLA_IO_INFO_RECURSIVE|
+				   REJILLA_IO_INFO_IDLE,
+				   GINT_TO_POINTER (reference));
+	g_slist_free (uris);
+}
+
+static void
+rejilla_data_vfs_explore_deferred (RejillaDataVFS *self,
+				   RejillaFileNode *node)
+{
+	gchar *uri;
+
+	node->is_deferred = FALSE;
+
+	/* Remove the estimate; its contents will be added with their size */
+	rejilla_data_project_directory_node_estimated (REJILLA_DATA_PROJECT (self),
+						       node,
+						       0);
+
+	uri = rejilla_data_project_node_to_uri (REJILLA_DATA_PROJECT (self), node);
+	rejilla_data_vfs_load_directory (self, node, uri);
+	g_free (uri);
+}
+
+/**
+ * rejilla_data_vfs_load_deferred:
+ * @vfs: a #RejillaDataVFS
+ *
+ * Explores all the directories whose exploration was put off as well as all
+ * their subdirectories.
+ *
+ * Return value: TRUE if some directories are going to be explored.
+ **/
+
+gboolean
+rejilla_data_vfs_load_deferred (RejillaDataVFS *self)
+{
+	RejillaDataVFSPrivate *priv;
+	gboolean result = FALSE;
+	GSList *deferred;
+	GSList *iter;
+
+	priv = REJILLA_DATA_VFS_PRIVATE (self);
+
+	deferred = priv->deferred;
+	priv->deferred = NULL;
+
+	/* Don't put off any exploration until all directories are loaded */
+	priv->explore_all = TRUE;
+	for (iter = deferred; iter; iter = iter->next) {
+		RejillaFileNode *node;
+		guint reference;
+
+		reference = GPOINTER_TO_INT (iter->data);
+		node = rejilla_data_project_reference_get (REJILLA_DATA_PROJECT (self), reference);
+		rejilla_data_project_reference_free (REJILLA_DATA_PROJECT (self), reference);
+
+		if (!node || !node->is_deferred)
+			continue;
+
+		rejilla_data_vfs_explore_deferred (self, node);
+		result = TRUE;
+	}
+	g_slist_free (deferred);
+
+	if (!g_hash_table_size (priv->directories))
+		priv->explore_all = FALSE;
+
+	return result;
+}
+
 static gboolean
 rejilla_data_vfs_increase_priority_cb (gpointer data, gpointer user_data)
 {
@@ -823,6 +1122,12 @@ rejilla_data_vfs_require_directory_contents (RejillaDataVFS *self,
 	RejillaDataVFSPrivate *priv;
 
 	priv = REJILLA_DATA_VFS_PRIVATE (self);
+
+	if (node->is_deferred) {
+		rejilla_data_vfs_explore_deferred (self, node);
+		return TRUE;
+	}
+
 	return rejilla_data_vfs_require_higher_priority (self,
 							 node,
 							 priv->load_contents);
@@ -943,7 +1248,12 @@ rejilla_data_vfs_node_added (RejillaDataProject *project,
 	if (node->is_file)
 		goto chain;
 
-	rejilla_data_vfs_load_directory (self, node, uri);
+	/* Only the directories that were added by the user are explored
+	 * right away with lazy exploration. */
+	if (priv->lazy && !priv->explore_all)
+		rejilla_data_vfs_defer_directory (self, node, uri);
+	else
+		rejilla_data_vfs_load_directory (self, node, uri);
 
 chain:
 	/* chain up this function except if we invalidated the node */
@@ -973,6 +1283,14 @@ rejilla_data_vfs_empty_loading_cb (gpointer key,
 	return TRUE;
 }
 
+static void
+rejilla_data_vfs_free_reference_cb (gpointer data,
+				    gpointer callback_data)
+{
+	rejilla_data_project_reference_free (REJILLA_DATA_PROJECT (callback_data),
+					     GPOINTER_TO_INT (data));
+}
+
 static void
 rejilla_data_vfs_clear (RejillaDataVFS *self)
 {
@@ -993,6 +1311,27 @@ rejilla_data_vfs_clear (RejillaDataVFS *self)
 		priv->load_contents = NULL;
 	}
 
+	if (priv->count_size) {
+		rejilla_io_cancel_by_base (priv->count_size);
+		rejilla_io_job_base_free (priv->count_size);
+		priv->count_size = NULL;
+	}
+
+	g_slist_foreach (priv->deferred, (GFunc) rejilla_data_vfs_free_reference_cb, self);
+	g_slist_free (priv->deferred);
+	priv->deferred = NULL;
+	priv->explore_all = FALSE;
+
+	/* The registered URIs are released with the hash table below */
+	if (priv->snapshot_id) {
+		g_source_remove (priv->snapshot_id);
+		priv->snapshot_id = 0;
+	}
+
+	g_slist_foreach (priv->snapshot_dirs, (GFunc) rejilla_data_vfs_snapshot_dir_free, NULL);
+	g_slist_free (priv->snapshot_dirs);
+	priv->snapshot_dirs = NULL;
+
 	/* Empty the hash tables */
 	g_hash_table_foreach_remove (priv->loading,
 				     rejilla_data_vfs_empty_loading_cb,
@@ -1044,6 +1383,8 @@ rejilla_data_vfs_settings_changed (GSettings *settings,
 		priv->filter_broken_sym = g_settings_get_boolean (settings, REJILLA_PROPS_FILTER_BROKEN);
 	if (g_strcmp0 (key, REJILLA_PROPS_FILTER_HIDDEN))
 		priv->filter_hidden = g_settings_get_boolean (settings, REJILLA_PROPS_FILTER_HIDDEN);
+	if (!g_strcmp0 (key, REJILLA_PROPS_LAZY_EXPLORATION))
+		priv->lazy = g_settings_get_boolean (settings, REJILLA_PROPS_LAZY_EXPLORATION);
 }
 
 static void
@@ -1060,6 +1401,7 @@ rejilla_data_vfs_init (RejillaDataVFS *object)
 	priv->replace_sym = g_settings_get_boolean (priv->settings, REJILLA_PROPS_FILTER_REPLACE_SYMLINK);
 	priv->filter_broken_sym = g_settings_get_boolean (priv->settings, REJILLA_PROPS_FILTER_BROKEN);
 	priv->filter_hidden = g_settings_get_boolean (priv->settings, REJILLA_PROPS_FILTER_HIDDEN);
+	priv->lazy = g_settings_get_boolean (priv->settings, REJILLA_PROPS_LAZY_EXPLORATION);
 	g_signal_connect (priv->settings,
 	                  "changed",
 	                  G_CALLBACK (rejilla_data_vfs_settings_changed),
@@ -1094,6 +1436,11 @@ rejilla_data_vfs_finalize (GObject *object)
 		priv->filtered = NULL;
 	}
 
+	if (priv->snapshot) {
+		rejilla_data_snapshot_free (priv->snapshot);
+		priv->snapshot = NULL;
+	}
+
 	if (priv->settings) {
 		g_object_unref (priv->settings);
 		priv->settings = NULL;
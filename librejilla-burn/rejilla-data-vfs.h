@@ -36,6 +36,7 @@
 
 #include "rejilla-data-session.h"
 #include "rejilla-filtered-uri.h"
+#include "rejilla-data-snapshot.h"
 
 G_BEGIN_DECLS
 
@@ -43,6 +44,7 @@ G_BEGIN_DECLS
 #define REJILLA_PROPS_FILTER_HIDDEN	        "hidden"
 #define REJILLA_PROPS_FILTER_BROKEN	        "broken-sym"
 #define REJILLA_PROPS_FILTER_REPLACE_SYMLINK    "replace-sym"
+#define REJILLA_PROPS_LAZY_EXPLORATION		"lazy-exploration"
 
 #define REJILLA_TYPE_DATA_VFS             (rejilla_data_vfs_get_type ())
 #define REJILLA_DATA_VFS(obj)             (G_TYPE_CHECK_INSTANCE_CAST ((obj), REJILLA_TYPE_DATA_VFS, RejillaDataVFS))
@@ -90,6 +92,13 @@ rejilla_data_vfs_require_directory_contents (RejillaDataVFS *vfs,
 RejillaFilteredUri *
 rejilla_data_vfs_get_filtered_model (RejillaDataVFS *vfs);
 
+gboolean
+rejilla_data_vfs_load_deferred (RejillaDataVFS *vfs);
+
+void
+rejilla_data_vfs_set_snapshot (RejillaDataVFS *vfs,
+			       RejillaDataSnapshot *snapshot);
+
 G_END_DECLS
 
 #endif /* _REJILLA_DATA_VFS_H_ */
@@ -49,6 +49,7 @@
 
 #include "burn-basics.h"
 #include "burn-debug.h"
+#include "rejilla-tags.h"
 #include "rejilla-drive-properties.h"
 
 typedef struct _RejillaDrivePropertiesPrivate RejillaDrivePropertiesPrivate;
@@ -63,6 +64,7 @@ struct _RejillaDrivePropertiesPrivate
 	GtkWidget *multi;
 	GtkWidget *burnproof;
 	GtkWidget *notmp;
+	GtkWidget *verify;
 
 	GtkWidget *tmpdir;
 };
@@ -99,6 +101,23 @@ rejilla_drive_properties_no_tmp_toggled (GtkToggleButton *button,
 						  REJILLA_BURN_FLAG_NO_TMP_FILES);
 }
 
+static void
+rejilla_drive_properties_verify_toggled (GtkToggleButton *button,
+					 RejillaDriveProperties *self)
+{
+	RejillaDrivePropertiesPrivate *priv;
+
+	priv = REJILLA_DRIVE_PROPERTIES_PRIVATE (self);
+
+	if (gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (priv->verify)))
+		rejilla_burn_session_tag_add_int (REJILLA_BURN_SESSION (priv->session),
+						  REJILLA_SESSION_VERIFY_WHILE_WRITING,
+						  TRUE);
+	else
+		rejilla_burn_session_tag_remove (REJILLA_BURN_SESSION (priv->session),
+						 REJILLA_SESSION_VERIFY_WHILE_WRITING);
+}
+
 static void
 rejilla_drive_properties_dummy_toggled (GtkToggleButton *button,
 					RejillaDriveProperties *self)
@@ -509,7 +528,7 @@ rejilla_drive_properties_rate_changed_cb (GtkComboBox *combo,
 					  RejillaDriveProperties *self)
 {
 	RejillaDrivePropertiesPrivate *priv;
-	guint64 rate;
+	gint64 rate;
 
 	priv = REJILLA_DRIVE_PROPERTIES_PRIVATE (self);
 
@@ -517,6 +536,16 @@ rejilla_drive_properties_rate_changed_cb (GtkComboBox *combo,
 	if (!rate)
 		return;
 
+	/* Automatic speed is chosen when recording from previous results */
+	if (rate < 0) {
+		rejilla_burn_session_tag_add_int (REJILLA_BURN_SESSION (priv->session),
+						  REJILLA_SESSION_AUTO_WRITE_STRATEGY,
+						  TRUE);
+		return;
+	}
+
+	rejilla_burn_session_tag_remove (REJILLA_BURN_SESSION (priv->session),
+					 REJILLA_SESSION_AUTO_WRITE_STRATEGY);
 	rejilla_burn_session_set_rate (REJILLA_BURN_SESSION (priv->session), rate);
 }
 
@@ -552,7 +581,8 @@ rejilla_drive_properties_format_disc_speed (RejillaMedia media,
 static void
 rejilla_drive_properties_set_drive (RejillaDriveProperties *self,
 				    RejillaDrive *drive,
-				    gint64 default_rate)
+				    gint64 default_rate,
+				    gboolean automatic)
 {
 	RejillaDrivePropertiesPrivate *priv;
 	RejillaMedium *medium;
@@ -586,6 +616,15 @@ rejilla_drive_properties_set_drive (RejillaDriveProperties *self,
 		return;
 	}
 
+	gtk_list_store_append (GTK_LIST_STORE (model), &iter);
+	gtk_list_store_set (GTK_LIST_STORE (model), &iter,
+			    TEXT_COL, _("Automatic"),
+			    RATE_COL, (gint64) -1,
+			    -1);
+
+	if (automatic)
+		gtk_combo_box_set_active_iter (GTK_COMBO_BOX (priv->speed), &iter);
+
 	gtk_list_store_append (GTK_LIST_STORE (model), &iter);
 	gtk_list_store_set (GTK_LIST_STORE (model), &iter,
 			    TEXT_COL, _("Maximum speed"),
@@ -604,6 +643,9 @@ rejilla_drive_properties_set_drive (RejillaDriveProperties *self,
 	}
 	g_free (rates);
 
+	if (automatic)
+		return;
+
 	/* Set active one preferably max speed */
 	gtk_tree_model_get_iter_first (model, &iter);
 	do {
@@ -639,7 +681,13 @@ rejilla_drive_properties_update (RejillaDriveProperties *self)
 	priv = REJILLA_DRIVE_PROPERTIES_PRIVATE (self);
 	rejilla_drive_properties_set_drive (self,
 					    rejilla_burn_session_get_burner (REJILLA_BURN_SESSION (priv->session)),
-					    rejilla_burn_session_get_rate (REJILLA_BURN_SESSION (priv->session)));
+					    rejilla_burn_session_get_rate (REJILLA_BURN_SESSION (priv->session)),
+					    rejilla_burn_session_tag_lookup_int (REJILLA_BURN_SESSION (priv->session),
+										 REJILLA_SESSION_AUTO_WRITE_STRATEGY));
+
+	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (priv->verify),
+				      rejilla_burn_session_tag_lookup_int (REJILLA_BURN_SESSION (priv->session),
+									   REJILLA_SESSION_VERIFY_WHILE_WRITING));
 
 	flags = rejilla_burn_session_get_flags (REJILLA_BURN_SESSION (priv->session));
 	rejilla_burn_session_get_burn_flags (REJILLA_BURN_SESSION (priv->session),
@@ -686,7 +734,9 @@ rejilla_drive_properties_output_changed_cb (RejillaSessionCfg *session,
 	 * why we don't do it when the is-valid signal is emitted. */
 	rejilla_drive_properties_set_drive (self,
 					    rejilla_burn_session_get_burner (REJILLA_BURN_SESSION (priv->session)),
-					    rejilla_burn_session_get_rate (REJILLA_BURN_SESSION (priv->session)));
+					    rejilla_burn_session_get_rate (REJILLA_BURN_SESSION (priv->session)),
+					    rejilla_burn_session_tag_lookup_int (REJILLA_BURN_SESSION (priv->session),
+										 REJILLA_SESSION_AUTO_WRITE_STRATEGY));
 }
 
 static void
@@ -737,6 +787,9 @@ rejilla_drive_properties_init (RejillaDriveProperties *object)
 	priv->multi = gtk_check_button_new_with_mnemonic (_("Leave the disc _open to add other files later"));
 	gtk_widget_set_tooltip_text (priv->multi, _("Allow to add more data to the disc later"));
 	gtk_widget_show (priv->multi);
+	priv->verify = gtk_check_button_new_with_mnemonic (_("_Verify the disc while burning"));
+	gtk_widget_set_tooltip_text (priv->verify, _("Compare what is already burnt with the image while burning goes on, if the drive allows it"));
+	gtk_widget_show (priv->verify);
 
 	g_signal_connect (priv->dummy,
 			  "toggled",
@@ -754,6 +807,10 @@ rejilla_drive_properties_init (RejillaDriveProperties *object)
 			  "toggled",
 			  G_CALLBACK (rejilla_drive_properties_no_tmp_toggled),
 			  object);
+	g_signal_connect (priv->verify,
+			  "toggled",
+			  G_CALLBACK (rejilla_drive_properties_verify_toggled),
+			  object);
 
 	string = g_strdup_printf ("<b>%s</b>", _("Options"));
 	gtk_box_pack_start (GTK_BOX (vbox),
@@ -762,6 +819,7 @@ rejilla_drive_properties_init (RejillaDriveProperties *object)
 							   priv->burnproof,
 							   priv->multi,
 							   priv->notmp,
+							   priv->verify,
 							   NULL),
 			    FALSE,
 			    FALSE, 0);
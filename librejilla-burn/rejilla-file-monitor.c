@@ -34,9 +34,11 @@
 
 #include <string.h>
 #include <errno.h>
+#include <sys/stat.h>
 
 #include <glib.h>
 #include <glib/gi18n-lib.h>
+#include <glib/gstdio.h>
 
 #include <sys/inotify.h>
 
@@ -59,6 +61,13 @@ struct _RejillaFileMonitorPrivate
 
 	/* This is used in the case of a MOVE_FROM event */
 	GSList *moved_list;
+
+	/* Files/directories that we could not afford a watch for. They
+	 * are checked against their last modification time instead. */
+	GSList *unwatched;
+	guint max_watches;
+
+	guint revalidating:1;
 };
 
 #define REJILLA_FILE_MONITOR_PRIVATE(o)  (G_TYPE_INSTANCE_GET_PRIVATE ((o), REJILLA_TYPE_FILE_MONITOR, RejillaFileMonitorPrivate))
@@ -96,6 +105,17 @@ struct _RejillaFileMonitorSearchResult {
 };
 typedef struct _RejillaFileMonitorSearchResult RejillaFileMonitorSearchResult;
 
+struct _RejillaFileMonitorUnwatched {
+	RejillaFileMonitorType type;
+	gpointer callback_data;
+	gchar *path;
+	time_t mtime;
+};
+typedef struct _RejillaFileMonitorUnwatched RejillaFileMonitorUnwatched;
+
+/* Used when the limit cannot be read from /proc */
+#define REJILLA_FILE_MONITOR_DEFAULT_MAX_WATCHES	8192
+
 static void
 rejilla_inotify_file_data_free (RejillaInotifyFileData *data)
 {
@@ -103,6 +123,13 @@ rejilla_inotify_file_data_free (RejillaInotifyFileData *data)
 	g_free (data);
 }
 
+static void
+rejilla_file_monitor_unwatched_free (RejillaFileMonitorUnwatched *unwatched)
+{
+	g_free (unwatched->path);
+	g_free (unwatched);
+}
+
 static void
 rejilla_file_monitor_moved_to_event (RejillaFileMonitor *self,
 				     gpointer callback_data,
@@ -593,6 +620,11 @@ rejilla_file_monitor_start_monitoring_real (RejillaFileMonitor *self,
 
 	priv = REJILLA_FILE_MONITOR_PRIVATE (self);
 
+	/* Every watch costs kernel memory and their number is limited
+	 * for each user. Past our share, don't even try. */
+	if (g_hash_table_size (priv->files) + g_hash_table_size (priv->directories) >= priv->max_watches)
+		return 0;
+
 	unescaped_uri = g_uri_unescape_string (uri, NULL);
 	path = g_filename_from_uri (unescaped_uri, NULL, NULL);
 	g_free (unescaped_uri);
@@ -613,6 +645,12 @@ rejilla_file_monitor_start_monitoring_real (RejillaFileMonitor *self,
 		REJILLA_BURN_LOG ("ERROR creating watch for local file %s : %s\n",
 				  path,
 				  g_strerror (errno));
+
+		/* The system limit was reached before ours; lower ours */
+		if (errno == ENOSPC)
+			priv->max_watches = g_hash_table_size (priv->files) +
+					    g_hash_table_size (priv->directories);
+
 		g_free (path);
 		return 0;
 	}
@@ -621,6 +659,34 @@ rejilla_file_monitor_start_monitoring_real (RejillaFileMonitor *self,
 	return wd;
 }
 
+static void
+rejilla_file_monitor_add_unwatched (RejillaFileMonitor *self,
+				    RejillaFileMonitorType type,
+				    const gchar *uri,
+				    gpointer callback_data)
+{
+	RejillaFileMonitorUnwatched *unwatched;
+	RejillaFileMonitorPrivate *priv;
+	struct stat buffer;
+	gchar *path;
+
+	priv = REJILLA_FILE_MONITOR_PRIVATE (self);
+
+	path = g_filename_from_uri (uri, NULL, NULL);
+	if (!path)
+		return;
+
+	unwatched = g_new0 (RejillaFileMonitorUnwatched, 1);
+	unwatched->type = type;
+	unwatched->callback_data = callback_data;
+	unwatched->path = path;
+	if (!g_stat (path, &buffer))
+		unwatched->mtime = buffer.st_mtime;
+
+	priv->unwatched = g_slist_prepend (priv->unwatched, unwatched);
+	REJILLA_BURN_LOG ("File Monitoring (no watch left for %s)", path);
+}
+
 /**
  * This is used for top grafted directories in the hierarchies or for
  * single grafted files whose parents are not watched and for which we
@@ -648,8 +714,13 @@ rejilla_file_monitor_single_file (RejillaFileMonitor *self,
 	wd = rejilla_file_monitor_start_monitoring_real (self, parent);
 	g_free (parent);
 
-	if (!wd)
+	if (!wd) {
+		rejilla_file_monitor_add_unwatched (self,
+						    REJILLA_FILE_MONITOR_FILE,
+						    uri,
+						    callback_data);
 		return FALSE;
+	}
 
 	/* Since we monitor the parent, put that into a special table */
 	data = g_new0 (RejillaInotifyFileData, 1);
@@ -690,8 +761,13 @@ rejilla_file_monitor_directory_contents (RejillaFileMonitor *self,
 	 * directory to find it more easily and mark it as being watched */
 	wd = rejilla_file_monitor_start_monitoring_real (self, uri);
 
-	if (!wd)
+	if (!wd) {
+		rejilla_file_monitor_add_unwatched (self,
+						    REJILLA_FILE_MONITOR_FOLDER,
+						    uri,
+						    callback_data);
 		return FALSE;
+	}
 
 	g_hash_table_insert (priv->directories,
 			     GINT_TO_POINTER (wd),
@@ -803,6 +879,27 @@ rejilla_file_monitor_foreach_cancel (RejillaFileMonitor *self,
 			g_free (data);
 		}
 	}
+
+	for (iter = priv->unwatched; iter; iter = next) {
+		RejillaFileMonitorUnwatched *unwatched;
+
+		unwatched = iter->data;
+		next = iter->next;
+		if (!unwatched->callback_data)
+			continue;
+
+		if (!func (unwatched->callback_data, callback_data))
+			continue;
+
+		if (priv->revalidating) {
+			/* rejilla_file_monitor_revalidate () will free it */
+			unwatched->callback_data = NULL;
+			continue;
+		}
+
+		priv->unwatched = g_slist_remove (priv->unwatched, unwatched);
+		rejilla_file_monitor_unwatched_free (unwatched);
+	}
 }
 
 static gboolean
@@ -846,12 +943,95 @@ rejilla_file_monitor_reset (RejillaFileMonitor *self)
 	g_hash_table_foreach_remove (priv->directories,
 				     rejilla_file_monitor_foreach_directory_reset_cb,
 				     GINT_TO_POINTER (g_io_channel_unix_get_fd (priv->notify)));
+
+	g_slist_foreach (priv->unwatched, (GFunc) rejilla_file_monitor_unwatched_free, NULL);
+	g_slist_free (priv->unwatched);
+	priv->unwatched = NULL;
+}
+
+/**
+ * Check all that we could not watch for changes that would have
+ * escaped us. Directories are only checked through their modification
+ * time (which changes when an entry is added, removed or renamed) and
+ * are then handed back to the class for a comparison of their contents.
+ */
+void
+rejilla_file_monitor_revalidate (RejillaFileMonitor *self)
+{
+	RejillaFileMonitorPrivate *priv;
+	RejillaFileMonitorClass *klass;
+	GSList *unwatched;
+	GSList *iter;
+
+	priv = REJILLA_FILE_MONITOR_PRIVATE (self);
+	klass = REJILLA_FILE_MONITOR_GET_CLASS (self);
+
+	/* Handlers may remove nodes and therefore cancel entries while we
+	 * go through the list. Those are only marked until we are done. */
+	priv->revalidating = TRUE;
+
+	for (iter = priv->unwatched; iter; iter = iter->next) {
+		RejillaFileMonitorUnwatched *data;
+		struct stat buffer;
+
+		data = iter->data;
+		if (!data->callback_data)
+			continue;
+
+		if (g_stat (data->path, &buffer)) {
+			gpointer callback_data;
+
+			REJILLA_BURN_LOG ("File Monitoring (unwatched %s was removed)", data->path);
+
+			callback_data = data->callback_data;
+			data->callback_data = NULL;
+
+			/* Directories have a FILE entry as well if grafted */
+			if (data->type == REJILLA_FILE_MONITOR_FILE
+			&&  klass->file_removed)
+				klass->file_removed (self,
+						     REJILLA_FILE_MONITOR_FILE,
+						     callback_data,
+						     NULL);
+			continue;
+		}
+
+		if (buffer.st_mtime == data->mtime)
+			continue;
+
+		REJILLA_BURN_LOG ("File Monitoring (unwatched %s changed)", data->path);
+		data->mtime = buffer.st_mtime;
+
+		if (data->type == REJILLA_FILE_MONITOR_FILE) {
+			if (klass->file_modified)
+				klass->file_modified (self, data->callback_data, NULL);
+		}
+		else if (klass->directory_changed)
+			klass->directory_changed (self, data->callback_data);
+	}
+
+	priv->revalidating = FALSE;
+
+	/* Now get rid of those that were removed or cancelled */
+	unwatched = priv->unwatched;
+	priv->unwatched = NULL;
+	for (iter = unwatched; iter; iter = iter->next) {
+		RejillaFileMonitorUnwatched *data;
+
+		data = iter->data;
+		if (data->callback_data)
+			priv->unwatched = g_slist_prepend (priv->unwatched, data);
+		else
+			rejilla_file_monitor_unwatched_free (data);
+	}
+	g_slist_free (unwatched);
 }
 
 static void
 rejilla_file_monitor_init (RejillaFileMonitor *object)
 {
 	RejillaFileMonitorPrivate *priv;
+	gchar *contents;
 	int fd;
 
 	priv = REJILLA_FILE_MONITOR_PRIVATE (object);
@@ -859,6 +1039,20 @@ rejilla_file_monitor_init (RejillaFileMonitor *object)
 	priv->files = g_hash_table_new (g_direct_hash, g_direct_equal);
 	priv->directories = g_hash_table_new (g_direct_hash, g_direct_equal);
 
+	/* The limit is shared by all applications run by the user so
+	 * don't use more than half of it. */
+	priv->max_watches = REJILLA_FILE_MONITOR_DEFAULT_MAX_WATCHES;
+	if (g_file_get_contents ("/proc/sys/fs/inotify/max_user_watches", &contents, NULL, NULL)) {
+		guint64 limit;
+
+		limit = g_ascii_strtoull (contents, NULL, 10);
+		if (limit)
+			priv->max_watches = MIN (limit, G_MAXUINT);
+
+		g_free (contents);
+	}
+	priv->max_watches /= 2;
+
 	/* start inotify monitoring backend */
 	fd = inotify_init ();
 	if (fd != -1) {
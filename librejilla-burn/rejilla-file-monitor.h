@@ -82,6 +82,11 @@ struct _RejillaFileMonitorClass
 	void		(*file_modified)	(RejillaFileMonitor *monitor,
 						 gpointer callback_data,
 						 const gchar *name);
+
+	/* Only for directories that could not be watched; the contents
+	 * changed in a way we can't know. */
+	void		(*directory_changed)	(RejillaFileMonitor *monitor,
+						 gpointer callback_data);
 };
 
 struct _RejillaFileMonitor
@@ -102,6 +107,9 @@ rejilla_file_monitor_directory_contents (RejillaFileMonitor *monitor,
 void
 rejilla_file_monitor_reset (RejillaFileMonitor *monitor);
 
+void
+rejilla_file_monitor_revalidate (RejillaFileMonitor *monitor);
+
 void
 rejilla_file_monitor_foreach_cancel (RejillaFileMonitor *self,
 				     RejillaMonitorFindFunc func,
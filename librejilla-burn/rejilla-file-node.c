@@ -41,6 +41,7 @@
 #include "burn-basics.h"
 
 #include "rejilla-file-node.h"
+#include "rejilla-iso-size.h"
 #include "rejilla-io.h"
 
 
@@ -54,9 +55,21 @@ rejilla_file_node_root_new (void)
 	root->is_imported = TRUE;
 
 	root->union3.stats = g_new0 (RejillaFileTreeStats, 1);
+	root->union3.stats->iso_size = rejilla_iso_size_new ();
 	return root;
 }
 
+static void
+rejilla_file_node_iso_size_changed (RejillaFileNode *node)
+{
+	RejillaFileNode *root;
+
+	/* Only when it is in a tree */
+	root = rejilla_file_node_get_root (node, NULL);
+	if (root)
+		rejilla_iso_size_changed (REJILLA_FILE_NODE_STATS (root)->iso_size, node);
+}
+
 RejillaFileNode *
 rejilla_file_node_get_root (RejillaFileNode *node,
 			    guint *depth_retval)
@@ -711,6 +724,9 @@ rejilla_file_node_graft (RejillaFileNode *file_node,
 
 	graft->node = uri_node;
 	uri_node->nodes = g_slist_prepend (uri_node->nodes, file_node);
+
+	if (file_node->parent)
+		rejilla_file_node_iso_size_changed (file_node->parent);
 }
 
 void
@@ -741,6 +757,9 @@ rejilla_file_node_ungraft (RejillaFileNode *node)
 		if (parent->is_grafted)
 			break;
 	}
+
+	if (node->parent)
+		rejilla_file_node_iso_size_changed (node->parent);
 }
 
 void
@@ -752,6 +771,9 @@ rejilla_file_node_rename (RejillaFileNode *node,
 		node->union1.graft->name = g_strdup (name);
 	else
 		node->union1.name = g_strdup (name);
+
+	if (node->parent)
+		rejilla_file_node_iso_size_changed (node->parent);
 }
 
 void
@@ -772,6 +794,9 @@ rejilla_file_node_add (RejillaFileNode *parent,
 		return;
 
 	stats = rejilla_file_node_get_tree_stats (node->parent, &depth);
+	rejilla_iso_size_changed (stats->iso_size, parent);
+	rejilla_iso_size_changed (stats->iso_size, node);
+
 	if (!node->is_imported) {
 		/* book keeping */
 		if (!node->is_file)
@@ -845,6 +870,16 @@ rejilla_file_node_set_from_info (RejillaFileNode *node,
 	node->is_reloading = FALSE;
 	node->is_symlink = (g_file_info_get_file_type (info) == G_FILE_TYPE_SYMBOLIC_LINK);
 
+	if (stats) {
+		if (node->is_file)
+			rejilla_iso_size_removed (stats->iso_size, node);
+		else
+			rejilla_iso_size_changed (stats->iso_size, node);
+
+		if (node->parent)
+			rejilla_iso_size_changed (stats->iso_size, node->parent);
+	}
+
 	if (node->is_file) {
 		guint sectors;
 		gint sectors_diff;
@@ -970,6 +1005,8 @@ rejilla_file_node_unlink (RejillaFileNode *node)
 	if (!node->parent)
 		return;
 
+	rejilla_file_node_iso_size_changed (node->parent);
+
 	iter = REJILLA_FILE_NODE_CHILDREN (node->parent);
 
 	/* handle the size change for previous parent */
@@ -1077,6 +1114,8 @@ rejilla_file_node_move_to (RejillaFileNode *node,
 	/* NOTE: here stats about the tree can change if the parent has a depth
 	 * > 6 and if previous didn't. Other stats remains unmodified. */
 	stats = rejilla_file_node_get_tree_stats (node->parent, &depth);
+	rejilla_iso_size_changed (stats->iso_size, parent);
+
 	if (node->is_file) {
 		if (depth < 6)
 			return;
@@ -1126,6 +1165,9 @@ rejilla_file_node_destroy_with_children (RejillaFileNode *node,
 		}
 	}
 
+	if (!node->is_file && stats)
+		rejilla_iso_size_removed (stats->iso_size, node);
+
 	/* destruction */
 	import = REJILLA_FILE_NODE_IMPORT (node);
 	graft = REJILLA_FILE_NODE_GRAFT (node);
@@ -1158,8 +1200,10 @@ rejilla_file_node_destroy_with_children (RejillaFileNode *node,
 	if (node->is_file && !node->is_imported && REJILLA_FILE_NODE_MIME (node))
 		rejilla_utils_unregister_string (REJILLA_FILE_NODE_MIME (node));
 
-	if (node->is_root)
+	if (node->is_root) {
+		rejilla_iso_size_free (REJILLA_FILE_NODE_STATS (node)->iso_size);
 		g_free (REJILLA_FILE_NODE_STATS (node));
+	}
 
 	g_free (node);
 }
@@ -1213,6 +1257,9 @@ rejilla_file_node_save_imported_children (RejillaFileNode *node,
 	for (iter = import->replaced; iter; iter = iter->next)
 		rejilla_file_node_insert (iter, node, sort_func, NULL);
 
+	if (stats)
+		rejilla_iso_size_changed (stats->iso_size, node);
+
 	/* remove import */
 	node->union1.name = import->name;
 	node->has_import = FALSE;
@@ -68,6 +68,7 @@ typedef struct _RejillaImport RejillaImport;
  * - number of children (files+directories)
  * - number of deep directories
  * - number of files over 2 GiB
+ * - the sizes of the directories in an image
  */
 
 struct _RejillaFileTreeStats {
@@ -76,6 +77,8 @@ struct _RejillaFileTreeStats {
 	guint num_deep;
 	guint num_2GiB;
 	guint num_sym;
+
+	struct _RejillaIsoSize *iso_size;
 };
 typedef struct _RejillaFileTreeStats RejillaFileTreeStats;
 
@@ -139,6 +142,9 @@ struct _RejillaFileNode {
 	guint is_reloading:1;
 	guint is_exploring:1;
 
+	/* the exploration of the directory was put off until it is needed */
+	guint is_deferred:1;
+
 	/* that's for some special nodes (usually counted in statistics) */
 	guint is_2GiB:1;
 	guint is_deep:1;
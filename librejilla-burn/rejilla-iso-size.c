@@ -0,0 +1,552 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * Librejilla-burn
+ * Copyright (C) Philippe Rouquier 2005-2009 <bonfire-app@wanadoo.fr>
+ *
+ * Librejilla-burn is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The Librejilla-burn authors hereby grant permission for non-GPL compatible
+ * GStreamer plugins to be used and distributed together with GStreamer
+ * and Librejilla-burn. This permission is above and beyond the permissions granted
+ * by the GPL license by which Librejilla-burn is covered. If you modify this code
+ * you may extend this exception to your version of the code, but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version.
+ * 
+ * Librejilla-burn is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to:
+ * 	The Free Software Foundation, Inc.,
+ * 	51 Franklin Street, Fifth Floor
+ * 	Boston, MA  02110-1301, USA.
+ */
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "burn-iso-rules.h"
+#include "rejilla-file-node.h"
+#include "rejilla-iso-size.h"
+
+/**
+ * The image is made by iso-writer, mkisofs, genisoimage or libisofs and
+ * they don't mangle names, sort records or write Rock Ridge entries the
+ * same way. So the sizes are not those of a particular layout but the
+ * largest ones any of them can reach.
+ */
+
+/* Level 2 and 3: 30 characters with the '.' and the ";1" version for
+ * files, 31 characters for directories */
+#define REJILLA_ISO_SIZE_MAX_ID			33
+#define REJILLA_ISO_SIZE_MAX_DIR_ID		31
+
+/* 64 UCS-2 characters (with ";1" for files) */
+#define REJILLA_ISO_SIZE_MAX_JOLIET_ID		132
+#define REJILLA_ISO_SIZE_MAX_JOLIET_DIR_ID	128
+
+/* The length of a record fits in a byte and is even */
+#define REJILLA_ISO_SIZE_MAX_RECORD		254
+
+/* RR, PX (with a serial number), TF (four timestamps), PN and either CL,
+ * PL or RE for relocated directories */
+#define REJILLA_ISO_SIZE_MAX_ATTRIBUTES		(5 + 44 + 33 + 20 + 12)
+
+/* SP and ER in "." of root (the length of an ER fits in a byte) */
+#define REJILLA_ISO_SIZE_MAX_ROOT_ATTRIBUTES	(7 + 255)
+
+/* Volume recognition sequence, main and reserve descriptor sequences,
+ * integrity sequence and the anchors (the first one is at sector 256) */
+#define REJILLA_ISO_SIZE_UDF_BLOCKS		320
+
+struct _RejillaIsoSizeDir {
+	/* This directory: the sectors of its extent (and of its continuation
+	 * area) and the path table bytes of its subdirectories */
+	guint32 sectors;
+	guint32 joliet_sectors;
+	guint32 udf_sectors;
+	guint32 pt_size;
+	guint32 joliet_pt_size;
+
+	/* The records (and continuation entries) of its subdirectories if
+	 * they are relocated */
+	guint64 moved;
+	guint64 moved_ce;
+
+	/* The same for the directory and all its descendants */
+	guint64 total_sectors;
+	guint64 total_joliet_sectors;
+	guint64 total_udf_sectors;
+	guint64 total_pt_size;
+	guint64 total_joliet_pt_size;
+	guint64 total_moved;
+	guint64 total_moved_ce;
+
+	/* The records of the directory need to be computed again */
+	guint dirty:1;
+
+	/* A descendant changed */
+	guint subtree_dirty:1;
+
+	/* Whether symlinks were stored as such */
+	guint symlinks:1;
+
+	/* Whether subdirectories could be relocated */
+	guint deep:1;
+};
+typedef struct _RejillaIsoSizeDir RejillaIsoSizeDir;
+
+struct _RejillaIsoSize {
+	GHashTable *dirs;
+};
+
+RejillaIsoSize *
+rejilla_iso_size_new (void)
+{
+	RejillaIsoSize *self;
+
+	self = g_new0 (RejillaIsoSize, 1);
+	self->dirs = g_hash_table_new_full (g_direct_hash,
+					    g_direct_equal,
+					    NULL,
+					    g_free);
+	return self;
+}
+
+void
+rejilla_iso_size_free (RejillaIsoSize *self)
+{
+	if (!self)
+		return;
+
+	g_hash_table_destroy (self->dirs);
+	g_free (self);
+}
+
+void
+rejilla_iso_size_changed (RejillaIsoSize *self,
+			  RejillaFileNode *directory)
+{
+	RejillaIsoSizeDir *dir;
+	RejillaFileNode *parent;
+
+	if (directory->is_file)
+		return;
+
+	dir = g_hash_table_lookup (self->dirs, directory);
+	if (dir)
+		dir->dirty = TRUE;
+
+	for (parent = directory->parent; parent; parent = parent->parent) {
+		dir = g_hash_table_lookup (self->dirs, parent);
+		if (dir)
+			dir->subtree_dirty = TRUE;
+	}
+}
+
+void
+rejilla_iso_size_removed (RejillaIsoSize *self,
+			  RejillaFileNode *directory)
+{
+	g_hash_table_remove (self->dirs, directory);
+}
+
+static gboolean
+rejilla_iso_size_is_wanted (RejillaFileNode *node,
+			    GSList *children)
+{
+	if (REJILLA_FILE_NODE_VIRTUAL (node))
+		return FALSE;
+
+	if (children && !g_slist_find (children, node))
+		return FALSE;
+
+	return TRUE;
+}
+
+/**
+ * Gets the symlink target from the disk. The nodes below a graft have the
+ * same name on disk and on disc.
+ */
+
+static gchar *
+rejilla_iso_size_get_link (RejillaFileNode *node)
+{
+	RejillaGraft *graft;
+	GSList *names = NULL;
+	gchar *target = NULL;
+	gchar *path;
+	GSList *iter;
+
+	for (; node && !node->is_grafted; node = node->parent) {
+		if (node->is_root || node->is_imported)
+			break;
+
+		names = g_slist_prepend (names, REJILLA_FILE_NODE_NAME (node));
+	}
+
+	graft = node ? REJILLA_FILE_NODE_GRAFT (node):NULL;
+	if (!graft || !graft->node || !graft->node->uri) {
+		g_slist_free (names);
+		return NULL;
+	}
+
+	path = g_filename_from_uri (graft->node->uri, NULL, NULL);
+	for (iter = names; path && iter; iter = iter->next) {
+		gchar *tmp;
+
+		tmp = path;
+		path = g_build_filename (tmp, iter->data, NULL);
+		g_free (tmp);
+	}
+	g_slist_free (names);
+
+	if (path) {
+		target = g_file_read_link (path, NULL);
+		g_free (path);
+	}
+
+	return target;
+}
+
+static guint
+rejilla_iso_size_nm (const gchar *name)
+{
+	guint len;
+
+	/* 250 bytes at most per NM entry and one more entry if it is split
+	 * between the record and the continuation area */
+	len = strlen (name);
+	return len + 5 * (len / 250 + 2);
+}
+
+static guint
+rejilla_iso_size_sl (const gchar *target)
+{
+	gchar **components;
+	guint size = 5;
+	guint i;
+
+	/* Each component (or each 248 bytes of it) takes two more bytes and
+	 * at worst starts a new SL entry */
+	components = g_strsplit (target, G_DIR_SEPARATOR_S, 0);
+	for (i = 0; components [i]; i ++) {
+		guint len;
+
+		len = strlen (components [i]);
+		size += len + (2 + 5) * (len / 248 + 1);
+	}
+	g_strfreev (components);
+
+	return size;
+}
+
+static guint
+rejilla_iso_size_susp (RejillaFileNode *node,
+		       gboolean symlinks)
+{
+	guint size;
+
+	size = REJILLA_ISO_SIZE_MAX_ATTRIBUTES;
+	if (!node)
+		return size;
+
+	size += rejilla_iso_size_nm (REJILLA_FILE_NODE_NAME (node));
+	if (symlinks && node->is_symlink) {
+		gchar *target;
+
+		/* If it can't be read then make a guess */
+		target = rejilla_iso_size_get_link (node);
+		size += rejilla_iso_size_sl (target ? target:REJILLA_FILE_NODE_NAME (node));
+		g_free (target);
+	}
+
+	return size;
+}
+
+static void
+rejilla_iso_size_record (guint id_len,
+			 guint susp,
+			 guint64 *records,
+			 guint64 *ce)
+{
+	guint size;
+
+	size = rejilla_iso_rules_get_record_size (id_len);
+	if (size + susp + (susp & 1) <= REJILLA_ISO_SIZE_MAX_RECORD) {
+		*records += size + susp + (susp & 1);
+		return;
+	}
+
+	/* Count all the entries in the continuation area with a CE entry for
+	 * each sector they may span */
+	*records += REJILLA_ISO_SIZE_MAX_RECORD;
+	*ce += susp + REJILLA_ISO_RULES_CE_SIZE * (susp / (REJILLA_ISO_RULES_SECTOR_SIZE - REJILLA_ISO_RULES_CE_SIZE) + 1);
+}
+
+/**
+ * Records don't cross sectors so, whatever their order, every sector but
+ * the last one holds more than a sector minus the largest record.
+ */
+
+static guint32
+rejilla_iso_size_record_sectors (guint64 bytes,
+				 guint max_record)
+{
+	guint64 per_sector;
+
+	per_sector = REJILLA_ISO_RULES_SECTOR_SIZE - max_record;
+	return (bytes + per_sector - 1) / per_sector;
+}
+
+/**
+ * Continuation entries don't cross sectors either and are no larger than
+ * a sector so two sectors in a row always hold more than one sector.
+ */
+
+static guint32
+rejilla_iso_size_ce_sectors (guint64 bytes)
+{
+	return 2 * REJILLA_ISO_RULES_BLOCKS (bytes);
+}
+
+static void
+rejilla_iso_size_directory (RejillaFileNode *node,
+			    GSList *children,
+			    gboolean symlinks,
+			    gboolean deep,
+			    RejillaIsoSizeDir *dir)
+{
+	guint64 joliet_records = 0;
+	guint64 records = 0;
+	guint64 fids = 0;
+	guint64 ce = 0;
+	RejillaFileNode *child;
+	guint susp;
+
+	dir->pt_size = 0;
+	dir->joliet_pt_size = 0;
+	dir->moved = 0;
+	dir->moved_ce = 0;
+
+	/* The file entry of the directory in UDF */
+	dir->udf_sectors = 1;
+
+	/* "." and ".." */
+	susp = rejilla_iso_size_susp (NULL, symlinks);
+	rejilla_iso_size_record (1, susp + (node->is_root ? REJILLA_ISO_SIZE_MAX_ROOT_ATTRIBUTES:0), &records, &ce);
+	rejilla_iso_size_record (1, susp, &records, &ce);
+
+	joliet_records += 2 * rejilla_iso_rules_get_record_size (1);
+
+	/* The FID of the parent in UDF */
+	fids += 40;
+
+	for (child = REJILLA_FILE_NODE_CHILDREN (node); child; child = child->next) {
+		const gchar *name;
+
+		if (!rejilla_iso_size_is_wanted (child, children))
+			continue;
+
+		name = REJILLA_FILE_NODE_NAME (child);
+		susp = rejilla_iso_size_susp (child, symlinks);
+
+		/* There are fewer UTF-16 units than bytes in a name */
+		fids += 38 + 1 + 2 * strlen (name) + 3;
+
+		if (!child->is_file) {
+			rejilla_iso_size_record (REJILLA_ISO_SIZE_MAX_DIR_ID, susp, &records, &ce);
+			joliet_records += rejilla_iso_rules_get_record_size (REJILLA_ISO_SIZE_MAX_JOLIET_DIR_ID);
+
+			/* A relocated directory leaves a record behind and
+			 * has another one in the directory of relocations */
+			if (deep)
+				rejilla_iso_size_record (REJILLA_ISO_SIZE_MAX_DIR_ID, susp, &dir->moved, &dir->moved_ce);
+
+			dir->pt_size += 8 + REJILLA_ISO_SIZE_MAX_DIR_ID + 1;
+			dir->joliet_pt_size += 8 + REJILLA_ISO_SIZE_MAX_JOLIET_DIR_ID;
+			continue;
+		}
+
+		rejilla_iso_size_record (REJILLA_ISO_SIZE_MAX_ID, susp, &records, &ce);
+		joliet_records += rejilla_iso_rules_get_record_size (REJILLA_ISO_SIZE_MAX_JOLIET_ID);
+
+		/* The file entry in UDF */
+		dir->udf_sectors ++;
+
+		/* Files that are too big take several records; only the first
+		 * one has Rock Ridge entries */
+		if ((!child->is_symlink || !symlinks)
+		&&   REJILLA_FILE_NODE_SECTORS (child)) {
+			guint64 extents;
+
+			extents = (REJILLA_FILE_NODE_SECTORS (child) * REJILLA_ISO_RULES_SECTOR_SIZE - 1) / REJILLA_ISO_RULES_MAX_EXTENT;
+			records += extents * rejilla_iso_rules_get_record_size (REJILLA_ISO_SIZE_MAX_ID);
+			joliet_records += extents * rejilla_iso_rules_get_record_size (REJILLA_ISO_SIZE_MAX_JOLIET_ID);
+		}
+	}
+
+	dir->sectors = rejilla_iso_size_record_sectors (records, REJILLA_ISO_SIZE_MAX_RECORD) +
+		       rejilla_iso_size_ce_sectors (ce);
+	dir->joliet_sectors = rejilla_iso_size_record_sectors (joliet_records,
+							       rejilla_iso_rules_get_record_size (REJILLA_ISO_SIZE_MAX_JOLIET_ID));
+
+	/* FIDs can cross sectors */
+	dir->udf_sectors += REJILLA_ISO_RULES_BLOCKS (fids);
+}
+
+static void
+rejilla_iso_size_reset_totals (RejillaIsoSizeDir *dir)
+{
+	dir->total_sectors = dir->sectors;
+	dir->total_joliet_sectors = dir->joliet_sectors;
+	dir->total_udf_sectors = dir->udf_sectors;
+	dir->total_pt_size = dir->pt_size;
+	dir->total_joliet_pt_size = dir->joliet_pt_size;
+	dir->total_moved = dir->moved;
+	dir->total_moved_ce = dir->moved_ce;
+}
+
+static void
+rejilla_iso_size_add_totals (RejillaIsoSizeDir *dir,
+			     RejillaIsoSizeDir *child)
+{
+	dir->total_sectors += child->total_sectors;
+	dir->total_joliet_sectors += child->total_joliet_sectors;
+	dir->total_udf_sectors += child->total_udf_sectors;
+	dir->total_pt_size += child->total_pt_size;
+	dir->total_joliet_pt_size += child->total_joliet_pt_size;
+	dir->total_moved += child->total_moved;
+	dir->total_moved_ce += child->total_moved_ce;
+}
+
+static RejillaIsoSizeDir *
+rejilla_iso_size_get_dir (RejillaIsoSize *self,
+			  RejillaFileNode *node,
+			  gboolean symlinks,
+			  gboolean deep)
+{
+	RejillaIsoSizeDir *dir;
+	RejillaFileNode *child;
+
+	dir = g_hash_table_lookup (self->dirs, node);
+	if (!dir) {
+		dir = g_new0 (RejillaIsoSizeDir, 1);
+		dir->dirty = TRUE;
+		dir->symlinks = symlinks;
+		dir->deep = deep;
+		g_hash_table_insert (self->dirs, node, dir);
+	}
+	else if (dir->symlinks != symlinks || dir->deep != deep) {
+		dir->dirty = TRUE;
+		dir->symlinks = symlinks;
+		dir->deep = deep;
+	}
+
+	if (dir->dirty)
+		rejilla_iso_size_directory (node, NULL, symlinks, deep, dir);
+	else if (!dir->subtree_dirty)
+		return dir;
+
+	rejilla_iso_size_reset_totals (dir);
+	for (child = REJILLA_FILE_NODE_CHILDREN (node); child; child = child->next) {
+		if (child->is_file || !rejilla_iso_size_is_wanted (child, NULL))
+			continue;
+
+		rejilla_iso_size_add_totals (dir, rejilla_iso_size_get_dir (self, child, symlinks, deep));
+	}
+
+	dir->dirty = FALSE;
+	dir->subtree_dirty = FALSE;
+	return dir;
+}
+
+/**
+ * Returns the largest number of sectors that everything but the contents
+ * of the files can take in an image of @root. If @children is not NULL,
+ * only these children of @root are included.
+ */
+
+goffset
+rejilla_iso_size_get_blocks (RejillaIsoSize *self,
+			     RejillaFileNode *root,
+			     GSList *children,
+			     RejillaImageFS fs_type)
+{
+	RejillaIsoSizeDir *dir;
+	RejillaIsoSizeDir tmp;
+	gboolean symlinks;
+	gboolean deep;
+	goffset blocks;
+
+	symlinks = (fs_type & REJILLA_IMAGE_FS_SYMLINK) != 0;
+	deep = (fs_type & REJILLA_IMAGE_ISO_FS_DEEP_DIRECTORY) != 0;
+
+	if (children) {
+		RejillaFileNode *child;
+
+		/* Don't cache that one as it's not the whole root */
+		memset (&tmp, 0, sizeof (RejillaIsoSizeDir));
+		rejilla_iso_size_directory (root, children, symlinks, deep, &tmp);
+		rejilla_iso_size_reset_totals (&tmp);
+
+		for (child = REJILLA_FILE_NODE_CHILDREN (root); child; child = child->next) {
+			if (child->is_file || !rejilla_iso_size_is_wanted (child, children))
+				continue;
+
+			rejilla_iso_size_add_totals (&tmp, rejilla_iso_size_get_dir (self, child, symlinks, deep));
+		}
+		dir = &tmp;
+	}
+	else
+		dir = rejilla_iso_size_get_dir (self, root, symlinks, deep);
+
+	/* System area, primary volume descriptor, terminator and the version
+	 * descriptor mkisofs and genisoimage write after it */
+	blocks = 16 + 1 + 1 + 1;
+
+	/* Path tables (type L and M); the root entry is 10 bytes */
+	blocks += 2 * REJILLA_ISO_RULES_BLOCKS (10 + dir->total_pt_size + (deep ? 16:0));
+	blocks += dir->total_sectors;
+
+	/* The directory holding relocated directories: its "." and ".."
+	 * records are counted as a directory without children would be */
+	if (deep) {
+		guint64 moved_ce;
+		guint64 moved;
+		guint susp;
+
+		moved = dir->total_moved;
+		moved_ce = dir->total_moved_ce;
+		susp = rejilla_iso_size_susp (NULL, symlinks);
+		rejilla_iso_size_record (1, susp, &moved, &moved_ce);
+		rejilla_iso_size_record (1, susp, &moved, &moved_ce);
+
+		blocks += rejilla_iso_size_record_sectors (moved, REJILLA_ISO_SIZE_MAX_RECORD);
+		blocks += rejilla_iso_size_ce_sectors (moved_ce);
+	}
+
+	if (fs_type & REJILLA_IMAGE_FS_JOLIET) {
+		/* Supplementary volume descriptor */
+		blocks += 1;
+		blocks += 2 * REJILLA_ISO_RULES_BLOCKS (10 + dir->total_joliet_pt_size);
+		blocks += dir->total_joliet_sectors;
+	}
+
+	if (fs_type & REJILLA_IMAGE_FS_UDF) {
+		blocks += REJILLA_ISO_SIZE_UDF_BLOCKS;
+		blocks += dir->total_udf_sectors;
+	}
+
+	return blocks;
+}
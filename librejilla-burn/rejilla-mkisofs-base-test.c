@@ -0,0 +1,204 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * Librejilla-burn
+ * Copyright (C) Philippe Rouquier 2005-2009 <bonfire-app@wanadoo.fr>
+ *
+ * Librejilla-burn is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The Librejilla-burn authors hereby grant permission for non-GPL compatible
+ * GStreamer plugins to be used and distributed together with GStreamer
+ * and Librejilla-burn. This permission is above and beyond the permissions granted
+ * by the GPL license by which Librejilla-burn is covered. If you modify this code
+ * you may extend this exception to your version of the code, but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version.
+ *
+ * Librejilla-burn is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to:
+ * 	The Free Software Foundation, Inc.,
+ * 	51 Franklin Street, Fifth Floor
+ * 	Boston, MA  02110-1301, USA.
+ */
+
+/**
+ * Checks which excluded paths end up in the excluded list written for
+ * mkisofs/genisoimage. An excluded path can only be left out when one of
+ * its parents is excluded and no graft brings anything back inside this
+ * parent. Paths don't need to exist: only the list files are created.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "burn-basics.h"
+#include "rejilla-track-data.h"
+#include "burn-mkisofs-base.h"
+
+typedef struct {
+	const gchar *name;
+
+	/* the graft uris are also used as their path on the disc */
+	const gchar *grafts [4];
+	const gchar *excluded [4];
+	const gchar *written [4];
+} RejillaMkisofsBaseTest;
+
+static const RejillaMkisofsBaseTest tests [] = {
+	{ "excluded child of an excluded parent",
+	  { "/root", NULL },
+	  { "/root/a", "/root/a/x", NULL },
+	  { "/root/a", NULL } },
+
+	{ "excluded child of an excluded parent with a graft inside",
+	  { "/root", "/root/a/y", NULL },
+	  { "/root/a", "/root/a/x", NULL },
+	  { "/root/a", "/root/a/x", NULL } },
+
+	{ "excluded child of an excluded parent which is also a graft",
+	  { "/a", NULL },
+	  { "/a", "/a/x", NULL },
+	  { "/a", "/a/x", NULL } },
+
+	{ "excluded child of an excluded parent with a graft next to it",
+	  { "/a/bc", NULL },
+	  { "/a/b", "/a/b/x", NULL },
+	  { "/a/b", NULL } },
+};
+
+static gboolean
+rejilla_mkisofs_base_test_run (const RejillaMkisofsBaseTest *test,
+			       const gchar *grafts_path,
+			       const gchar *excluded_path)
+{
+	RejillaBurnResult result;
+	GError *error = NULL;
+	GSList *excluded = NULL;
+	GSList *grafts = NULL;
+	gchar *contents = NULL;
+	gchar **lines;
+	gboolean success;
+	guint i;
+
+	for (i = 0; test->grafts [i]; i ++) {
+		RejillaGraftPt *graft;
+
+		graft = g_new0 (RejillaGraftPt, 1);
+		graft->uri = g_strdup (test->grafts [i]);
+		graft->path = g_strdup (test->grafts [i]);
+		grafts = g_slist_append (grafts, graft);
+	}
+
+	for (i = 0; test->excluded [i]; i ++)
+		excluded = g_slist_append (excluded, g_strdup (test->excluded [i]));
+
+	/* the lists are opened without O_CREAT */
+	g_file_set_contents (grafts_path, "", 0, NULL);
+	g_file_set_contents (excluded_path, "", 0, NULL);
+
+	result = rejilla_mkisofs_base_write_to_files (grafts,
+						      excluded,
+						      FALSE,
+						      NULL,
+						      NULL,
+						      grafts_path,
+						      excluded_path,
+						      &error);
+
+	g_slist_foreach (grafts, (GFunc) rejilla_graft_point_free, NULL);
+	g_slist_free (grafts);
+	g_slist_foreach (excluded, (GFunc) g_free, NULL);
+	g_slist_free (excluded);
+
+	if (result != REJILLA_BURN_OK) {
+		g_printerr ("FAIL: %s: %s\n",
+			    test->name,
+			    error? error->message:"unknown error");
+		if (error)
+			g_error_free (error);
+		return FALSE;
+	}
+
+	if (!g_file_get_contents (excluded_path, &contents, NULL, NULL)) {
+		g_printerr ("FAIL: %s: excluded list could not be read\n", test->name);
+		return FALSE;
+	}
+
+	/* the list ends with a newline, hence the last empty line */
+	lines = g_strsplit (contents, "\n", -1);
+	success = TRUE;
+	for (i = 0; test->written [i]; i ++) {
+		if (!lines [i] || strcmp (lines [i], test->written [i])) {
+			success = FALSE;
+			break;
+		}
+	}
+
+	if (success && lines [i] && lines [i][0] != '\0')
+		success = FALSE;
+
+	if (success && lines [i] && lines [i + 1])
+		success = FALSE;
+
+	if (!success)
+		g_printerr ("FAIL: %s: unexpected excluded list:\n%s", test->name, contents);
+	else
+		g_print ("PASS: %s\n", test->name);
+
+	g_strfreev (lines);
+	g_free (contents);
+	return success;
+}
+
+int
+main (int argc, char **argv)
+{
+	gchar *excluded_path;
+	gchar *grafts_path;
+	gboolean success;
+	gchar *tmpdir;
+	guint i;
+
+	g_type_init ();
+
+	tmpdir = g_build_filename (g_get_tmp_dir (), "rejilla-mkisofs-base-XXXXXX", NULL);
+	if (!mkdtemp (tmpdir)) {
+		g_printerr ("Temporary directory could not be created\n");
+		g_free (tmpdir);
+		return EXIT_FAILURE;
+	}
+
+	grafts_path = g_build_filename (tmpdir, "grafts", NULL);
+	excluded_path = g_build_filename (tmpdir, "excluded", NULL);
+
+	success = TRUE;
+	for (i = 0; i < G_N_ELEMENTS (tests); i ++) {
+		if (!rejilla_mkisofs_base_test_run (tests + i, grafts_path, excluded_path))
+			success = FALSE;
+	}
+
+	g_remove (grafts_path);
+	g_remove (excluded_path);
+	g_rmdir (tmpdir);
+
+	g_free (grafts_path);
+	g_free (excluded_path);
+	g_free (tmpdir);
+
+	return success? EXIT_SUCCESS:EXIT_FAILURE;
+}
@@ -88,6 +88,15 @@ rejilla_plugin_check_media_restrictions (RejillaPlugin *plugin,
 void
 rejilla_plugin_check_plugin_ready (RejillaPlugin *plugin);
 
+void
+rejilla_plugin_run_check_config (RejillaPlugin *plugin);
+
+void
+rejilla_plugin_apply_check_config (RejillaPlugin *plugin);
+
+gboolean
+rejilla_plugin_get_config_cached (RejillaPlugin *plugin);
+
 G_END_DECLS
 
 #endif
@@ -486,6 +486,29 @@ rejilla_burn_progress_set_status (RejillaBurnProgress *self,
 		gtk_label_set_text (GTK_LABEL (self->priv->bytes_written), " ");
 }
 
+void
+rejilla_burn_progress_set_estimate (RejillaBurnProgress *self,
+				    glong estimate)
+{
+	int hrs, mn, sec;
+	gchar *text;
+
+	/* Only meaningful before anything has started */
+	if (self->priv->current != REJILLA_BURN_ACTION_NONE || estimate < 0)
+		return;
+
+	hrs = estimate / 3600;
+	estimate = ((int) estimate) % 3600;
+	mn = estimate / 60;
+	sec = ((int) estimate) % 60;
+
+	/* Translators: first %02i is hours, the second one is minutes
+	 * and the third one is seconds. */
+	text = g_strdup_printf (_("Estimated duration: %02i:%02i:%02i"), hrs, mn, sec);
+	gtk_progress_bar_set_text (GTK_PROGRESS_BAR (self->priv->progress), text);
+	g_free (text);
+}
+
 void
 rejilla_burn_progress_set_action (RejillaBurnProgress *self,
 				  RejillaBurnAction action,
@@ -87,6 +87,10 @@ rejilla_burn_progress_set_action (RejillaBurnProgress *progress,
 				  RejillaBurnAction action,
 				  const gchar *string);
 
+void
+rejilla_burn_progress_set_estimate (RejillaBurnProgress *progress,
+				    glong estimate);
+
 G_END_DECLS
 
 #endif /* PROGRESS_H */
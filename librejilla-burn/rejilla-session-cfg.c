@@ -402,6 +402,41 @@ rejilla_session_cfg_disable (RejillaSessionCfg *self)
 	priv->disabled = TRUE;
 }
 
+/**
+ * rejilla_session_cfg_revalidate:
+ * @cfg: a #RejillaSessionCfg
+ * @missing: a #GSList ** or NULL
+ * @changed: a #GSList ** or NULL
+ *
+ * Checks the files of all the data tracks of @cfg against the disk so that
+ * changes are not discovered while writing. See
+ * rejilla_track_data_cfg_revalidate ().
+ *
+ * Return value: a #gboolean. TRUE if one of the tracks was changed.
+ **/
+
+gboolean
+rejilla_session_cfg_revalidate (RejillaSessionCfg *self,
+				GSList **missing,
+				GSList **changed)
+{
+	gboolean result = FALSE;
+	GSList *tracks;
+
+	tracks = rejilla_burn_session_get_tracks (REJILLA_BURN_SESSION (self));
+	for (; tracks; tracks = tracks->next) {
+		if (!REJILLA_IS_TRACK_DATA_CFG (tracks->data))
+			continue;
+
+		if (rejilla_track_data_cfg_revalidate (REJILLA_TRACK_DATA_CFG (tracks->data),
+						       missing,
+						       changed))
+			result = TRUE;
+	}
+
+	return result;
+}
+
 /**
  * rejilla_session_cfg_enable:
  * @cfg: a #RejillaSessionCfg
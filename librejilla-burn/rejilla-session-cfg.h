@@ -111,6 +111,11 @@ rejilla_session_cfg_enable (RejillaSessionCfg *cfg);
 void
 rejilla_session_cfg_disable (RejillaSessionCfg *cfg);
 
+gboolean
+rejilla_session_cfg_revalidate (RejillaSessionCfg *cfg,
+				GSList **missing,
+				GSList **changed);
+
 G_END_DECLS
 
 #endif /* _REJILLA_SESSION_CFG_H_ */
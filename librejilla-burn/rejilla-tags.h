@@ -99,6 +99,18 @@ enum {
 };
 #define REJILLA_VCD_TYPE			"session::VCD::format"
 
+/**
+ * Let the library choose the speed and the write mode from the results of
+ * the previous recordings with the same drive and media
+ */
+#define REJILLA_SESSION_AUTO_WRITE_STRATEGY	"session::write::auto"		/* Int */
+
+/**
+ * Compare the disc with the image while it is recorded (when the drive allows
+ * it) instead of reading it all back afterwards to check its checksum
+ */
+#define REJILLA_SESSION_VERIFY_WHILE_WRITING	"session::verify::while-writing"	/* Int */
+
 /**
  * This is the video format that should be used.
  */
@@ -53,6 +53,7 @@
 #include "burn-basics.h"
 #include "rejilla-data-project.h"
 #include "rejilla-data-tree-model.h"
+#include "rejilla-data-snapshot.h"
 
 typedef struct _RejillaTrackDataCfgPrivate RejillaTrackDataCfgPrivate;
 struct _RejillaTrackDataCfgPrivate
@@ -794,6 +795,16 @@ rejilla_track_data_cfg_get_value (GtkTreeModel *model,
 		else if (!node->is_file) {
 			guint nb_items;
 
+			if (node->is_deferred && REJILLA_FILE_NODE_SECTORS (node)) {
+				gchar *text;
+
+				/* Only an estimate until it is explored */
+				text = g_format_size_for_display (REJILLA_FILE_NODE_SECTORS (node) * 2048);
+				g_value_set_string (value, text);
+				g_free (text);
+				return;
+			}
+
 			if (node->is_exploring) {
 				g_value_set_string (value, _("(loading…)"));
 				return;
@@ -2079,6 +2090,120 @@ rejilla_track_data_cfg_get_filtered_model (RejillaTrackDataCfg *track)
 	return model;
 }
 
+/**
+ * rejilla_track_data_cfg_explore_all:
+ * @track: a #RejillaTrackDataCfg
+ *
+ * Explores all the directories of @track that were not explored yet (see
+ * lazy exploration) so that all the files that will be written are known and
+ * checked. rejilla_track_get_status () returns REJILLA_BURN_NOT_READY until
+ * it is finished.
+ *
+ * Return value: a #gboolean. TRUE if some directories need to be explored.
+ **/
+
+gboolean
+rejilla_track_data_cfg_explore_all (RejillaTrackDataCfg *track)
+{
+	RejillaTrackDataCfgPrivate *priv;
+
+	g_return_val_if_fail (REJILLA_TRACK_DATA_CFG (track), FALSE);
+	priv = REJILLA_TRACK_DATA_CFG_PRIVATE (track);
+
+	return rejilla_data_vfs_load_deferred (REJILLA_DATA_VFS (priv->tree));
+}
+
+/**
+ * rejilla_track_data_cfg_revalidate:
+ * @track: a #RejillaTrackDataCfg
+ * @missing: a #GSList ** or NULL
+ * @changed: a #GSList ** or NULL
+ *
+ * Checks that all the files of @track still exist on disk with the same size.
+ * The missing ones are removed and the others reloaded. This catches changes
+ * that escaped monitoring (for example when there are too many directories
+ * to watch). It should be called before @track is used for burning.
+ * The URIs of the missing and changed files are prepended to @missing and
+ * @changed respectively; they should be freed afterwards.
+ *
+ * Return value: a #gboolean. TRUE if @track was changed.
+ **/
+
+gboolean
+rejilla_track_data_cfg_revalidate (RejillaTrackDataCfg *track,
+				   GSList **missing,
+				   GSList **changed)
+{
+	RejillaTrackDataCfgPrivate *priv;
+
+	g_return_val_if_fail (REJILLA_TRACK_DATA_CFG (track), FALSE);
+	priv = REJILLA_TRACK_DATA_CFG_PRIVATE (track);
+
+#ifdef BUILD_INOTIFY
+	/* This finds the files added to directories that are not watched */
+	rejilla_file_monitor_revalidate (REJILLA_FILE_MONITOR (priv->tree));
+#endif
+
+	return rejilla_data_project_revalidate (REJILLA_DATA_PROJECT (priv->tree),
+						missing,
+						changed);
+}
+
+/**
+ * rejilla_track_data_cfg_load_snapshot:
+ * @track: a #RejillaTrackDataCfg
+ * @path: a #gchar
+ *
+ * Loads a snapshot previously saved with rejilla_track_data_cfg_save_snapshot ().
+ * The directories recorded in the snapshot that were not modified since
+ * will not be explored again when the contents of @track are set.
+ * This must be called before rejilla_track_data_set_source ().
+ *
+ * Return value: a #gboolean. TRUE if a valid snapshot was found at @path.
+ **/
+
+gboolean
+rejilla_track_data_cfg_load_snapshot (RejillaTrackDataCfg *track,
+				      const gchar *path)
+{
+	RejillaTrackDataCfgPrivate *priv;
+	RejillaDataSnapshot *snapshot;
+
+	g_return_val_if_fail (REJILLA_TRACK_DATA_CFG (track), FALSE);
+	priv = REJILLA_TRACK_DATA_CFG_PRIVATE (track);
+
+	snapshot = rejilla_data_snapshot_load (path);
+	rejilla_data_vfs_set_snapshot (REJILLA_DATA_VFS (priv->tree), snapshot);
+	return (snapshot != NULL);
+}
+
+/**
+ * rejilla_track_data_cfg_save_snapshot:
+ * @track: a #RejillaTrackDataCfg
+ * @path: a #gchar
+ * @error: a #GError or NULL
+ *
+ * Saves the contents of all the directories of @track that were explored
+ * (with the size and type of their files) to @path.
+ *
+ * Return value: a #gboolean. FALSE if an error occurred.
+ **/
+
+gboolean
+rejilla_track_data_cfg_save_snapshot (RejillaTrackDataCfg *track,
+				      const gchar *path,
+				      GError **error)
+{
+	RejillaTrackDataCfgPrivate *priv;
+
+	g_return_val_if_fail (REJILLA_TRACK_DATA_CFG (track), FALSE);
+	priv = REJILLA_TRACK_DATA_CFG_PRIVATE (track);
+
+	return rejilla_data_snapshot_save (REJILLA_DATA_PROJECT (priv->tree),
+					   path,
+					   error);
+}
+
 /**
  * rejilla_track_data_cfg_restore:
  * @track: a #RejillaTrackDataCfg
@@ -2463,19 +2588,16 @@ rejilla_track_data_cfg_get_size (RejillaTrack *track,
 
 	sectors = rejilla_data_project_get_sectors (REJILLA_DATA_PROJECT (priv->tree));
 	if (blocks) {
-		RejillaFileNode *root;
 		RejillaImageFS fs_type;
-		RejillaFileTreeStats *stats;
 
 		if (!sectors)
 			return sectors;
 
 		fs_type = rejilla_track_data_cfg_get_fs (REJILLA_TRACK_DATA (track));
-		root = rejilla_data_project_get_root (REJILLA_DATA_PROJECT (priv->tree));
-		stats = REJILLA_FILE_NODE_STATS (root);
-		sectors = rejilla_data_project_improve_image_size_accuracy (sectors,
-									    stats->num_dir,
-									    fs_type);
+		sectors = rejilla_data_project_get_image_blocks (REJILLA_DATA_PROJECT (priv->tree),
+								 NULL,
+								 sectors,
+								 fs_type);
 		*blocks = sectors;
 	}
 
@@ -148,6 +148,26 @@ rejilla_track_data_cfg_restore (RejillaTrackDataCfg *track,
 GtkTreeModel *
 rejilla_track_data_cfg_get_filtered_model (RejillaTrackDataCfg *track);
 
+gboolean
+rejilla_track_data_cfg_explore_all (RejillaTrackDataCfg *track);
+
+gboolean
+rejilla_track_data_cfg_revalidate (RejillaTrackDataCfg *track,
+				   GSList **missing,
+				   GSList **changed);
+
+/**
+ * Snapshot of explored directories
+ */
+
+gboolean
+rejilla_track_data_cfg_load_snapshot (RejillaTrackDataCfg *track,
+				      const gchar *path);
+
+gboolean
+rejilla_track_data_cfg_save_snapshot (RejillaTrackDataCfg *track,
+				      const gchar *path,
+				      GError **error);
 
 /**
  * Track Spanning
@@ -55,6 +55,15 @@ struct _RejillaIsoCtx {
 	gint offset;
 	RejillaVolSrc *vol;
 
+	/* Directory extents are read in batches of up to
+	 * ISO9660_READ_AHEAD_BLOCKS blocks; dir_blocks is the size of the
+	 * extent being read and address its first block. */
+	gchar *ahead;
+	gint ahead_blocks;
+	gint ahead_pos;
+	gint dir_blocks;
+	gint address;
+
 	gchar *spare_record;
 
 	guint64 data_blocks;
@@ -132,6 +141,10 @@ typedef enum {
 
 #define ISO9660_BYTES_TO_BLOCKS(size)			REJILLA_BYTES_TO_SECTORS ((size), ISO9660_BLOCK_SIZE)
 
+/* Optical drives are much faster with one large request than with many
+ * single block requests (each of them costing a full command round trip) */
+#define ISO9660_READ_AHEAD_BLOCKS			32
+
 static GList *
 rejilla_iso9660_load_directory_records (RejillaIsoCtx *ctx,
 					RejillaVolFile *parent,
@@ -204,6 +217,10 @@ rejilla_iso9660_seek (RejillaIsoCtx *ctx, gint address)
 {
 	ctx->offset = 0;
 	ctx->num_blocks = 1;
+	ctx->dir_blocks = 1;
+	ctx->address = address;
+	ctx->ahead_blocks = 0;
+	ctx->ahead_pos = 0;
 
 	/* The size of all the records is given by size member and its location
 	 * by its address member. In a set of directory records the first two 
@@ -221,9 +238,43 @@ rejilla_iso9660_seek (RejillaIsoCtx *ctx, gint address)
 static RejillaIsoResult
 rejilla_iso9660_next_block (RejillaIsoCtx *ctx)
 {
+	gint blocks;
+
 	ctx->offset = 0;
 	ctx->num_blocks ++;
 
+	if (ctx->ahead_pos < ctx->ahead_blocks) {
+		memcpy (ctx->buffer,
+			ctx->ahead + ctx->ahead_pos * ISO9660_BLOCK_SIZE,
+			ISO9660_BLOCK_SIZE);
+		ctx->ahead_pos ++;
+		return REJILLA_ISO_OK;
+	}
+
+	/* Read all the remaining blocks of the extent at once if possible */
+	blocks = MIN (ctx->dir_blocks - ctx->num_blocks + 1, ISO9660_READ_AHEAD_BLOCKS);
+	if (blocks > 1) {
+		if (!ctx->ahead)
+			ctx->ahead = g_new (gchar, ISO9660_READ_AHEAD_BLOCKS * ISO9660_BLOCK_SIZE);
+
+		if (REJILLA_VOL_SRC_READ (ctx->vol, ctx->ahead, blocks, NULL)) {
+			memcpy (ctx->buffer, ctx->ahead, ISO9660_BLOCK_SIZE);
+			ctx->ahead_blocks = blocks;
+			ctx->ahead_pos = 1;
+			return REJILLA_ISO_OK;
+		}
+
+		/* Some drives refuse large requests; go back to one block */
+		REJILLA_MEDIA_LOG ("Batched read failed, reading block by block");
+		ctx->ahead_blocks = 0;
+		ctx->ahead_pos = 0;
+		if (REJILLA_VOL_SRC_SEEK (ctx->vol,
+					  ctx->address + ctx->num_blocks - 1,
+					  SEEK_SET,
+					  &(ctx->error)) == -1)
+			return REJILLA_ISO_ERROR;
+	}
+
 	if (!REJILLA_VOL_SRC_READ (ctx->vol, ctx->buffer, 1, &(ctx->error)))
 		return REJILLA_ISO_ERROR;
 
@@ -582,6 +633,7 @@ rejilla_iso9660_load_directory_records (RejillaIsoCtx *ctx,
 	max_record_size = rejilla_iso9660_get_733_val (record->file_size);
 	max_block = ISO9660_BYTES_TO_BLOCKS (max_record_size);
 	REJILLA_MEDIA_LOG ("Maximum directory record length %i block (= %i bytes)", max_block, max_record_size);
+	ctx->dir_blocks = max_block;
 
 	/* skip ".." */
 	result = rejilla_iso9660_next_record (ctx, &record);
@@ -791,6 +843,9 @@ rejilla_iso9660_get_contents (RejillaVolSrc *vol,
 	if (ctx.spare_record)
 		g_free (ctx.spare_record);
 
+	if (ctx.ahead)
+		g_free (ctx.ahead);
+
 	if (data_blocks)
 		*data_blocks = ctx.data_blocks;
 
@@ -950,6 +1005,7 @@ rejilla_iso9660_lookup_directory_records (RejillaIsoCtx *ctx,
 	max_record_size = rejilla_iso9660_get_733_val (record->file_size);
 	max_block = ISO9660_BYTES_TO_BLOCKS (max_record_size);
 	REJILLA_MEDIA_LOG ("Maximum directory record length %i block (= %i bytes)", max_block, max_record_size);
+	ctx->dir_blocks = max_block;
 
 	/* skip ".." */
 	result = rejilla_iso9660_next_record (ctx, &record);
@@ -1050,6 +1106,9 @@ rejilla_iso9660_get_file (RejillaVolSrc *vol,
 	if (ctx.spare_record)
 		g_free (ctx.spare_record);
 
+	if (ctx.ahead)
+		g_free (ctx.ahead);
+
 	if (error && ctx.error)
 		g_propagate_error (error, ctx.error);
 
@@ -1089,6 +1148,13 @@ rejilla_iso9660_get_directory_contents (RejillaVolSrc *vol,
 							   NULL,
 							   record,
 							   FALSE);
+
+	if (ctx.spare_record)
+		g_free (ctx.spare_record);
+
+	if (ctx.ahead)
+		g_free (ctx.ahead);
+
 	if (ctx.error && error)
 		g_propagate_error (error, ctx.error);
 
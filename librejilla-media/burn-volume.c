@@ -133,6 +133,21 @@ rejilla_volume_get_primary_from_file (RejillaVolSrc *vol,
 	return TRUE;
 }
 
+gboolean
+rejilla_volume_get_primary (RejillaVolSrc *vol,
+			    gint64 session_block,
+			    gchar *primary_vol,
+			    GError **error)
+{
+	if (REJILLA_VOL_SRC_SEEK (vol, session_block, SEEK_SET, error) == -1)
+		return FALSE;
+
+	if (!rejilla_volume_get_primary_from_file (vol, primary_vol, error))
+		return FALSE;
+
+	return rejilla_iso9660_is_primary_descriptor (primary_vol, error);
+}
+
 gboolean
 rejilla_volume_get_size (RejillaVolSrc *vol,
 			 gint64 block,
@@ -83,6 +83,12 @@ gboolean
 rejilla_volume_is_valid (RejillaVolSrc *src,
 			 GError **error);
 
+gboolean
+rejilla_volume_get_primary (RejillaVolSrc *vol,
+			    gint64 session_block,
+			    gchar *primary_vol,
+			    GError **error);
+
 gboolean
 rejilla_volume_get_size (RejillaVolSrc *src,
 			 gint64 block,
@@ -29,6 +29,8 @@
  */
 
 #include "rejilla-drive.h"
+#include "scsi-device.h"
+#include "scsi-error.h"
 
 #ifndef _BURN_DRIVE_PRIV_H_
 #define _BURN_DRIVE_PRIV_H_
@@ -41,6 +43,30 @@ rejilla_drive_probing (RejillaDrive *drive);
 gboolean
 rejilla_medium_probing (RejillaMedium *medium);
 
+void
+rejilla_medium_wake_probe (RejillaMedium *medium);
+
+const gchar *
+rejilla_medium_get_probe_identity (RejillaMedium *medium);
+
+typedef gboolean (* RejillaDriveCancelledFunc) (gpointer user_data);
+
+RejillaDeviceHandle *
+rejilla_drive_open_handle_wait (const gchar *device,
+				GMutex *mutex,
+				GCond *cond,
+				RejillaDriveCancelledFunc cancelled,
+				gpointer user_data,
+				RejillaScsiErrCode *code);
+
+RejillaScsiResult
+rejilla_drive_wait_unit_ready (RejillaDeviceHandle *handle,
+			       GMutex *mutex,
+			       GCond *cond,
+			       RejillaDriveCancelledFunc cancelled,
+			       gpointer user_data,
+			       RejillaScsiErrCode *code);
+
 G_END_DECLS
 
 #endif
@@ -74,7 +74,14 @@ struct _RejillaDrivePrivate
 	GMutex *mutex;
 	GCond *cond;
 	GCond *cond_probe;
-	gint probe_id;
+
+	/* Checks for a medium after a change, done with asynchronous commands
+	 * from the main loop */
+	RejillaDeviceHandle *poll_handle;
+	RejillaScsiMediaEventData poll_event;
+	guint poll_id;
+	gint poll_interval;
+	gint poll_waited;
 
 	RejillaMedium *medium;
 	RejillaDriveCaps caps;
@@ -92,7 +99,6 @@ struct _RejillaDrivePrivate
 	guint initial_probe_cancelled:1;
 
 	guint has_medium:1;
-	guint probe_cancelled:1;
 
 	guint locked:1;
 	guint ejecting:1;
@@ -117,7 +123,16 @@ enum {
 
 G_DEFINE_TYPE (RejillaDrive, rejilla_drive, G_TYPE_OBJECT);
 
-#define REJILLA_DRIVE_OPEN_ATTEMPTS			5
+/* How long (in ms) to keep trying to open a busy drive */
+#define REJILLA_DRIVE_OPEN_TIMEOUT			6000
+
+/* Bounds (in ms) of the interval between two checks of a drive that is not
+ * ready yet. It starts small and grows as long as nothing happens. */
+#define REJILLA_DRIVE_WAIT_MIN				100
+#define REJILLA_DRIVE_WAIT_MAX				2000
+
+/* How long (in ms) a drive may take to answer a command while being checked */
+#define REJILLA_DRIVE_POLL_TIMEOUT			5000
 
 static void
 rejilla_drive_probe_inside (RejillaDrive *drive);
@@ -198,6 +213,34 @@ last_resort:
 	return result;
 }
 
+static gboolean
+rejilla_drive_stop_polling (RejillaDrive *drive)
+{
+	RejillaDrivePrivate *priv;
+	gboolean polling = FALSE;
+
+	priv = REJILLA_DRIVE_PRIVATE (drive);
+
+	if (priv->poll_id) {
+		g_source_remove (priv->poll_id);
+		priv->poll_id = 0;
+		polling = TRUE;
+	}
+
+	if (priv->poll_handle) {
+		RejillaDeviceHandle *handle;
+
+		/* The pending command is called back while closing; unsetting
+		 * poll_handle first tells it polling stopped */
+		handle = priv->poll_handle;
+		priv->poll_handle = NULL;
+		rejilla_device_handle_close (handle);
+		polling = TRUE;
+	}
+
+	return polling;
+}
+
 static void
 rejilla_drive_cancel_probing (RejillaDrive *drive)
 {
@@ -206,11 +249,11 @@ rejilla_drive_cancel_probing (RejillaDrive *drive)
 	priv = REJILLA_DRIVE_PRIVATE (drive);
 
 	priv->probe_waiting = FALSE;
+	rejilla_drive_stop_polling (drive);
 
 	g_mutex_lock (priv->mutex);
 	if (priv->probe) {
 		/* This to signal that we are cancelling */
-		priv->probe_cancelled = TRUE;
 		priv->initial_probe_cancelled = TRUE;
 
 		/* This is to wake up the thread if it
@@ -221,11 +264,6 @@ rejilla_drive_cancel_probing (RejillaDrive *drive)
 		g_cond_wait (priv->cond, priv->mutex);
 	}
 	g_mutex_unlock (priv->mutex);
-
-	if (priv->probe_id) {
-		g_source_remove (priv->probe_id);
-		priv->probe_id = 0;
-	}
 }
 
 static void
@@ -235,6 +273,11 @@ rejilla_drive_wait_probing_thread (RejillaDrive *drive)
 
 	priv = REJILLA_DRIVE_PRIVATE (drive);
 
+	/* Checking the drive again is pointless before the end of the
+	 * operation; it will be done afterwards */
+	if (rejilla_drive_stop_polling (drive))
+		priv->probe_waiting = TRUE;
+
 	g_mutex_lock (priv->mutex);
 	if (priv->probe) {
 		/* This is to wake up the thread if it
@@ -865,7 +908,7 @@ rejilla_drive_probing (RejillaDrive *drive)
 	g_return_val_if_fail (REJILLA_IS_DRIVE (drive), FALSE);
 
 	priv = REJILLA_DRIVE_PRIVATE (drive);
-	if (priv->probe != NULL)
+	if (priv->probe != NULL || priv->poll_handle || priv->poll_id)
 		return TRUE;
 
 	if (priv->medium)
@@ -874,6 +917,110 @@ rejilla_drive_probing (RejillaDrive *drive)
 	return FALSE;
 }
 
+static void
+rejilla_drive_wait (GMutex *mutex,
+		    GCond *cond,
+		    RejillaDriveCancelledFunc cancelled,
+		    gpointer user_data,
+		    gint msecs)
+{
+	GTimeVal wait_time;
+
+	g_get_current_time (&wait_time);
+	g_time_val_add (&wait_time, msecs * 1000);
+
+	/* Cancellation is set with the mutex held, so checking it here
+	 * guarantees the wake up is not missed */
+	g_mutex_lock (mutex);
+	if (!cancelled (user_data))
+		g_cond_timed_wait (cond, mutex, &wait_time);
+	g_mutex_unlock (mutex);
+}
+
+/**
+ * This is not public API. Defined in rejilla-drive-priv.h.
+ * The drive might be busy (a burning is going on) so we don't block
+ * but retry to open it, more and more rarely, until we give up, cond
+ * is signalled or cancelled () returns TRUE.
+ */
+RejillaDeviceHandle *
+rejilla_drive_open_handle_wait (const gchar *device,
+				GMutex *mutex,
+				GCond *cond,
+				RejillaDriveCancelledFunc cancelled,
+				gpointer user_data,
+				RejillaScsiErrCode *code)
+{
+	RejillaDeviceHandle *handle;
+	gint interval = REJILLA_DRIVE_WAIT_MIN;
+	gint waited = 0;
+
+	handle = rejilla_device_handle_open (device, FALSE, code);
+	while (!handle && waited < REJILLA_DRIVE_OPEN_TIMEOUT) {
+		rejilla_drive_wait (mutex, cond, cancelled, user_data, interval);
+		if (cancelled (user_data))
+			return NULL;
+
+		waited += interval;
+		interval = MIN (interval * 2, REJILLA_DRIVE_WAIT_MAX);
+
+		handle = rejilla_device_handle_open (device, FALSE, code);
+	}
+
+	return handle;
+}
+
+/**
+ * This is not public API. Defined in rejilla-drive-priv.h.
+ * Waits until the drive is ready (medium loaded and spun up). Returns
+ * REJILLA_SCSI_OK when it is; otherwise code tells why (no medium, drive
+ * not responding). Returns REJILLA_SCSI_FAILURE as well when cancelled.
+ */
+RejillaScsiResult
+rejilla_drive_wait_unit_ready (RejillaDeviceHandle *handle,
+			       GMutex *mutex,
+			       GCond *cond,
+			       RejillaDriveCancelledFunc cancelled,
+			       gpointer user_data,
+			       RejillaScsiErrCode *code)
+{
+	gint interval = REJILLA_DRIVE_WAIT_MIN;
+	RejillaScsiErrCode err = REJILLA_SCSI_ERROR_NONE;
+
+	while (rejilla_spc1_test_unit_ready (handle, &err) != REJILLA_SCSI_OK) {
+		RejillaScsiMediaEventData event;
+		RejillaScsiResult res;
+
+		if (err != REJILLA_SCSI_NOT_READY)
+			goto end;
+
+		rejilla_drive_wait (mutex, cond, cancelled, user_data, interval);
+		if (cancelled (user_data))
+			goto end;
+
+		/* A media event means the drive state is changing (tray closed,
+		 * medium loaded) so keep checking often. Otherwise back off.
+		 * Drives not supporting this command just get backed off. */
+		res = rejilla_mmc2_get_event_status_media (handle, &event, NULL);
+		if (res == REJILLA_SCSI_OK
+		&&  event.desc.event_code != REJILLA_SCSI_MEDIA_EVENT_NO_CHANGE) {
+			REJILLA_MEDIA_LOG ("Media event %i", event.desc.event_code);
+			interval = REJILLA_DRIVE_WAIT_MIN;
+		}
+		else
+			interval = MIN (interval * 2, REJILLA_DRIVE_WAIT_MAX);
+	}
+
+	err = REJILLA_SCSI_ERROR_NONE;
+
+end:
+
+	if (code)
+		*code = err;
+
+	return (err == REJILLA_SCSI_ERROR_NONE)? REJILLA_SCSI_OK:REJILLA_SCSI_FAILURE;
+}
+
 static void
 rejilla_drive_update_medium (RejillaDrive *drive)
 {
@@ -914,121 +1061,159 @@ rejilla_drive_update_medium (RejillaDrive *drive)
 	}
 }
 
-static gboolean
-rejilla_drive_probed_inside (gpointer data)
+static void
+rejilla_drive_poll_finished (RejillaDrive *drive,
+			     gboolean has_medium)
 {
-	RejillaDrive *self;
 	RejillaDrivePrivate *priv;
 
-	self = REJILLA_DRIVE (data);
-	priv = REJILLA_DRIVE_PRIVATE (self);
-
-	if (!g_mutex_trylock (priv->mutex))
-		return TRUE;
+	priv = REJILLA_DRIVE_PRIVATE (drive);
 
-	priv->probe_id = 0;
-	g_mutex_unlock (priv->mutex);
+	rejilla_drive_stop_polling (drive);
 
-	rejilla_drive_update_medium (self);
-	return FALSE;
+	priv->has_medium = has_medium;
+	rejilla_drive_update_medium (drive);
 }
 
-static gpointer
-rejilla_drive_probe_inside_thread (gpointer data)
+static void
+rejilla_drive_poll_unit_ready (RejillaDrive *drive);
+
+static void
+rejilla_drive_poll_event_cb (RejillaScsiResult result,
+			     RejillaScsiErrCode code,
+			     gpointer user_data)
 {
-	gint counter = 0;
-	GTimeVal wait_time;
-	const gchar *device;
-	RejillaScsiErrCode code;
+	RejillaDrive *drive = REJILLA_DRIVE (user_data);
 	RejillaDrivePrivate *priv;
-	RejillaDeviceHandle *handle = NULL;
-	RejillaDrive *drive = REJILLA_DRIVE (data);
 
 	priv = REJILLA_DRIVE_PRIVATE (drive);
+	if (!priv->poll_handle)
+		return;
 
-	/* the drive might be busy (a burning is going on) so we don't block
-	 * but we re-try to open it every second */
-	device = rejilla_drive_get_device (drive);
-	REJILLA_MEDIA_LOG ("Trying to open device %s", device);
+	/* A media event means the drive state is changing (tray closed,
+	 * medium loaded) so keep checking often. Otherwise back off.
+	 * Drives not supporting this command just get backed off. */
+	if (result == REJILLA_SCSI_OK
+	&&  priv->poll_event.desc.event_code != REJILLA_SCSI_MEDIA_EVENT_NO_CHANGE) {
+		REJILLA_MEDIA_LOG ("Media event %i", priv->poll_event.desc.event_code);
+		priv->poll_interval = REJILLA_DRIVE_WAIT_MIN;
+	}
+	else
+		priv->poll_interval = MIN (priv->poll_interval * 2, REJILLA_DRIVE_WAIT_MAX);
 
-	priv->has_medium = FALSE;
+	rejilla_drive_poll_unit_ready (drive);
+}
 
-	handle = rejilla_device_handle_open (device, FALSE, &code);
-	while (!handle && counter <= REJILLA_DRIVE_OPEN_ATTEMPTS) {
-		sleep (1);
+static gboolean
+rejilla_drive_poll_event (gpointer data)
+{
+	RejillaDrive *drive = REJILLA_DRIVE (data);
+	RejillaDrivePrivate *priv;
+	RejillaScsiResult res;
 
-		if (priv->probe_cancelled) {
-			REJILLA_MEDIA_LOG ("Open () cancelled");
-			goto end;
-		}
+	priv = REJILLA_DRIVE_PRIVATE (drive);
+	priv->poll_id = 0;
 
-		counter ++;
-		handle = rejilla_device_handle_open (device, FALSE, &code);
-	}
+	res = rejilla_mmc2_get_event_status_media_async (priv->poll_handle,
+							 &priv->poll_event,
+							 REJILLA_DRIVE_POLL_TIMEOUT,
+							 rejilla_drive_poll_event_cb,
+							 drive,
+							 NULL);
+	if (res != REJILLA_SCSI_OK)
+		rejilla_drive_poll_event_cb (res, REJILLA_SCSI_ERR_UNKNOWN, drive);
 
-	if (!handle) {
-		REJILLA_MEDIA_LOG ("Open () failed: medium busy");
-		goto end;
-	}
+	return FALSE;
+}
 
-	if (priv->probe_cancelled) {
-		REJILLA_MEDIA_LOG ("Open () cancelled");
+static void
+rejilla_drive_poll_unit_ready_cb (RejillaScsiResult result,
+				  RejillaScsiErrCode code,
+				  gpointer user_data)
+{
+	RejillaDrive *drive = REJILLA_DRIVE (user_data);
+	RejillaDrivePrivate *priv;
 
-		rejilla_device_handle_close (handle);
-		goto end;
+	priv = REJILLA_DRIVE_PRIVATE (drive);
+	if (!priv->poll_handle) {
+		REJILLA_MEDIA_LOG ("Device probing cancelled");
+		return;
 	}
 
-	while (rejilla_spc1_test_unit_ready (handle, &code) != REJILLA_SCSI_OK) {
-		if (code == REJILLA_SCSI_NO_MEDIUM) {
-			REJILLA_MEDIA_LOG ("No medium inserted");
-
-			rejilla_device_handle_close (handle);
-			goto end;
-		}
-
-		if (code != REJILLA_SCSI_NOT_READY) {
-			REJILLA_MEDIA_LOG ("Device does not respond");
+	if (result == REJILLA_SCSI_OK) {
+		REJILLA_MEDIA_LOG ("Medium inserted");
+		rejilla_drive_poll_finished (drive, TRUE);
+		return;
+	}
 
-			rejilla_device_handle_close (handle);
-			goto end;
-		}
+	if (code == REJILLA_SCSI_NO_MEDIUM) {
+		REJILLA_MEDIA_LOG ("No medium inserted");
+		rejilla_drive_poll_finished (drive, FALSE);
+		return;
+	}
 
-		g_get_current_time (&wait_time);
-		g_time_val_add (&wait_time, 2000000);
+	if (code != REJILLA_SCSI_NOT_READY) {
+		REJILLA_MEDIA_LOG ("Device does not respond");
+		rejilla_drive_poll_finished (drive, FALSE);
+		return;
+	}
 
-		g_mutex_lock (priv->mutex);
-		g_cond_timed_wait (priv->cond_probe,
-		                   priv->mutex,
-		                   &wait_time);
-		g_mutex_unlock (priv->mutex);
+	priv->poll_id = g_timeout_add (priv->poll_interval,
+				       rejilla_drive_poll_event,
+				       drive);
+}
 
-		if (priv->probe_cancelled) {
-			REJILLA_MEDIA_LOG ("Device probing cancelled");
+static void
+rejilla_drive_poll_unit_ready (RejillaDrive *drive)
+{
+	RejillaDrivePrivate *priv;
+	RejillaScsiResult res;
 
-			rejilla_device_handle_close (handle);
-			goto end;
-		}
+	priv = REJILLA_DRIVE_PRIVATE (drive);
+	res = rejilla_spc1_test_unit_ready_async (priv->poll_handle,
+						  REJILLA_DRIVE_POLL_TIMEOUT,
+						  rejilla_drive_poll_unit_ready_cb,
+						  drive,
+						  NULL);
+	if (res != REJILLA_SCSI_OK) {
+		REJILLA_MEDIA_LOG ("Device does not respond");
+		rejilla_drive_poll_finished (drive, FALSE);
 	}
+}
 
-	REJILLA_MEDIA_LOG ("Medium inserted");
-	rejilla_device_handle_close (handle);
-
-	priv->has_medium = TRUE;
+static gboolean
+rejilla_drive_poll_open (gpointer data)
+{
+	RejillaDrive *drive = REJILLA_DRIVE (data);
+	RejillaDrivePrivate *priv;
+	const gchar *device;
 
-end:
+	priv = REJILLA_DRIVE_PRIVATE (drive);
+	priv->poll_id = 0;
 
-	g_mutex_lock (priv->mutex);
+	/* the drive might be busy (a burning is going on) so we don't block
+	 * but we re-try to open it (more and more rarely) */
+	device = rejilla_drive_get_device (drive);
+	priv->poll_handle = rejilla_device_handle_open (device, FALSE, NULL);
+	if (!priv->poll_handle) {
+		if (priv->poll_waited >= REJILLA_DRIVE_OPEN_TIMEOUT) {
+			REJILLA_MEDIA_LOG ("Open () failed: medium busy");
+			rejilla_drive_poll_finished (drive, FALSE);
+			return FALSE;
+		}
 
-	if (!priv->probe_cancelled)
-		priv->probe_id = g_idle_add (rejilla_drive_probed_inside, drive);
+		priv->poll_id = g_timeout_add (priv->poll_interval,
+					       rejilla_drive_poll_open,
+					       drive);
 
-	priv->probe = NULL;
-	g_cond_broadcast (priv->cond);
-	g_mutex_unlock (priv->mutex);
-
-	g_thread_exit (0);
+		priv->poll_waited += priv->poll_interval;
+		priv->poll_interval = MIN (priv->poll_interval * 2, REJILLA_DRIVE_WAIT_MAX);
+		return FALSE;
+	}
 
-	return NULL;
+	priv->poll_interval = REJILLA_DRIVE_WAIT_MIN;
+	rejilla_drive_poll_unit_ready (drive);
+	return FALSE;
 }
 
 static void
@@ -1044,24 +1229,22 @@ rejilla_drive_probe_inside (RejillaDrive *drive)
 	}
 
 	/* Check that a probe is not already being performed */
-	if (priv->probe) {
+	if (priv->poll_handle || priv->poll_id) {
 		REJILLA_MEDIA_LOG ("Ongoing probe");
 		rejilla_drive_cancel_probing (drive);
 	}
 
 	REJILLA_MEDIA_LOG ("Setting new probe");
+	REJILLA_MEDIA_LOG ("Trying to open device %s", rejilla_drive_get_device (drive));
 
-	g_mutex_lock (priv->mutex);
-
+	/* NOTE: no thread here; commands are asynchronous so that a slow drive
+	 * doesn't block the UI */
 	priv->probe_waiting = FALSE;
-	priv->probe_cancelled = FALSE;
-
-	priv->probe = g_thread_create (rejilla_drive_probe_inside_thread,
-	                               drive,
-				       FALSE,
-				       NULL);
+	priv->has_medium = FALSE;
+	priv->poll_interval = REJILLA_DRIVE_WAIT_MIN;
+	priv->poll_waited = 0;
 
-	g_mutex_unlock (priv->mutex);
+	rejilla_drive_poll_open (drive);
 }
 
 static void
@@ -1086,6 +1269,12 @@ rejilla_drive_medium_gdrive_changed_cb (RejillaDrive *gdrive,
 	}
 
 	REJILLA_MEDIA_LOG ("GDrive changed");
+
+	/* If the medium is waiting for the drive to be ready, have it check
+	 * again right away */
+	if (priv->medium)
+		rejilla_medium_wake_probe (priv->medium);
+
 	rejilla_drive_probe_inside (drive);
 }
 
@@ -1306,11 +1495,18 @@ rejilla_drive_get_caps_2A (RejillaDrive *self,
 	g_free (data);
 }
 
+static gboolean
+rejilla_drive_initial_probe_cancelled_cb (gpointer data)
+{
+	RejillaDrivePrivate *priv;
+
+	priv = REJILLA_DRIVE_PRIVATE (data);
+	return priv->initial_probe_cancelled;
+}
+
 static gpointer
 rejilla_drive_probe_thread (gpointer data)
 {
-	gint counter = 0;
-	GTimeVal wait_time;
 	const gchar *device;
 	RejillaScsiResult res;
 	RejillaScsiInquiry hdr;
@@ -1322,25 +1518,21 @@ rejilla_drive_probe_thread (gpointer data)
 	priv = REJILLA_DRIVE_PRIVATE (drive);
 
 	/* the drive might be busy (a burning is going on) so we don't block
-	 * but we re-try to open it every second */
+	 * but we re-try to open it (more and more rarely) */
 	device = rejilla_drive_get_device (drive);
 	REJILLA_MEDIA_LOG ("Trying to open device %s", device);
 
-	handle = rejilla_device_handle_open (device, FALSE, &code);
-	while (!handle && counter <= REJILLA_DRIVE_OPEN_ATTEMPTS) {
-		sleep (1);
-
-		if (priv->initial_probe_cancelled) {
-			REJILLA_MEDIA_LOG ("Open () cancelled");
-			goto end;
-		}
-
-		counter ++;
-		handle = rejilla_device_handle_open (device, FALSE, &code);
-	}
-
+	handle = rejilla_drive_open_handle_wait (device,
+						 priv->mutex,
+						 priv->cond_probe,
+						 rejilla_drive_initial_probe_cancelled_cb,
+						 drive,
+						 &code);
 	if (priv->initial_probe_cancelled) {
 		REJILLA_MEDIA_LOG ("Open () cancelled");
+
+		if (handle)
+			rejilla_device_handle_close (handle);
 		goto end;
 	}
 
@@ -1349,32 +1541,28 @@ rejilla_drive_probe_thread (gpointer data)
 		goto end;
 	}
 
-	while (rejilla_spc1_test_unit_ready (handle, &code) != REJILLA_SCSI_OK) {
-		if (code == REJILLA_SCSI_NO_MEDIUM) {
-			REJILLA_MEDIA_LOG ("No medium inserted");
-			goto capabilities;
-		}
-
-		if (code != REJILLA_SCSI_NOT_READY) {
-			rejilla_device_handle_close (handle);
-			REJILLA_MEDIA_LOG ("Device does not respond");
-			goto end;
-		}
+	rejilla_drive_wait_unit_ready (handle,
+				       priv->mutex,
+				       priv->cond_probe,
+				       rejilla_drive_initial_probe_cancelled_cb,
+				       drive,
+				       &code);
 
-		g_get_current_time (&wait_time);
-		g_time_val_add (&wait_time, 2000000);
+	if (priv->initial_probe_cancelled) {
+		rejilla_device_handle_close (handle);
+		REJILLA_MEDIA_LOG ("Device probing cancelled");
+		goto end;
+	}
 
-		g_mutex_lock (priv->mutex);
-		g_cond_timed_wait (priv->cond_probe,
-		                   priv->mutex,
-		                   &wait_time);
-		g_mutex_unlock (priv->mutex);
+	if (code == REJILLA_SCSI_NO_MEDIUM) {
+		REJILLA_MEDIA_LOG ("No medium inserted");
+		goto capabilities;
+	}
 
-		if (priv->initial_probe_cancelled) {
-			rejilla_device_handle_close (handle);
-			REJILLA_MEDIA_LOG ("Device probing cancelled");
-			goto end;
-		}
+	if (code != REJILLA_SCSI_ERROR_NONE) {
+		rejilla_device_handle_close (handle);
+		REJILLA_MEDIA_LOG ("Device does not respond");
+		goto end;
 	}
 
 	REJILLA_MEDIA_LOG ("Device ready");
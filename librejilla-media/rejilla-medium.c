@@ -36,6 +36,7 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <glib.h>
@@ -98,6 +99,12 @@ struct _RejillaMediumPrivate
 
 	gchar *id;
 
+	/* Manufacturer of a recordable disc */
+	gchar *media_id;
+
+	/* Fingerprint of the contents; NULL when they can change unnoticed */
+	gchar *identity;
+
 	guint max_rd;
 	guint max_wrt;
 
@@ -115,6 +122,10 @@ struct _RejillaMediumPrivate
 
 	gchar *CD_TEXT_title;
 
+	/* Mode page 2A as read during the current probe */
+	RejillaScsiModeData *page_2A;
+	int page_2A_size;
+
 	/* Do we really need both? */
 	guint dummy_sao:1;
 	guint dummy_tao:1;
@@ -130,15 +141,6 @@ struct _RejillaMediumPrivate
 
 #define REJILLA_MEDIUM_PRIVATE(o)  (G_TYPE_INSTANCE_GET_PRIVATE ((o), REJILLA_TYPE_MEDIUM, RejillaMediumPrivate))
 
-/**
- * Try to open the drive exclusively but don't block; if drive can't be opened
- * exclusively then retry every second until we're shut or the drive state
- * changes to not busy.
- * No exclusive at the moment since when the medium is mounted we can't use excl
- */
-
-#define BUSY_RETRY_TIME			1000
-
 typedef enum {
 	REJILLA_MEDIUM_TRACK_NONE		= 0,
 	REJILLA_MEDIUM_TRACK_DATA		= 1,
@@ -171,7 +173,50 @@ enum {
 };
 static gulong medium_signals [LAST_SIGNAL] = {0, };
 
-#define REJILLA_MEDIUM_OPEN_ATTEMPTS			5
+/**
+ * The results of the last probes are kept around so that a disc that was
+ * already probed in a drive is available immediately when it is reinserted.
+ * Only discs whose contents can't change without their TOC changing are
+ * concerned.
+ */
+
+#define REJILLA_MEDIUM_CACHE_MAX			16
+
+typedef struct _RejillaMediumCacheEntry RejillaMediumCacheEntry;
+struct _RejillaMediumCacheEntry {
+	gchar *identity;
+
+	RejillaMedia info;
+	const gchar *type;
+	gchar *id;
+	gchar *media_id;
+
+	GSList *tracks;
+
+	guint max_rd;
+	guint max_wrt;
+	guint *rd_speeds;
+	guint *wr_speeds;
+
+	goffset block_num;
+	goffset block_size;
+
+	guint first_open_track;
+	goffset next_wr_add;
+
+	gchar *CD_TEXT_title;
+
+	guint dummy_sao:1;
+	guint dummy_tao:1;
+	guint burnfree:1;
+	guint sao:1;
+	guint tao:1;
+	guint blank_command:1;
+	guint write_command:1;
+};
+
+G_LOCK_DEFINE_STATIC (probe_cache_lock);
+static GQueue *probe_cache = NULL;
 
 static GObjectClass* parent_class = NULL;
 
@@ -1060,6 +1105,34 @@ rejilla_medium_test_DVDRW_incremental_simulate (RejillaMedium *self,
  * This is a last resort when the initialization has failed.
  */
 
+static RejillaScsiResult
+rejilla_medium_get_page_2A (RejillaMedium *self,
+			    RejillaDeviceHandle *handle,
+			    RejillaScsiModeData **data,
+			    int *size,
+			    RejillaScsiErrCode *code)
+{
+	RejillaMediumPrivate *priv;
+	RejillaScsiResult result;
+
+	priv = REJILLA_MEDIUM_PRIVATE (self);
+
+	/* Several steps of a probe may need this page; only ask once */
+	if (!priv->page_2A) {
+		result = rejilla_spc1_mode_sense_get_page (handle,
+							   REJILLA_SPC_PAGE_STATUS,
+							   &priv->page_2A,
+							   &priv->page_2A_size,
+							   code);
+		if (result != REJILLA_SCSI_OK)
+			return result;
+	}
+
+	*data = priv->page_2A;
+	*size = priv->page_2A_size;
+	return REJILLA_SCSI_OK;
+}
+
 static void
 rejilla_medium_test_2A_simulate (RejillaMedium *self,
 				 RejillaDeviceHandle *handle,
@@ -1074,11 +1147,11 @@ rejilla_medium_test_2A_simulate (RejillaMedium *self,
 	priv = REJILLA_MEDIUM_PRIVATE (self);
 
 	/* FIXME: we need to get a way to get the write types */
-	result = rejilla_spc1_mode_sense_get_page (handle,
-						   REJILLA_SPC_PAGE_STATUS,
-						   &data,
-						   &size,
-						   code);
+	result = rejilla_medium_get_page_2A (self,
+					     handle,
+					     &data,
+					     &size,
+					     code);
 	if (result != REJILLA_SCSI_OK) {
 		REJILLA_MEDIA_LOG ("MODE SENSE failed");
 		return;
@@ -1095,8 +1168,6 @@ rejilla_medium_test_2A_simulate (RejillaMedium *self,
 
 	priv->blank_command = (page_2A->wr_CDRW != 0);
 	REJILLA_MEDIA_LOG ("Medium %s be blanked", priv->blank_command? "can":"cannot");
-
-	g_free (data);
 }
 
 static void
@@ -1423,11 +1494,11 @@ rejilla_medium_get_page_2A_write_speed_desc (RejillaMedium *self,
 	REJILLA_MEDIA_LOG ("Retrieving speed (2A speeds)");
 
 	priv = REJILLA_MEDIUM_PRIVATE (self);
-	result = rejilla_spc1_mode_sense_get_page (handle,
-						   REJILLA_SPC_PAGE_STATUS,
-						   &data,
-						   &size,
-						   code);
+	result = rejilla_medium_get_page_2A (self,
+					     handle,
+					     &data,
+					     &size,
+					     code);
 	if (result != REJILLA_SCSI_OK) {
 		REJILLA_MEDIA_LOG ("MODE SENSE failed");
 		return FALSE;
@@ -1439,7 +1510,6 @@ rejilla_medium_get_page_2A_write_speed_desc (RejillaMedium *self,
  	size = MIN (size, sizeof (data->hdr.len) + REJILLA_GET_16 (data->hdr.len));
 
 	if (size < (G_STRUCT_OFFSET (RejillaScsiStatusPage, copy_mngt_rev) + sizeof (RejillaScsiModeHdr))) {
-		g_free (data);
 		REJILLA_MEDIA_LOG ("wrong page size");
 		return FALSE;
 	}
@@ -1459,8 +1529,6 @@ rejilla_medium_get_page_2A_write_speed_desc (RejillaMedium *self,
 		priv->wr_speeds [0] = REJILLA_GET_16 (page_2A->wr_max_speed);
 		priv->rd_speeds = g_new0 (guint, 2);
 		priv->rd_speeds [0] = REJILLA_GET_16 (page_2A->rd_max_speed);
-
-		g_free (data);
 		return TRUE;
 	}
 
@@ -1493,7 +1561,6 @@ rejilla_medium_get_page_2A_write_speed_desc (RejillaMedium *self,
 		priv->max_wrt = max_wrt;
 
 	REJILLA_MEDIA_LOG ("Maximum Speed (Page 2A) %i", priv->max_wrt);
-	g_free (data);
 
 	return TRUE;
 }
@@ -2211,6 +2278,98 @@ rejilla_medium_get_DVD_id (RejillaMedium *self,
 	g_free (hdr);
 }
 
+/**
+ * The manufacturer and the dye of a recordable disc are what make the speed
+ * it can be reliably written at vary between discs of the same type.
+ */
+
+static gchar *
+rejilla_medium_media_id_from_data (const uchar *data,
+				   int len1,
+				   const uchar *data2,
+				   int len2)
+{
+	GString *string;
+	int i;
+
+	string = g_string_new (NULL);
+	for (i = 0; i < len1; i ++)
+		g_string_append_c (string, g_ascii_isprint (data [i]) ? data [i]:' ');
+
+	if (data2) {
+		g_string_append_c (string, '/');
+		for (i = 0; i < len2; i ++)
+			g_string_append_c (string, g_ascii_isprint (data2 [i]) ? data2 [i]:' ');
+	}
+
+	g_strstrip (string->str);
+	return g_string_free (string, FALSE);
+}
+
+static void
+rejilla_medium_read_media_id (RejillaMedium *self,
+			      RejillaDeviceHandle *handle,
+			      RejillaScsiErrCode *code)
+{
+	RejillaScsiReadDiscStructureHdr *hdr = NULL;
+	RejillaMediumPrivate *priv;
+	RejillaScsiResult result;
+	int size = 0;
+
+	priv = REJILLA_MEDIUM_PRIVATE (self);
+
+	if (priv->info & REJILLA_MEDIUM_ROM)
+		return;
+
+	if (priv->info & REJILLA_MEDIUM_CD) {
+		RejillaScsiAtipData *atip = NULL;
+
+		/* The start of the lead-in identifies the manufacturer */
+		result = rejilla_mmc1_read_atip (handle, &atip, &size, code);
+		if (result != REJILLA_SCSI_OK)
+			return;
+
+		if (size >= sizeof (RejillaScsiTocPmaAtipHdr) + 8)
+			priv->media_id = g_strdup_printf ("%02i:%02i:%02i",
+							  atip->desc->leadin_mn,
+							  atip->desc->leadin_sec,
+							  atip->desc->leadin_frame);
+		g_free (atip);
+	}
+	else if (REJILLA_MEDIUM_IS (priv->info, REJILLA_MEDIUM_DVD|REJILLA_MEDIUM_PLUS)) {
+		/* Manufacturer and media type IDs from ADIP */
+		result = rejilla_mmc2_read_generic_structure (handle,
+							      REJILLA_SCSI_FORMAT_PLUS_ADIP,
+							      &hdr,
+							      &size,
+							      code);
+		if (result != REJILLA_SCSI_OK)
+			return;
+
+		if (size >= sizeof (RejillaScsiReadDiscStructureHdr) + 30)
+			priv->media_id = rejilla_medium_media_id_from_data (hdr->data + 19, 8,
+									    hdr->data + 27, 3);
+		g_free (hdr);
+	}
+	else if (priv->info & REJILLA_MEDIUM_DVD) {
+		/* Manufacturer ID from the pre-pit data (DVD-R/-RW) */
+		result = rejilla_mmc2_read_generic_structure (handle,
+							      REJILLA_SCSI_FORMAT_LESS_PRE_PIT_INFO,
+							      &hdr,
+							      &size,
+							      code);
+		if (result != REJILLA_SCSI_OK)
+			return;
+
+		if (size >= sizeof (RejillaScsiReadDiscStructureHdr) + 31)
+			priv->media_id = rejilla_medium_media_id_from_data (hdr->data + 17, 6,
+									    hdr->data + 25, 6);
+		g_free (hdr);
+	}
+
+	REJILLA_MEDIA_LOG ("Media id %s", priv->media_id);
+}
+
 static gboolean
 rejilla_medium_set_blank (RejillaMedium *self,
 			  RejillaDeviceHandle *handle,
@@ -2888,76 +3047,311 @@ rejilla_medium_read_CD_TEXT (RejillaMedium *self,
 	g_free (cd_text);
 }
 
+/**
+ * Functions to save and restore the results of a probe
+ */
+
+static guint *
+rejilla_medium_copy_speeds (const guint *speeds)
+{
+	guint num;
+
+	if (!speeds)
+		return NULL;
+
+	for (num = 0; speeds [num] != 0; num ++);
+	return g_memdup (speeds, (num + 1) * sizeof (guint));
+}
+
+static GSList *
+rejilla_medium_copy_tracks (GSList *tracks)
+{
+	GSList *copy = NULL;
+	GSList *iter;
+
+	for (iter = tracks; iter; iter = iter->next)
+		copy = g_slist_prepend (copy, g_memdup (iter->data, sizeof (RejillaMediumTrack)));
+
+	return g_slist_reverse (copy);
+}
+
 static void
-rejilla_medium_init_real (RejillaMedium *object,
-			  RejillaDeviceHandle *handle)
+rejilla_medium_cache_entry_free (RejillaMediumCacheEntry *entry)
 {
-	guint i;
-	gchar *name;
-	gboolean result;
+	g_slist_foreach (entry->tracks, (GFunc) g_free, NULL);
+	g_slist_free (entry->tracks);
+
+	g_free (entry->identity);
+	g_free (entry->id);
+	g_free (entry->media_id);
+	g_free (entry->rd_speeds);
+	g_free (entry->wr_speeds);
+	g_free (entry->CD_TEXT_title);
+	g_free (entry);
+}
+
+/**
+ * Returns a string identifying the drive and the disc inside or NULL if the
+ * results of the probe can't be reused.
+ */
+
+static gchar *
+rejilla_medium_get_identity (RejillaMedium *self,
+			     RejillaDeviceHandle *handle,
+			     RejillaScsiErrCode *code)
+{
+	RejillaScsiFormattedTocData *toc = NULL;
+	RejillaScsiDiscInfoStd *info = NULL;
 	RejillaMediumPrivate *priv;
-	RejillaScsiErrCode code = 0;
-	gchar buffer [256] = { 0, };
+	RejillaScsiResult result;
+	gchar *identity = NULL;
+	GChecksum *checksum;
+	const gchar *device;
+	int toc_size = 0;
+	gchar *name;
+	int size = 0;
 
-	priv = REJILLA_MEDIUM_PRIVATE (object);
+	priv = REJILLA_MEDIUM_PRIVATE (self);
+
+	/* Data can be overwritten on these without the TOC telling */
+	if (REJILLA_MEDIUM_RANDOM_WRITABLE (priv->info))
+		return NULL;
+
+	result = rejilla_mmc1_read_disc_information_std (handle,
+							 &info,
+							 &size,
+							 code);
+	if (result != REJILLA_SCSI_OK)
+		return NULL;
+
+	/* Blank discs of a type all look alike even if the speeds they can
+	 * be written at depend on their manufacturer */
+	if (info->status != REJILLA_SCSI_DISC_INCOMPLETE
+	&&  info->status != REJILLA_SCSI_DISC_FINALIZED)
+		goto end;
+
+	result = rejilla_mmc1_read_toc_formatted (handle,
+						  0,
+						  &toc,
+						  &toc_size,
+						  code);
+	if (result != REJILLA_SCSI_OK)
+		goto end;
+
+	if (toc_size < sizeof (RejillaScsiFormattedTocData))
+		goto end;
+
+	checksum = g_checksum_new (G_CHECKSUM_SHA1);
+
+	/* The same disc may not give the same results in another drive */
+	device = rejilla_drive_get_device (priv->drive);
+	if (device)
+		g_checksum_update (checksum, (guchar *) device, -1);
 
 	name = rejilla_drive_get_display_name (priv->drive);
-	REJILLA_MEDIA_LOG ("Initializing information for medium in %s", name);
+	if (name)
+		g_checksum_update (checksum, (guchar *) name, -1);
 	g_free (name);
 
-	if (priv->probe_cancelled)
-		return;
+	g_checksum_update (checksum, (guchar *) &priv->info, sizeof (priv->info));
+	g_checksum_update (checksum, (guchar *) info, size);
+	g_checksum_update (checksum, (guchar *) toc, toc_size);
 
-	result = rejilla_medium_get_medium_type (object, handle, &code);
-	if (result != TRUE)
-		return;
+	identity = g_strdup (g_checksum_get_string (checksum));
+	g_checksum_free (checksum);
 
-	if (priv->probe_cancelled)
-		return;
+end:
+
+	g_free (toc);
+	g_free (info);
+
+	return identity;
+}
+
+static gboolean
+rejilla_medium_cache_restore (RejillaMedium *self,
+			      const gchar *identity)
+{
+	RejillaMediumCacheEntry *entry = NULL;
+	RejillaMediumPrivate *priv;
+	GList *iter;
+
+	priv = REJILLA_MEDIUM_PRIVATE (self);
+
+	G_LOCK (probe_cache_lock);
+
+	if (!probe_cache)
+		goto end;
+
+	for (iter = probe_cache->head; iter; iter = iter->next) {
+		RejillaMediumCacheEntry *tmp;
+
+		tmp = iter->data;
+		if (!strcmp (tmp->identity, identity)) {
+			entry = tmp;
+			break;
+		}
+	}
+
+	if (!entry)
+		goto end;
+
+	/* Most recently used first */
+	g_queue_unlink (probe_cache, iter);
+	g_queue_push_head_link (probe_cache, iter);
 
-	result = rejilla_medium_get_speed (object, handle, &code);
+	priv->info = entry->info;
+	priv->type = entry->type;
+	priv->id = g_strdup (entry->id);
+	priv->media_id = g_strdup (entry->media_id);
+
+	priv->tracks = rejilla_medium_copy_tracks (entry->tracks);
+
+	/* Identifying the medium type may have set them already */
+	g_free (priv->rd_speeds);
+	g_free (priv->wr_speeds);
+
+	priv->max_rd = entry->max_rd;
+	priv->max_wrt = entry->max_wrt;
+	priv->rd_speeds = rejilla_medium_copy_speeds (entry->rd_speeds);
+	priv->wr_speeds = rejilla_medium_copy_speeds (entry->wr_speeds);
+
+	priv->block_num = entry->block_num;
+	priv->block_size = entry->block_size;
+
+	priv->first_open_track = entry->first_open_track;
+	priv->next_wr_add = entry->next_wr_add;
+
+	priv->CD_TEXT_title = g_strdup (entry->CD_TEXT_title);
+
+	priv->dummy_sao = entry->dummy_sao;
+	priv->dummy_tao = entry->dummy_tao;
+	priv->burnfree = entry->burnfree;
+	priv->sao = entry->sao;
+	priv->tao = entry->tao;
+	priv->blank_command = entry->blank_command;
+	priv->write_command = entry->write_command;
+
+end:
+
+	G_UNLOCK (probe_cache_lock);
+
+	return (entry != NULL);
+}
+
+static void
+rejilla_medium_cache_store (RejillaMedium *self,
+			    const gchar *identity)
+{
+	RejillaMediumCacheEntry *entry;
+	RejillaMediumPrivate *priv;
+
+	priv = REJILLA_MEDIUM_PRIVATE (self);
+
+	entry = g_new0 (RejillaMediumCacheEntry, 1);
+	entry->identity = g_strdup (identity);
+
+	entry->info = priv->info;
+	entry->type = priv->type;
+	entry->id = g_strdup (priv->id);
+	entry->media_id = g_strdup (priv->media_id);
+
+	entry->tracks = rejilla_medium_copy_tracks (priv->tracks);
+
+	entry->max_rd = priv->max_rd;
+	entry->max_wrt = priv->max_wrt;
+	entry->rd_speeds = rejilla_medium_copy_speeds (priv->rd_speeds);
+	entry->wr_speeds = rejilla_medium_copy_speeds (priv->wr_speeds);
+
+	entry->block_num = priv->block_num;
+	entry->block_size = priv->block_size;
+
+	entry->first_open_track = priv->first_open_track;
+	entry->next_wr_add = priv->next_wr_add;
+
+	entry->CD_TEXT_title = g_strdup (priv->CD_TEXT_title);
+
+	entry->dummy_sao = priv->dummy_sao;
+	entry->dummy_tao = priv->dummy_tao;
+	entry->burnfree = priv->burnfree;
+	entry->sao = priv->sao;
+	entry->tao = priv->tao;
+	entry->blank_command = priv->blank_command;
+	entry->write_command = priv->write_command;
+
+	G_LOCK (probe_cache_lock);
+
+	if (!probe_cache)
+		probe_cache = g_queue_new ();
+
+	g_queue_push_head (probe_cache, entry);
+	while (g_queue_get_length (probe_cache) > REJILLA_MEDIUM_CACHE_MAX)
+		rejilla_medium_cache_entry_free (g_queue_pop_tail (probe_cache));
+
+	G_UNLOCK (probe_cache_lock);
+}
+
+static gboolean
+rejilla_medium_init_real_probe (RejillaMedium *object,
+				RejillaDeviceHandle *handle,
+				RejillaScsiErrCode *code)
+{
+	guint i;
+	gboolean result;
+	RejillaMediumPrivate *priv;
+	gchar buffer [256] = { 0, };
+
+	priv = REJILLA_MEDIUM_PRIVATE (object);
+
+	result = rejilla_medium_get_speed (object, handle, code);
 	if (result != TRUE)
-		return;
+		return FALSE;
 
 	if (priv->probe_cancelled)
-		return;
+		return FALSE;
 
-	rejilla_medium_get_capacity_by_type (object, handle, &code);
+	rejilla_medium_get_capacity_by_type (object, handle, code);
 	if (priv->probe_cancelled)
-		return;
+		return FALSE;
 
-	rejilla_medium_init_caps (object, handle, &code);
+	rejilla_medium_init_caps (object, handle, code);
 	if (priv->probe_cancelled)
-		return;
+		return FALSE;
 
-	result = rejilla_medium_get_contents (object, handle, &code);
-	if (result != TRUE)
+	result = rejilla_medium_get_contents (object, handle, code);
 	if (result != TRUE)
-		return;
+		return FALSE;
 
 	if (priv->probe_cancelled)
-		return;
+		return FALSE;
 
 	/* assume that css feature is only for DVD-ROM which might be wrong but
 	 * some drives wrongly reports that css is enabled for blank DVD+R/W */
 	if (REJILLA_MEDIUM_IS (priv->info, (REJILLA_MEDIUM_DVD|REJILLA_MEDIUM_ROM)))
-		rejilla_medium_get_css_feature (object, handle, &code);
+		rejilla_medium_get_css_feature (object, handle, code);
 
 	if (priv->probe_cancelled)
-		return;
+		return FALSE;
 
 	/* read CD-TEXT title */
 	if (priv->info & REJILLA_MEDIUM_HAS_AUDIO)
-		rejilla_medium_read_CD_TEXT (object, handle, &code);
+		rejilla_medium_read_CD_TEXT (object, handle, code);
 
 	if (priv->probe_cancelled)
-		return;
+		return FALSE;
+
+	/* Only useful when it can be written */
+	if (priv->info & (REJILLA_MEDIUM_BLANK|REJILLA_MEDIUM_APPENDABLE|REJILLA_MEDIUM_REWRITABLE))
+		rejilla_medium_read_media_id (object, handle, code);
+
+	if (priv->probe_cancelled)
+		return FALSE;
 
 	rejilla_media_to_string (priv->info, buffer);
 	REJILLA_MEDIA_LOG ("media is %s", buffer);
 
 	if (!priv->wr_speeds)
-		return;
+		return TRUE;
 
 	/* sort write speeds */
 	for (i = 0; priv->wr_speeds [i] != 0; i ++) {
@@ -2973,6 +3367,66 @@ rejilla_medium_init_real (RejillaMedium *object,
 			}
 		}
 	}
+
+	return TRUE;
+}
+
+static void
+rejilla_medium_init_real (RejillaMedium *object,
+			  RejillaDeviceHandle *handle)
+{
+	gchar *name;
+	gboolean result;
+	gchar *identity;
+	RejillaMediumPrivate *priv;
+	RejillaScsiErrCode code = 0;
+	gchar buffer [256] = { 0, };
+
+	priv = REJILLA_MEDIUM_PRIVATE (object);
+
+	name = rejilla_drive_get_display_name (priv->drive);
+	REJILLA_MEDIA_LOG ("Initializing information for medium in %s", name);
+	g_free (name);
+
+	if (priv->probe_cancelled)
+		return;
+
+	result = rejilla_medium_get_medium_type (object, handle, &code);
+	if (result != TRUE)
+		return;
+
+	if (priv->probe_cancelled)
+		return;
+
+	identity = rejilla_medium_get_identity (object, handle, &code);
+	if (identity) {
+		result = rejilla_medium_cache_restore (object, identity);
+		if (result) {
+			REJILLA_MEDIA_LOG ("Medium already probed");
+			priv->identity = identity;
+
+			rejilla_media_to_string (priv->info, buffer);
+			REJILLA_MEDIA_LOG ("media is %s", buffer);
+			return;
+		}
+	}
+
+	result = rejilla_medium_init_real_probe (object, handle, &code);
+	if (result && identity && !priv->probe_cancelled)
+		rejilla_medium_cache_store (object, identity);
+
+	priv->identity = identity;
+}
+
+const gchar *
+rejilla_medium_get_probe_identity (RejillaMedium *medium)
+{
+	RejillaMediumPrivate *priv;
+
+	g_return_val_if_fail (REJILLA_IS_MEDIUM (medium), NULL);
+
+	priv = REJILLA_MEDIUM_PRIVATE (medium);
+	return priv->identity;
 }
 
 gboolean
@@ -3007,11 +3461,36 @@ rejilla_medium_probed (gpointer data)
 	return FALSE;
 }
 
+/**
+ * This is not public API. Defined in rejilla-drive-priv.h.
+ */
+void
+rejilla_medium_wake_probe (RejillaMedium *medium)
+{
+	RejillaMediumPrivate *priv;
+
+	g_return_if_fail (REJILLA_IS_MEDIUM (medium));
+
+	priv = REJILLA_MEDIUM_PRIVATE (medium);
+
+	g_mutex_lock (priv->mutex);
+	if (priv->probe)
+		g_cond_signal (priv->cond_probe);
+	g_mutex_unlock (priv->mutex);
+}
+
+static gboolean
+rejilla_medium_probe_cancelled_cb (gpointer data)
+{
+	RejillaMediumPrivate *priv;
+
+	priv = REJILLA_MEDIUM_PRIVATE (data);
+	return priv->probe_cancelled;
+}
+
 static gpointer
 rejilla_medium_probe_thread (gpointer self)
 {
-	gint counter = 0;
-	GTimeVal wait_time;
 	const gchar *device;
 	RejillaScsiErrCode code;
 	RejillaMediumPrivate *priv;
@@ -3022,19 +3501,20 @@ rejilla_medium_probe_thread (gpointer self)
 	priv->info = REJILLA_MEDIUM_BUSY;
 
 	/* the drive might be busy (a burning is going on) so we don't block
-	 * but we re-try to open it every second */
+	 * but we re-try to open it (more and more rarely) */
 	device = rejilla_drive_get_device (priv->drive);
 	REJILLA_MEDIA_LOG ("Trying to open device %s", device);
 
-	handle = rejilla_device_handle_open (device, FALSE, &code);
-	while (!handle && counter <= REJILLA_MEDIUM_OPEN_ATTEMPTS) {
-		sleep (1);
-
-		if (priv->probe_cancelled)
-			goto end;
-
-		counter ++;
-		handle = rejilla_device_handle_open (device, FALSE, &code);
+	handle = rejilla_drive_open_handle_wait (device,
+						 priv->mutex,
+						 priv->cond_probe,
+						 rejilla_medium_probe_cancelled_cb,
+						 self,
+						 &code);
+	if (priv->probe_cancelled) {
+		if (handle)
+			rejilla_device_handle_close (handle);
+		goto end;
 	}
 
 	if (!handle) {
@@ -3049,38 +3529,32 @@ rejilla_medium_probe_thread (gpointer self)
 
 	REJILLA_MEDIA_LOG ("Open () succeeded");
 
-	/* NOTE: if we wanted to know the status we'd need to read the 
-	 * error code variable which is currently NULL */
-	while (rejilla_spc1_test_unit_ready (handle, &code) != REJILLA_SCSI_OK) {
-		if (code == REJILLA_SCSI_NO_MEDIUM) {
-			REJILLA_MEDIA_LOG ("No medium inserted");
-			priv->info = REJILLA_MEDIUM_NONE;
-
-			rejilla_device_handle_close (handle);
-			goto end;
-		}
-		else if (code != REJILLA_SCSI_NOT_READY) {
-			REJILLA_MEDIA_LOG ("Device does not respond");
+	rejilla_drive_wait_unit_ready (handle,
+				       priv->mutex,
+				       priv->cond_probe,
+				       rejilla_medium_probe_cancelled_cb,
+				       self,
+				       &code);
 
-			rejilla_device_handle_close (handle);
-			goto end;
-		}
+	if (priv->probe_cancelled) {
+		REJILLA_MEDIA_LOG ("Device probing cancelled");
 
-		g_get_current_time (&wait_time);
-		g_time_val_add (&wait_time, 2000000);
+		rejilla_device_handle_close (handle);
+		goto end;
+	}
 
-		g_mutex_lock (priv->mutex);
-		g_cond_timed_wait (priv->cond_probe,
-		                   priv->mutex,
-		                   &wait_time);
-		g_mutex_unlock (priv->mutex);
+	if (code == REJILLA_SCSI_NO_MEDIUM) {
+		REJILLA_MEDIA_LOG ("No medium inserted");
+		priv->info = REJILLA_MEDIUM_NONE;
 
-		if (priv->probe_cancelled) {
-			REJILLA_MEDIA_LOG ("Device probing cancelled");
+		rejilla_device_handle_close (handle);
+		goto end;
+	}
+	else if (code != REJILLA_SCSI_ERROR_NONE) {
+		REJILLA_MEDIA_LOG ("Device does not respond");
 
-			rejilla_device_handle_close (handle);
-			goto end;
-		}
+		rejilla_device_handle_close (handle);
+		goto end;
 	}
 
 	REJILLA_MEDIA_LOG ("Device ready");
@@ -3088,6 +3562,9 @@ rejilla_medium_probe_thread (gpointer self)
 	rejilla_medium_init_real (REJILLA_MEDIUM (self), handle);
 	rejilla_device_handle_close (handle);
 
+	g_free (priv->page_2A);
+	priv->page_2A = NULL;
+
 end:
 
 	g_mutex_lock (priv->mutex);
@@ -3199,6 +3676,16 @@ rejilla_medium_finalize (GObject *object)
 		priv->id = NULL;
 	}
 
+	if (priv->media_id) {
+		g_free (priv->media_id);
+		priv->media_id = NULL;
+	}
+
+	if (priv->identity) {
+		g_free (priv->identity);
+		priv->identity = NULL;
+	}
+
 	if (priv->CD_TEXT_title) {
 		g_free (priv->CD_TEXT_title);
 		priv->CD_TEXT_title = NULL;
@@ -3517,6 +4004,28 @@ rejilla_medium_get_CD_TEXT_title (RejillaMedium *medium)
 
 }
 
+/**
+ * rejilla_medium_get_media_id:
+ * @medium: #RejillaMedium
+ *
+ * Gets a string identifying the manufacturer (and for some types the dye)
+ * of a recordable @medium as written on the disc itself.
+ *
+ * Return value: a #gchar * or NULL if it is not known.
+ *
+ **/
+const gchar *
+rejilla_medium_get_media_id (RejillaMedium *medium)
+{
+	RejillaMediumPrivate *priv;
+
+	g_return_val_if_fail (medium != NULL, NULL);
+	g_return_val_if_fail (REJILLA_IS_MEDIUM (medium), NULL);
+
+	priv = REJILLA_MEDIUM_PRIVATE (medium);
+	return priv->media_id;
+}
+
 GType
 rejilla_medium_get_type (void)
 {
@@ -109,6 +109,9 @@ rejilla_medium_can_be_written (RejillaMedium *medium);
 const gchar *
 rejilla_medium_get_CD_TEXT_title (RejillaMedium *medium);
 
+const gchar *
+rejilla_medium_get_media_id (RejillaMedium *medium);
+
 const gchar *
 rejilla_medium_get_type_string (RejillaMedium *medium);
 
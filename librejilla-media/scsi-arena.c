@@ -0,0 +1,181 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * Librejilla-media
+ * Copyright (C) Philippe Rouquier 2005-2009 <bonfire-app@wanadoo.fr>
+ *
+ * Librejilla-media is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The Librejilla-media authors hereby grant permission for non-GPL compatible
+ * GStreamer plugins to be used and distributed together with GStreamer
+ * and Librejilla-media. This permission is above and beyond the permissions granted
+ * by the GPL license by which Librejilla-media is covered. If you modify this code
+ * you may extend this exception to your version of the code, but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version.
+ * 
+ * Librejilla-media is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to:
+ * 	The Free Software Foundation, Inc.,
+ * 	51 Franklin Street, Fifth Floor
+ * 	Boston, MA  02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+#include "rejilla-media-private.h"
+
+#include "scsi-utils.h"
+#include "scsi-command.h"
+
+/* Number of freed commands kept around for later use */
+#define REJILLA_SCSI_ARENA_COMMANDS	4
+
+struct _RejillaScsiArena {
+	GSList *commands;
+	gsize command_size;
+
+	gpointer buffer;
+	int buffer_size;
+};
+
+RejillaScsiArena *
+rejilla_scsi_arena_new (void)
+{
+	return g_new0 (RejillaScsiArena, 1);
+}
+
+void
+rejilla_scsi_arena_free (RejillaScsiArena *arena)
+{
+	g_slist_foreach (arena->commands, (GFunc) g_free, NULL);
+	g_slist_free (arena->commands);
+
+	/* allocated with posix_memalign () */
+	if (arena->buffer)
+		free (arena->buffer);
+
+	g_free (arena);
+}
+
+gpointer
+rejilla_scsi_arena_get_command (RejillaScsiArena *arena,
+				gsize size)
+{
+	gpointer command;
+
+	/* All the commands of an OS implementation have the same size */
+	if (!arena->commands || arena->command_size != size) {
+		arena->command_size = size;
+		return g_malloc0 (size);
+	}
+
+	command = arena->commands->data;
+	arena->commands = g_slist_delete_link (arena->commands, arena->commands);
+
+	memset (command, 0, size);
+	return command;
+}
+
+void
+rejilla_scsi_arena_put_command (RejillaScsiArena *arena,
+				gpointer command)
+{
+	if (g_slist_length (arena->commands) >= REJILLA_SCSI_ARENA_COMMANDS) {
+		g_free (command);
+		return;
+	}
+
+	arena->commands = g_slist_prepend (arena->commands, command);
+}
+
+gpointer
+rejilla_scsi_arena_get_buffer (RejillaScsiArena *arena,
+			       int size)
+{
+	if (size > arena->buffer_size) {
+		long page_size;
+		gpointer buffer = NULL;
+		int buffer_size;
+
+		/* Page aligned buffers let the kernel map them directly
+		 * for DMA instead of going through a bounce buffer */
+		page_size = sysconf (_SC_PAGESIZE);
+		if (page_size <= 0)
+			page_size = 4096;
+
+		buffer_size = ((size + page_size - 1) / page_size) * page_size;
+		if (posix_memalign (&buffer, page_size, buffer_size))
+			return NULL;
+
+		if (arena->buffer)
+			free (arena->buffer);
+
+		arena->buffer = buffer;
+		arena->buffer_size = buffer_size;
+	}
+
+	memset (arena->buffer, 0, size);
+	return arena->buffer;
+}
+
+/**
+ * Used when the OS has no scatter-gather support: data is read into the
+ * scratch buffer and then copied into each buffer.
+ */
+
+RejillaScsiResult
+rejilla_scsi_command_issue_sync_bounce (gpointer command,
+					const struct iovec *iov,
+					int iov_count,
+					RejillaScsiErrCode *error)
+{
+	RejillaScsiResult res;
+	guchar *buffer;
+	gsize offset;
+	gsize size;
+	int i;
+
+	if (iov_count == 1)
+		return rejilla_scsi_command_issue_sync (command,
+							iov [0].iov_base,
+							iov [0].iov_len,
+							error);
+
+	size = 0;
+	for (i = 0; i < iov_count; i ++)
+		size += iov [i].iov_len;
+
+	buffer = rejilla_scsi_command_get_buffer (command, size);
+	if (!buffer) {
+		REJILLA_SCSI_SET_ERRCODE (error, REJILLA_SCSI_ERRNO);
+		return REJILLA_SCSI_FAILURE;
+	}
+
+	res = rejilla_scsi_command_issue_sync (command, buffer, size, error);
+	if (res != REJILLA_SCSI_OK)
+		return res;
+
+	offset = 0;
+	for (i = 0; i < iov_count; i ++) {
+		memcpy (iov [i].iov_base, buffer + offset, iov [i].iov_len);
+		offset += iov [i].iov_len;
+	}
+
+	return REJILLA_SCSI_OK;
+}
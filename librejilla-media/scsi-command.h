@@ -28,6 +28,8 @@
  * 	Boston, MA  02110-1301, USA.
  */
 
+#include <sys/uio.h>
+
 #include <glib.h>
 
 #include "scsi-device.h"
@@ -75,6 +77,110 @@ rejilla_scsi_command_issue_sync (gpointer command,
 				 gpointer buffer,
 				 int size,
 				 RejillaScsiErrCode *error);
+
+/**
+ * Lets a command transfer data directly to several (caller) buffers
+ */
+
+RejillaScsiResult
+rejilla_scsi_command_issue_sync_iov (gpointer command,
+				     const struct iovec *iov,
+				     int iov_count,
+				     RejillaScsiErrCode *error);
+
+/**
+ * Returns a zeroed page-aligned buffer of size bytes owned by the handle the
+ * command was created for. It remains valid until the next call for this
+ * handle so its contents must be copied before issuing another command.
+ */
+
+gpointer
+rejilla_scsi_command_get_buffer (gpointer command,
+				 int size);
+
+/**
+ * Asynchronous commands (see scsi-device.h): timeout is in milliseconds, 0
+ * meaning the default. The command then belongs to the handle which frees it
+ * before calling back, while buffer must remain valid until then. If issuing
+ * fails, there is no callback and the command remains the caller's.
+ */
+
+RejillaScsiResult
+rejilla_scsi_command_issue_async (gpointer command,
+				  gpointer buffer,
+				  int size,
+				  int timeout,
+				  RejillaScsiCommandCallback callback,
+				  gpointer user_data,
+				  RejillaScsiErrCode *error);
+
+/* Allocation length used when asking for a whole answer at once */
+#define REJILLA_SCSI_MAX_ALLOC_LEN	65530
+
+/**
+ * Each handle keeps the commands it created once freed as well as a scratch
+ * buffer so that issuing a command doesn't need any allocation.
+ * These are used by the OS specific implementations.
+ */
+
+typedef struct _RejillaScsiArena RejillaScsiArena;
+
+RejillaScsiArena *
+rejilla_scsi_arena_new (void);
+
+void
+rejilla_scsi_arena_free (RejillaScsiArena *arena);
+
+gpointer
+rejilla_scsi_arena_get_command (RejillaScsiArena *arena,
+				gsize size);
+
+void
+rejilla_scsi_arena_put_command (RejillaScsiArena *arena,
+				gpointer command);
+
+gpointer
+rejilla_scsi_arena_get_buffer (RejillaScsiArena *arena,
+			       int size);
+
+/**
+ * Delivers the answers to asynchronous commands. Implementations with no
+ * native asynchronous interface also push their commands there to have them
+ * issued one after the other by a thread (the timeout of synchronous commands
+ * applies then). It must be freed before the arena.
+ */
+
+typedef struct _RejillaScsiQueue RejillaScsiQueue;
+
+RejillaScsiQueue *
+rejilla_scsi_queue_new (void);
+
+void
+rejilla_scsi_queue_free (RejillaScsiQueue *queue);
+
+RejillaScsiResult
+rejilla_scsi_queue_push (RejillaScsiQueue *queue,
+			 gpointer command,
+			 gpointer buffer,
+			 int size,
+			 RejillaScsiCommandCallback callback,
+			 gpointer user_data,
+			 RejillaScsiErrCode *error);
+
+void
+rejilla_scsi_queue_complete (RejillaScsiQueue *queue,
+			     gpointer command,
+			     RejillaScsiResult result,
+			     RejillaScsiErrCode code,
+			     RejillaScsiCommandCallback callback,
+			     gpointer user_data);
+
+RejillaScsiResult
+rejilla_scsi_command_issue_sync_bounce (gpointer command,
+					const struct iovec *iov,
+					int iov_count,
+					RejillaScsiErrCode *error);
+
 G_END_DECLS
 
 #endif /* _BURN_SCSI_COMMAND_H */
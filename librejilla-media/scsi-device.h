@@ -47,9 +47,27 @@ rejilla_device_handle_open (const gchar *path,
 void
 rejilla_device_handle_close (RejillaDeviceHandle *handle);
 
+/* Used when the OS doesn't tell how much data a command can transfer */
+#define REJILLA_SCSI_DEFAULT_MAX_TRANSFER	65536
+
+int
+rejilla_device_handle_get_max_transfer (RejillaDeviceHandle *handle);
+
 char *
 rejilla_device_get_bus_target_lun (const gchar *device);
 
+/**
+ * Called from the default main context once the drive answered a command
+ * issued asynchronously. Handles used that way must be used and closed from
+ * the thread running the default main context. Closing one calls back its
+ * pending commands right away with REJILLA_SCSI_FAILURE; these callbacks
+ * must not use the handle.
+ */
+
+typedef void (*RejillaScsiCommandCallback) (RejillaScsiResult result,
+					    RejillaScsiErrCode code,
+					    gpointer user_data);
+
 G_END_DECLS
 
 #endif /* _SCSI_DEVICE_H */
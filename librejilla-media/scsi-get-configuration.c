@@ -100,7 +100,6 @@ rejilla_get_configuration (RejillaGetConfigCDB *cdb,
 			   RejillaScsiErrCode *error)
 {
 	RejillaScsiGetConfigHdr *buffer;
-	RejillaScsiGetConfigHdr hdr;
 	RejillaScsiResult res;
 	int request_size;
 	int buffer_size;
@@ -110,59 +109,39 @@ rejilla_get_configuration (RejillaGetConfigCDB *cdb,
 		return REJILLA_SCSI_FAILURE;
 	}
 
-	/* first issue the command once ... */
-	memset (&hdr, 0, sizeof (hdr));
-	REJILLA_SET_16 (cdb->alloc_len, sizeof (hdr));
-	res = rejilla_scsi_command_issue_sync (cdb, &hdr, sizeof (hdr), error);
-	if (res)
-		return res;
-
-	/* ... check the size returned ... */
-	request_size = REJILLA_GET_32 (hdr.len) +
-		       G_STRUCT_OFFSET (RejillaScsiGetConfigHdr, len) +
-		       sizeof (hdr.len);
-
-	/* NOTE: if size is not valid use the maximum possible size */
-	if ((request_size - sizeof (hdr)) % 8) {
-		REJILLA_MEDIA_LOG ("Unaligned data (%i) setting to max (65530)", request_size);
-		request_size = 65530;
-	}
-	else if (request_size <= sizeof (hdr)) {
-		/* NOTE: if there is a feature, the size must be larger than the
-		 * header size. */
-		REJILLA_MEDIA_LOG ("Undersized data (%i) setting to max (65530)", request_size);
-		request_size = 65530;
+	/* Ask for as much as possible at once into the handle buffer instead
+	 * of issuing the command a first time just to get the size */
+	request_size = REJILLA_SCSI_MAX_ALLOC_LEN;
+	buffer = rejilla_scsi_command_get_buffer (cdb, request_size);
+	if (!buffer) {
+		REJILLA_SCSI_SET_ERRCODE (error, REJILLA_SCSI_ERRNO);
+		return REJILLA_SCSI_FAILURE;
 	}
 
-	/* ... allocate a buffer and re-issue the command */
-	buffer = (RejillaScsiGetConfigHdr *) g_new0 (uchar, request_size);
-
 	REJILLA_SET_16 (cdb->alloc_len, request_size);
 	res = rejilla_scsi_command_issue_sync (cdb, buffer, request_size, error);
-	if (res) {
-		g_free (buffer);
+	if (res)
 		return res;
-	}
 
-	/* make sure the response has the requested size */
+	/* make sure the response has a valid size */
 	buffer_size = REJILLA_GET_32 (buffer->len) +
 		      G_STRUCT_OFFSET (RejillaScsiGetConfigHdr, len) +
-		      sizeof (hdr.len);
+		      sizeof (buffer->len);
 
 	if (buffer_size < sizeof (RejillaScsiGetConfigHdr) + 2) {
 		/* we can't have a size less or equal to that of the header */
 		REJILLA_MEDIA_LOG ("Size of buffer is less or equal to size of header");
-		g_free (buffer);
 		return REJILLA_SCSI_FAILURE;
 	}
 
-	if (buffer_size != request_size)
+	if (buffer_size > request_size)
 		REJILLA_MEDIA_LOG ("Sizes mismatch asked %i / received %i",
 				  request_size,
 				  buffer_size);
 
-	*data = buffer;
+	/* only keep what was actually returned */
 	*size = MIN (buffer_size, request_size);
+	*data = g_memdup (buffer, *size);
 	return REJILLA_SCSI_OK;
 }
 
@@ -0,0 +1,213 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * Librejilla-media
+ * Copyright (C) Philippe Rouquier 2005-2009 <bonfire-app@wanadoo.fr>
+ *
+ * Librejilla-media is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The Librejilla-media authors hereby grant permission for non-GPL compatible
+ * GStreamer plugins to be used and distributed together with GStreamer
+ * and Librejilla-media. This permission is above and beyond the permissions granted
+ * by the GPL license by which Librejilla-media is covered. If you modify this code
+ * you may extend this exception to your version of the code, but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version.
+ * 
+ * Librejilla-media is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to:
+ * 	The Free Software Foundation, Inc.,
+ * 	51 Franklin Street, Fifth Floor
+ * 	Boston, MA  02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "scsi-mmc2.h"
+
+#include "scsi-error.h"
+#include "scsi-utils.h"
+#include "scsi-base.h"
+#include "scsi-command.h"
+#include "scsi-opcodes.h"
+#include "scsi-get-event-status.h"
+
+/**
+ * GET EVENT STATUS NOTIFICATION command description (MMC2)
+ */
+
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+
+struct _RejillaGetEventStatusCDB {
+	uchar opcode;
+
+	uchar polled		:1;
+	uchar reserved0		:7;
+
+	uchar reserved1		[2];
+
+	uchar class_request;
+
+	uchar reserved2		[2];
+
+	uchar alloc_len		[2];
+
+	uchar ctl;
+};
+
+#else
+
+struct _RejillaGetEventStatusCDB {
+	uchar opcode;
+
+	uchar reserved0		:7;
+	uchar polled		:1;
+
+	uchar reserved1		[2];
+
+	uchar class_request;
+
+	uchar reserved2		[2];
+
+	uchar alloc_len		[2];
+
+	uchar ctl;
+};
+
+#endif
+
+typedef struct _RejillaGetEventStatusCDB RejillaGetEventStatusCDB;
+
+REJILLA_SCSI_COMMAND_DEFINE (RejillaGetEventStatusCDB,
+			     GET_EVENT_STATUS_NOTIFICATION,
+			     REJILLA_SCSI_READ);
+
+/* Bit of the media class in class_request */
+#define REJILLA_GET_EVENT_STATUS_MEDIA_CLASS		0x10
+
+static void
+rejilla_get_event_status_media_check (RejillaScsiMediaEventData *data)
+{
+	/* No Event Available or not a media event */
+	if (data->hdr.NEA || data->hdr.notification_class != 0x04) {
+		memset (&data->desc, 0, sizeof (RejillaScsiMediaEventDesc));
+		data->desc.event_code = REJILLA_SCSI_MEDIA_EVENT_NO_CHANGE;
+	}
+}
+
+/**
+ * Returns (and clears) the last media event the drive reported. Polled mode
+ * is used as asynchronous mode is not supported by most drives.
+ */
+
+RejillaScsiResult
+rejilla_mmc2_get_event_status_media (RejillaDeviceHandle *handle,
+				     RejillaScsiMediaEventData *data,
+				     RejillaScsiErrCode *error)
+{
+	RejillaGetEventStatusCDB *cdb;
+	RejillaScsiResult res;
+
+	g_return_val_if_fail (handle != NULL, REJILLA_SCSI_FAILURE);
+
+	cdb = rejilla_scsi_command_new (&info, handle);
+	cdb->polled = 1;
+	cdb->class_request = REJILLA_GET_EVENT_STATUS_MEDIA_CLASS;
+	REJILLA_SET_16 (cdb->alloc_len, sizeof (RejillaScsiMediaEventData));
+
+	memset (data, 0, sizeof (RejillaScsiMediaEventData));
+	res = rejilla_scsi_command_issue_sync (cdb,
+					       data,
+					       sizeof (RejillaScsiMediaEventData),
+					       error);
+	rejilla_scsi_command_free (cdb);
+
+	if (res == REJILLA_SCSI_OK)
+		rejilla_get_event_status_media_check (data);
+
+	return res;
+}
+
+struct _RejillaGetEventStatusAsync {
+	RejillaScsiMediaEventData *data;
+	RejillaScsiCommandCallback callback;
+	gpointer user_data;
+};
+typedef struct _RejillaGetEventStatusAsync RejillaGetEventStatusAsync;
+
+static void
+rejilla_get_event_status_media_cb (RejillaScsiResult result,
+				   RejillaScsiErrCode code,
+				   gpointer user_data)
+{
+	RejillaGetEventStatusAsync *async_data = user_data;
+	RejillaScsiCommandCallback callback;
+
+	if (result == REJILLA_SCSI_OK)
+		rejilla_get_event_status_media_check (async_data->data);
+
+	callback = async_data->callback;
+	user_data = async_data->user_data;
+	g_free (async_data);
+
+	callback (result, code, user_data);
+}
+
+/**
+ * Same as above except that callback is called once data is set. data must
+ * remain valid until then.
+ */
+
+RejillaScsiResult
+rejilla_mmc2_get_event_status_media_async (RejillaDeviceHandle *handle,
+					   RejillaScsiMediaEventData *data,
+					   int timeout,
+					   RejillaScsiCommandCallback callback,
+					   gpointer user_data,
+					   RejillaScsiErrCode *error)
+{
+	RejillaGetEventStatusAsync *async_data;
+	RejillaGetEventStatusCDB *cdb;
+	RejillaScsiResult res;
+
+	g_return_val_if_fail (handle != NULL, REJILLA_SCSI_FAILURE);
+	g_return_val_if_fail (callback != NULL, REJILLA_SCSI_FAILURE);
+
+	cdb = rejilla_scsi_command_new (&info, handle);
+	cdb->polled = 1;
+	cdb->class_request = REJILLA_GET_EVENT_STATUS_MEDIA_CLASS;
+	REJILLA_SET_16 (cdb->alloc_len, sizeof (RejillaScsiMediaEventData));
+
+	async_data = g_new0 (RejillaGetEventStatusAsync, 1);
+	async_data->data = data;
+	async_data->callback = callback;
+	async_data->user_data = user_data;
+
+	memset (data, 0, sizeof (RejillaScsiMediaEventData));
+	res = rejilla_scsi_command_issue_async (cdb,
+						data,
+						sizeof (RejillaScsiMediaEventData),
+						timeout,
+						rejilla_get_event_status_media_cb,
+						async_data,
+						error);
+	if (res != REJILLA_SCSI_OK) {
+		rejilla_scsi_command_free (cdb);
+		g_free (async_data);
+	}
+
+	return res;
+}
@@ -104,50 +104,8 @@ REJILLA_SCSI_COMMAND_DEFINE (RejillaGetPerformanceCDB,
 #define REJILLA_GET_PERFORMANCE_DBI_TYPE		0x04
 #define REJILLA_GET_PERFORMANCE_DBI_CACHE_TYPE		0x05
 
-static RejillaScsiGetPerfData *
-rejilla_get_performance_get_buffer (RejillaGetPerformanceCDB *cdb,
-				    gint sizeof_descriptors,
-				    RejillaScsiGetPerfHdr *hdr,
-				    RejillaScsiErrCode *error)
-{
-	RejillaScsiGetPerfData *buffer;
-	RejillaScsiResult res;
-	int request_size;
-	int desc_num;
-
-	/* ... check the request size ... */
-	request_size = REJILLA_GET_32 (hdr->len) +
-		       G_STRUCT_OFFSET (RejillaScsiGetPerfHdr, len) +
-		       sizeof (hdr->len);
-
-	/* ... check the request size ... */
-	if (request_size > 2048) {
-		REJILLA_MEDIA_LOG ("Oversized data (%i) setting to max (2048)", request_size);
-		request_size = 2048;
-	}
-	else if ((request_size - sizeof (hdr)) % sizeof_descriptors) {
-		REJILLA_MEDIA_LOG ("Unaligned data (%i) setting to max (2048)", request_size);
-		request_size = 2048;
-	}
-	else if (request_size < sizeof (hdr)) {
-		REJILLA_MEDIA_LOG ("Undersized data (%i) setting to max (2048)", request_size);
-		request_size = 2048;
-	}
-
-	desc_num = (request_size - sizeof (RejillaScsiGetPerfHdr)) / sizeof_descriptors;
-
-	/* ... allocate a buffer and re-issue the command */
-	buffer = (RejillaScsiGetPerfData *) g_new0 (uchar, request_size);
-
-	REJILLA_SET_16 (cdb->max_desc, desc_num);
-	res = rejilla_scsi_command_issue_sync (cdb, buffer, request_size, error);
-	if (res) {
-		g_free (buffer);
-		return NULL;
-	}
-
-	return buffer;
-}
+/* The answer is not supposed to be bigger than that */
+#define REJILLA_GET_PERFORMANCE_MAX_SIZE		2048
 
 static RejillaScsiResult
 rejilla_get_performance (RejillaGetPerformanceCDB *cdb,
@@ -157,74 +115,45 @@ rejilla_get_performance (RejillaGetPerformanceCDB *cdb,
 			 RejillaScsiErrCode *error)
 {
 	RejillaScsiGetPerfData *buffer;
-	RejillaScsiGetPerfHdr hdr;
 	RejillaScsiResult res;
 	int request_size;
 	int buffer_size;
+	int desc_num;
 
 	if (!data || !data_size) {
 		REJILLA_SCSI_SET_ERRCODE (error, REJILLA_SCSI_BAD_ARGUMENT);
 		return REJILLA_SCSI_FAILURE;
 	}
 
-	/* Issue the command once to get the size ... */
-	memset (&hdr, 0, sizeof (hdr));
-	REJILLA_SET_16 (cdb->max_desc, 0);
-	res = rejilla_scsi_command_issue_sync (cdb, &hdr, sizeof (hdr), error);
-	if (res != REJILLA_SCSI_OK)
-		return res;
+	/* Ask for as many descriptors as can be returned at once rather than
+	 * issuing the command a first time only to get the size of the
+	 * answer. Drives return less if there are fewer. */
+	desc_num = (REJILLA_GET_PERFORMANCE_MAX_SIZE - sizeof (RejillaScsiGetPerfHdr)) / sizeof_descriptors;
+	request_size = sizeof (RejillaScsiGetPerfHdr) + desc_num * sizeof_descriptors;
 
-	/* ... get the request size ... */
-	request_size = REJILLA_GET_32 (hdr.len) +
-		       G_STRUCT_OFFSET (RejillaScsiGetPerfHdr, len) +
-		       sizeof (hdr.len);
-
-	/* ... get the answer itself. */
-	buffer = rejilla_get_performance_get_buffer (cdb,
-						     sizeof_descriptors,
-						     &hdr,
-						     error);
-	if (!buffer)
+	buffer = rejilla_scsi_command_get_buffer (cdb, request_size);
+	if (!buffer) {
+		REJILLA_SCSI_SET_ERRCODE (error, REJILLA_SCSI_ERRNO);
 		return REJILLA_SCSI_FAILURE;
+	}
+
+	REJILLA_SET_16 (cdb->max_desc, desc_num);
+	res = rejilla_scsi_command_issue_sync (cdb, buffer, request_size, error);
+	if (res != REJILLA_SCSI_OK)
+		return res;
 
-	/* make sure the response has the requested size */
 	buffer_size = REJILLA_GET_32 (buffer->hdr.len) +
 		      G_STRUCT_OFFSET (RejillaScsiGetPerfHdr, len) +
 		      sizeof (buffer->hdr.len);
 
-	if (request_size < buffer_size) {
-		RejillaScsiGetPerfData *new_buffer;
-
-		/* Strangely some drives returns a buffer size that is bigger
-		 * than the one they returned on the first time. So redo whole
-		 * operation again but this time with the new size we got */
-		REJILLA_MEDIA_LOG ("Sizes mismatch asked %i / received %i\n"
-				   "Re-issuing the command with received size",
-				   request_size,
-				   buffer_size);
-
-		/* Try to get a new buffer of the new size */
-		memcpy (&hdr, &buffer->hdr, sizeof (hdr));
-		new_buffer = rejilla_get_performance_get_buffer (cdb,
-		                                         	 sizeof_descriptors,
-		                                                 &hdr,
-		                                                 error);
-		if (new_buffer) {
-			g_free (buffer);
-			buffer = new_buffer;
-
-			request_size = buffer_size;
-			buffer_size = REJILLA_GET_32 (buffer->hdr.len) +
-				      G_STRUCT_OFFSET (RejillaScsiGetPerfHdr, len) +
-				      sizeof (buffer->hdr.len);
-		}
-	}
-	else if (request_size > buffer_size)
-		REJILLA_MEDIA_LOG ("Sizes mismatch asked %i / received %i",
-				   request_size,
-				   buffer_size);
-	*data = buffer;
+	if (buffer_size > request_size)
+		REJILLA_MEDIA_LOG ("Oversized data (%i) keeping the first %i bytes",
+				   buffer_size,
+				   request_size);
+
+	/* only keep what was actually returned */
 	*data_size = MIN (buffer_size, request_size);
+	*data = g_memdup (buffer, *data_size);
 
 	return res;
 }
@@ -37,6 +37,7 @@
 #include "scsi-get-configuration.h"
 #include "scsi-read-disc-structure.h"
 #include "scsi-read-format-capacities.h"
+#include "scsi-get-event-status.h"
 
 #ifndef _SCSI_MMC2_H
 #define _SCSI_MMC2_H
@@ -73,6 +74,27 @@ rejilla_mmc2_read_format_capacities (RejillaDeviceHandle *handle,
 				     RejillaScsiFormatCapacitiesHdr **data,
 				     int *size,
 				     RejillaScsiErrCode *error);
+
+RejillaScsiResult
+rejilla_mmc2_get_event_status_media (RejillaDeviceHandle *handle,
+				     RejillaScsiMediaEventData *data,
+				     RejillaScsiErrCode *error);
+
+RejillaScsiResult
+rejilla_mmc2_get_event_status_media_async (RejillaDeviceHandle *handle,
+					   RejillaScsiMediaEventData *data,
+					   int timeout,
+					   RejillaScsiCommandCallback callback,
+					   gpointer user_data,
+					   RejillaScsiErrCode *error);
+
+#define REJILLA_SCSI_SPEED_MAX		0xFFFF
+
+RejillaScsiResult
+rejilla_mmc2_set_cd_speed (RejillaDeviceHandle *handle,
+			   int read_speed,
+			   int write_speed,
+			   RejillaScsiErrCode *error);
 G_END_DECLS
 
 #endif /* _SCSI_MMC2_H */
@@ -109,7 +109,6 @@ rejilla_spc1_mode_sense_get_page (RejillaDeviceHandle *handle,
 	int request_size;
 	RejillaScsiResult res;
 	RejillaModeSenseCDB *cdb;
-	RejillaScsiModeData header;
 	RejillaScsiModeData *buffer;
 
 	g_return_val_if_fail (handle != NULL, REJILLA_SCSI_FAILURE);
@@ -119,19 +118,28 @@ rejilla_spc1_mode_sense_get_page (RejillaDeviceHandle *handle,
 		return REJILLA_SCSI_FAILURE;
 	}
 
-	/* issue a first command to get the size of the page ... */
+	/* Ask for as much as possible at once into the handle buffer instead
+	 * of issuing a first command to get the size of the page */
 	cdb = rejilla_scsi_command_new (&info, handle);
 	cdb->dbd = 1;
 	cdb->page_code = num;
-	REJILLA_SET_16 (cdb->alloc_len, sizeof (header));
-	bzero (&header, sizeof (header));
 
-	REJILLA_MEDIA_LOG ("Getting page size");
-	res = rejilla_scsi_command_issue_sync (cdb, &header, sizeof (header), error);
+	request_size = REJILLA_SCSI_MAX_ALLOC_LEN;
+	buffer = rejilla_scsi_command_get_buffer (cdb, request_size);
+	if (!buffer) {
+		REJILLA_SCSI_SET_ERRCODE (error, REJILLA_SCSI_ERRNO);
+		res = REJILLA_SCSI_FAILURE;
+		goto end;
+	}
+
+	REJILLA_MEDIA_LOG ("Getting page");
+
+	REJILLA_SET_16 (cdb->alloc_len, request_size);
+	res = rejilla_scsi_command_issue_sync (cdb, buffer, request_size, error);
 	if (res)
 		goto end;
 
-	if (!header.hdr.len) {
+	if (!REJILLA_GET_16 (buffer->hdr.len)) {
 		REJILLA_SCSI_SET_ERRCODE (error, REJILLA_SCSI_SIZE_MISMATCH);
 		res = REJILLA_SCSI_FAILURE;
 		goto end;
@@ -139,47 +147,15 @@ rejilla_spc1_mode_sense_get_page (RejillaDeviceHandle *handle,
 
 	/* Paranoïa, make sure:
 	 * - the size given in header, the one of the page returned are coherent
-	 * - the block descriptors are actually disabled */
-	if (REJILLA_GET_16 (header.hdr.bdlen)) {
+	 * - the block descriptors are actually disabled
+	 * - header claimed size fits in what we requested */
+	if (REJILLA_GET_16 (buffer->hdr.bdlen)) {
 		REJILLA_SCSI_SET_ERRCODE (error, REJILLA_SCSI_BAD_ARGUMENT);
-		REJILLA_MEDIA_LOG ("Block descriptors not disabled %i", REJILLA_GET_16 (header.hdr.bdlen));
+		REJILLA_MEDIA_LOG ("Block descriptors not disabled %i", REJILLA_GET_16 (buffer->hdr.bdlen));
 		res = REJILLA_SCSI_FAILURE;
 		goto end;
 	}
 
-	request_size = REJILLA_GET_16 (header.hdr.len) +
-		       G_STRUCT_OFFSET (RejillaScsiModeHdr, len) +
-		       sizeof (header.hdr.len);
-
-	page_size = header.page.len +
-		    G_STRUCT_OFFSET (RejillaScsiModePage, len) +
-		    sizeof (header.page.len);
-
-	if (request_size != page_size + sizeof (RejillaScsiModeHdr)) {
-		REJILLA_SCSI_SET_ERRCODE (error, REJILLA_SCSI_SIZE_MISMATCH);
-		REJILLA_MEDIA_LOG ("Incoherent answer sizes: request %i, page %i", request_size, page_size);
-		res = REJILLA_SCSI_FAILURE;
-		goto end;
-	}
-
-	/* ... allocate an appropriate buffer ... */
-	buffer = (RejillaScsiModeData *) g_new0 (uchar, request_size);
-
-	/* ... re-issue the command */
-	REJILLA_MEDIA_LOG("Getting page (size = %i)", request_size);
-
-	REJILLA_SET_16 (cdb->alloc_len, request_size);
-	res = rejilla_scsi_command_issue_sync (cdb, buffer, request_size, error);
-	if (res) {
-		g_free (buffer);
-		goto end;
-	}
-
-	/* Paranoïa, some more checks:
-	 * - the size of the page returned is the one we requested
-	 * - block descriptors are actually disabled
-	 * - header claimed size == buffer size
-	 * - header claimed size == sizeof (header) + sizeof (page) */
 	buffer_size = REJILLA_GET_16 (buffer->hdr.len) +
 		      G_STRUCT_OFFSET (RejillaScsiModeHdr, len) +
 		      sizeof (buffer->hdr.len);
@@ -188,18 +164,16 @@ rejilla_spc1_mode_sense_get_page (RejillaDeviceHandle *handle,
 		    G_STRUCT_OFFSET (RejillaScsiModePage, len) +
 		    sizeof (buffer->page.len);
 
-	if (request_size != buffer_size
-	||  REJILLA_GET_16 (buffer->hdr.bdlen)
+	if (buffer_size > request_size
 	||  buffer_size != page_size + sizeof (RejillaScsiModeHdr)) {
-		g_free (buffer);
-
 		REJILLA_SCSI_SET_ERRCODE (error, REJILLA_SCSI_SIZE_MISMATCH);
+		REJILLA_MEDIA_LOG ("Incoherent answer sizes: request %i, page %i", buffer_size, page_size);
 		res = REJILLA_SCSI_FAILURE;
 		goto end;
 	}
 
-	*data = buffer;
-	*data_size = request_size;
+	*data = g_memdup (buffer, buffer_size);
+	*data_size = buffer_size;
 
 end:
 	rejilla_scsi_command_free (cdb);
@@ -54,6 +54,8 @@
 
 struct _RejillaDeviceHandle {
 	int fd;
+	RejillaScsiArena *arena;
+	RejillaScsiQueue *queue;
 };
 
 struct _RejillaScsiCmd {
@@ -128,6 +130,57 @@ rejilla_scsi_command_issue_sync (gpointer command,
 	return REJILLA_SCSI_FAILURE;
 }
 
+RejillaScsiResult
+rejilla_scsi_command_issue_sync_iov (gpointer command,
+				     const struct iovec *iov,
+				     int iov_count,
+				     RejillaScsiErrCode *error)
+{
+	/* No scatter-gather here: go through the handle buffer */
+	return rejilla_scsi_command_issue_sync_bounce (command,
+						       iov,
+						       iov_count,
+						       error);
+}
+
+RejillaScsiResult
+rejilla_scsi_command_issue_async (gpointer command,
+				  gpointer buffer,
+				  int size,
+				  int timeout,
+				  RejillaScsiCommandCallback callback,
+				  gpointer user_data,
+				  RejillaScsiErrCode *error)
+{
+	RejillaScsiCmd *cmd;
+
+	g_return_val_if_fail (command != NULL, REJILLA_SCSI_FAILURE);
+
+	cmd = command;
+	if (!cmd->handle->queue)
+		cmd->handle->queue = rejilla_scsi_queue_new ();
+
+	/* NOTE: timeout can't be honoured; the one used for synchronous
+	 * commands applies */
+	return rejilla_scsi_queue_push (cmd->handle->queue,
+					command,
+					buffer,
+					size,
+					callback,
+					user_data,
+					error);
+}
+
+gpointer
+rejilla_scsi_command_get_buffer (gpointer command,
+				 int size)
+{
+	RejillaScsiCmd *cmd;
+
+	cmd = command;
+	return rejilla_scsi_arena_get_buffer (cmd->handle->arena, size);
+}
+
 gpointer
 rejilla_scsi_command_new (const RejillaScsiCmdInfo *info,
 			  RejillaDeviceHandle *handle) 
@@ -136,8 +189,8 @@ rejilla_scsi_command_new (const RejillaScsiCmdInfo *info,
 
 	/* make sure we can set the flags of the descriptor */
 
-	/* allocate the command */
-	cmd = g_new0 (RejillaScsiCmd, 1);
+	/* allocate the command (or reuse one freed for this handle) */
+	cmd = rejilla_scsi_arena_get_command (handle->arena, sizeof (RejillaScsiCmd));
 	cmd->info = info;
 	cmd->handle = handle;
 
@@ -148,7 +201,7 @@ rejilla_scsi_command_new (const RejillaScsiCmdInfo *info,
 RejillaScsiResult
 rejilla_scsi_command_free (gpointer cmd)
 {
-	g_free (cmd);
+	rejilla_scsi_arena_put_command (((RejillaScsiCmd *) cmd)->handle->arena, cmd);
 	return REJILLA_SCSI_OK;
 }
 
@@ -187,6 +240,8 @@ rejilla_device_handle_open (const gchar *path,
 
 	handle = g_new (RejillaDeviceHandle, 1);
 	handle->fd = fd;
+	handle->arena = rejilla_scsi_arena_new ();
+	handle->queue = NULL;
 
 	return handle;
 }
@@ -194,10 +249,21 @@ rejilla_device_handle_open (const gchar *path,
 void
 rejilla_device_handle_close (RejillaDeviceHandle *handle)
 {
+	/* Pending commands are called back before their arena is freed */
+	if (handle->queue)
+		rejilla_scsi_queue_free (handle->queue);
+
 	close (handle->fd);
+	rejilla_scsi_arena_free (handle->arena);
 	g_free (handle);
 }
 
+int
+rejilla_device_handle_get_max_transfer (RejillaDeviceHandle *handle)
+{
+	return REJILLA_SCSI_DEFAULT_MAX_TRANSFER;
+}
+
 char *
 rejilla_device_get_bus_target_lun (const gchar *device)
 {
@@ -76,6 +76,8 @@ G_BEGIN_DECLS
 #define REJILLA_READ_CAPACITY_OPCODE			0x25
 #define REJILLA_READ_FORMAT_CAPACITIES_OPCODE		0x23
 #define REJILLA_READ10_OPCODE				0x28
+#define REJILLA_GET_EVENT_STATUS_NOTIFICATION_OPCODE	0x4A
+#define REJILLA_SET_CD_SPEED_OPCODE			0xBB
 
 /**
  *	MMC3
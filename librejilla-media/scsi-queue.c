@@ -0,0 +1,260 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * Librejilla-media
+ * Copyright (C) Philippe Rouquier 2005-2009 <bonfire-app@wanadoo.fr>
+ *
+ * Librejilla-media is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The Librejilla-media authors hereby grant permission for non-GPL compatible
+ * GStreamer plugins to be used and distributed together with GStreamer
+ * and Librejilla-media. This permission is above and beyond the permissions granted
+ * by the GPL license by which Librejilla-media is covered. If you modify this code
+ * you may extend this exception to your version of the code, but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version.
+ * 
+ * Librejilla-media is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to:
+ * 	The Free Software Foundation, Inc.,
+ * 	51 Franklin Street, Fifth Floor
+ * 	Boston, MA  02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <glib.h>
+
+#include "rejilla-media-private.h"
+
+#include "scsi-error.h"
+#include "scsi-utils.h"
+#include "scsi-command.h"
+
+struct _RejillaScsiQueueRequest {
+	gpointer command;
+	gpointer buffer;
+	int size;
+
+	RejillaScsiCommandCallback callback;
+	gpointer user_data;
+
+	RejillaScsiResult result;
+	RejillaScsiErrCode code;
+};
+typedef struct _RejillaScsiQueueRequest RejillaScsiQueueRequest;
+
+struct _RejillaScsiQueue {
+	/* Requests issued by the thread */
+	GThread *thread;
+	GAsyncQueue *requests;
+	gint cancel;
+
+	/* Answered requests whose callback is still to be called */
+	GMutex *mutex;
+	GQueue *done;
+	guint done_id;
+};
+
+/* Pushed to wake up and stop the thread */
+static RejillaScsiQueueRequest stop_request;
+
+static void
+rejilla_scsi_queue_request_call (RejillaScsiQueueRequest *request)
+{
+	RejillaScsiCommandCallback callback;
+	RejillaScsiErrCode code;
+	RejillaScsiResult result;
+	gpointer user_data;
+
+	callback = request->callback;
+	user_data = request->user_data;
+	result = request->result;
+	code = request->code;
+
+	/* The command goes back to the arena before the callback is called
+	 * since the callback may well close the handle */
+	rejilla_scsi_command_free (request->command);
+	g_free (request);
+
+	callback (result, code, user_data);
+}
+
+static gboolean
+rejilla_scsi_queue_done_cb (gpointer data)
+{
+	RejillaScsiQueueRequest *request;
+	RejillaScsiQueue *queue = data;
+	gboolean result;
+
+	/* One request at a time: once the callback is called the queue may
+	 * not exist any more, so it is not touched afterwards. If the queue
+	 * was freed by the callback, so was this source. */
+	g_mutex_lock (queue->mutex);
+	request = g_queue_pop_head (queue->done);
+	result = !g_queue_is_empty (queue->done);
+	if (!result)
+		queue->done_id = 0;
+	g_mutex_unlock (queue->mutex);
+
+	if (request)
+		rejilla_scsi_queue_request_call (request);
+
+	return result;
+}
+
+static void
+rejilla_scsi_queue_request_done (RejillaScsiQueue *queue,
+				 RejillaScsiQueueRequest *request)
+{
+	/* Callbacks are always run from the main loop, never from the
+	 * function issuing the command */
+	g_mutex_lock (queue->mutex);
+	g_queue_push_tail (queue->done, request);
+	if (!queue->done_id)
+		queue->done_id = g_idle_add (rejilla_scsi_queue_done_cb, queue);
+	g_mutex_unlock (queue->mutex);
+}
+
+static gpointer
+rejilla_scsi_queue_thread (gpointer data)
+{
+	RejillaScsiQueue *queue = data;
+
+	while (1) {
+		RejillaScsiQueueRequest *request;
+
+		request = g_async_queue_pop (queue->requests);
+		if (request == &stop_request)
+			break;
+
+		if (g_atomic_int_get (&queue->cancel)) {
+			request->result = REJILLA_SCSI_FAILURE;
+			request->code = REJILLA_SCSI_ERR_UNKNOWN;
+		}
+		else
+			request->result = rejilla_scsi_command_issue_sync (request->command,
+									   request->buffer,
+									   request->size,
+									   &request->code);
+
+		rejilla_scsi_queue_request_done (queue, request);
+	}
+
+	return NULL;
+}
+
+RejillaScsiQueue *
+rejilla_scsi_queue_new (void)
+{
+	RejillaScsiQueue *queue;
+
+	queue = g_new0 (RejillaScsiQueue, 1);
+	queue->mutex = g_mutex_new ();
+	queue->done = g_queue_new ();
+	return queue;
+}
+
+void
+rejilla_scsi_queue_free (RejillaScsiQueue *queue)
+{
+	RejillaScsiQueueRequest *request;
+
+	if (queue->thread) {
+		/* Remaining requests are failed by the thread. This waits for
+		 * the one being issued, if any. */
+		g_atomic_int_set (&queue->cancel, 1);
+		g_async_queue_push (queue->requests, &stop_request);
+		g_thread_join (queue->thread);
+		g_async_queue_unref (queue->requests);
+	}
+
+	if (queue->done_id) {
+		g_source_remove (queue->done_id);
+		queue->done_id = 0;
+	}
+
+	/* Nothing can add requests any more. Call back the remaining ones now
+	 * while their commands and the arena still exist. */
+	while ((request = g_queue_pop_head (queue->done)))
+		rejilla_scsi_queue_request_call (request);
+
+	g_queue_free (queue->done);
+	g_mutex_free (queue->mutex);
+	g_free (queue);
+}
+
+void
+rejilla_scsi_queue_complete (RejillaScsiQueue *queue,
+			     gpointer command,
+			     RejillaScsiResult result,
+			     RejillaScsiErrCode code,
+			     RejillaScsiCommandCallback callback,
+			     gpointer user_data)
+{
+	RejillaScsiQueueRequest *request;
+
+	request = g_new0 (RejillaScsiQueueRequest, 1);
+	request->command = command;
+	request->callback = callback;
+	request->user_data = user_data;
+	request->result = result;
+	request->code = code;
+
+	rejilla_scsi_queue_request_done (queue, request);
+}
+
+RejillaScsiResult
+rejilla_scsi_queue_push (RejillaScsiQueue *queue,
+			 gpointer command,
+			 gpointer buffer,
+			 int size,
+			 RejillaScsiCommandCallback callback,
+			 gpointer user_data,
+			 RejillaScsiErrCode *error)
+{
+	RejillaScsiQueueRequest *request;
+
+	g_return_val_if_fail (callback != NULL, REJILLA_SCSI_FAILURE);
+
+	/* The thread is only started when first needed */
+	if (!queue->thread) {
+		GError *thread_error = NULL;
+
+		queue->requests = g_async_queue_new ();
+		queue->thread = g_thread_create (rejilla_scsi_queue_thread,
+						 queue,
+						 TRUE,
+						 &thread_error);
+		if (!queue->thread) {
+			REJILLA_MEDIA_LOG ("Can't start SCSI queue thread: %s",
+					   thread_error->message);
+			g_error_free (thread_error);
+
+			g_async_queue_unref (queue->requests);
+			queue->requests = NULL;
+
+			REJILLA_SCSI_SET_ERRCODE (error, REJILLA_SCSI_ERR_UNKNOWN);
+			return REJILLA_SCSI_FAILURE;
+		}
+	}
+
+	request = g_new0 (RejillaScsiQueueRequest, 1);
+	request->command = command;
+	request->buffer = buffer;
+	request->size = size;
+	request->callback = callback;
+	request->user_data = user_data;
+
+	g_async_queue_push (queue->requests, request);
+	return REJILLA_SCSI_OK;
+}
@@ -123,7 +123,14 @@ rejilla_mmc1_read_disc_information_std (RejillaDeviceHandle *handle,
 
 	request_size = REJILLA_GET_16 (std_info.len) + 
 		       sizeof (std_info.len);
-	
+
+	/* The first answer is complete unless there are OPC tables */
+	if (request_size <= sizeof (RejillaScsiDiscInfoStd)) {
+		*info_return = g_memdup (&std_info, sizeof (RejillaScsiDiscInfoStd));
+		*size = request_size;
+		goto end;
+	}
+
 	buffer = (RejillaScsiDiscInfoStd *) g_new0 (uchar, request_size);
 
 	REJILLA_SET_16 (cdb->alloc_len, request_size);
@@ -110,40 +110,36 @@ rejilla_read_disc_structure (RejillaReadDiscStructureCDB *cdb,
 			     RejillaScsiErrCode *error)
 {
 	RejillaScsiReadDiscStructureHdr *buffer;
-	RejillaScsiReadDiscStructureHdr hdr;
 	RejillaScsiResult res;
 	int request_size;
+	int buffer_size;
 
 	if (!data || !size) {
 		REJILLA_SCSI_SET_ERRCODE (error, REJILLA_SCSI_BAD_ARGUMENT);
 		return REJILLA_SCSI_FAILURE;
 	}
 
-	REJILLA_SET_16 (cdb->alloc_len, sizeof (hdr));
-
-	memset (&hdr, 0, sizeof (hdr));
-	res = rejilla_scsi_command_issue_sync (cdb, &hdr, sizeof (hdr), error);
-	if (res)
-		return res;
-
-	request_size = REJILLA_GET_16 (hdr.len) + sizeof (hdr.len);
-	buffer = (RejillaScsiReadDiscStructureHdr *) g_new0 (uchar, request_size);
+	/* Ask for as much as possible at once into the handle buffer */
+	request_size = REJILLA_SCSI_MAX_ALLOC_LEN;
+	buffer = rejilla_scsi_command_get_buffer (cdb, request_size);
+	if (!buffer) {
+		REJILLA_SCSI_SET_ERRCODE (error, REJILLA_SCSI_ERRNO);
+		return REJILLA_SCSI_FAILURE;
+	}
 
 	REJILLA_SET_16 (cdb->alloc_len, request_size);
 	res = rejilla_scsi_command_issue_sync (cdb, buffer, request_size, error);
-	if (res) {
-		g_free (buffer);
+	if (res)
 		return res;
-	}
 
-	if (request_size < REJILLA_GET_16 (buffer->len) + sizeof (buffer->len)) {
+	buffer_size = REJILLA_GET_16 (buffer->len) + sizeof (buffer->len);
+	if (buffer_size > request_size) {
 		REJILLA_SCSI_SET_ERRCODE (error, REJILLA_SCSI_SIZE_MISMATCH);
-		g_free (buffer);
 		return REJILLA_SCSI_FAILURE;
 	}
 
-	*data = buffer;
-	*size = request_size;
+	*data = g_memdup (buffer, buffer_size);
+	*size = buffer_size;
 
 	return res;
 }
@@ -65,10 +65,10 @@ rejilla_mmc2_read_format_capacities (RejillaDeviceHandle *handle,
 				     RejillaScsiErrCode *error)
 {
 	RejillaScsiFormatCapacitiesHdr *buffer;
-	RejillaScsiFormatCapacitiesHdr hdr;
 	RejillaRdFormatCapacitiesCDB *cdb;
 	RejillaScsiResult res;
 	int request_size;
+	int buffer_size;
 
 	g_return_val_if_fail (handle != NULL, REJILLA_SCSI_FAILURE);
 
@@ -78,36 +78,30 @@ rejilla_mmc2_read_format_capacities (RejillaDeviceHandle *handle,
 	}
 
 	cdb = rejilla_scsi_command_new (&info, handle);
-	REJILLA_SET_16 (cdb->alloc_len, sizeof (RejillaScsiFormatCapacitiesHdr));
 
-	memset (&hdr, 0, sizeof (RejillaScsiFormatCapacitiesHdr));
-	res = rejilla_scsi_command_issue_sync (cdb,
-					       &hdr,
-					       sizeof (RejillaScsiFormatCapacitiesHdr),
-					       error);
-	if (res)
+	/* Ask for as much as possible at once into the handle buffer */
+	request_size = REJILLA_SCSI_MAX_ALLOC_LEN;
+	buffer = rejilla_scsi_command_get_buffer (cdb, request_size);
+	if (!buffer) {
+		REJILLA_SCSI_SET_ERRCODE (error, REJILLA_SCSI_ERRNO);
+		res = REJILLA_SCSI_FAILURE;
 		goto end;
-
-	request_size = hdr.len + sizeof (hdr.len) + G_STRUCT_OFFSET (RejillaScsiFormatCapacitiesHdr, len);
-	buffer = (RejillaScsiFormatCapacitiesHdr *) g_new0 (uchar, request_size);
+	}
 
 	REJILLA_SET_16 (cdb->alloc_len, request_size);
 	res = rejilla_scsi_command_issue_sync (cdb, buffer, request_size, error);
-	if (res) {
-		g_free (buffer);
+	if (res)
 		goto end;
-	}
 
-	if (request_size != buffer->len + sizeof (buffer->len) + G_STRUCT_OFFSET (RejillaScsiFormatCapacitiesHdr, len)) {
+	buffer_size = buffer->len + sizeof (buffer->len) + G_STRUCT_OFFSET (RejillaScsiFormatCapacitiesHdr, len);
+	if (buffer_size > request_size) {
 		REJILLA_SCSI_SET_ERRCODE (error, REJILLA_SCSI_SIZE_MISMATCH);
-
 		res = REJILLA_SCSI_FAILURE;
-		g_free (buffer);
 		goto end;
 	}
 
-	*data = buffer;
-	*size = request_size;
+	*data = g_memdup (buffer, buffer_size);
+	*size = buffer_size;
 
 end:
 
@@ -32,6 +32,8 @@
 #  include <config.h>
 #endif
 
+#include <string.h>
+
 #include <glib.h>
 
 #include "rejilla-media-private.h"
@@ -101,6 +103,9 @@ REJILLA_RD_TAP_ATIP			= 0x04,
 REJILLA_RD_TAP_CD_TEXT			= 0x05	/* Introduced in MMC3 */
 } RejillaReadTocPmaAtipType;
 
+/* Enough for a full TOC (99 tracks and the leadout) or an ATIP */
+#define REJILLA_RD_TAP_FIRST_SIZE		2048
+
 static RejillaScsiResult
 rejilla_read_toc_pma_atip (RejillaRdTocPmaAtipCDB *cdb,
 			   int desc_size,
@@ -109,7 +114,6 @@ rejilla_read_toc_pma_atip (RejillaRdTocPmaAtipCDB *cdb,
 			   RejillaScsiErrCode *error)
 {
 	RejillaScsiTocPmaAtipHdr *buffer;
-	RejillaScsiTocPmaAtipHdr hdr;
 	RejillaScsiResult res;
 	int request_size;
 	int buffer_size;
@@ -119,44 +123,57 @@ rejilla_read_toc_pma_atip (RejillaRdTocPmaAtipCDB *cdb,
 		return REJILLA_SCSI_FAILURE;
 	}
 
-	REJILLA_SET_16 (cdb->alloc_len, sizeof (RejillaScsiTocPmaAtipHdr));
+	/* Most answers fit in the first buffer so there is no need to ask
+	 * for the header alone first and then for the whole answer */
+	buffer = rejilla_scsi_command_get_buffer (cdb, REJILLA_SCSI_MAX_ALLOC_LEN);
+	if (!buffer) {
+		REJILLA_SCSI_SET_ERRCODE (error, REJILLA_SCSI_ERRNO);
+		*size = 0;
+		return REJILLA_SCSI_FAILURE;
+	}
 
-	memset (&hdr, 0, sizeof (RejillaScsiTocPmaAtipHdr));
+	REJILLA_SET_16 (cdb->alloc_len, REJILLA_RD_TAP_FIRST_SIZE);
 	res = rejilla_scsi_command_issue_sync (cdb,
-					       &hdr,
-					       sizeof (RejillaScsiTocPmaAtipHdr),
+					       buffer,
+					       REJILLA_RD_TAP_FIRST_SIZE,
 					       error);
 	if (res) {
 		*size = 0;
 		return res;
 	}
 
-	request_size = REJILLA_GET_16 (hdr.len) + sizeof (hdr.len);
+	request_size = REJILLA_GET_16 (buffer->len) + sizeof (buffer->len);
 
 	/* NOTE: if size is not valid use the maximum possible size */
-	if ((request_size - sizeof (hdr)) % desc_size) {
+	if ((request_size - sizeof (RejillaScsiTocPmaAtipHdr)) % desc_size) {
 		REJILLA_MEDIA_LOG ("Unaligned data (%i) setting to max (65530)", request_size);
-		request_size = 65530;
+		request_size = REJILLA_SCSI_MAX_ALLOC_LEN;
 	}
-	else if (request_size - sizeof (hdr) < desc_size) {
+	else if (request_size - sizeof (RejillaScsiTocPmaAtipHdr) < desc_size) {
 		REJILLA_MEDIA_LOG ("Undersized data (%i) setting to max (65530)", request_size);
-		request_size = 65530;
+		request_size = REJILLA_SCSI_MAX_ALLOC_LEN;
+	}
+
+	if (request_size <= REJILLA_RD_TAP_FIRST_SIZE) {
+		*data = g_memdup (buffer, request_size);
+		*size = request_size;
+		return res;
 	}
 
-	buffer = (RejillaScsiTocPmaAtipHdr *) g_new0 (uchar, request_size);
+	/* The handle buffer is already large enough for the whole answer */
+	memset (buffer, 0, request_size);
 
 	REJILLA_SET_16 (cdb->alloc_len, request_size);
 	res = rejilla_scsi_command_issue_sync (cdb, buffer, request_size, error);
 	if (res) {
-		g_free (buffer);
 		*size = 0;
 		return res;
 	}
 
 	buffer_size = REJILLA_GET_16 (buffer->len) + sizeof (buffer->len);
 
-	*data = buffer;
 	*size = MIN (buffer_size, request_size);
+	*data = g_memdup (buffer, *size);
 
 	return res;
 }
@@ -124,3 +124,36 @@ rejilla_sbc_read10_block (RejillaDeviceHandle *handle,
 	rejilla_scsi_command_free (cdb);
 	return res;
 }
+
+/**
+ * Same as above but data is spread over several buffers (their total size
+ * must match num_blocks). This saves a copy when blocks go to different
+ * places (ring buffer wrapping around, ...)
+ */
+
+RejillaScsiResult
+rejilla_sbc_read10_block_iov (RejillaDeviceHandle *handle,
+			      int start,
+			      int num_blocks,
+			      const struct iovec *iov,
+			      int iov_count,
+			      RejillaScsiErrCode *error)
+{
+	RejillaRead10CDB *cdb;
+	RejillaScsiResult res;
+
+	g_return_val_if_fail (handle != NULL, REJILLA_SCSI_FAILURE);
+	g_return_val_if_fail (iov != NULL && iov_count > 0, REJILLA_SCSI_FAILURE);
+
+	cdb = rejilla_scsi_command_new (&info, handle);
+	REJILLA_SET_32 (cdb->start_address, start);
+	REJILLA_SET_16 (cdb->len, num_blocks);
+	cdb->FUA = 0;
+
+	res = rejilla_scsi_command_issue_sync_iov (cdb,
+						   iov,
+						   iov_count,
+						   error);
+	rejilla_scsi_command_free (cdb);
+	return res;
+}
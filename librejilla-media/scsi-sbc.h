@@ -28,6 +28,8 @@
  * 	Boston, MA  02110-1301, USA.
  */
 
+#include <sys/uio.h>
+
 #include <glib.h>
 
 #include "scsi-base.h"
@@ -52,6 +54,14 @@ rejilla_sbc_read10_block (RejillaDeviceHandle *handle,
 			  int buffer_size,
 			  RejillaScsiErrCode *error);
 
+RejillaScsiResult
+rejilla_sbc_read10_block_iov (RejillaDeviceHandle *handle,
+			      int start,
+			      int num_blocks,
+			      const struct iovec *iov,
+			      int iov_count,
+			      RejillaScsiErrCode *error);
+
 G_END_DECLS
 
 #endif /* _BURN_SBC_H */
@@ -37,6 +37,7 @@
 #include <stdlib.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/sysmacros.h>
 #include <fcntl.h>
 #include <string.h>
 #include <sys/ioctl.h>
@@ -53,6 +54,17 @@
 
 struct _RejillaDeviceHandle {
 	int fd;
+	RejillaScsiArena *arena;
+
+	/* Asynchronous commands (set up when first needed). They are submitted
+	 * through the sg node of the device (which block devices lack) or, if
+	 * there is none, issued by the queue thread. */
+	RejillaScsiQueue *queue;
+	int sg_fd;
+	GQueue *waiting;
+	GSList *submitted;
+	guint watch;
+	guint retry;
 };
 
 struct _RejillaScsiCmd {
@@ -68,6 +80,29 @@ typedef struct _RejillaScsiCmd RejillaScsiCmd;
 
 #define OPEN_FLAGS			O_RDWR /*|O_EXCL */|O_NONBLOCK
 
+/* Major number of sg nodes (linux/major.h) */
+#define REJILLA_SG_MAJOR		21
+
+/* Commands submitted at once to the driver (it accepts up to 16 per fd) */
+#define REJILLA_SG_MAX_SUBMITTED	8
+
+/* Delay (in ms) before submitting again when the driver had no room */
+#define REJILLA_SG_RETRY_DELAY		50
+
+/* Host and driver status (scsi.h) reporting the command timed out */
+#define REJILLA_SG_DID_TIME_OUT		0x03
+#define REJILLA_SG_DRIVER_TIMEOUT	0x06
+
+struct _RejillaSgRequest {
+	struct sg_io_hdr transport;
+	uchar sense_buffer [REJILLA_SENSE_DATA_SIZE];
+
+	RejillaScsiCmd *cmd;
+	RejillaScsiCommandCallback callback;
+	gpointer user_data;
+};
+typedef struct _RejillaSgRequest RejillaSgRequest;
+
 /**
  * This is to send a command
  */
@@ -136,6 +171,323 @@ rejilla_scsi_command_issue_sync (gpointer command,
 	return REJILLA_SCSI_FAILURE;
 }
 
+RejillaScsiResult
+rejilla_scsi_command_issue_sync_iov (gpointer command,
+				     const struct iovec *iov,
+				     int iov_count,
+				     RejillaScsiErrCode *error)
+{
+	uchar sense_buffer [REJILLA_SENSE_DATA_SIZE];
+	struct sg_io_hdr transport;
+	RejillaScsiResult res;
+	RejillaScsiCmd *cmd;
+	int size = 0;
+	int i;
+
+	g_return_val_if_fail (command != NULL, REJILLA_SCSI_FAILURE);
+	g_return_val_if_fail (iov_count > 0, REJILLA_SCSI_FAILURE);
+
+	for (i = 0; i < iov_count; i ++)
+		size += iov [i].iov_len;
+
+	cmd = command;
+	rejilla_sg_command_setup (&transport,
+				  sense_buffer,
+				  cmd,
+				  (uchar *) iov,
+				  size);
+
+	/* sg_iovec has the same layout as struct iovec; the kernel fills each
+	 * element directly instead of having us copy from a single buffer */
+	transport.iovec_count = iov_count;
+
+	res = ioctl (cmd->handle->fd, SG_IO, &transport);
+	if (res) {
+		REJILLA_SCSI_SET_ERRCODE (error, REJILLA_SCSI_ERRNO);
+		return REJILLA_SCSI_FAILURE;
+	}
+
+	if ((transport.info & SG_INFO_OK_MASK) == SG_INFO_OK)
+		return REJILLA_SCSI_OK;
+
+	if ((transport.masked_status & CHECK_CONDITION) && transport.sb_len_wr)
+		return rejilla_sense_data_process (sense_buffer, error);
+
+	return REJILLA_SCSI_FAILURE;
+}
+
+/**
+ * Asynchronous commands are written to the sg node and their answer is read
+ * back when it becomes readable. Answers are handed to the queue which calls
+ * back from an idle, so nothing here runs a callback.
+ */
+
+static int
+rejilla_sg_handle_open_node (RejillaDeviceHandle *handle)
+{
+	const gchar *name;
+	struct stat info;
+	gchar *path;
+	GDir *dir;
+	int fd = -1;
+
+	if (fstat (handle->fd, &info))
+		return -1;
+
+	if (S_ISCHR (info.st_mode) && major (info.st_rdev) == REJILLA_SG_MAJOR)
+		return handle->fd;
+
+	if (!S_ISBLK (info.st_mode))
+		return -1;
+
+	/* Find the sg node of the same device through sysfs */
+	path = g_strdup_printf ("/sys/dev/block/%u:%u/device/scsi_generic",
+				major (info.st_rdev),
+				minor (info.st_rdev));
+	dir = g_dir_open (path, 0, NULL);
+	g_free (path);
+
+	if (!dir)
+		return -1;
+
+	name = g_dir_read_name (dir);
+	if (name) {
+		path = g_build_filename ("/dev", name, NULL);
+		fd = open (path, OPEN_FLAGS);
+		if (fd < 0)
+			REJILLA_MEDIA_LOG ("Can't open %s: %s", path, g_strerror (errno));
+		g_free (path);
+	}
+	g_dir_close (dir);
+
+	return fd;
+}
+
+static RejillaScsiResult
+rejilla_sg_request_result (RejillaSgRequest *request,
+			   RejillaScsiErrCode *code)
+{
+	struct sg_io_hdr *transport;
+
+	transport = &request->transport;
+	if ((transport->info & SG_INFO_OK_MASK) == SG_INFO_OK)
+		return REJILLA_SCSI_OK;
+
+	if ((transport->masked_status & CHECK_CONDITION) && transport->sb_len_wr)
+		return rejilla_sense_data_process (request->sense_buffer, code);
+
+	if (transport->host_status == REJILLA_SG_DID_TIME_OUT
+	|| (transport->driver_status & 0x0F) == REJILLA_SG_DRIVER_TIMEOUT) {
+		REJILLA_MEDIA_LOG ("Command timed out after %i ms", transport->duration);
+		*code = REJILLA_SCSI_TIMEOUT;
+	}
+	else
+		*code = REJILLA_SCSI_ERR_UNKNOWN;
+
+	return REJILLA_SCSI_FAILURE;
+}
+
+static void
+rejilla_sg_request_done (RejillaDeviceHandle *handle,
+			 RejillaSgRequest *request,
+			 RejillaScsiResult result,
+			 RejillaScsiErrCode code)
+{
+	rejilla_scsi_queue_complete (handle->queue,
+				     request->cmd,
+				     result,
+				     code,
+				     request->callback,
+				     request->user_data);
+	g_free (request);
+}
+
+static void
+rejilla_sg_handle_submit (RejillaDeviceHandle *handle);
+
+static gboolean
+rejilla_sg_handle_retry_cb (gpointer data)
+{
+	RejillaDeviceHandle *handle = data;
+
+	handle->retry = 0;
+	rejilla_sg_handle_submit (handle);
+	return FALSE;
+}
+
+static gboolean
+rejilla_sg_handle_readable (GIOChannel *channel,
+			    GIOCondition condition,
+			    gpointer data)
+{
+	RejillaDeviceHandle *handle = data;
+
+	while (handle->submitted) {
+		struct sg_io_hdr transport;
+		RejillaSgRequest *request;
+		RejillaScsiErrCode code;
+		RejillaScsiResult res;
+
+		memset (&transport, 0, sizeof (transport));
+		transport.interface_id = 'S';
+		if (read (handle->sg_fd, &transport, sizeof (transport)) < 0) {
+			if (errno == EINTR)
+				continue;
+
+			if (errno == EAGAIN)
+				break;
+
+			REJILLA_MEDIA_LOG ("Reading command answer failed: %s", g_strerror (errno));
+
+			/* Nothing more will come from the driver */
+			while (handle->submitted) {
+				request = handle->submitted->data;
+				handle->submitted = g_slist_remove (handle->submitted, request);
+				rejilla_sg_request_done (handle,
+							 request,
+							 REJILLA_SCSI_FAILURE,
+							 REJILLA_SCSI_ERRNO);
+			}
+			break;
+		}
+
+		/* usr_ptr is returned as it was given */
+		request = transport.usr_ptr;
+		handle->submitted = g_slist_remove (handle->submitted, request);
+		memcpy (&request->transport, &transport, sizeof (transport));
+
+		code = REJILLA_SCSI_ERROR_NONE;
+		res = rejilla_sg_request_result (request, &code);
+		rejilla_sg_request_done (handle, request, res, code);
+	}
+
+	rejilla_sg_handle_submit (handle);
+	if (handle->submitted)
+		return TRUE;
+
+	handle->watch = 0;
+	return FALSE;
+}
+
+static void
+rejilla_sg_handle_submit (RejillaDeviceHandle *handle)
+{
+	while (!g_queue_is_empty (handle->waiting)
+	&&  g_slist_length (handle->submitted) < REJILLA_SG_MAX_SUBMITTED) {
+		RejillaSgRequest *request;
+
+		request = g_queue_peek_head (handle->waiting);
+		if (write (handle->sg_fd, &request->transport, sizeof (struct sg_io_hdr)) < 0) {
+			if (errno == EINTR)
+				continue;
+
+			/* The driver has no room left for now */
+			if (errno == EAGAIN || errno == EDOM)
+				break;
+
+			g_queue_pop_head (handle->waiting);
+			REJILLA_MEDIA_LOG ("Submitting command failed: %s", g_strerror (errno));
+			rejilla_sg_request_done (handle,
+						 request,
+						 REJILLA_SCSI_FAILURE,
+						 REJILLA_SCSI_ERRNO);
+			continue;
+		}
+
+		g_queue_pop_head (handle->waiting);
+		handle->submitted = g_slist_prepend (handle->submitted, request);
+	}
+
+	/* Answers wake us up; with none to wait for, try again a bit later */
+	if (!handle->submitted
+	&&  !g_queue_is_empty (handle->waiting)
+	&&  !handle->retry)
+		handle->retry = g_timeout_add (REJILLA_SG_RETRY_DELAY,
+					       rejilla_sg_handle_retry_cb,
+					       handle);
+
+	if (handle->submitted && !handle->watch) {
+		GIOChannel *channel;
+
+		channel = g_io_channel_unix_new (handle->sg_fd);
+		handle->watch = g_io_add_watch (channel,
+						G_IO_IN|G_IO_PRI|G_IO_ERR|G_IO_HUP,
+						rejilla_sg_handle_readable,
+						handle);
+		g_io_channel_unref (channel);
+	}
+}
+
+RejillaScsiResult
+rejilla_scsi_command_issue_async (gpointer command,
+				  gpointer buffer,
+				  int size,
+				  int timeout,
+				  RejillaScsiCommandCallback callback,
+				  gpointer user_data,
+				  RejillaScsiErrCode *error)
+{
+	RejillaDeviceHandle *handle;
+	RejillaSgRequest *request;
+	RejillaScsiCmd *cmd;
+
+	g_return_val_if_fail (command != NULL, REJILLA_SCSI_FAILURE);
+	g_return_val_if_fail (callback != NULL, REJILLA_SCSI_FAILURE);
+
+	cmd = command;
+	handle = cmd->handle;
+
+	if (!handle->queue) {
+		handle->queue = rejilla_scsi_queue_new ();
+		handle->sg_fd = rejilla_sg_handle_open_node (handle);
+		if (handle->sg_fd >= 0)
+			handle->waiting = g_queue_new ();
+		else
+			REJILLA_MEDIA_LOG ("No sg node; commands are issued from a thread");
+	}
+
+	/* NOTE: timeout can't be honoured there; the one used for synchronous
+	 * commands applies */
+	if (handle->sg_fd < 0)
+		return rejilla_scsi_queue_push (handle->queue,
+						command,
+						buffer,
+						size,
+						callback,
+						user_data,
+						error);
+
+	request = g_new0 (RejillaSgRequest, 1);
+	request->cmd = cmd;
+	request->callback = callback;
+	request->user_data = user_data;
+
+	rejilla_sg_command_setup (&request->transport,
+				  request->sense_buffer,
+				  cmd,
+				  buffer,
+				  size);
+	request->transport.usr_ptr = request;
+	if (timeout > 0)
+		request->transport.timeout = timeout;
+
+	/* Commands are submitted in order; if too many are already being
+	 * processed by the drive this one waits for a completion */
+	g_queue_push_tail (handle->waiting, request);
+	rejilla_sg_handle_submit (handle);
+	return REJILLA_SCSI_OK;
+}
+
+gpointer
+rejilla_scsi_command_get_buffer (gpointer command,
+				 int size)
+{
+	RejillaScsiCmd *cmd;
+
+	cmd = command;
+	return rejilla_scsi_arena_get_buffer (cmd->handle->arena, size);
+}
+
 gpointer
 rejilla_scsi_command_new (const RejillaScsiCmdInfo *info,
 			  RejillaDeviceHandle *handle) 
@@ -146,8 +498,8 @@ rejilla_scsi_command_new (const RejillaScsiCmdInfo *info,
 
 	/* make sure we can set the flags of the descriptor */
 
-	/* allocate the command */
-	cmd = g_new0 (RejillaScsiCmd, 1);
+	/* allocate the command (or reuse one freed for this handle) */
+	cmd = rejilla_scsi_arena_get_command (handle->arena, sizeof (RejillaScsiCmd));
 	cmd->info = info;
 	cmd->handle = handle;
 
@@ -158,7 +510,7 @@ rejilla_scsi_command_new (const RejillaScsiCmdInfo *info,
 RejillaScsiResult
 rejilla_scsi_command_free (gpointer cmd)
 {
-	g_free (cmd);
+	rejilla_scsi_arena_put_command (((RejillaScsiCmd *) cmd)->handle->arena, cmd);
 	return REJILLA_SCSI_OK;
 }
 
@@ -194,20 +546,89 @@ rejilla_device_handle_open (const gchar *path,
 		return NULL;
 	}
 
-	handle = g_new (RejillaDeviceHandle, 1);
+	handle = g_new0 (RejillaDeviceHandle, 1);
 	handle->fd = fd;
+	handle->arena = rejilla_scsi_arena_new ();
+	handle->sg_fd = -1;
 
 	REJILLA_MEDIA_LOG ("Handle ready");
 	return handle;
 }
 
+static void
+rejilla_sg_handle_stop (RejillaDeviceHandle *handle)
+{
+	RejillaSgRequest *request;
+
+	if (handle->watch) {
+		g_source_remove (handle->watch);
+		handle->watch = 0;
+	}
+
+	if (handle->retry) {
+		g_source_remove (handle->retry);
+		handle->retry = 0;
+	}
+
+	/* The driver discards the answers to the commands still in flight once
+	 * the node is closed; as data goes through its own buffers, it never
+	 * reaches ours */
+	if (handle->sg_fd != handle->fd)
+		close (handle->sg_fd);
+
+	while ((request = g_queue_pop_head (handle->waiting)))
+		rejilla_sg_request_done (handle,
+					 request,
+					 REJILLA_SCSI_FAILURE,
+					 REJILLA_SCSI_ERR_UNKNOWN);
+	g_queue_free (handle->waiting);
+
+	while (handle->submitted) {
+		request = handle->submitted->data;
+		handle->submitted = g_slist_remove (handle->submitted, request);
+		rejilla_sg_request_done (handle,
+					 request,
+					 REJILLA_SCSI_FAILURE,
+					 REJILLA_SCSI_ERR_UNKNOWN);
+	}
+}
+
 void
 rejilla_device_handle_close (RejillaDeviceHandle *handle)
 {
+	if (handle->queue) {
+		if (handle->sg_fd >= 0)
+			rejilla_sg_handle_stop (handle);
+
+		/* Pending commands are called back before their arena is
+		 * freed */
+		rejilla_scsi_queue_free (handle->queue);
+	}
+
 	close (handle->fd);
+	rejilla_scsi_arena_free (handle->arena);
 	g_free (handle);
 }
 
+/**
+ * Returns the largest amount of data (in bytes) a single command can transfer
+ * with this handle. For sg that's the reserved buffer size which, for block
+ * devices, is also bounded by the queue limits.
+ */
+
+int
+rejilla_device_handle_get_max_transfer (RejillaDeviceHandle *handle)
+{
+	int size = 0;
+
+	if (ioctl (handle->fd, SG_GET_RESERVED_SIZE, &size) || size <= 0) {
+		REJILLA_MEDIA_LOG ("No reserved size: %s", strerror (errno));
+		return REJILLA_SCSI_DEFAULT_MAX_TRANSFER;
+	}
+
+	return size;
+}
+
 char *
 rejilla_device_get_bus_target_lun (const gchar *device)
 {
@@ -46,6 +46,13 @@ RejillaScsiResult
 rejilla_spc1_test_unit_ready (RejillaDeviceHandle *handle,
 			      RejillaScsiErrCode *error);
 
+RejillaScsiResult
+rejilla_spc1_test_unit_ready_async (RejillaDeviceHandle *handle,
+				    int timeout,
+				    RejillaScsiCommandCallback callback,
+				    gpointer user_data,
+				    RejillaScsiErrCode *error);
+
 RejillaScsiResult
 rejilla_spc1_mode_sense_get_page (RejillaDeviceHandle *handle,
 				  RejillaSPCPageType num,
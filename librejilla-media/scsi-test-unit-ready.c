@@ -70,4 +70,28 @@ rejilla_spc1_test_unit_ready (RejillaDeviceHandle *handle,
 	return res;
 }
 
- 
+RejillaScsiResult
+rejilla_spc1_test_unit_ready_async (RejillaDeviceHandle *handle,
+				    int timeout,
+				    RejillaScsiCommandCallback callback,
+				    gpointer user_data,
+				    RejillaScsiErrCode *error)
+{
+	RejillaTestUnitReadyCDB *cdb;
+	RejillaScsiResult res;
+
+	g_return_val_if_fail (handle != NULL, REJILLA_SCSI_FAILURE);
+
+	cdb = rejilla_scsi_command_new (&info, handle);
+	res = rejilla_scsi_command_issue_async (cdb,
+						NULL,
+						0,
+						timeout,
+						callback,
+						user_data,
+						error);
+	if (res != REJILLA_SCSI_OK)
+		rejilla_scsi_command_free (cdb);
+
+	return res;
+}
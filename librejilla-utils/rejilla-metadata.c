@@ -48,8 +48,10 @@
 
 #include "rejilla-misc.h"
 #include "rejilla-metadata.h"
+#include "rejilla-silence.h"
 
-#define REJILLA_METADATA_SILENCE_INTERVAL		100000000LL
+#define REJILLA_METADATA_SILENCE_THRESHOLD		-50.0
+#define REJILLA_METADATA_SILENCE_MIN_DURATION		100000000LL
 #define REJILLA_METADATA_INITIAL_STATE			GST_STATE_PAUSED
 
 struct RejillaMetadataPrivate {
@@ -57,7 +59,7 @@ struct RejillaMetadataPrivate {
 	GstElement *source;
 	GstElement *decode;
 	GstElement *convert;
-	GstElement *level;
+	GstElement *filter;
 	GstElement *sink;
 
 	GstElement *pipeline_mp3;
@@ -71,7 +73,11 @@ struct RejillaMetadataPrivate {
 	guint watch;
 	guint watch_mp3;
 
-	RejillaMetadataSilence *silence;
+	/* Silences are looked for in the decoded samples directly */
+	RejillaSilenceDetector *detector;
+	gdouble silence_threshold;
+	gint64 silence_min_duration;
+	gint silence_channels;
 
 	RejillaMetadataFlag flags;
 	RejillaMetadataInfo *info;
@@ -90,10 +96,10 @@ struct RejillaMetadataPrivate {
 
 	guint started:1;
 	guint moved_forward:1;
-	guint prev_level_mes:1;
 	guint video_linked:1;
 	guint audio_linked:1;
 	guint snapshot_started:1;
+	guint silence_decoding:1;
 };
 typedef struct RejillaMetadataPrivate RejillaMetadataPrivate;
 #define REJILLA_METADATA_PRIVATE(object)(G_TYPE_INSTANCE_GET_PRIVATE ((object), REJILLA_TYPE_METADATA, RejillaMetadataPrivate))
@@ -146,6 +152,27 @@ rejilla_metadata_set_get_xid_callback (RejillaMetadata *metadata,
 	priv->xid_user_data = user_data;
 }
 
+/**
+ * rejilla_metadata_set_silence_detection:
+ * @metadata: a #RejillaMetadata
+ * @threshold: the level (in dB) under which a sample is silent
+ * @min_duration: the minimal duration (in ns) of a silence
+ *
+ * Sets how silences are detected with REJILLA_METADATA_FLAG_SILENCES.
+ **/
+
+void
+rejilla_metadata_set_silence_detection (RejillaMetadata *metadata,
+					gdouble threshold,
+					gint64 min_duration)
+{
+	RejillaMetadataPrivate *priv;
+
+	priv = REJILLA_METADATA_PRIVATE (metadata);
+	priv->silence_threshold = threshold;
+	priv->silence_min_duration = min_duration;
+}
+
 struct _RejillaMetadataGstDownload {
 	gchar *detail;
 
@@ -331,9 +358,9 @@ rejilla_metadata_destroy_pipeline (RejillaMetadata *self)
 	gst_object_unref (GST_OBJECT (priv->pipeline));
 	priv->pipeline = NULL;
 
-	if (priv->level) {
-		gst_object_unref (GST_OBJECT (priv->level));
-		priv->level = NULL;
+	if (priv->filter) {
+		gst_object_unref (GST_OBJECT (priv->filter));
+		priv->filter = NULL;
 	}
 
 	if (priv->sink) {
@@ -1000,55 +1027,6 @@ rejilla_metadata_process_element_messages (RejillaMetadata *self,
 	&&   gst_is_missing_plugin_message (msg)) {
 		priv->missing_plugins = g_slist_prepend (priv->missing_plugins, gst_message_ref (msg));
 	}
-	else if (!strcmp (gst_structure_get_name (msg->structure), "level")
-	&&   gst_structure_has_field (msg->structure, "peak")) {
-		const GValue *value;
-		const GValue *list;
-		gdouble peak;
-
-		list = gst_structure_get_value (msg->structure, "peak");
-		value = gst_value_list_get_value (list, 0);
-		peak = g_value_get_double (value);
-
-		/* detection of silence */
-		if (peak < -50.0) {
-			gint64 pos = -1;
-			GstFormat format = GST_FORMAT_TIME;
-
-			/* was there a silence last time we check ?
-			 * NOTE: if that's the first signal we receive
-			 * then consider that silence started from 0 */
-			gst_element_query_position (priv->pipeline, &format, &pos);
-			if (pos == -1) {
-				REJILLA_UTILS_LOG ("impossible to retrieve position");
-				return TRUE;
-			}
-
-			if (!priv->silence) {
-				priv->silence = g_new0 (RejillaMetadataSilence, 1);
-				if (priv->prev_level_mes) {
-					priv->silence->start = pos;
-					priv->silence->end = pos;
-				}
-				else {
-					priv->silence->start = 0;
-					priv->silence->end = pos;
-				}
-			}				
-			else
-				priv->silence->end = pos;
-
-			REJILLA_UTILS_LOG ("silence detected at %lli", pos);
-		}
-		else if (priv->silence) {
-			REJILLA_UTILS_LOG ("silence finished");
-
-			priv->info->silences = g_slist_append (priv->info->silences,
-							       priv->silence);
-			priv->silence = NULL;
-		}
-		priv->prev_level_mes = 1;
-	}
 
 	return TRUE;
 }
@@ -1092,10 +1070,10 @@ rejilla_metadata_success (RejillaMetadata *self)
 	/* check if that's a seekable one */
 	rejilla_metadata_is_seekable (self);
 
-	if (priv->silence) {
-		priv->silence->end = priv->info->len;
-		priv->info->silences = g_slist_append (priv->info->silences, priv->silence);
-		priv->silence = NULL;
+	if (priv->detector) {
+		priv->info->silences = rejilla_silence_detector_finish (priv->detector);
+		rejilla_silence_detector_free (priv->detector);
+		priv->detector = NULL;
 	}
 
 	/* before leaving, check if we need a snapshot */
@@ -1267,6 +1245,14 @@ rejilla_metadata_success_main (RejillaMetadata *self)
 
 	priv = REJILLA_METADATA_PRIVATE (self);
 
+	/* Silences are only known once all the stream was decoded */
+	if ((priv->flags & REJILLA_METADATA_FLAG_SILENCES) && !priv->silence_decoding) {
+		REJILLA_UTILS_LOG ("Decoding %s to find silences", priv->info->uri);
+		priv->silence_decoding = 1;
+		gst_element_set_state (priv->pipeline, GST_STATE_PLAYING);
+		return TRUE;
+	}
+
 	REJILLA_UTILS_LOG ("Metadata retrieval successfully completed for %s", priv->info->uri);
 
 	/* find the type of the file */
@@ -1340,6 +1326,10 @@ rejilla_metadata_bus_messages (GstBus *bus,
 		if (newstate != GST_STATE_PAUSED && newstate != GST_STATE_PLAYING)
 			break;
 
+		/* Looking for silences: wait for the end of the stream */
+		if (priv->silence_decoding)
+			break;
+
 		if (!priv->snapshot_started)
 			return rejilla_metadata_success_main (self);
 
@@ -1352,6 +1342,50 @@ rejilla_metadata_bus_messages (GstBus *bus,
 	return TRUE;
 }
 
+/* Called from the streaming thread for every buffer of decoded samples */
+static gboolean
+rejilla_metadata_silence_buffer_cb (GstPad *pad,
+				    GstBuffer *buffer,
+				    RejillaMetadata *self)
+{
+	RejillaMetadataPrivate *priv;
+	gint channels = 0;
+	gint rate = 0;
+
+	priv = REJILLA_METADATA_PRIVATE (self);
+
+	if (!priv->detector) {
+		GstStructure *structure;
+
+		if (!GST_BUFFER_CAPS (buffer))
+			return TRUE;
+
+		structure = gst_caps_get_structure (GST_BUFFER_CAPS (buffer), 0);
+		gst_structure_get_int (structure, "rate", &rate);
+		gst_structure_get_int (structure, "channels", &channels);
+		if (rate <= 0 || channels <= 0)
+			return TRUE;
+
+		REJILLA_UTILS_LOG ("Looking for silences (%i Hz, %i channels)", rate, channels);
+		priv->detector = rejilla_silence_detector_new (rate,
+							       channels,
+							       priv->silence_threshold,
+							       priv->silence_min_duration);
+
+		/* That's the only time the position is needed: after that the
+		 * position is deduced from the number of samples */
+		if (GST_BUFFER_TIMESTAMP_IS_VALID (buffer))
+			rejilla_silence_detector_set_start (priv->detector, GST_BUFFER_TIMESTAMP (buffer));
+
+		priv->silence_channels = channels;
+	}
+
+	rejilla_silence_detector_process (priv->detector,
+					  (const gint16 *) GST_BUFFER_DATA (buffer),
+					  GST_BUFFER_SIZE (buffer) / (sizeof (gint16) * priv->silence_channels));
+	return TRUE;
+}
+
 static gboolean
 rejilla_metadata_create_audio_pipeline (RejillaMetadata *self)
 {
@@ -1364,41 +1398,55 @@ rejilla_metadata_create_audio_pipeline (RejillaMetadata *self)
 
 	/* set up the pipeline according to flags */
 	if (priv->flags & REJILLA_METADATA_FLAG_SILENCES) {
-		priv->prev_level_mes = 0;
+		GstCaps *filtercaps;
+		GstPad *filter_pad;
 
 		/* Add a reference to these objects as we want to keep them
 		 * around after the bin they've been added to is destroyed
 		 * NOTE: now we destroy the pipeline every time which means
 		 * that it doesn't really matter. */
-		if (!priv->level) {
-			priv->level = gst_element_factory_make ("level", NULL);
-			if (!priv->level) {
+		if (!priv->filter) {
+			priv->filter = gst_element_factory_make ("capsfilter", NULL);
+			if (!priv->filter) {
 				priv->error = g_error_new (REJILLA_UTILS_ERROR,
 							   REJILLA_UTILS_ERROR_GENERAL,
 							   _("%s element could not be created"),
-							   "\"Level\"");
+							   "\"Filter\"");
 				gst_object_unref (priv->audio);
 				priv->audio = NULL;
 				return FALSE;
 			}
-			g_object_set (priv->level,
-				      "message", TRUE,
-				      "interval", (guint64) REJILLA_METADATA_SILENCE_INTERVAL,
-				      NULL);
+
+			/* The detector works on 16 bits samples */
+			filtercaps = gst_caps_new_full (gst_structure_new ("audio/x-raw-int",
+									   "width", G_TYPE_INT, 16,
+									   "depth", G_TYPE_INT, 16,
+									   "endianness", G_TYPE_INT, G_BYTE_ORDER,
+									   "signed", G_TYPE_BOOLEAN, TRUE,
+									   NULL),
+							NULL);
+			g_object_set (priv->filter, "caps", filtercaps, NULL);
+			gst_caps_unref (filtercaps);
+
+			filter_pad = gst_element_get_static_pad (priv->filter, "src");
+			gst_pad_add_buffer_probe (filter_pad,
+						  G_CALLBACK (rejilla_metadata_silence_buffer_cb),
+						  self);
+			gst_object_unref (filter_pad);
 		}
 
 		gst_object_ref (priv->convert);
-		gst_object_ref (priv->level);
+		gst_object_ref (priv->filter);
 		gst_object_ref (priv->sink);
 
 		gst_bin_add_many (GST_BIN (priv->audio),
 				  priv->convert,
-				  priv->level,
+				  priv->filter,
 				  priv->sink,
 				  NULL);
 
 		if (!gst_element_link_many (priv->convert,
-		                            priv->level,
+		                            priv->filter,
 		                            priv->sink,
 		                            NULL)) {
 			REJILLA_UTILS_LOG ("Impossible to link elements");
@@ -1797,9 +1845,9 @@ rejilla_metadata_set_new_uri (RejillaMetadata *self,
 	rejilla_metadata_info_free (priv->info);
 	priv->info = NULL;
 
-	if (priv->silence) {
-		g_free (priv->silence);
-		priv->silence = NULL;
+	if (priv->detector) {
+		rejilla_silence_detector_free (priv->detector);
+		priv->detector = NULL;
 	}
 
 	priv->info = g_new0 (RejillaMetadataInfo, 1);
@@ -1832,6 +1880,7 @@ rejilla_metadata_set_new_uri (RejillaMetadata *self,
 	priv->video_linked = 0;
 	priv->audio_linked = 0;
 	priv->snapshot_started = 0;
+	priv->silence_decoding = 0;
 
 	/* create a necessary source */
 	priv->source = gst_element_make_from_uri (GST_URI_SRC,
@@ -2055,6 +2104,9 @@ rejilla_metadata_init (RejillaMetadata *obj)
 	priv = REJILLA_METADATA_PRIVATE (obj);
 
 	priv->mutex = g_mutex_new ();
+
+	priv->silence_threshold = REJILLA_METADATA_SILENCE_THRESHOLD;
+	priv->silence_min_duration = REJILLA_METADATA_SILENCE_MIN_DURATION;
 }
 
 static void
@@ -2067,9 +2119,9 @@ rejilla_metadata_finalize (GObject *object)
 
 	rejilla_metadata_destroy_pipeline (REJILLA_METADATA (object));
 
-	if (priv->silence) {
-		g_free (priv->silence);
-		priv->silence = NULL;
+	if (priv->detector) {
+		rejilla_silence_detector_free (priv->detector);
+		priv->detector = NULL;
 	}
 
 	if (priv->error) {
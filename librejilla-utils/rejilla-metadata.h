@@ -154,6 +154,11 @@ void
 rejilla_metadata_set_get_xid_callback (RejillaMetadata *metadata,
                                        RejillaMetadataGetXidCb callback,
                                        gpointer user_data);
+
+void
+rejilla_metadata_set_silence_detection (RejillaMetadata *metadata,
+					gdouble threshold,
+					gint64 min_duration);
 G_END_DECLS
 
 #endif				/* METADATA_H */
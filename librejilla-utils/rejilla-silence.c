@@ -0,0 +1,239 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * Librejilla-misc
+ * Copyright (C) Philippe Rouquier 2005-2009 <bonfire-app@wanadoo.fr>
+ *
+ * Librejilla-misc is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The Librejilla-misc authors hereby grant permission for non-GPL compatible
+ * GStreamer plugins to be used and distributed together with GStreamer
+ * and Librejilla-misc. This permission is above and beyond the permissions granted
+ * by the GPL license by which Librejilla-burn is covered. If you modify this code
+ * you may extend this exception to your version of the code, but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version.
+ * 
+ * Librejilla-misc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to:
+ * 	The Free Software Foundation, Inc.,
+ * 	51 Franklin Street, Fifth Floor
+ * 	Boston, MA  02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <math.h>
+
+#include <glib.h>
+
+#include "rejilla-metadata.h"
+#include "rejilla-silence.h"
+
+/* Number of frames whose peak is computed at once. Blocks with a sample
+ * above the threshold are then looked at frame by frame. */
+#define REJILLA_SILENCE_BLOCK		256
+
+#define REJILLA_SILENCE_SECOND		G_GINT64_CONSTANT (1000000000)
+
+struct _RejillaSilenceDetector {
+	gint rate;
+	gint channels;
+	gint threshold;
+	gint64 min_duration;
+
+	/* Position (in ns) of the first sample */
+	gint64 start;
+
+	/* Frames processed so far */
+	guint64 frame;
+
+	/* First frame of the current silence */
+	guint64 silence_start;
+
+	GSList *silences;
+
+	guint silent:1;
+};
+
+/**
+ * rejilla_silence_detector_new:
+ * @rate: the number of frames per second
+ * @channels: the number of samples in a frame
+ * @threshold: the level (in dB) under which a sample is silent
+ * @min_duration: the minimal duration (in ns) of a silence
+ *
+ * Return value: a new #RejillaSilenceDetector.
+ **/
+
+RejillaSilenceDetector *
+rejilla_silence_detector_new (gint rate,
+			      gint channels,
+			      gdouble threshold,
+			      gint64 min_duration)
+{
+	RejillaSilenceDetector *detector;
+
+	g_return_val_if_fail (rate > 0 && channels > 0, NULL);
+
+	detector = g_new0 (RejillaSilenceDetector, 1);
+	detector->rate = rate;
+	detector->channels = channels;
+	detector->min_duration = min_duration;
+
+	/* Level in dB relative to the full scale of 16 bits samples */
+	detector->threshold = (gint) (G_MAXINT16 * pow (10.0, threshold / 20.0));
+
+	return detector;
+}
+
+void
+rejilla_silence_detector_free (RejillaSilenceDetector *detector)
+{
+	g_slist_foreach (detector->silences, (GFunc) g_free, NULL);
+	g_slist_free (detector->silences);
+	g_free (detector);
+}
+
+/**
+ * rejilla_silence_detector_set_start:
+ * @detector: a #RejillaSilenceDetector
+ * @position: the position (in ns) of the first sample in the stream
+ *
+ * Must be called before any sample is processed.
+ **/
+
+void
+rejilla_silence_detector_set_start (RejillaSilenceDetector *detector,
+				    gint64 position)
+{
+	detector->start = position;
+}
+
+static gint64
+rejilla_silence_detector_get_position (RejillaSilenceDetector *detector,
+				       guint64 frame)
+{
+	return detector->start + frame * REJILLA_SILENCE_SECOND / detector->rate;
+}
+
+static void
+rejilla_silence_detector_close (RejillaSilenceDetector *detector,
+				guint64 end)
+{
+	RejillaMetadataSilence *silence;
+	gint64 start_pos;
+	gint64 end_pos;
+
+	detector->silent = FALSE;
+
+	start_pos = rejilla_silence_detector_get_position (detector, detector->silence_start);
+	end_pos = rejilla_silence_detector_get_position (detector, end);
+	if (end_pos - start_pos < detector->min_duration)
+		return;
+
+	silence = g_new0 (RejillaMetadataSilence, 1);
+	silence->start = start_pos;
+	silence->end = end_pos;
+	detector->silences = g_slist_prepend (detector->silences, silence);
+}
+
+/* This is written so that the compiler can vectorise it: no branch other
+ * than the loop and no dependency between iterations but the maximum. */
+static inline gint
+rejilla_silence_detector_peak (const gint16 *samples,
+			       gsize num)
+{
+	gint peak = 0;
+	gsize i;
+
+	for (i = 0; i < num; i ++) {
+		gint value;
+
+		value = samples [i];
+		value = value < 0 ? -value : value;
+		peak = value > peak ? value : peak;
+	}
+
+	return peak;
+}
+
+/**
+ * rejilla_silence_detector_process:
+ * @detector: a #RejillaSilenceDetector
+ * @samples: interleaved samples
+ * @frames: the number of frames in @samples
+ *
+ * Looks for silences in the next @frames frames of the stream.
+ **/
+
+void
+rejilla_silence_detector_process (RejillaSilenceDetector *detector,
+				  const gint16 *samples,
+				  gsize frames)
+{
+	while (frames > 0) {
+		gsize block;
+		gsize i;
+
+		block = MIN (frames, REJILLA_SILENCE_BLOCK);
+
+		if (rejilla_silence_detector_peak (samples, block * detector->channels) <= detector->threshold) {
+			/* The most likely case: the whole block is either
+			 * silent or loud */
+			if (!detector->silent) {
+				detector->silent = TRUE;
+				detector->silence_start = detector->frame;
+			}
+		}
+		else for (i = 0; i < block; i ++) {
+			const gint16 *frame;
+
+			frame = samples + i * detector->channels;
+			if (rejilla_silence_detector_peak (frame, detector->channels) <= detector->threshold) {
+				if (!detector->silent) {
+					detector->silent = TRUE;
+					detector->silence_start = detector->frame + i;
+				}
+			}
+			else if (detector->silent)
+				rejilla_silence_detector_close (detector, detector->frame + i);
+		}
+
+		samples += block * detector->channels;
+		detector->frame += block;
+		frames -= block;
+	}
+}
+
+/**
+ * rejilla_silence_detector_finish:
+ * @detector: a #RejillaSilenceDetector
+ *
+ * Must be called once the whole stream was processed.
+ *
+ * Return value: a #GSList of #RejillaMetadataSilence ordered by position.
+ * The list and its contents are to be freed after use.
+ **/
+
+GSList *
+rejilla_silence_detector_finish (RejillaSilenceDetector *detector)
+{
+	GSList *silences;
+
+	if (detector->silent)
+		rejilla_silence_detector_close (detector, detector->frame);
+
+	silences = g_slist_reverse (detector->silences);
+	detector->silences = NULL;
+	return silences;
+}
@@ -0,0 +1,69 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * Librejilla-misc
+ * Copyright (C) Philippe Rouquier 2005-2009 <bonfire-app@wanadoo.fr>
+ *
+ * Librejilla-misc is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The Librejilla-misc authors hereby grant permission for non-GPL compatible
+ * GStreamer plugins to be used and distributed together with GStreamer
+ * and Librejilla-misc. This permission is above and beyond the permissions granted
+ * by the GPL license by which Librejilla-burn is covered. If you modify this code
+ * you may extend this exception to your version of the code, but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version.
+ * 
+ * Librejilla-misc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to:
+ * 	The Free Software Foundation, Inc.,
+ * 	51 Franklin Street, Fifth Floor
+ * 	Boston, MA  02110-1301, USA.
+ */
+
+#ifndef _REJILLA_SILENCE_H_
+#define _REJILLA_SILENCE_H_
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * Finds the silences in a stream of signed 16 bits native endian PCM samples
+ * with the accuracy of a sample. A silence is a range of samples whose peak
+ * level stays under a threshold for a minimal duration.
+ */
+
+typedef struct _RejillaSilenceDetector RejillaSilenceDetector;
+
+RejillaSilenceDetector *
+rejilla_silence_detector_new (gint rate,
+			      gint channels,
+			      gdouble threshold,
+			      gint64 min_duration);
+
+void
+rejilla_silence_detector_free (RejillaSilenceDetector *detector);
+
+void
+rejilla_silence_detector_set_start (RejillaSilenceDetector *detector,
+				    gint64 position);
+
+void
+rejilla_silence_detector_process (RejillaSilenceDetector *detector,
+				  const gint16 *samples,
+				  gsize frames);
+
+GSList *
+rejilla_silence_detector_finish (RejillaSilenceDetector *detector);
+
+G_END_DECLS
+
+#endif /* _REJILLA_SILENCE_H_ */
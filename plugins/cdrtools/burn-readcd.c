@@ -459,7 +459,7 @@ rejilla_readcd_export_caps (RejillaPlugin *plugin)
 	                       NULL,
 			       _("Copies any disc to a disc image"),
 			       "Philippe Rouquier",
-			       0);
+			       1);
 
 	/* that's for clone mode only The only one to copy audio */
 	output = rejilla_caps_image_new (REJILLA_PLUGIN_IO_ACCEPT_FILE,
@@ -50,6 +50,7 @@
 #include "rejilla-plugin-registration.h"
 #include "burn-job.h"
 #include "burn-volume.h"
+#include "burn-checksum-store.h"
 #include "rejilla-drive.h"
 #include "rejilla-track-disc.h"
 #include "rejilla-track-image.h"
@@ -271,6 +272,7 @@ rejilla_checksum_image_checksum_file_input (RejillaChecksumImage *self,
 	RejillaChecksumImagePrivate *priv;
 	RejillaBurnResult result;
 	RejillaTrack *track;
+	struct stat info;
 	int fd_out = -1;
 	int fd_in = -1;
 	gchar *path;
@@ -293,6 +295,10 @@ rejilla_checksum_image_checksum_file_input (RejillaChecksumImage *self,
 			 path,
 			 priv->total);
 
+	/* Needed to remember the checksum for the next runs */
+	if (g_stat (path, &info))
+		memset (&info, 0, sizeof (info));
+
 	fd_in = open (path, O_RDONLY);
 	if (!fd_in) {
                 int errsv;
@@ -322,6 +328,11 @@ rejilla_checksum_image_checksum_file_input (RejillaChecksumImage *self,
 	/* and here we go */
 	rejilla_job_get_fd_out (REJILLA_JOB (self), &fd_out);
 	result = rejilla_checksum_image_checksum (self, checksum_type, fd_in, fd_out, error);
+	if (result == REJILLA_BURN_OK && info.st_ino)
+		rejilla_burn_checksum_store_add (path,
+						 &info,
+						 priv->checksum_type,
+						 g_checksum_get_string (priv->checksum));
 	g_free (path);
 	close (fd_in);
 
@@ -428,6 +439,30 @@ rejilla_checksum_get_checksum_type (void)
 	return checksum_type;
 }
 
+static RejillaChecksumType
+rejilla_checksum_image_get_image_checksum_type (GChecksumType *checksum_type)
+{
+	RejillaChecksumType type;
+
+	type = rejilla_checksum_get_checksum_type ();
+
+	if (type & REJILLA_CHECKSUM_MD5) {
+		*checksum_type = G_CHECKSUM_MD5;
+		return REJILLA_CHECKSUM_MD5;
+	}
+	if (type & REJILLA_CHECKSUM_SHA1) {
+		*checksum_type = G_CHECKSUM_SHA1;
+		return REJILLA_CHECKSUM_SHA1;
+	}
+	if (type & REJILLA_CHECKSUM_SHA256) {
+		*checksum_type = G_CHECKSUM_SHA256;
+		return REJILLA_CHECKSUM_SHA256;
+	}
+
+	*checksum_type = G_CHECKSUM_MD5;
+	return REJILLA_CHECKSUM_MD5;
+}
+
 static RejillaBurnResult
 rejilla_checksum_image_image_and_checksum (RejillaChecksumImage *self,
 					   GError **error)
@@ -438,18 +473,7 @@ rejilla_checksum_image_image_and_checksum (RejillaChecksumImage *self,
 
 	priv = REJILLA_CHECKSUM_IMAGE_PRIVATE (self);
 
-	priv->checksum_type = rejilla_checksum_get_checksum_type ();
-
-	if (priv->checksum_type & REJILLA_CHECKSUM_MD5)
-		checksum_type = G_CHECKSUM_MD5;
-	else if (priv->checksum_type & REJILLA_CHECKSUM_SHA1)
-		checksum_type = G_CHECKSUM_SHA1;
-	else if (priv->checksum_type & REJILLA_CHECKSUM_SHA256)
-		checksum_type = G_CHECKSUM_SHA256;
-	else {
-		checksum_type = G_CHECKSUM_MD5;
-		priv->checksum_type = REJILLA_CHECKSUM_MD5;
-	}
+	priv->checksum_type = rejilla_checksum_image_get_image_checksum_type (&checksum_type);
 
 	rejilla_job_set_current_action (REJILLA_JOB (self),
 					REJILLA_BURN_ACTION_CHECKSUM,
@@ -668,6 +692,35 @@ rejilla_checksum_image_start (RejillaJob *job,
 	return REJILLA_BURN_OK;
 }
 
+static gboolean
+rejilla_checksum_image_use_stored (RejillaJob *job,
+				   RejillaTrack *track)
+{
+	GChecksumType checksum_type;
+	RejillaChecksumType type;
+	gchar *checksum;
+	gchar *path;
+
+	if (!REJILLA_IS_TRACK_IMAGE (track))
+		return FALSE;
+
+	path = rejilla_track_image_get_source (REJILLA_TRACK_IMAGE (track), FALSE);
+	if (!path)
+		return FALSE;
+
+	type = rejilla_checksum_image_get_image_checksum_type (&checksum_type);
+	checksum = rejilla_burn_checksum_store_lookup (path, type);
+	g_free (path);
+
+	if (!checksum)
+		return FALSE;
+
+	REJILLA_JOB_LOG (job, "Using stored checksum (type = %i) %s", type, checksum);
+	rejilla_track_set_checksum (track, type, checksum);
+	g_free (checksum);
+	return TRUE;
+}
+
 static RejillaBurnResult
 rejilla_checksum_image_activate (RejillaJob *job,
 				 GError **error)
@@ -696,6 +749,11 @@ rejilla_checksum_image_activate (RejillaJob *job,
 		return REJILLA_BURN_NOT_RUNNING;
 	}
 
+	/* The same image may have been hashed during a previous run */
+	if (action == REJILLA_JOB_ACTION_IMAGE
+	&&  rejilla_checksum_image_use_stored (job, track))
+		return REJILLA_BURN_NOT_RUNNING;
+
 	return REJILLA_BURN_OK;
 }
 
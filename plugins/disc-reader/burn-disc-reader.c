@@ -0,0 +1,984 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * Librejilla-burn
+ * Copyright (C) Philippe Rouquier 2005-2009 <bonfire-app@wanadoo.fr>
+ *
+ * Librejilla-burn is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The Librejilla-burn authors hereby grant permission for non-GPL compatible
+ * GStreamer plugins to be used and distributed together with GStreamer
+ * and Librejilla-burn. This permission is above and beyond the permissions granted
+ * by the GPL license by which Librejilla-burn is covered. If you modify this code
+ * you may extend this exception to your version of the code, but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version.
+ * 
+ * Librejilla-burn is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to:
+ * 	The Free Software Foundation, Inc.,
+ * 	51 Franklin Street, Fifth Floor
+ * 	Boston, MA  02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <glib.h>
+#include <glib-object.h>
+#include <glib/gstdio.h>
+#include <glib/gi18n-lib.h>
+#include <gmodule.h>
+
+#include "rejilla-units.h"
+
+#include "burn-job.h"
+#include "rejilla-plugin-registration.h"
+#include "rejilla-tags.h"
+#include "rejilla-drive.h"
+#include "rejilla-medium.h"
+#include "rejilla-track-image.h"
+#include "rejilla-track-disc.h"
+
+#include "scsi-device.h"
+#include "scsi-sbc.h"
+#include "scsi-mmc2.h"
+
+
+#define REJILLA_TYPE_DISC_READER         (rejilla_disc_reader_get_type ())
+#define REJILLA_DISC_READER(o)           (G_TYPE_CHECK_INSTANCE_CAST ((o), REJILLA_TYPE_DISC_READER, RejillaDiscReader))
+#define REJILLA_DISC_READER_CLASS(k)     (G_TYPE_CHECK_CLASS_CAST((k), REJILLA_TYPE_DISC_READER, RejillaDiscReaderClass))
+#define REJILLA_IS_DISC_READER(o)        (G_TYPE_CHECK_INSTANCE_TYPE ((o), REJILLA_TYPE_DISC_READER))
+#define REJILLA_IS_DISC_READER_CLASS(k)  (G_TYPE_CHECK_CLASS_TYPE ((k), REJILLA_TYPE_DISC_READER))
+#define REJILLA_DISC_READER_GET_CLASS(o) (G_TYPE_INSTANCE_GET_CLASS ((o), REJILLA_TYPE_DISC_READER, RejillaDiscReaderClass))
+
+REJILLA_PLUGIN_BOILERPLATE (RejillaDiscReader, rejilla_disc_reader, REJILLA_TYPE_JOB, RejillaJob);
+
+#define REJILLA_SCHEMA_CONFIG		"org.mate.rejilla.config"
+#define REJILLA_KEY_SKIP_UNREADABLE	"disc-reader-skip-unreadable"
+
+#define REJILLA_DISC_READER_BLOCK_SIZE	2048
+
+/* Upper limit for a single READ whatever the OS allows (in blocks) */
+#define REJILLA_DISC_READER_MAX_BLOCKS	512
+
+/* Size of each buffer (in blocks). A READ spans as many buffers as the OS
+ * allows, the data landing directly in each of them. */
+#define REJILLA_DISC_READER_BUFFER_BLOCKS	64
+#define REJILLA_DISC_READER_MAX_SPAN	(REJILLA_DISC_READER_MAX_BLOCKS / REJILLA_DISC_READER_BUFFER_BLOCKS)
+
+/* Number of buffers going back and forth between reader and writer */
+#define REJILLA_DISC_READER_BUFFERS	(REJILLA_DISC_READER_MAX_SPAN * 2)
+
+/* How many times a single block is read before giving up on it */
+#define REJILLA_DISC_READER_RETRIES	3
+
+/* Number of successful reads before the transfer size is doubled again */
+#define REJILLA_DISC_READER_RECOVER	16
+
+struct _RejillaDiscReaderBuffer {
+	guchar *data;
+	gint64 sector;
+	gint blocks;
+};
+typedef struct _RejillaDiscReaderBuffer RejillaDiscReaderBuffer;
+
+struct _RejillaDiscReaderRange {
+	gint64 start;
+	gint64 end;
+};
+typedef struct _RejillaDiscReaderRange RejillaDiscReaderRange;
+
+struct _RejillaDiscReaderPrivate {
+	GError *error;
+	GThread *thread;
+	GMutex *mutex;
+	GCond *cond;
+	guint thread_id;
+
+	/* Buffers are passed from the reader thread to the writer thread
+	 * through full_buffers and given back through free_buffers */
+	GAsyncQueue *free_buffers;
+	GAsyncQueue *full_buffers;
+
+	/* Ranges of blocks that could not be read (only used by the reader
+	 * thread) */
+	GSList *bad_ranges;
+	gint64 bad_blocks;
+
+	int fd;
+	gboolean close_fd;
+
+	/* Set by the writer thread; not a bitfield as cancel is set from
+	 * the main loop at the same time */
+	gboolean write_failed;
+
+	guint cancel:1;
+
+	/* Whether unreadable blocks are replaced with zeros instead of
+	 * failing the copy */
+	guint skip_unreadable:1;
+};
+typedef struct _RejillaDiscReaderPrivate RejillaDiscReaderPrivate;
+
+#define REJILLA_DISC_READER_PRIVATE(o)  (G_TYPE_INSTANCE_GET_PRIVATE ((o), REJILLA_TYPE_DISC_READER, RejillaDiscReaderPrivate))
+
+static GObjectClass *parent_class = NULL;
+
+static void
+rejilla_disc_reader_set_error (RejillaDiscReader *self,
+			       GError *error)
+{
+	RejillaDiscReaderPrivate *priv;
+
+	priv = REJILLA_DISC_READER_PRIVATE (self);
+
+	/* only keep the first one */
+	g_mutex_lock (priv->mutex);
+	if (!priv->error)
+		priv->error = error;
+	else
+		g_error_free (error);
+	g_mutex_unlock (priv->mutex);
+}
+
+static void
+rejilla_disc_reader_get_range (RejillaDiscReader *self,
+			       goffset *start_retval,
+			       goffset *blocks_retval)
+{
+	goffset start = 0;
+	goffset blocks = 0;
+	GValue *value = NULL;
+	RejillaTrack *track = NULL;
+
+	rejilla_job_get_current_track (REJILLA_JOB (self), &track);
+	rejilla_track_tag_lookup (track,
+				  REJILLA_TRACK_MEDIUM_ADDRESS_START_TAG,
+				  &value);
+
+	if (value) {
+		guint64 end;
+
+		/* we were given an address to start */
+		start = g_value_get_uint64 (value);
+
+		/* get the length now */
+		value = NULL;
+		rejilla_track_tag_lookup (track,
+					  REJILLA_TRACK_MEDIUM_ADDRESS_END_TAG,
+					  &value);
+
+		end = g_value_get_uint64 (value);
+		blocks = end - start;
+	}
+	/* 0 means all disc, -1 problem */
+	else if (rejilla_track_disc_get_track_num (REJILLA_TRACK_DISC (track)) > 0) {
+		RejillaDrive *drive;
+		RejillaMedium *medium;
+
+		drive = rejilla_track_disc_get_drive (REJILLA_TRACK_DISC (track));
+		medium = rejilla_drive_get_medium (drive);
+		rejilla_medium_get_track_space (medium,
+						rejilla_track_disc_get_track_num (REJILLA_TRACK_DISC (track)),
+						NULL,
+						&blocks);
+		rejilla_medium_get_track_address (medium,
+						  rejilla_track_disc_get_track_num (REJILLA_TRACK_DISC (track)),
+						  NULL,
+						  &start);
+	}
+	/* BIN output: just read the last track */
+	else {
+		RejillaDrive *drive;
+		RejillaMedium *medium;
+
+		drive = rejilla_track_disc_get_drive (REJILLA_TRACK_DISC (track));
+		medium = rejilla_drive_get_medium (drive);
+		rejilla_medium_get_last_data_track_space (medium,
+							  NULL,
+							  &blocks);
+		rejilla_medium_get_last_data_track_address (medium,
+							    NULL,
+							    &start);
+	}
+
+	if (start_retval)
+		*start_retval = start;
+	if (blocks_retval)
+		*blocks_retval = blocks;
+}
+
+/**
+ * Speeds (in kB/s) used around bad regions
+ */
+
+static gint
+rejilla_disc_reader_get_slow_speed (RejillaMedia media)
+{
+	if (media & REJILLA_MEDIUM_BD)
+		return REJILLA_SPEED_TO_RATE_BD (1) / 1000;
+
+	if (media & REJILLA_MEDIUM_DVD)
+		return REJILLA_SPEED_TO_RATE_DVD (2) / 1000;
+
+	return REJILLA_SPEED_TO_RATE_CD (4) / 1000;
+}
+
+static void
+rejilla_disc_reader_add_bad_block (RejillaDiscReader *self,
+				   gint64 sector)
+{
+	RejillaDiscReaderPrivate *priv;
+	RejillaDiscReaderRange *range;
+
+	priv = REJILLA_DISC_READER_PRIVATE (self);
+	priv->bad_blocks ++;
+
+	/* Merge contiguous blocks (the list is in reverse order) */
+	if (priv->bad_ranges) {
+		range = priv->bad_ranges->data;
+		if (range->end == sector) {
+			range->end ++;
+			return;
+		}
+	}
+
+	range = g_new0 (RejillaDiscReaderRange, 1);
+	range->start = sector;
+	range->end = sector + 1;
+	priv->bad_ranges = g_slist_prepend (priv->bad_ranges, range);
+}
+
+static void
+rejilla_disc_reader_write_bad_map (RejillaDiscReader *self)
+{
+	RejillaDiscReaderPrivate *priv;
+	gchar *image = NULL;
+	gchar *path;
+	GSList *iter;
+	FILE *file;
+
+	priv = REJILLA_DISC_READER_PRIVATE (self);
+	if (!priv->bad_ranges)
+		return;
+
+	priv->bad_ranges = g_slist_reverse (priv->bad_ranges);
+
+	REJILLA_JOB_LOG (self, "%"G_GINT64_FORMAT" blocks could not be read", priv->bad_blocks);
+	for (iter = priv->bad_ranges; iter; iter = iter->next) {
+		RejillaDiscReaderRange *range;
+
+		range = iter->data;
+		REJILLA_JOB_LOG (self,
+				 "Unreadable blocks from %"G_GINT64_FORMAT" to %"G_GINT64_FORMAT,
+				 range->start,
+				 range->end);
+	}
+
+	/* Only when we write to a file; the map goes alongside the image */
+	if (rejilla_job_get_fd_out (REJILLA_JOB (self), NULL) == REJILLA_BURN_OK)
+		return;
+
+	rejilla_job_get_image_output (REJILLA_JOB (self), &image, NULL);
+	if (!image)
+		return;
+
+	path = g_strdup_printf ("%s.badmap", image);
+	g_free (image);
+
+	file = fopen (path, "w");
+	if (!file) {
+		REJILLA_JOB_LOG (self, "Bad block map could not be written (%s)", g_strerror (errno));
+		g_free (path);
+		return;
+	}
+
+	/* One line per range: first block and number of blocks */
+	for (iter = priv->bad_ranges; iter; iter = iter->next) {
+		RejillaDiscReaderRange *range;
+
+		range = iter->data;
+		fprintf (file,
+			 "%"G_GINT64_FORMAT" %"G_GINT64_FORMAT"\n",
+			 range->start,
+			 range->end - range->start);
+	}
+
+	fclose (file);
+	REJILLA_JOB_LOG (self, "Bad block map written to %s", path);
+	g_free (path);
+}
+
+static gboolean
+rejilla_disc_reader_thread_finished (gpointer data)
+{
+	goffset blocks = 0;
+	gchar *image = NULL;
+	RejillaDiscReader *self = data;
+	RejillaDiscReaderPrivate *priv;
+	RejillaTrackImage *track = NULL;
+
+	priv = REJILLA_DISC_READER_PRIVATE (self);
+	priv->thread_id = 0;
+
+	if (priv->error) {
+		GError *error;
+
+		error = priv->error;
+		priv->error = NULL;
+		rejilla_job_error (REJILLA_JOB (self), error);
+		return FALSE;
+	}
+
+	track = rejilla_track_image_new ();
+	rejilla_job_get_image_output (REJILLA_JOB (self),
+				      &image,
+				      NULL);
+	rejilla_track_image_set_source (track,
+					image,
+					NULL,
+					REJILLA_IMAGE_FORMAT_BIN);
+
+	rejilla_job_get_session_output_size (REJILLA_JOB (self), &blocks, NULL);
+	rejilla_track_image_set_block_num (track, blocks);
+
+	rejilla_job_add_track (REJILLA_JOB (self), REJILLA_TRACK (track));
+	g_object_unref (track);
+
+	rejilla_job_finished_track (REJILLA_JOB (self));
+
+	return FALSE;
+}
+
+static gpointer
+rejilla_disc_reader_write_thread (gpointer data)
+{
+	RejillaDiscReader *self = data;
+	RejillaDiscReaderPrivate *priv;
+	gint64 written = 0;
+
+	priv = REJILLA_DISC_READER_PRIVATE (self);
+
+	while (1) {
+		RejillaDiscReaderBuffer *buffer;
+		gsize bytes_remaining;
+		gsize bytes_written;
+		GTimeVal timeout;
+
+		if (priv->cancel)
+			break;
+
+		g_get_current_time (&timeout);
+		g_time_val_add (&timeout, 500000);
+		buffer = g_async_queue_timed_pop (priv->full_buffers, &timeout);
+		if (!buffer)
+			continue;
+
+		/* That's the end of the data */
+		if (!buffer->blocks) {
+			g_free (buffer);
+			break;
+		}
+
+		bytes_written = 0;
+		bytes_remaining = buffer->blocks * REJILLA_DISC_READER_BLOCK_SIZE;
+		while (bytes_remaining && !priv->cancel) {
+			gssize res;
+
+			res = write (priv->fd, buffer->data + bytes_written, bytes_remaining);
+			if (res < 0) {
+				int errsv = errno;
+
+				if (errsv == EINTR || errsv == EAGAIN) {
+					g_thread_yield ();
+					continue;
+				}
+
+				rejilla_disc_reader_set_error (self,
+							       g_error_new (REJILLA_BURN_ERROR,
+									    REJILLA_BURN_ERROR_GENERAL,
+									    _("Data could not be written (%s)"),
+									    g_strerror (errsv)));
+				priv->write_failed = TRUE;
+				break;
+			}
+
+			bytes_remaining -= res;
+			bytes_written += res;
+		}
+
+		g_async_queue_push (priv->free_buffers, buffer);
+		if (priv->write_failed)
+			break;
+
+		written += bytes_written;
+		rejilla_job_set_written_track (REJILLA_JOB (self), written);
+	}
+
+	return NULL;
+}
+
+static RejillaDiscReaderBuffer *
+rejilla_disc_reader_get_free_buffer (RejillaDiscReader *self)
+{
+	RejillaDiscReaderPrivate *priv;
+
+	priv = REJILLA_DISC_READER_PRIVATE (self);
+	while (!priv->cancel && !priv->write_failed) {
+		RejillaDiscReaderBuffer *buffer;
+		GTimeVal timeout;
+
+		g_get_current_time (&timeout);
+		g_time_val_add (&timeout, 500000);
+		buffer = g_async_queue_timed_pop (priv->free_buffers, &timeout);
+		if (buffer)
+			return buffer;
+	}
+
+	return NULL;
+}
+
+/**
+ * Describes @num blocks starting at block @first of the consecutive @buffers
+ * so that they can be read with a single command.
+ */
+
+static int
+rejilla_disc_reader_get_iov (RejillaDiscReaderBuffer **buffers,
+			     gint first,
+			     gint num,
+			     struct iovec *iov)
+{
+	int iov_count = 0;
+
+	while (num > 0) {
+		gint offset;
+		gint len;
+
+		offset = first % REJILLA_DISC_READER_BUFFER_BLOCKS;
+		len = MIN (num, REJILLA_DISC_READER_BUFFER_BLOCKS - offset);
+
+		iov [iov_count].iov_base = buffers [first / REJILLA_DISC_READER_BUFFER_BLOCKS]->data +
+					   offset * REJILLA_DISC_READER_BLOCK_SIZE;
+		iov [iov_count].iov_len = len * REJILLA_DISC_READER_BLOCK_SIZE;
+		iov_count ++;
+
+		first += len;
+		num -= len;
+	}
+
+	return iov_count;
+}
+
+static gpointer
+rejilla_disc_reader_read_thread (gpointer data)
+{
+	RejillaDiscReader *self = data;
+	RejillaDeviceHandle *handle = NULL;
+	RejillaDiscReaderBuffer *buffers [REJILLA_DISC_READER_MAX_SPAN];
+	RejillaDiscReaderPrivate *priv;
+	RejillaDiscReaderBuffer *buffer;
+	RejillaScsiErrCode code = 0;
+	GThread *writer = NULL;
+	RejillaTrack *track;
+	RejillaDrive *drive;
+	RejillaMedia media;
+	gboolean slowed = FALSE;
+	goffset start, blocks;
+	gint64 sector, end;
+	gint max_blocks;
+	gint chunk;
+	gint good = 0;
+	gint retries = 0;
+	gint i;
+
+	priv = REJILLA_DISC_READER_PRIVATE (self);
+
+	rejilla_job_get_current_track (REJILLA_JOB (self), &track);
+	drive = rejilla_track_disc_get_drive (REJILLA_TRACK_DISC (track));
+	media = rejilla_medium_get_status (rejilla_drive_get_medium (drive));
+
+	rejilla_disc_reader_get_range (self, &start, &blocks);
+	REJILLA_JOB_LOG (self,
+			 "Reading from block %"G_GINT64_FORMAT" to %"G_GINT64_FORMAT,
+			 start,
+			 start + blocks);
+
+	handle = rejilla_device_handle_open (rejilla_drive_get_device (drive), FALSE, &code);
+	if (!handle) {
+		rejilla_disc_reader_set_error (self,
+					       g_error_new (REJILLA_BURN_ERROR,
+							    REJILLA_BURN_ERROR_GENERAL,
+							    _("The drive could not be opened (%s)"),
+							    rejilla_scsi_strerror (code)));
+		goto end;
+	}
+
+	/* Use the largest transfers the OS allows */
+	max_blocks = rejilla_device_handle_get_max_transfer (handle) / REJILLA_DISC_READER_BLOCK_SIZE;
+	max_blocks = CLAMP (max_blocks, 1, REJILLA_DISC_READER_MAX_BLOCKS);
+	chunk = max_blocks;
+	REJILLA_JOB_LOG (self, "Reading %i blocks at a time", max_blocks);
+
+	if (rejilla_job_get_fd_out (REJILLA_JOB (self), &priv->fd) != REJILLA_BURN_OK) {
+		gchar *output = NULL;
+
+		rejilla_job_get_image_output (REJILLA_JOB (self), &output, NULL);
+		priv->fd = g_open (output, O_WRONLY|O_CREAT|O_TRUNC, S_IRUSR|S_IWUSR|S_IRGRP|S_IROTH);
+		if (priv->fd == -1) {
+			int errsv = errno;
+
+			rejilla_disc_reader_set_error (self,
+						       g_error_new_literal (REJILLA_BURN_ERROR,
+									    REJILLA_BURN_ERROR_GENERAL,
+									    g_strerror (errsv)));
+			g_free (output);
+			goto end;
+		}
+		g_free (output);
+		priv->close_fd = TRUE;
+	}
+
+	for (i = 0; i < REJILLA_DISC_READER_BUFFERS; i ++) {
+		buffer = g_new0 (RejillaDiscReaderBuffer, 1);
+		buffer->data = g_malloc (REJILLA_DISC_READER_BUFFER_BLOCKS * REJILLA_DISC_READER_BLOCK_SIZE);
+		g_async_queue_push (priv->free_buffers, buffer);
+	}
+
+	/* Writing happens in its own thread so that reading never waits for
+	 * the output to be ready */
+	writer = g_thread_create (rejilla_disc_reader_write_thread,
+				  self,
+				  TRUE,
+				  NULL);
+	if (!writer) {
+		rejilla_disc_reader_set_error (self,
+					       g_error_new (REJILLA_BURN_ERROR,
+							    REJILLA_BURN_ERROR_GENERAL,
+							    _("An internal error occurred")));
+		goto end;
+	}
+
+	rejilla_job_set_use_average_rate (REJILLA_JOB (self), TRUE);
+	rejilla_job_set_current_action (REJILLA_JOB (self),
+					REJILLA_BURN_ACTION_DRIVE_COPY,
+					NULL,
+					FALSE);
+	rejilla_job_start_progress (REJILLA_JOB (self), FALSE);
+
+	sector = start;
+	end = start + blocks;
+	while (sector < end) {
+		gint filled = 0;
+		gint count;
+		gint span;
+
+		count = MIN (max_blocks, end - sector);
+		span = (count + REJILLA_DISC_READER_BUFFER_BLOCKS - 1) / REJILLA_DISC_READER_BUFFER_BLOCKS;
+		for (i = 0; i < span; i ++) {
+			buffers [i] = rejilla_disc_reader_get_free_buffer (self);
+			if (!buffers [i])
+				break;
+		}
+
+		if (i < span) {
+			while (i > 0)
+				g_async_queue_push (priv->free_buffers, buffers [-- i]);
+			break;
+		}
+
+		while (filled < count && !priv->cancel) {
+			struct iovec iov [REJILLA_DISC_READER_MAX_SPAN];
+			RejillaScsiResult res;
+			int iov_count;
+			gint num;
+
+			num = MIN (chunk, count - filled);
+			iov_count = rejilla_disc_reader_get_iov (buffers, filled, num, iov);
+			res = rejilla_sbc_read10_block_iov (handle,
+							    sector + filled,
+							    num,
+							    iov,
+							    iov_count,
+							    &code);
+			if (res == REJILLA_SCSI_OK) {
+				filled += num;
+				retries = 0;
+
+				/* Get back to full speed and size progressively
+				 * once we're past the bad region */
+				if (chunk < max_blocks && ++ good >= REJILLA_DISC_READER_RECOVER) {
+					chunk = MIN (chunk * 2, max_blocks);
+					good = 0;
+				}
+
+				if (slowed && chunk == max_blocks) {
+					REJILLA_JOB_LOG (self, "Restoring maximum read speed");
+					rejilla_mmc2_set_cd_speed (handle,
+								   REJILLA_SCSI_SPEED_MAX,
+								   REJILLA_SCSI_SPEED_MAX,
+								   NULL);
+					slowed = FALSE;
+				}
+				continue;
+			}
+
+			if (code == REJILLA_SCSI_NO_MEDIUM) {
+				rejilla_disc_reader_set_error (self,
+							       g_error_new (REJILLA_BURN_ERROR,
+									    REJILLA_BURN_ERROR_MEDIUM_NONE,
+									    _("The disc could not be read (%s)"),
+									    rejilla_scsi_strerror (code)));
+				break;
+			}
+
+			REJILLA_JOB_LOG (self,
+					 "Read error at block %"G_GINT64_FORMAT" (%i blocks): %s",
+					 sector + filled,
+					 num,
+					 rejilla_scsi_strerror (code));
+
+			good = 0;
+
+			/* Slow down the drive: it usually has better chances
+			 * to read damaged areas at lower speeds */
+			if (!slowed) {
+				gint speed;
+
+				speed = rejilla_disc_reader_get_slow_speed (media);
+				REJILLA_JOB_LOG (self, "Lowering read speed to %i kB/s", speed);
+				rejilla_mmc2_set_cd_speed (handle,
+							   speed,
+							   REJILLA_SCSI_SPEED_MAX,
+							   NULL);
+				slowed = TRUE;
+			}
+
+			/* Narrow down the region with smaller reads */
+			if (chunk > 1) {
+				chunk = MAX (1, num / 2);
+				continue;
+			}
+
+			if (++ retries < REJILLA_DISC_READER_RETRIES)
+				continue;
+
+			/* The image would be silently corrupted: only go on if
+			 * the user asked for it */
+			if (!priv->skip_unreadable) {
+				rejilla_disc_reader_set_error (self,
+							       g_error_new (REJILLA_BURN_ERROR,
+									    REJILLA_BURN_ERROR_GENERAL,
+									    _("The disc could not be read (%s)"),
+									    rejilla_scsi_strerror (code)));
+				break;
+			}
+
+			/* Give up on this block */
+			buffer = buffers [filled / REJILLA_DISC_READER_BUFFER_BLOCKS];
+			memset (buffer->data + (filled % REJILLA_DISC_READER_BUFFER_BLOCKS) * REJILLA_DISC_READER_BLOCK_SIZE,
+				0,
+				REJILLA_DISC_READER_BLOCK_SIZE);
+			rejilla_disc_reader_add_bad_block (self, sector + filled);
+			filled ++;
+			retries = 0;
+		}
+
+		/* Hand the buffers over in order; those left empty go back */
+		for (i = 0; i < span; i ++) {
+			buffer = buffers [i];
+			buffer->sector = sector + i * REJILLA_DISC_READER_BUFFER_BLOCKS;
+			buffer->blocks = CLAMP (filled - i * REJILLA_DISC_READER_BUFFER_BLOCKS,
+						0,
+						REJILLA_DISC_READER_BUFFER_BLOCKS);
+			if (buffer->blocks)
+				g_async_queue_push (priv->full_buffers, buffer);
+			else
+				g_async_queue_push (priv->free_buffers, buffer);
+		}
+
+		sector += filled;
+		if (filled < count)
+			break;
+	}
+
+	if (slowed)
+		rejilla_mmc2_set_cd_speed (handle,
+					   REJILLA_SCSI_SPEED_MAX,
+					   REJILLA_SCSI_SPEED_MAX,
+					   NULL);
+
+	/* Tell the writer there won't be anything more and wait for it */
+	g_async_queue_push (priv->full_buffers, g_new0 (RejillaDiscReaderBuffer, 1));
+	g_thread_join (writer);
+
+	if (!priv->cancel)
+		rejilla_disc_reader_write_bad_map (self);
+
+end:
+
+	if (handle)
+		rejilla_device_handle_close (handle);
+
+	if (priv->close_fd) {
+		close (priv->fd);
+		priv->close_fd = FALSE;
+	}
+	priv->fd = -1;
+
+	while ((buffer = g_async_queue_try_pop (priv->free_buffers))) {
+		g_free (buffer->data);
+		g_free (buffer);
+	}
+
+	while ((buffer = g_async_queue_try_pop (priv->full_buffers))) {
+		g_free (buffer->data);
+		g_free (buffer);
+	}
+
+	g_slist_foreach (priv->bad_ranges, (GFunc) g_free, NULL);
+	g_slist_free (priv->bad_ranges);
+	priv->bad_ranges = NULL;
+	priv->bad_blocks = 0;
+	priv->write_failed = FALSE;
+
+	if (!priv->cancel)
+		priv->thread_id = g_idle_add (rejilla_disc_reader_thread_finished, self);
+
+	/* End thread */
+	g_mutex_lock (priv->mutex);
+	priv->thread = NULL;
+	g_cond_signal (priv->cond);
+	g_mutex_unlock (priv->mutex);
+
+	g_thread_exit (NULL);
+
+	return NULL;
+}
+
+static RejillaBurnResult
+rejilla_disc_reader_start (RejillaJob *job,
+			   GError **error)
+{
+	RejillaDiscReader *self;
+	RejillaJobAction action;
+	RejillaDiscReaderPrivate *priv;
+	GError *thread_error = NULL;
+
+	self = REJILLA_DISC_READER (job);
+	priv = REJILLA_DISC_READER_PRIVATE (self);
+
+	rejilla_job_get_action (job, &action);
+	if (action == REJILLA_JOB_ACTION_SIZE) {
+		goffset blocks = 0;
+
+		rejilla_disc_reader_get_range (self, NULL, &blocks);
+		rejilla_job_set_output_size_for_current_track (job,
+							       blocks,
+							       blocks * REJILLA_DISC_READER_BLOCK_SIZE);
+		return REJILLA_BURN_NOT_RUNNING;
+	}
+
+	if (action != REJILLA_JOB_ACTION_IMAGE)
+		return REJILLA_BURN_NOT_SUPPORTED;
+
+	if (priv->thread)
+		return REJILLA_BURN_RUNNING;
+
+	g_mutex_lock (priv->mutex);
+	priv->thread = g_thread_create (rejilla_disc_reader_read_thread,
+					self,
+					FALSE,
+					&thread_error);
+	g_mutex_unlock (priv->mutex);
+
+	/* Reminder: this is not necessarily an error as the thread may have finished */
+	if (thread_error) {
+		g_propagate_error (error, thread_error);
+		return REJILLA_BURN_ERR;
+	}
+
+	return REJILLA_BURN_OK;
+}
+
+static void
+rejilla_disc_reader_stop_real (RejillaDiscReader *self)
+{
+	RejillaDiscReaderPrivate *priv;
+
+	priv = REJILLA_DISC_READER_PRIVATE (self);
+
+	g_mutex_lock (priv->mutex);
+	if (priv->thread) {
+		priv->cancel = 1;
+		g_cond_wait (priv->cond, priv->mutex);
+		priv->cancel = 0;
+	}
+	g_mutex_unlock (priv->mutex);
+
+	if (priv->thread_id) {
+		g_source_remove (priv->thread_id);
+		priv->thread_id = 0;
+	}
+
+	if (priv->error) {
+		g_error_free (priv->error);
+		priv->error = NULL;
+	}
+}
+
+static RejillaBurnResult
+rejilla_disc_reader_stop (RejillaJob *job,
+			  GError **error)
+{
+	RejillaDiscReader *self;
+
+	self = REJILLA_DISC_READER (job);
+
+	rejilla_disc_reader_stop_real (self);
+	return REJILLA_BURN_OK;
+}
+
+static void
+rejilla_disc_reader_class_init (RejillaDiscReaderClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	RejillaJobClass *job_class = REJILLA_JOB_CLASS (klass);
+
+	g_type_class_add_private (klass, sizeof (RejillaDiscReaderPrivate));
+
+	parent_class = g_type_class_peek_parent (klass);
+	object_class->finalize = rejilla_disc_reader_finalize;
+
+	job_class->start = rejilla_disc_reader_start;
+	job_class->stop = rejilla_disc_reader_stop;
+}
+
+static void
+rejilla_disc_reader_init (RejillaDiscReader *obj)
+{
+	RejillaDiscReaderPrivate *priv;
+	GSettings *settings;
+
+	priv = REJILLA_DISC_READER_PRIVATE (obj);
+
+	settings = g_settings_new (REJILLA_SCHEMA_CONFIG);
+	priv->skip_unreadable = g_settings_get_boolean (settings, REJILLA_KEY_SKIP_UNREADABLE);
+	g_object_unref (settings);
+
+	priv->mutex = g_mutex_new ();
+	priv->cond = g_cond_new ();
+
+	priv->fd = -1;
+	priv->free_buffers = g_async_queue_new ();
+	priv->full_buffers = g_async_queue_new ();
+}
+
+static void
+rejilla_disc_reader_finalize (GObject *object)
+{
+	RejillaDiscReaderPrivate *priv;
+
+	priv = REJILLA_DISC_READER_PRIVATE (object);
+
+	rejilla_disc_reader_stop_real (REJILLA_DISC_READER (object));
+
+	if (priv->free_buffers) {
+		g_async_queue_unref (priv->free_buffers);
+		priv->free_buffers = NULL;
+	}
+
+	if (priv->full_buffers) {
+		g_async_queue_unref (priv->full_buffers);
+		priv->full_buffers = NULL;
+	}
+
+	if (priv->mutex) {
+		g_mutex_free (priv->mutex);
+		priv->mutex = NULL;
+	}
+
+	if (priv->cond) {
+		g_cond_free (priv->cond);
+		priv->cond = NULL;
+	}
+
+	G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+rejilla_disc_reader_export_caps (RejillaPlugin *plugin)
+{
+	RejillaPluginConfOption *skip_unreadable;
+	GSList *output;
+	GSList *input;
+
+	/* readcd and readom are preferred */
+	rejilla_plugin_define (plugin,
+			       "disc-reader",
+	                       NULL,
+			       _("Copies data discs to a disc image"),
+			       "The Rejilla developers",
+			       0);
+
+	/* Only 2048 bytes blocks are read so that's for data only */
+	output = rejilla_caps_image_new (REJILLA_PLUGIN_IO_ACCEPT_FILE|
+					 REJILLA_PLUGIN_IO_ACCEPT_PIPE,
+					 REJILLA_IMAGE_FORMAT_BIN);
+
+	input = rejilla_caps_disc_new (REJILLA_MEDIUM_CD|
+				       REJILLA_MEDIUM_DVD|
+				       REJILLA_MEDIUM_DUAL_L|
+				       REJILLA_MEDIUM_PLUS|
+				       REJILLA_MEDIUM_SEQUENTIAL|
+				       REJILLA_MEDIUM_RESTRICTED|
+				       REJILLA_MEDIUM_ROM|
+				       REJILLA_MEDIUM_WRITABLE|
+				       REJILLA_MEDIUM_REWRITABLE|
+				       REJILLA_MEDIUM_CLOSED|
+				       REJILLA_MEDIUM_APPENDABLE|
+				       REJILLA_MEDIUM_HAS_DATA);
+
+	rejilla_plugin_link_caps (plugin, output, input);
+	g_slist_free (output);
+	g_slist_free (input);
+
+	input = rejilla_caps_disc_new (REJILLA_MEDIUM_BD|
+				       REJILLA_MEDIUM_DUAL_L|
+				       REJILLA_MEDIUM_ROM|
+				       REJILLA_MEDIUM_WRITABLE|
+				       REJILLA_MEDIUM_REWRITABLE|
+				       REJILLA_MEDIUM_CLOSED|
+				       REJILLA_MEDIUM_APPENDABLE|
+				       REJILLA_MEDIUM_HAS_DATA);
+
+	output = rejilla_caps_image_new (REJILLA_PLUGIN_IO_ACCEPT_FILE|
+					 REJILLA_PLUGIN_IO_ACCEPT_PIPE,
+					 REJILLA_IMAGE_FORMAT_BIN);
+	rejilla_plugin_link_caps (plugin, output, input);
+	g_slist_free (output);
+	g_slist_free (input);
+
+	skip_unreadable = rejilla_plugin_conf_option_new (REJILLA_KEY_SKIP_UNREADABLE,
+							  _("Replace the blocks that cannot be read with zeros instead of stopping the copy"),
+							  REJILLA_PLUGIN_OPTION_BOOL);
+	rejilla_plugin_add_conf_option (plugin, skip_unreadable);
+}
@@ -71,13 +71,31 @@ struct _RejillaDvdcssPrivate {
 	GCond *cond;
 	guint thread_id;
 
+	/* Buffers go from the reading thread to the writing thread through
+	 * full_buffers and come back through free_buffers */
+	GAsyncQueue *free_buffers;
+	GAsyncQueue *full_buffers;
+	FILE *output;
+
+	/* Set by the writing thread; not a bitfield as cancel is set from
+	 * the main loop at the same time */
+	gboolean write_failed;
+
 	guint cancel:1;
 };
 typedef struct _RejillaDvdcssPrivate RejillaDvdcssPrivate;
 
 #define REJILLA_DVDCSS_PRIVATE(o)  (G_TYPE_INSTANCE_GET_PRIVATE ((o), REJILLA_TYPE_DVDCSS, RejillaDvdcssPrivate))
 
-#define REJILLA_DVDCSS_I_BLOCKS	16ULL
+/* Maximum number of blocks per read and number of buffers in flight */
+#define REJILLA_DVDCSS_I_BLOCKS	512ULL
+#define REJILLA_DVDCSS_BUFFERS	4
+
+struct _RejillaDvdcssBuffer {
+	guchar *data;
+	gint blocks;
+};
+typedef struct _RejillaDvdcssBuffer RejillaDvdcssBuffer;
 
 static GObjectClass *parent_class = NULL;
 
@@ -213,10 +231,13 @@ rejilla_dvdcss_write_sector_to_fd (RejillaDvdcss *self,
                                 int errsv = errno;
 
 				/* unrecoverable error */
-				priv->error = g_error_new (REJILLA_BURN_ERROR,
-							   REJILLA_BURN_ERROR_GENERAL,
-							   _("Data could not be written (%s)"),
-							   g_strerror (errsv));
+				g_mutex_lock (priv->mutex);
+				if (!priv->error)
+					priv->error = g_error_new (REJILLA_BURN_ERROR,
+								   REJILLA_BURN_ERROR_GENERAL,
+								   _("Data could not be written (%s)"),
+								   g_strerror (errsv));
+				g_mutex_unlock (priv->mutex);
 				return REJILLA_BURN_ERR;
 			}
 
@@ -232,33 +253,95 @@ rejilla_dvdcss_write_sector_to_fd (RejillaDvdcss *self,
 	return REJILLA_BURN_OK;
 }
 
+static gpointer
+rejilla_dvdcss_write_thread (gpointer data)
+{
+	RejillaDvdcss *self = data;
+	RejillaDvdcssPrivate *priv;
+	gint64 written = 0;
+
+	priv = REJILLA_DVDCSS_PRIVATE (self);
+
+	while (!priv->cancel) {
+		RejillaDvdcssBuffer *buffer;
+		guint64 data_size;
+		GTimeVal timeout;
+
+		g_get_current_time (&timeout);
+		g_time_val_add (&timeout, 500000);
+		buffer = g_async_queue_timed_pop (priv->full_buffers, &timeout);
+		if (!buffer)
+			continue;
+
+		/* That's the end of the data */
+		if (!buffer->blocks) {
+			g_free (buffer);
+			break;
+		}
+
+		data_size = buffer->blocks * DVDCSS_BLOCK_SIZE;
+		if (priv->output) {
+			if (fwrite (buffer->data, 1, data_size, priv->output) != data_size) {
+                                int errsv = errno;
+
+				g_mutex_lock (priv->mutex);
+				if (!priv->error)
+					priv->error = g_error_new (REJILLA_BURN_ERROR,
+								   REJILLA_BURN_ERROR_GENERAL,
+								   _("Data could not be written (%s)"),
+								   g_strerror (errsv));
+				g_mutex_unlock (priv->mutex);
+				priv->write_failed = TRUE;
+			}
+		}
+		else {
+			RejillaBurnResult result;
+
+			result = rejilla_dvdcss_write_sector_to_fd (self,
+								    buffer->data,
+								    data_size);
+			if (result != REJILLA_BURN_OK)
+				priv->write_failed = TRUE;
+		}
+
+		g_async_queue_push (priv->free_buffers, buffer);
+		if (priv->write_failed)
+			break;
+
+		written += data_size;
+		rejilla_job_set_written_track (REJILLA_JOB (self), written);
+	}
+
+	return NULL;
+}
+
 struct _RejillaScrambledSectorRange {
 	gint start;
 	gint end;
 };
 typedef struct _RejillaScrambledSectorRange RejillaScrambledSectorRange;
 
+/**
+ * NOTE: keys are not retrieved here but when the copy reaches each range so
+ * that the (unscrambled) beginning of the disc is copied meanwhile.
+ */
+
 static gboolean
 rejilla_dvdcss_create_scrambled_sectors_map (RejillaDvdcss *self,
                                              GQueue *map,
-					     dvdcss_handle *handle,
-					     RejillaVolFile *parent,
-					     GError **error)
+					     RejillaVolFile *parent)
 {
 	GList *iter;
 
-	/* this allows to cache keys for encrypted files */
 	for (iter = parent->specific.dir.children; iter; iter = iter->next) {
 		RejillaVolFile *file;
 
 		file = iter->data;
 		if (!file->isdir) {
 			if (!strncmp (file->name + strlen (file->name) - 6, ".VOB", 4)) {
-				RejillaScrambledSectorRange *range;
-				gsize current_extent;
 				GSList *extents;
 
-				REJILLA_JOB_LOG (self, "Retrieving keys for %s", file->name);
+				REJILLA_JOB_LOG (self, "Mapping %s", file->name);
 
 				/* take the first address for each extent of the file */
 				if (!file->specific.file.extents) {
@@ -266,37 +349,26 @@ rejilla_dvdcss_create_scrambled_sectors_map (RejillaDvdcss *self,
 					return FALSE;
 				}
 
-				range = g_new0 (RejillaScrambledSectorRange, 1);
 				for (extents = file->specific.file.extents; extents; extents = extents->next) {
+					RejillaScrambledSectorRange *range;
 					RejillaVolFileExtent *extent;
 
 					extent = extents->data;
-
-					range->start = extent->block;
-					range->end = extent->block + REJILLA_BYTES_TO_SECTORS (extent->size, DVDCSS_BLOCK_SIZE);
-
-					REJILLA_JOB_LOG (self, "From 0x%llx to 0x%llx", range->start, range->end);
-					g_queue_push_head (map, range);
-
 					if (extent->size == 0) {
 						REJILLA_JOB_LOG (self, "0 size extent");
 						continue;
 					}
 
-					current_extent = dvdcss_seek (handle, range->start, DVDCSS_SEEK_KEY);
-					if (current_extent != range->start) {
-						REJILLA_JOB_LOG (self, "Problem: could not retrieve key");
-						g_set_error (error,
-							     REJILLA_BURN_ERROR,
-							     REJILLA_BURN_ERROR_GENERAL,
-							     _("Error while reading video DVD (%s)"),
-							     dvdcss_error (handle));
-						return FALSE;
-					}
+					range = g_new0 (RejillaScrambledSectorRange, 1);
+					range->start = extent->block;
+					range->end = extent->block + REJILLA_BYTES_TO_SECTORS (extent->size, DVDCSS_BLOCK_SIZE);
+
+					REJILLA_JOB_LOG (self, "From 0x%x to 0x%x", range->start, range->end);
+					g_queue_push_head (map, range);
 				}
 			}
 		}
-		else if (!rejilla_dvdcss_create_scrambled_sectors_map (self, map, handle, file, error))
+		else if (!rejilla_dvdcss_create_scrambled_sectors_map (self, map, file))
 			return FALSE;
 	}
 
@@ -312,11 +384,31 @@ rejilla_dvdcss_sort_ranges (gconstpointer a, gconstpointer b, gpointer user_data
 	return range_a->start - range_b->start;
 }
 
+static RejillaDvdcssBuffer *
+rejilla_dvdcss_get_free_buffer (RejillaDvdcss *self)
+{
+	RejillaDvdcssPrivate *priv;
+
+	priv = REJILLA_DVDCSS_PRIVATE (self);
+	while (!priv->cancel && !priv->write_failed) {
+		RejillaDvdcssBuffer *buffer;
+		GTimeVal timeout;
+
+		g_get_current_time (&timeout);
+		g_time_val_add (&timeout, 500000);
+		buffer = g_async_queue_timed_pop (priv->free_buffers, &timeout);
+		if (buffer)
+			return buffer;
+	}
+
+	return NULL;
+}
+
 static gpointer
 rejilla_dvdcss_write_image_thread (gpointer data)
 {
-	guchar buf [DVDCSS_BLOCK_SIZE * REJILLA_DVDCSS_I_BLOCKS];
 	RejillaScrambledSectorRange *range = NULL;
+	RejillaDvdcssBuffer *buffer = NULL;
 	RejillaMedium *medium = NULL;
 	RejillaVolFile *files = NULL;
 	dvdcss_handle *handle = NULL;
@@ -326,10 +418,11 @@ rejilla_dvdcss_write_image_thread (gpointer data)
 	RejillaDvdcss *self = data;
 	RejillaTrack *track = NULL;
 	guint64 remaining_sectors;
-	FILE *output_fd = NULL;
+	GThread *writer = NULL;
 	RejillaVolSrc *vol;
 	gint64 volume_size;
 	GQueue *map = NULL;
+	gint i;
 
 	rejilla_job_set_use_average_rate (REJILLA_JOB (self), TRUE);
 	rejilla_job_set_current_action (REJILLA_JOB (self),
@@ -373,13 +466,16 @@ rejilla_dvdcss_write_image_thread (gpointer data)
 		goto end;
 	}
 
-	/* look through the files to get the ranges of encrypted sectors
-	 * and cache the CSS keys while at it. */
+	/* look through the files to get the ranges of encrypted sectors */
 	map = g_queue_new ();
-	if (!rejilla_dvdcss_create_scrambled_sectors_map (self, map, handle, files, &priv->error))
+	if (!rejilla_dvdcss_create_scrambled_sectors_map (self, map, files)) {
+		priv->error = g_error_new (REJILLA_BURN_ERROR,
+					   REJILLA_BURN_ERROR_GENERAL,
+					   _("Video DVD could not be opened"));
 		goto end;
+	}
 
-	REJILLA_JOB_LOG (self, "DVD map created (keys retrieved)");
+	REJILLA_JOB_LOG (self, "DVD map created");
 
 	g_queue_sort (map, rejilla_dvdcss_sort_ranges, NULL);
 
@@ -395,22 +491,12 @@ rejilla_dvdcss_write_image_thread (gpointer data)
 		goto end;
 	}
 
-	rejilla_job_set_current_action (REJILLA_JOB (self),
-					REJILLA_BURN_ACTION_DRIVE_COPY,
-					_("Copying video DVD"),
-					FALSE);
-
-	rejilla_job_start_progress (REJILLA_JOB (self), TRUE);
-
-	remaining_sectors = volume_size;
-	range = g_queue_pop_head (map);
-
 	if (rejilla_job_get_fd_out (REJILLA_JOB (self), NULL) != REJILLA_BURN_OK) {
 		gchar *output = NULL;
 
 		rejilla_job_get_image_output (REJILLA_JOB (self), &output, NULL);
-		output_fd = fopen (output, "w");
-		if (!output_fd) {
+		priv->output = fopen (output, "w");
+		if (!priv->output) {
 			priv->error = g_error_new_literal (REJILLA_BURN_ERROR,
 							   REJILLA_BURN_ERROR_GENERAL,
 							   g_strerror (errno));
@@ -420,13 +506,44 @@ rejilla_dvdcss_write_image_thread (gpointer data)
 		g_free (output);
 	}
 
+	for (i = 0; i < REJILLA_DVDCSS_BUFFERS; i ++) {
+		buffer = g_new0 (RejillaDvdcssBuffer, 1);
+		buffer->data = g_malloc (DVDCSS_BLOCK_SIZE * REJILLA_DVDCSS_I_BLOCKS);
+		g_async_queue_push (priv->free_buffers, buffer);
+	}
+	buffer = NULL;
+
+	/* Output is written from another thread so that reading (and key
+	 * retrieval) never waits for it */
+	writer = g_thread_create (rejilla_dvdcss_write_thread,
+				  self,
+				  TRUE,
+				  &priv->error);
+	if (!writer)
+		goto end;
+
+	rejilla_job_set_current_action (REJILLA_JOB (self),
+					REJILLA_BURN_ACTION_DRIVE_COPY,
+					_("Copying video DVD"),
+					FALSE);
+
+	rejilla_job_start_progress (REJILLA_JOB (self), TRUE);
+
+	remaining_sectors = volume_size;
+	range = g_queue_pop_head (map);
+
 	while (remaining_sectors) {
+		GError *error = NULL;
+		gint num_blocks;
 		gint flag;
-		guint64 num_blocks, data_size;
 
 		if (priv->cancel)
 			break;
 
+		buffer = rejilla_dvdcss_get_free_buffer (self);
+		if (!buffer)
+			break;
+
 		num_blocks = REJILLA_DVDCSS_I_BLOCKS;
 
 		/* see if we are approaching the end of the dvd */
@@ -450,14 +567,14 @@ rejilla_dvdcss_write_image_thread (gpointer data)
 			if (written_sectors == range->start) {
 				int pos;
 
+				REJILLA_JOB_LOG (self, "Retrieving key at 0x%x", range->start);
 				pos = dvdcss_seek (handle, written_sectors, DVDCSS_SEEK_KEY);
 				if (pos < 0) {
 					REJILLA_JOB_LOG (self, "Error seeking");
-					priv->error = g_error_new (REJILLA_BURN_ERROR,
-								   REJILLA_BURN_ERROR_GENERAL,
-								   _("Error while reading video DVD (%s)"),
-								   dvdcss_error (handle));
-					break;
+					error = g_error_new (REJILLA_BURN_ERROR,
+							     REJILLA_BURN_ERROR_GENERAL,
+							     _("Error while reading video DVD (%s)"),
+							     dvdcss_error (handle));
 				}
 			}
 
@@ -473,45 +590,58 @@ rejilla_dvdcss_write_image_thread (gpointer data)
 			}
 		}
 
-		num_blocks = dvdcss_read (handle, buf, num_blocks, flag);
-		if (num_blocks < 0) {
-			REJILLA_JOB_LOG (self, "Error reading");
-			priv->error = g_error_new (REJILLA_BURN_ERROR,
-						   REJILLA_BURN_ERROR_GENERAL,
-						   _("Error while reading video DVD (%s)"),
-						   dvdcss_error (handle));
-			break;
-		}
-
-		data_size = num_blocks * DVDCSS_BLOCK_SIZE;
-		if (output_fd) {
-			if (fwrite (buf, 1, data_size, output_fd) != data_size) {
-                                int errsv = errno;
-
-				priv->error = g_error_new (REJILLA_BURN_ERROR,
-							   REJILLA_BURN_ERROR_GENERAL,
-							   _("Data could not be written (%s)"),
-							   g_strerror (errsv));
-				break;
+		if (!error) {
+			num_blocks = dvdcss_read (handle, buffer->data, num_blocks, flag);
+			if (num_blocks < 0) {
+				REJILLA_JOB_LOG (self, "Error reading");
+				error = g_error_new (REJILLA_BURN_ERROR,
+						     REJILLA_BURN_ERROR_GENERAL,
+						     _("Error while reading video DVD (%s)"),
+						     dvdcss_error (handle));
 			}
 		}
-		else {
-			RejillaBurnResult result;
 
-			result = rejilla_dvdcss_write_sector_to_fd (self,
-								    buf,
-								    data_size);
-			if (result != REJILLA_BURN_OK)
-				break;
+		if (error) {
+			g_mutex_lock (priv->mutex);
+			if (!priv->error)
+				priv->error = error;
+			else
+				g_error_free (error);
+			g_mutex_unlock (priv->mutex);
+			break;
 		}
 
+		buffer->blocks = num_blocks;
+		g_async_queue_push (priv->full_buffers, buffer);
+		buffer = NULL;
+
 		written_sectors += num_blocks;
 		remaining_sectors -= num_blocks;
-		rejilla_job_set_written_track (REJILLA_JOB (self), written_sectors * DVDCSS_BLOCK_SIZE);
 	}
 
+	/* Tell the writer there won't be anything more and wait for it */
+	g_async_queue_push (priv->full_buffers, g_new0 (RejillaDvdcssBuffer, 1));
+	g_thread_join (writer);
+
 end:
 
+	if (buffer) {
+		g_free (buffer->data);
+		g_free (buffer);
+	}
+
+	while ((buffer = g_async_queue_try_pop (priv->free_buffers))) {
+		g_free (buffer->data);
+		g_free (buffer);
+	}
+
+	while ((buffer = g_async_queue_try_pop (priv->full_buffers))) {
+		g_free (buffer->data);
+		g_free (buffer);
+	}
+
+	priv->write_failed = FALSE;
+
 	if (range)
 		g_free (range);
 
@@ -521,8 +651,10 @@ end:
 	if (files)
 		rejilla_volume_file_free (files);
 
-	if (output_fd)
-		fclose (output_fd);
+	if (priv->output) {
+		fclose (priv->output);
+		priv->output = NULL;
+	}
 
 	if (map) {
 		g_queue_foreach (map, (GFunc) g_free, NULL);
@@ -657,6 +789,9 @@ rejilla_dvdcss_init (RejillaDvdcss *obj)
 
 	priv->mutex = g_mutex_new ();
 	priv->cond = g_cond_new ();
+
+	priv->free_buffers = g_async_queue_new ();
+	priv->full_buffers = g_async_queue_new ();
 }
 
 static void
@@ -668,6 +803,16 @@ rejilla_dvdcss_finalize (GObject *object)
 
 	rejilla_dvdcss_stop_real (REJILLA_DVDCSS (object));
 
+	if (priv->free_buffers) {
+		g_async_queue_unref (priv->free_buffers);
+		priv->free_buffers = NULL;
+	}
+
+	if (priv->full_buffers) {
+		g_async_queue_unref (priv->full_buffers);
+		priv->full_buffers = NULL;
+	}
+
 	if (priv->mutex) {
 		g_mutex_free (priv->mutex);
 		priv->mutex = NULL;
@@ -0,0 +1,1958 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * Librejilla-burn
+ * Copyright (C) Philippe Rouquier 2005-2009 <bonfire-app@wanadoo.fr>
+ *
+ * Librejilla-burn is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The Librejilla-burn authors hereby grant permission for non-GPL compatible
+ * GStreamer plugins to be used and distributed together with GStreamer
+ * and Librejilla-burn. This permission is above and beyond the permissions granted
+ * by the GPL license by which Librejilla-burn is covered. If you modify this code
+ * you may extend this exception to your version of the code, but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version.
+ *
+ * Librejilla-burn is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to:
+ * 	The Free Software Foundation, Inc.,
+ * 	51 Franklin Street, Fifth Floor
+ * 	Boston, MA  02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <glib/gi18n-lib.h>
+
+#include "rejilla-error.h"
+#include "burn-debug.h"
+#include "burn-iso-rules.h"
+#include "burn-iso-layout.h"
+
+#define REJILLA_ISO_SECTOR_SIZE		REJILLA_ISO_RULES_SECTOR_SIZE
+#define REJILLA_ISO_BLOCKS		REJILLA_ISO_RULES_BLOCKS
+
+/* Size of the blocks passed to the write function */
+#define REJILLA_ISO_BUFFER_SIZE		(512 * REJILLA_ISO_SECTOR_SIZE)
+
+typedef struct _RejillaIsoDir RejillaIsoDir;
+typedef struct _RejillaIsoNode RejillaIsoNode;
+
+/* Only directories have this */
+struct _RejillaIsoDir {
+	RejillaIsoNode *children;
+
+	/* to detect loops when symlinks are followed */
+	dev_t dev;
+	ino_t ino;
+
+	guint32 extent;
+	guint32 size;
+
+	/* Rock Ridge entries that did not fit in the records */
+	guint32 ce_extent;
+	guint32 ce_size;
+
+	guint32 joliet_extent;
+	guint32 joliet_size;
+
+	guint number;
+	guint joliet_number;
+	guint nlink;
+};
+
+struct _RejillaIsoNode {
+	RejillaIsoNode *parent;
+	RejillaIsoNode *next;
+
+	/* Name on the disc. Unless the node is grafted, it's also the
+	 * name on disk (in the directory of the parent). */
+	gchar *name;
+
+	/* Only for grafted nodes */
+	gchar *path;
+
+	/* Only for symlinks */
+	gchar *link;
+
+	gchar *iso_name;
+	gunichar2 *joliet_name;
+	guint joliet_len;
+
+	RejillaIsoDir *dir;
+
+	guint64 size;
+	guint32 extent;
+
+	guint32 mode;
+	guint32 uid;
+	guint32 gid;
+	gint64 mtime;
+
+	/* Directories created to hold grafts */
+	guint is_fake:1;
+};
+
+struct _RejillaIsoLayout {
+	RejillaIsoNode *root;
+
+	gchar *label;
+	gchar *publisher;
+	gchar *preparer;
+	time_t creation;
+
+	guint32 start;
+
+	GHashTable *excluded;
+
+	/* Directories grafted whose contents are to be explored */
+	GSList *grafted;
+
+	/* Directories in the order of the path tables */
+	GPtrArray *dirs;
+	GPtrArray *joliet_dirs;
+
+	/* Files in the order of their contents on the disc */
+	GPtrArray *files;
+
+	guint32 pt_size;
+	guint32 pt_l;
+	guint32 pt_m;
+
+	guint32 joliet_pt_size;
+	guint32 joliet_pt_l;
+	guint32 joliet_pt_m;
+
+	/* in sectors (start not included) */
+	guint32 size;
+
+	/* Used while exploring */
+	GMutex *mutex;
+	GCond *cond;
+	GQueue *queue;
+	guint busy;
+	GError *error;
+	volatile gint *cancel;
+
+	guint joliet:1;
+	guint symlinks:1;
+};
+
+typedef enum {
+	REJILLA_ISO_RECORD_CHILD,
+	REJILLA_ISO_RECORD_DOT,
+	REJILLA_ISO_RECORD_DOTDOT,
+
+	/* That's the record of the root in volume descriptors */
+	REJILLA_ISO_RECORD_ROOT
+} RejillaIsoRecordType;
+
+/* Where Rock Ridge entries go when they don't fit in a record */
+struct _RejillaIsoContinuation {
+	guchar *buffer;
+	guint32 extent;
+	guint32 offset;
+};
+typedef struct _RejillaIsoContinuation RejillaIsoContinuation;
+
+struct _RejillaIsoOutput {
+	RejillaIsoLayoutWriteFunc func;
+	gpointer user_data;
+
+	guchar *buffer;
+	gsize len;
+
+	/* in bytes, since the start of the session */
+	guint64 written;
+};
+typedef struct _RejillaIsoOutput RejillaIsoOutput;
+
+/**
+ * Encoding helpers (numbers refer to sections in ECMA-119)
+ */
+
+static void
+_set_721 (guchar *buffer, guint16 value)
+{
+	buffer [0] = value & 0xFF;
+	buffer [1] = (value >> 8) & 0xFF;
+}
+
+static void
+_set_722 (guchar *buffer, guint16 value)
+{
+	buffer [0] = (value >> 8) & 0xFF;
+	buffer [1] = value & 0xFF;
+}
+
+static void
+_set_723 (guchar *buffer, guint16 value)
+{
+	_set_721 (buffer, value);
+	_set_722 (buffer + 2, value);
+}
+
+static void
+_set_731 (guchar *buffer, guint32 value)
+{
+	buffer [0] = value & 0xFF;
+	buffer [1] = (value >> 8) & 0xFF;
+	buffer [2] = (value >> 16) & 0xFF;
+	buffer [3] = (value >> 24) & 0xFF;
+}
+
+static void
+_set_732 (guchar *buffer, guint32 value)
+{
+	buffer [0] = (value >> 24) & 0xFF;
+	buffer [1] = (value >> 16) & 0xFF;
+	buffer [2] = (value >> 8) & 0xFF;
+	buffer [3] = value & 0xFF;
+}
+
+static void
+_set_733 (guchar *buffer, guint32 value)
+{
+	_set_731 (buffer, value);
+	_set_732 (buffer + 4, value);
+}
+
+static void
+_set_string (guchar *buffer, guint len, const gchar *string)
+{
+	guint string_len;
+
+	string_len = string ? MIN (strlen (string), len):0;
+	if (string_len)
+		memcpy (buffer, string, string_len);
+	memset (buffer + string_len, ' ', len - string_len);
+}
+
+static void
+_set_ucs2_string (guchar *buffer, guint len, const gchar *string)
+{
+	gunichar2 *utf16 = NULL;
+	glong utf16_len = 0;
+	guint i;
+
+	if (string)
+		utf16 = g_utf8_to_utf16 (string, -1, NULL, &utf16_len, NULL);
+
+	for (i = 0; i + 1 < len; i += 2) {
+		if (i / 2 < utf16_len)
+			_set_722 (buffer + i, utf16 [i / 2]);
+		else
+			_set_722 (buffer + i, ' ');
+	}
+
+	g_free (utf16);
+}
+
+/* 9.1.5 */
+static void
+_set_record_date (guchar *buffer, gint64 date)
+{
+	time_t time_date = date;
+	struct tm tm_date;
+
+	gmtime_r (&time_date, &tm_date);
+	buffer [0] = tm_date.tm_year;
+	buffer [1] = tm_date.tm_mon + 1;
+	buffer [2] = tm_date.tm_mday;
+	buffer [3] = tm_date.tm_hour;
+	buffer [4] = tm_date.tm_min;
+	buffer [5] = tm_date.tm_sec;
+	buffer [6] = 0;
+}
+
+/* 8.4.26.1 */
+static void
+_set_volume_date (guchar *buffer, time_t date)
+{
+	struct tm tm_date;
+	gchar digits [17];
+
+	if (!date) {
+		memset (buffer, '0', 16);
+		buffer [16] = 0;
+		return;
+	}
+
+	gmtime_r (&date, &tm_date);
+	g_snprintf (digits, sizeof (digits),
+		    "%04i%02i%02i%02i%02i%02i00",
+		    tm_date.tm_year + 1900,
+		    tm_date.tm_mon + 1,
+		    tm_date.tm_mday,
+		    tm_date.tm_hour,
+		    tm_date.tm_min,
+		    tm_date.tm_sec);
+	memcpy (buffer, digits, 16);
+	buffer [16] = 0;
+}
+
+/**
+ * Tree
+ */
+
+static void
+rejilla_iso_node_set_info (RejillaIsoNode *node,
+			   struct stat *info)
+{
+	node->mode = info->st_mode;
+	node->uid = info->st_uid;
+	node->gid = info->st_gid;
+	node->mtime = info->st_mtime;
+
+	if (node->dir) {
+		node->dir->dev = info->st_dev;
+		node->dir->ino = info->st_ino;
+	}
+	else if (S_ISREG (info->st_mode))
+		node->size = info->st_size;
+}
+
+static RejillaIsoNode *
+rejilla_iso_node_new (const gchar *name,
+		      struct stat *info)
+{
+	RejillaIsoNode *node;
+
+	node = g_new0 (RejillaIsoNode, 1);
+	node->name = g_strdup (name);
+
+	if (!info) {
+		/* That's a directory created for the disc */
+		node->dir = g_new0 (RejillaIsoDir, 1);
+		node->mode = S_IFDIR|0755;
+		node->mtime = time (NULL);
+		node->is_fake = TRUE;
+		return node;
+	}
+
+	if (S_ISDIR (info->st_mode))
+		node->dir = g_new0 (RejillaIsoDir, 1);
+
+	rejilla_iso_node_set_info (node, info);
+	return node;
+}
+
+static void
+rejilla_iso_node_free (RejillaIsoNode *node)
+{
+	if (node->dir) {
+		RejillaIsoNode *child;
+		RejillaIsoNode *next;
+
+		for (child = node->dir->children; child; child = next) {
+			next = child->next;
+			rejilla_iso_node_free (child);
+		}
+
+		g_free (node->dir);
+	}
+
+	g_free (node->name);
+	g_free (node->path);
+	g_free (node->link);
+	g_free (node->iso_name);
+	g_free (node->joliet_name);
+	g_free (node);
+}
+
+static RejillaIsoNode *
+rejilla_iso_node_get_child (RejillaIsoNode *parent,
+			    const gchar *name)
+{
+	RejillaIsoNode *child;
+
+	for (child = parent->dir->children; child; child = child->next) {
+		if (!strcmp (child->name, name))
+			return child;
+	}
+
+	return NULL;
+}
+
+static void
+rejilla_iso_node_remove_child (RejillaIsoNode *parent,
+			       RejillaIsoNode *node)
+{
+	RejillaIsoNode *iter;
+
+	if (parent->dir->children == node)
+		parent->dir->children = node->next;
+	else for (iter = parent->dir->children; iter; iter = iter->next) {
+		if (iter->next == node) {
+			iter->next = node->next;
+			break;
+		}
+	}
+
+	rejilla_iso_node_free (node);
+}
+
+static void
+rejilla_iso_node_add_child (RejillaIsoNode *parent,
+			    RejillaIsoNode *node)
+{
+	node->parent = parent;
+	node->next = parent->dir->children;
+	parent->dir->children = node;
+}
+
+static gchar *
+rejilla_iso_node_get_path (RejillaIsoNode *node)
+{
+	GSList *names = NULL;
+	GString *path;
+	GSList *iter;
+
+	/* go up until the first grafted parent */
+	for (; node && !node->path; node = node->parent)
+		names = g_slist_prepend (names, node->name);
+
+	if (!node) {
+		g_slist_free (names);
+		return NULL;
+	}
+
+	path = g_string_new (node->path);
+	for (iter = names; iter; iter = iter->next) {
+		if (path->len && path->str [path->len - 1] != G_DIR_SEPARATOR)
+			g_string_append_c (path, G_DIR_SEPARATOR);
+
+		g_string_append (path, iter->data);
+	}
+	g_slist_free (names);
+
+	return g_string_free (path, FALSE);
+}
+
+/**
+ * Grafts
+ */
+
+RejillaIsoLayout *
+rejilla_iso_layout_new (const gchar *label,
+			const gchar *publisher,
+			const gchar *preparer,
+			guint32 start_block,
+			gboolean joliet,
+			gboolean symlinks)
+{
+	RejillaIsoLayout *layout;
+
+	layout = g_new0 (RejillaIsoLayout, 1);
+	layout->label = g_strdup (label);
+	layout->publisher = g_strdup (publisher);
+	layout->preparer = g_strdup (preparer);
+	layout->start = start_block;
+	layout->joliet = (joliet != FALSE);
+	layout->symlinks = (symlinks != FALSE);
+	layout->creation = time (NULL);
+
+	layout->root = rejilla_iso_node_new ("", NULL);
+	layout->excluded = g_hash_table_new_full (g_str_hash,
+						  g_str_equal,
+						  g_free,
+						  NULL);
+	return layout;
+}
+
+void
+rejilla_iso_layout_free (RejillaIsoLayout *layout)
+{
+	rejilla_iso_node_free (layout->root);
+	g_hash_table_destroy (layout->excluded);
+	g_slist_free (layout->grafted);
+
+	if (layout->dirs)
+		g_ptr_array_free (layout->dirs, TRUE);
+	if (layout->joliet_dirs)
+		g_ptr_array_free (layout->joliet_dirs, TRUE);
+	if (layout->files)
+		g_ptr_array_free (layout->files, TRUE);
+	if (layout->error)
+		g_error_free (layout->error);
+
+	g_free (layout->label);
+	g_free (layout->publisher);
+	g_free (layout->preparer);
+	g_free (layout);
+}
+
+void
+rejilla_iso_layout_add_excluded (RejillaIsoLayout *layout,
+				 const gchar *path)
+{
+	g_hash_table_insert (layout->excluded, g_strdup (path), GINT_TO_POINTER (1));
+}
+
+static RejillaIsoNode *
+rejilla_iso_layout_new_local_node (RejillaIsoLayout *layout,
+				   const gchar *name,
+				   const gchar *path,
+				   gboolean grafted,
+				   GError **error)
+{
+	RejillaIsoNode *node;
+	struct stat info;
+	gchar *link = NULL;
+	int res;
+
+	if (layout->symlinks)
+		res = g_lstat (path, &info);
+	else
+		res = g_stat (path, &info);
+
+	if (res) {
+		int errsv = errno;
+
+		REJILLA_BURN_LOG ("Can't stat %s: %s", path, g_strerror (errsv));
+
+		/* Broken symlinks, files removed since exploration, ... */
+		if (!grafted)
+			return NULL;
+
+		g_set_error (error,
+			     REJILLA_BURN_ERROR,
+			     REJILLA_BURN_ERROR_GENERAL,
+			     _("\"%s\" could not be found"),
+			     path);
+		return NULL;
+	}
+
+	if (S_ISLNK (info.st_mode)) {
+		link = g_file_read_link (path, NULL);
+		if (!link || strlen (link) > REJILLA_ISO_RULES_MAX_LINK) {
+			REJILLA_BURN_LOG ("Symlink %s can't be written", path);
+			g_free (link);
+			return NULL;
+		}
+	}
+	else if (S_ISREG (info.st_mode)) {
+		/* Only ISO9660 level 3 allows files that big */
+		if (info.st_size >= G_GINT64_CONSTANT (0xFFFFFFFF)) {
+			g_set_error (error,
+				     REJILLA_BURN_ERROR,
+				     REJILLA_BURN_ERROR_GENERAL,
+				     _("The size of the file \"%s\" is over 4 GiB"),
+				     path);
+			return NULL;
+		}
+	}
+	else if (!S_ISDIR (info.st_mode)) {
+		/* Devices, sockets, pipes are not written */
+		REJILLA_BURN_LOG ("Special file %s ignored", path);
+		return NULL;
+	}
+
+	node = rejilla_iso_node_new (name, &info);
+	node->link = link;
+	return node;
+}
+
+/**
+ * Grafts must be added parents first (the shortest disc path first).
+ * If @path is NULL, an empty directory is created.
+ */
+
+gboolean
+rejilla_iso_layout_add_graft (RejillaIsoLayout *layout,
+			      const gchar *disc_path,
+			      const gchar *path,
+			      GError **error)
+{
+	RejillaIsoNode *parent;
+	RejillaIsoNode *node;
+	gchar **components;
+	gchar *name = NULL;
+	guint i;
+
+	components = g_strsplit (disc_path, G_DIR_SEPARATOR_S, 0);
+
+	/* Create all the parents needed */
+	parent = layout->root;
+	for (i = 0; components [i]; i ++) {
+		if (!components [i][0])
+			continue;
+
+		if (name) {
+			node = rejilla_iso_node_get_child (parent, name);
+			if (!node || !node->dir) {
+				if (node)
+					rejilla_iso_node_remove_child (parent, node);
+
+				node = rejilla_iso_node_new (name, NULL);
+				rejilla_iso_node_add_child (parent, node);
+			}
+			parent = node;
+		}
+
+		name = components [i];
+	}
+
+	if (!name) {
+		/* That's the root */
+		g_strfreev (components);
+		return TRUE;
+	}
+
+	node = rejilla_iso_node_get_child (parent, name);
+	if (!path) {
+		if (!node || !node->dir) {
+			if (node)
+				rejilla_iso_node_remove_child (parent, node);
+
+			rejilla_iso_node_add_child (parent, rejilla_iso_node_new (name, NULL));
+		}
+
+		g_strfreev (components);
+		return TRUE;
+	}
+
+	/* The graft replaces whatever was there */
+	if (node) {
+		layout->grafted = g_slist_remove (layout->grafted, node);
+		rejilla_iso_node_remove_child (parent, node);
+	}
+
+	node = rejilla_iso_layout_new_local_node (layout, name, path, TRUE, error);
+	g_strfreev (components);
+
+	if (!node)
+		return (error == NULL || *error == NULL);
+
+	node->path = g_strdup (path);
+	rejilla_iso_node_add_child (parent, node);
+
+	if (node->dir)
+		layout->grafted = g_slist_prepend (layout->grafted, node);
+
+	return TRUE;
+}
+
+/**
+ * Exploration of grafted directories. It's done by a few threads as it
+ * mostly waits for the disk.
+ */
+
+static void
+rejilla_iso_layout_set_error (RejillaIsoLayout *layout,
+			      GError *error)
+{
+	g_mutex_lock (layout->mutex);
+	if (!layout->error)
+		layout->error = error;
+	else
+		g_error_free (error);
+	g_cond_broadcast (layout->cond);
+	g_mutex_unlock (layout->mutex);
+}
+
+static gboolean
+rejilla_iso_layout_is_loop (RejillaIsoNode *parent,
+			    RejillaIsoNode *node)
+{
+	for (; parent; parent = parent->parent) {
+		if (parent->dir->dev == node->dir->dev
+		&&  parent->dir->ino == node->dir->ino)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static void
+rejilla_iso_layout_explore (RejillaIsoLayout *layout,
+			    RejillaIsoNode *node,
+			    GSList **subdirs)
+{
+	RejillaIsoNode *grafted;
+	const gchar *name;
+	GError *error = NULL;
+	gchar *path;
+	GDir *dir;
+
+	path = rejilla_iso_node_get_path (node);
+	dir = g_dir_open (path, 0, &error);
+	if (!dir) {
+		/* unreadable directories were excluded by the project */
+		REJILLA_BURN_LOG ("Directory %s could not be opened: %s", path, error->message);
+		g_error_free (error);
+		g_free (path);
+		return;
+	}
+
+	/* Children already there were grafted and replace those on disk */
+	grafted = node->dir->children;
+
+	while ((name = g_dir_read_name (dir))) {
+		RejillaIsoNode *child;
+		gchar *child_path;
+
+		if (layout->cancel && g_atomic_int_get (layout->cancel))
+			break;
+
+		child_path = g_build_filename (path, name, NULL);
+		if (g_hash_table_lookup (layout->excluded, child_path)) {
+			g_free (child_path);
+			continue;
+		}
+
+		for (child = grafted; child; child = child->next) {
+			if (!strcmp (child->name, name))
+				break;
+		}
+
+		if (child) {
+			struct stat info;
+
+			/* A directory created for grafts that also exists
+			 * on disk: its contents are merged */
+			if (child->is_fake
+			&& !g_stat (child_path, &info)
+			&&  S_ISDIR (info.st_mode)) {
+				child->is_fake = FALSE;
+				rejilla_iso_node_set_info (child, &info);
+				*subdirs = g_slist_prepend (*subdirs, child);
+			}
+
+			g_free (child_path);
+			continue;
+		}
+
+		child = rejilla_iso_layout_new_local_node (layout, name, child_path, FALSE, &error);
+		g_free (child_path);
+
+		if (error) {
+			rejilla_iso_layout_set_error (layout, error);
+			error = NULL;
+			break;
+		}
+
+		if (!child)
+			continue;
+
+		if (child->dir && rejilla_iso_layout_is_loop (node, child)) {
+			REJILLA_BURN_LOG ("Loop detected for %s in %s", name, path);
+			rejilla_iso_node_free (child);
+			continue;
+		}
+
+		rejilla_iso_node_add_child (node, child);
+		if (child->dir)
+			*subdirs = g_slist_prepend (*subdirs, child);
+	}
+
+	g_dir_close (dir);
+	g_free (path);
+}
+
+static gpointer
+rejilla_iso_layout_explore_thread (gpointer data)
+{
+	RejillaIsoLayout *layout = data;
+
+	g_mutex_lock (layout->mutex);
+	while (1) {
+		RejillaIsoNode *node;
+		GSList *subdirs;
+		GSList *iter;
+
+		while (g_queue_is_empty (layout->queue)
+		&&     layout->busy
+		&&    !layout->error
+		&&   !(layout->cancel && g_atomic_int_get (layout->cancel)))
+			g_cond_wait (layout->cond, layout->mutex);
+
+		if (layout->error
+		||  g_queue_is_empty (layout->queue)
+		|| (layout->cancel && g_atomic_int_get (layout->cancel)))
+			break;
+
+		node = g_queue_pop_head (layout->queue);
+		layout->busy ++;
+		g_mutex_unlock (layout->mutex);
+
+		subdirs = NULL;
+		rejilla_iso_layout_explore (layout, node, &subdirs);
+
+		g_mutex_lock (layout->mutex);
+		layout->busy --;
+
+		for (iter = subdirs; iter; iter = iter->next)
+			g_queue_push_tail (layout->queue, iter->data);
+		g_slist_free (subdirs);
+
+		g_cond_broadcast (layout->cond);
+	}
+
+	/* wake up the others so they can leave too */
+	g_cond_broadcast (layout->cond);
+	g_mutex_unlock (layout->mutex);
+	return NULL;
+}
+
+static void
+rejilla_iso_layout_explore_all (RejillaIsoLayout *layout)
+{
+	GSList *threads = NULL;
+	guint num_threads;
+	GSList *iter;
+	guint i;
+
+	layout->mutex = g_mutex_new ();
+	layout->cond = g_cond_new ();
+	layout->queue = g_queue_new ();
+	layout->busy = 0;
+
+	for (iter = layout->grafted; iter; iter = iter->next)
+		g_queue_push_tail (layout->queue, iter->data);
+
+	num_threads = CLAMP (sysconf (_SC_NPROCESSORS_ONLN) * 2, 2, 16);
+	for (i = 1; i < num_threads; i ++) {
+		GThread *thread;
+
+		thread = g_thread_create (rejilla_iso_layout_explore_thread,
+					  layout,
+					  TRUE,
+					  NULL);
+		if (!thread)
+			break;
+
+		threads = g_slist_prepend (threads, thread);
+	}
+
+	REJILLA_BURN_LOG ("Exploring with %i threads", g_slist_length (threads) + 1);
+	rejilla_iso_layout_explore_thread (layout);
+
+	for (iter = threads; iter; iter = iter->next)
+		g_thread_join (iter->data);
+	g_slist_free (threads);
+
+	g_queue_free (layout->queue);
+	layout->queue = NULL;
+	g_cond_free (layout->cond);
+	layout->cond = NULL;
+	g_mutex_free (layout->mutex);
+	layout->mutex = NULL;
+}
+
+/**
+ * Names
+ */
+
+static gint
+_compare_iso_names (gconstpointer a, gconstpointer b)
+{
+	const RejillaIsoNode *node1 = *(RejillaIsoNode **) a;
+	const RejillaIsoNode *node2 = *(RejillaIsoNode **) b;
+
+	return rejilla_iso_rules_compare_names (node1->iso_name, node2->iso_name);
+}
+
+static gint
+_compare_joliet_names (gconstpointer a, gconstpointer b)
+{
+	const RejillaIsoNode *node1 = *(RejillaIsoNode **) a;
+	const RejillaIsoNode *node2 = *(RejillaIsoNode **) b;
+
+	return rejilla_iso_rules_compare_joliet_names (node1->joliet_name,
+						       node1->joliet_len,
+						       node2->joliet_name,
+						       node2->joliet_len);
+}
+
+static gint
+_compare_names (gconstpointer a, gconstpointer b)
+{
+	const RejillaIsoNode *node1 = *(RejillaIsoNode **) a;
+	const RejillaIsoNode *node2 = *(RejillaIsoNode **) b;
+
+	return strcmp (node1->name, node2->name);
+}
+
+static GPtrArray *
+rejilla_iso_layout_get_children (RejillaIsoNode *node,
+				 GCompareFunc func)
+{
+	RejillaIsoNode *child;
+	GPtrArray *children;
+
+	children = g_ptr_array_new ();
+	for (child = node->dir->children; child; child = child->next)
+		g_ptr_array_add (children, child);
+
+	if (func)
+		g_ptr_array_sort (children, func);
+
+	return children;
+}
+
+static void
+rejilla_iso_layout_name_children (RejillaIsoLayout *layout,
+				  RejillaIsoNode *node)
+{
+	GHashTable *joliet_names;
+	GHashTable *iso_names;
+	GPtrArray *children;
+	guint i;
+
+	/* Sort them by name first so the results don't depend on the
+	 * order in which they were found. */
+	children = rejilla_iso_layout_get_children (node, _compare_names);
+
+	iso_names = g_hash_table_new (g_str_hash, g_str_equal);
+	joliet_names = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	node->dir->nlink = 2;
+	for (i = 0; i < children->len; i ++) {
+		RejillaIsoNode *child;
+		guint attempt;
+
+		child = g_ptr_array_index (children, i);
+		if (child->dir)
+			node->dir->nlink ++;
+
+		attempt = 0;
+		child->iso_name = rejilla_iso_rules_get_name (child->name,
+							      (child->dir != NULL),
+							      attempt);
+		while (g_hash_table_lookup (iso_names, child->iso_name)) {
+			g_free (child->iso_name);
+			child->iso_name = rejilla_iso_rules_get_name (child->name,
+								      (child->dir != NULL),
+								      ++ attempt);
+		}
+		g_hash_table_insert (iso_names, child->iso_name, child);
+
+		if (!layout->joliet)
+			continue;
+
+		attempt = 0;
+		while (1) {
+			gchar *key;
+
+			child->joliet_name = rejilla_iso_rules_get_joliet_name (child->name,
+										(child->dir != NULL),
+										attempt ++,
+										&child->joliet_len);
+			key = g_utf16_to_utf8 (child->joliet_name, child->joliet_len, NULL, NULL, NULL);
+			if (!key)
+				key = g_strdup_printf ("%p", child);
+
+			if (!g_hash_table_lookup (joliet_names, key)) {
+				g_hash_table_insert (joliet_names, key, child);
+				break;
+			}
+
+			g_free (key);
+			g_free (child->joliet_name);
+		}
+	}
+
+	/* Now sort them in the order of the directory records */
+	g_ptr_array_sort (children, _compare_iso_names);
+	node->dir->children = NULL;
+	for (i = children->len; i > 0; i --) {
+		RejillaIsoNode *child;
+
+		child = g_ptr_array_index (children, i - 1);
+		child->next = node->dir->children;
+		node->dir->children = child;
+	}
+
+	g_hash_table_destroy (iso_names);
+	g_hash_table_destroy (joliet_names);
+	g_ptr_array_free (children, TRUE);
+}
+
+/**
+ * Directory records
+ */
+
+static guint
+rejilla_iso_layout_susp (RejillaIsoLayout *layout,
+			 RejillaIsoNode *node,
+			 RejillaIsoRecordType type,
+			 gboolean is_root,
+			 guchar *buffer,
+			 guint *fields)
+{
+	guint num = 0;
+	guint offset = 0;
+
+	/* SP must be the first entry of the first record of the root */
+	if (type == REJILLA_ISO_RECORD_DOT && is_root) {
+		buffer [0] = 'S';
+		buffer [1] = 'P';
+		buffer [2] = REJILLA_ISO_RULES_SP_SIZE;
+		buffer [3] = 1;
+		buffer [4] = 0xBE;
+		buffer [5] = 0xEF;
+		buffer [6] = 0;
+		offset += REJILLA_ISO_RULES_SP_SIZE;
+		fields [num ++] = offset;
+	}
+
+	/* POSIX attributes */
+	buffer [offset] = 'P';
+	buffer [offset + 1] = 'X';
+	buffer [offset + 2] = REJILLA_ISO_RULES_PX_SIZE;
+	buffer [offset + 3] = 1;
+	_set_733 (buffer + offset + 4, node->mode);
+	_set_733 (buffer + offset + 12, node->dir ? node->dir->nlink:1);
+	_set_733 (buffer + offset + 20, node->uid);
+	_set_733 (buffer + offset + 28, node->gid);
+	offset += REJILLA_ISO_RULES_PX_SIZE;
+	fields [num ++] = offset;
+
+	/* modification, access and attributes times */
+	buffer [offset] = 'T';
+	buffer [offset + 1] = 'F';
+	buffer [offset + 2] = REJILLA_ISO_RULES_TF_SIZE;
+	buffer [offset + 3] = 1;
+	buffer [offset + 4] = 0x0E;
+	_set_record_date (buffer + offset + 5, node->mtime);
+	_set_record_date (buffer + offset + 12, node->mtime);
+	_set_record_date (buffer + offset + 19, node->mtime);
+	offset += REJILLA_ISO_RULES_TF_SIZE;
+	fields [num ++] = offset;
+
+	if (type == REJILLA_ISO_RECORD_CHILD) {
+		offset += rejilla_iso_rules_write_nm (node->name, buffer + offset);
+		fields [num ++] = offset;
+
+		if (node->link) {
+			offset += rejilla_iso_rules_write_sl (node->link, buffer + offset);
+			fields [num ++] = offset;
+		}
+	}
+
+	if (type == REJILLA_ISO_RECORD_DOT && is_root) {
+		guint id_len = strlen (REJILLA_ISO_RULES_ER_ID);
+		guint des_len = strlen (REJILLA_ISO_RULES_ER_DESCRIPTION);
+		guint src_len = strlen (REJILLA_ISO_RULES_ER_SOURCE);
+
+		buffer [offset] = 'E';
+		buffer [offset + 1] = 'R';
+		buffer [offset + 2] = REJILLA_ISO_RULES_ER_SIZE;
+		buffer [offset + 3] = 1;
+		buffer [offset + 4] = id_len;
+		buffer [offset + 5] = des_len;
+		buffer [offset + 6] = src_len;
+		buffer [offset + 7] = 1;
+		memcpy (buffer + offset + 8, REJILLA_ISO_RULES_ER_ID, id_len);
+		memcpy (buffer + offset + 8 + id_len, REJILLA_ISO_RULES_ER_DESCRIPTION, des_len);
+		memcpy (buffer + offset + 8 + id_len + des_len, REJILLA_ISO_RULES_ER_SOURCE, src_len);
+		offset += REJILLA_ISO_RULES_ER_SIZE;
+		fields [num ++] = offset;
+	}
+
+	fields [num] = 0;
+	return offset;
+}
+
+/* 9.1: returns the length of the record written in @record */
+static guint
+rejilla_iso_layout_record (RejillaIsoLayout *layout,
+			   RejillaIsoNode *node,
+			   RejillaIsoRecordType type,
+			   gboolean joliet,
+			   guchar *record,
+			   RejillaIsoContinuation *continuation)
+{
+	guchar susp [REJILLA_ISO_SECTOR_SIZE];
+	guint fields [8];
+	guint in_record;
+	guint susp_len;
+	guint id_len;
+	guint offset;
+
+	memset (record, 0, 256);
+
+	if (node->dir) {
+		if (joliet) {
+			_set_733 (record + 2, node->dir->joliet_extent);
+			_set_733 (record + 10, node->dir->joliet_size);
+		}
+		else {
+			_set_733 (record + 2, node->dir->extent);
+			_set_733 (record + 10, node->dir->size);
+		}
+		record [25] = 0x02;
+	}
+	else {
+		_set_733 (record + 2, node->extent);
+		_set_733 (record + 10, node->link ? 0:node->size);
+	}
+
+	_set_record_date (record + 18, node->mtime);
+	_set_723 (record + 28, 1);
+
+	if (type == REJILLA_ISO_RECORD_CHILD) {
+		if (joliet) {
+			guint i;
+
+			id_len = node->joliet_len * 2;
+			for (i = 0; i < node->joliet_len; i ++)
+				_set_722 (record + 33 + i * 2, node->joliet_name [i]);
+		}
+		else {
+			id_len = strlen (node->iso_name);
+			memcpy (record + 33, node->iso_name, id_len);
+		}
+	}
+	else {
+		id_len = 1;
+		record [33] = (type == REJILLA_ISO_RECORD_DOTDOT) ? 0x01:0x00;
+	}
+
+	record [32] = id_len;
+	offset = rejilla_iso_rules_get_record_size (id_len);
+
+	/* Rock Ridge is only for the ISO9660 tree */
+	if (joliet || type == REJILLA_ISO_RECORD_ROOT) {
+		record [0] = offset;
+		return offset;
+	}
+
+	susp_len = rejilla_iso_layout_susp (layout,
+					    node,
+					    type,
+					    (node == layout->root),
+					    susp,
+					    fields);
+
+	in_record = rejilla_iso_rules_split_susp (offset, fields);
+	memcpy (record + offset, susp, in_record);
+	offset += in_record;
+
+	if (in_record < susp_len) {
+		guint32 ce_start;
+
+		/* The rest goes to the continuation area */
+		ce_start = rejilla_iso_rules_place (continuation->offset, susp_len - in_record);
+		if (continuation->buffer)
+			memcpy (continuation->buffer + ce_start,
+				susp + in_record,
+				susp_len - in_record);
+
+		record [offset] = 'C';
+		record [offset + 1] = 'E';
+		record [offset + 2] = REJILLA_ISO_RULES_CE_SIZE;
+		record [offset + 3] = 1;
+		_set_733 (record + offset + 4, continuation->extent + ce_start / REJILLA_ISO_SECTOR_SIZE);
+		_set_733 (record + offset + 12, ce_start % REJILLA_ISO_SECTOR_SIZE);
+		_set_733 (record + offset + 20, susp_len - in_record);
+		offset += REJILLA_ISO_RULES_CE_SIZE;
+
+		continuation->offset = ce_start + susp_len - in_record;
+	}
+
+	if (offset & 1)
+		offset ++;
+
+	record [0] = offset;
+	return offset;
+}
+
+/* Computes the size of the directory extent (and of its continuation
+ * area) and fills the buffers if they are not NULL. */
+static void
+rejilla_iso_layout_directory (RejillaIsoLayout *layout,
+			      RejillaIsoNode *node,
+			      gboolean joliet,
+			      guchar *buffer,
+			      guchar *ce_buffer,
+			      guint32 *size,
+			      guint32 *ce_size)
+{
+	RejillaIsoContinuation continuation;
+	GPtrArray *children = NULL;
+	RejillaIsoNode *child;
+	guchar record [256];
+	guint32 offset = 0;
+	guint i;
+
+	continuation.buffer = ce_buffer;
+	continuation.extent = node->dir->ce_extent;
+	continuation.offset = 0;
+
+	if (joliet)
+		children = rejilla_iso_layout_get_children (node, _compare_joliet_names);
+
+	for (i = 0, child = node->dir->children; ; i ++) {
+		RejillaIsoRecordType type;
+		RejillaIsoNode *target;
+		guint len;
+
+		if (i == 0) {
+			type = REJILLA_ISO_RECORD_DOT;
+			target = node;
+		}
+		else if (i == 1) {
+			type = REJILLA_ISO_RECORD_DOTDOT;
+			target = node->parent ? node->parent:node;
+		}
+		else if (joliet) {
+			if (i - 2 >= children->len)
+				break;
+
+			type = REJILLA_ISO_RECORD_CHILD;
+			target = g_ptr_array_index (children, i - 2);
+		}
+		else {
+			if (!child)
+				break;
+
+			type = REJILLA_ISO_RECORD_CHILD;
+			target = child;
+			child = child->next;
+		}
+
+		len = rejilla_iso_layout_record (layout,
+						 target,
+						 type,
+						 joliet,
+						 record,
+						 &continuation);
+
+		/* records don't cross sectors */
+		if ((offset % REJILLA_ISO_SECTOR_SIZE) + len > REJILLA_ISO_SECTOR_SIZE)
+			offset = REJILLA_ISO_BLOCKS (offset) * REJILLA_ISO_SECTOR_SIZE;
+
+		if (buffer)
+			memcpy (buffer + offset, record, len);
+
+		offset += len;
+	}
+
+	if (children)
+		g_ptr_array_free (children, TRUE);
+
+	if (size)
+		*size = REJILLA_ISO_BLOCKS (offset) * REJILLA_ISO_SECTOR_SIZE;
+	if (ce_size)
+		*ce_size = REJILLA_ISO_BLOCKS (continuation.offset) * REJILLA_ISO_SECTOR_SIZE;
+}
+
+/**
+ * Layout
+ */
+
+static GPtrArray *
+rejilla_iso_layout_get_directories (RejillaIsoNode *root,
+				    gboolean joliet)
+{
+	GPtrArray *dirs;
+	guint i;
+
+	/* 6.9.1: by level, then by parent, then by name */
+	dirs = g_ptr_array_new ();
+	g_ptr_array_add (dirs, root);
+	for (i = 0; i < dirs->len; i ++) {
+		RejillaIsoNode *node;
+		GPtrArray *children;
+		guint j;
+
+		node = g_ptr_array_index (dirs, i);
+		if (joliet)
+			node->dir->joliet_number = i + 1;
+		else
+			node->dir->number = i + 1;
+
+		children = rejilla_iso_layout_get_children (node, joliet ? _compare_joliet_names:NULL);
+		for (j = 0; j < children->len; j ++) {
+			RejillaIsoNode *child;
+
+			child = g_ptr_array_index (children, j);
+			if (child->dir)
+				g_ptr_array_add (dirs, child);
+		}
+		g_ptr_array_free (children, TRUE);
+	}
+
+	return dirs;
+}
+
+static guint32
+rejilla_iso_layout_path_table_size (GPtrArray *dirs,
+				    gboolean joliet)
+{
+	guint32 size = 0;
+	guint i;
+
+	for (i = 0; i < dirs->len; i ++) {
+		RejillaIsoNode *node;
+		guint len;
+
+		node = g_ptr_array_index (dirs, i);
+		if (!i)
+			len = 1;
+		else if (joliet)
+			len = node->joliet_len * 2;
+		else
+			len = strlen (node->iso_name);
+
+		size += 8 + len + (len & 1);
+	}
+
+	return size;
+}
+
+static void
+rejilla_iso_layout_collect_files (RejillaIsoLayout *layout,
+				  RejillaIsoNode *node)
+{
+	RejillaIsoNode *child;
+
+	for (child = node->dir->children; child; child = child->next) {
+		if (child->dir)
+			rejilla_iso_layout_collect_files (layout, child);
+		else if (!child->link)
+			g_ptr_array_add (layout->files, child);
+	}
+}
+
+static void
+rejilla_iso_layout_name_tree (RejillaIsoLayout *layout,
+			      RejillaIsoNode *node)
+{
+	RejillaIsoNode *child;
+
+	rejilla_iso_layout_name_children (layout, node);
+	for (child = node->dir->children; child; child = child->next) {
+		if (child->dir)
+			rejilla_iso_layout_name_tree (layout, child);
+	}
+}
+
+gboolean
+rejilla_iso_layout_build (RejillaIsoLayout *layout,
+			  volatile gint *cancel,
+			  GError **error)
+{
+	guint32 current;
+	guint i;
+
+	layout->cancel = cancel;
+
+	rejilla_iso_layout_explore_all (layout);
+	if (layout->error) {
+		g_propagate_error (error, layout->error);
+		layout->error = NULL;
+		return FALSE;
+	}
+
+	if (cancel && g_atomic_int_get (cancel))
+		return FALSE;
+
+	rejilla_iso_layout_name_tree (layout, layout->root);
+
+	layout->dirs = rejilla_iso_layout_get_directories (layout->root, FALSE);
+	if (layout->dirs->len > G_MAXUINT16) {
+		g_set_error (error,
+			     REJILLA_BURN_ERROR,
+			     REJILLA_BURN_ERROR_GENERAL,
+			     _("There are too many directories"));
+		return FALSE;
+	}
+
+	layout->pt_size = rejilla_iso_layout_path_table_size (layout->dirs, FALSE);
+
+	if (layout->joliet) {
+		layout->joliet_dirs = rejilla_iso_layout_get_directories (layout->root, TRUE);
+		layout->joliet_pt_size = rejilla_iso_layout_path_table_size (layout->joliet_dirs, TRUE);
+	}
+
+	/* System area, volume descriptors and terminator */
+	current = 16 + 1 + (layout->joliet ? 1:0) + 1;
+
+	layout->pt_l = layout->start + current;
+	current += REJILLA_ISO_BLOCKS (layout->pt_size);
+	layout->pt_m = layout->start + current;
+	current += REJILLA_ISO_BLOCKS (layout->pt_size);
+
+	if (layout->joliet) {
+		layout->joliet_pt_l = layout->start + current;
+		current += REJILLA_ISO_BLOCKS (layout->joliet_pt_size);
+		layout->joliet_pt_m = layout->start + current;
+		current += REJILLA_ISO_BLOCKS (layout->joliet_pt_size);
+	}
+
+	/* Directories, each followed by its continuation area. The sizes
+	 * don't depend on the addresses so they can be computed first. */
+	for (i = 0; i < layout->dirs->len; i ++) {
+		RejillaIsoNode *node;
+
+		node = g_ptr_array_index (layout->dirs, i);
+		rejilla_iso_layout_directory (layout,
+					      node,
+					      FALSE,
+					      NULL,
+					      NULL,
+					      &node->dir->size,
+					      &node->dir->ce_size);
+
+		node->dir->extent = layout->start + current;
+		current += REJILLA_ISO_BLOCKS (node->dir->size);
+
+		node->dir->ce_extent = layout->start + current;
+		current += REJILLA_ISO_BLOCKS (node->dir->ce_size);
+	}
+
+	if (layout->joliet) {
+		for (i = 0; i < layout->joliet_dirs->len; i ++) {
+			RejillaIsoNode *node;
+
+			node = g_ptr_array_index (layout->joliet_dirs, i);
+			rejilla_iso_layout_directory (layout,
+						      node,
+						      TRUE,
+						      NULL,
+						      NULL,
+						      &node->dir->joliet_size,
+						      NULL);
+
+			node->dir->joliet_extent = layout->start + current;
+			current += REJILLA_ISO_BLOCKS (node->dir->joliet_size);
+		}
+	}
+
+	/* File contents in the order of the tree */
+	layout->files = g_ptr_array_new ();
+	rejilla_iso_layout_collect_files (layout, layout->root);
+	for (i = 0; i < layout->files->len; i ++) {
+		RejillaIsoNode *node;
+
+		node = g_ptr_array_index (layout->files, i);
+		node->extent = layout->start + current;
+		current += REJILLA_ISO_BLOCKS (node->size);
+	}
+
+	layout->size = current;
+
+	REJILLA_BURN_LOG ("Image layout: %i directories, %i files, %i sectors",
+			  layout->dirs->len,
+			  layout->files->len,
+			  layout->size);
+	return TRUE;
+}
+
+guint32
+rejilla_iso_layout_get_size (RejillaIsoLayout *layout)
+{
+	return layout->size;
+}
+
+/**
+ * Output
+ */
+
+static gboolean
+rejilla_iso_output_flush (RejillaIsoOutput *output,
+			  GError **error)
+{
+	gboolean result;
+
+	if (!output->len)
+		return TRUE;
+
+	result = output->func (output->buffer, output->len, output->user_data, error);
+	output->written += output->len;
+	output->len = 0;
+	return result;
+}
+
+static gboolean
+rejilla_iso_output_append (RejillaIsoOutput *output,
+			   const guchar *data,
+			   gsize size,
+			   GError **error)
+{
+	while (size) {
+		gsize len;
+
+		len = MIN (size, REJILLA_ISO_BUFFER_SIZE - output->len);
+		if (data)
+			memcpy (output->buffer + output->len, data, len);
+		else
+			memset (output->buffer + output->len, 0, len);
+
+		output->len += len;
+		size -= len;
+		if (data)
+			data += len;
+
+		if (output->len == REJILLA_ISO_BUFFER_SIZE
+		&& !rejilla_iso_output_flush (output, error))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static gboolean
+rejilla_iso_output_check (RejillaIsoLayout *layout,
+			  RejillaIsoOutput *output,
+			  guint32 address,
+			  GError **error)
+{
+	/* Make sure what is written matches the layout */
+	if (output->written + output->len == (guint64) (address - layout->start) * REJILLA_ISO_SECTOR_SIZE)
+		return TRUE;
+
+	REJILLA_BURN_LOG ("Image layout mismatch (%" G_GUINT64_FORMAT " written, %i expected)",
+			  output->written + output->len,
+			  address);
+	g_set_error (error,
+		     REJILLA_BURN_ERROR,
+		     REJILLA_BURN_ERROR_GENERAL,
+		     _("An internal error occurred"));
+	return FALSE;
+}
+
+static void
+rejilla_iso_layout_volume_descriptor (RejillaIsoLayout *layout,
+				      gboolean joliet,
+				      guchar *buffer)
+{
+	guchar record [256];
+	guint32 pt_size;
+
+	memset (buffer, 0, REJILLA_ISO_SECTOR_SIZE);
+
+	/* 8.4 (primary) and 8.5 (supplementary for Joliet) */
+	buffer [0] = joliet ? 2:1;
+	memcpy (buffer + 1, "CD001", 5);
+	buffer [6] = 1;
+
+	if (joliet) {
+		_set_ucs2_string (buffer + 8, 32, "LINUX");
+		_set_ucs2_string (buffer + 40, 32, layout->label);
+
+		/* UCS-2 level 3 */
+		buffer [88] = '%';
+		buffer [89] = '/';
+		buffer [90] = 'E';
+	}
+	else {
+		_set_string (buffer + 8, 32, "LINUX");
+		_set_string (buffer + 40, 32, layout->label);
+	}
+
+	_set_733 (buffer + 80, layout->start + layout->size);
+	_set_723 (buffer + 120, 1);
+	_set_723 (buffer + 124, 1);
+	_set_723 (buffer + 128, REJILLA_ISO_SECTOR_SIZE);
+
+	pt_size = joliet ? layout->joliet_pt_size:layout->pt_size;
+	_set_733 (buffer + 132, pt_size);
+	_set_731 (buffer + 140, joliet ? layout->joliet_pt_l:layout->pt_l);
+	_set_732 (buffer + 148, joliet ? layout->joliet_pt_m:layout->pt_m);
+
+	rejilla_iso_layout_record (layout,
+				   layout->root,
+				   REJILLA_ISO_RECORD_ROOT,
+				   joliet,
+				   record,
+				   NULL);
+	memcpy (buffer + 156, record, 34);
+
+	if (joliet) {
+		_set_ucs2_string (buffer + 190, 128, NULL);
+		_set_ucs2_string (buffer + 318, 128, layout->publisher);
+		_set_ucs2_string (buffer + 446, 128, layout->preparer);
+		_set_ucs2_string (buffer + 574, 128, "REJILLA");
+		_set_ucs2_string (buffer + 702, 36, NULL);
+		_set_ucs2_string (buffer + 739, 36, NULL);
+		_set_ucs2_string (buffer + 776, 36, NULL);
+	}
+	else {
+		_set_string (buffer + 190, 128, NULL);
+		_set_string (buffer + 318, 128, layout->publisher);
+		_set_string (buffer + 446, 128, layout->preparer);
+		_set_string (buffer + 574, 128, "REJILLA");
+		_set_string (buffer + 702, 37, NULL);
+		_set_string (buffer + 739, 37, NULL);
+		_set_string (buffer + 776, 37, NULL);
+	}
+
+	_set_volume_date (buffer + 813, layout->creation);
+	_set_volume_date (buffer + 830, layout->creation);
+	_set_volume_date (buffer + 847, 0);
+	_set_volume_date (buffer + 864, layout->creation);
+	buffer [881] = 1;
+}
+
+static gboolean
+rejilla_iso_layout_write_path_table (RejillaIsoLayout *layout,
+				     RejillaIsoOutput *output,
+				     gboolean joliet,
+				     gboolean big_endian,
+				     GError **error)
+{
+	GPtrArray *dirs;
+	guint32 size;
+	guchar *buffer;
+	guint32 offset;
+	gboolean result;
+	guint i;
+
+	dirs = joliet ? layout->joliet_dirs:layout->dirs;
+	size = joliet ? layout->joliet_pt_size:layout->pt_size;
+
+	buffer = g_malloc0 (REJILLA_ISO_BLOCKS (size) * REJILLA_ISO_SECTOR_SIZE);
+	offset = 0;
+	for (i = 0; i < dirs->len; i ++) {
+		RejillaIsoNode *node;
+		guint32 extent;
+		guint parent;
+		guint len;
+
+		/* 9.4 */
+		node = g_ptr_array_index (dirs, i);
+		if (joliet) {
+			extent = node->dir->joliet_extent;
+			parent = node->parent ? node->parent->dir->joliet_number:1;
+		}
+		else {
+			extent = node->dir->extent;
+			parent = node->parent ? node->parent->dir->number:1;
+		}
+
+		if (!i) {
+			len = 1;
+			buffer [offset + 8] = 0;
+		}
+		else if (joliet) {
+			guint j;
+
+			len = node->joliet_len * 2;
+			for (j = 0; j < node->joliet_len; j ++)
+				_set_722 (buffer + offset + 8 + j * 2, node->joliet_name [j]);
+		}
+		else {
+			len = strlen (node->iso_name);
+			memcpy (buffer + offset + 8, node->iso_name, len);
+		}
+
+		buffer [offset] = len;
+		if (big_endian) {
+			_set_732 (buffer + offset + 2, extent);
+			_set_722 (buffer + offset + 6, parent);
+		}
+		else {
+			_set_731 (buffer + offset + 2, extent);
+			_set_721 (buffer + offset + 6, parent);
+		}
+
+		offset += 8 + len + (len & 1);
+	}
+
+	result = rejilla_iso_output_append (output,
+					    buffer,
+					    REJILLA_ISO_BLOCKS (size) * REJILLA_ISO_SECTOR_SIZE,
+					    error);
+	g_free (buffer);
+	return result;
+}
+
+static gboolean
+rejilla_iso_layout_write_directories (RejillaIsoLayout *layout,
+				      RejillaIsoOutput *output,
+				      gboolean joliet,
+				      GError **error)
+{
+	GPtrArray *dirs;
+	guint i;
+
+	dirs = joliet ? layout->joliet_dirs:layout->dirs;
+	for (i = 0; i < dirs->len; i ++) {
+		RejillaIsoNode *node;
+		guchar *ce_buffer;
+		guchar *buffer;
+		gboolean result;
+		guint32 ce_size;
+		guint32 size;
+
+		node = g_ptr_array_index (dirs, i);
+		if (!rejilla_iso_output_check (layout,
+					       output,
+					       joliet ? node->dir->joliet_extent:node->dir->extent,
+					       error))
+			return FALSE;
+
+		size = joliet ? node->dir->joliet_size:node->dir->size;
+		ce_size = joliet ? 0:node->dir->ce_size;
+
+		buffer = g_malloc0 (size);
+		ce_buffer = ce_size ? g_malloc0 (ce_size):NULL;
+		rejilla_iso_layout_directory (layout,
+					      node,
+					      joliet,
+					      buffer,
+					      ce_buffer,
+					      NULL,
+					      NULL);
+
+		result = rejilla_iso_output_append (output, buffer, size, error);
+		if (result && ce_buffer)
+			result = rejilla_iso_output_append (output, ce_buffer, ce_size, error);
+
+		g_free (buffer);
+		g_free (ce_buffer);
+
+		if (!result)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static int
+rejilla_iso_layout_open_file (RejillaIsoNode *node,
+			      gboolean read_ahead)
+{
+	gchar *path;
+	int fd;
+
+	path = rejilla_iso_node_get_path (node);
+	fd = g_open (path, O_RDONLY, 0);
+	if (fd < 0) {
+		REJILLA_BURN_LOG ("File %s could not be opened: %s", path, g_strerror (errno));
+		g_free (path);
+		return -1;
+	}
+	g_free (path);
+
+#ifdef POSIX_FADV_SEQUENTIAL
+	posix_fadvise (fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+	/* Let the kernel start reading the next file while we're busy
+	 * with the current one */
+	if (read_ahead)
+		posix_fadvise (fd, 0, 0, POSIX_FADV_WILLNEED);
+#endif
+
+	return fd;
+}
+
+static gboolean
+rejilla_iso_layout_write_file (RejillaIsoLayout *layout,
+			       RejillaIsoOutput *output,
+			       RejillaIsoNode *node,
+			       int fd,
+			       GError **error)
+{
+	guint64 remaining;
+
+	remaining = node->size;
+	while (remaining) {
+		gssize bytes;
+		gsize len;
+
+		len = MIN (remaining, REJILLA_ISO_BUFFER_SIZE - output->len);
+		bytes = read (fd, output->buffer + output->len, len);
+		if (bytes < 0 && errno == EINTR)
+			continue;
+
+		if (bytes <= 0) {
+			gchar *path;
+
+			/* The file is unreadable or shorter than it was
+			 * when we laid out the image */
+			path = rejilla_iso_node_get_path (node);
+			g_set_error (error,
+				     REJILLA_BURN_ERROR,
+				     REJILLA_BURN_ERROR_GENERAL,
+				     _("\"%s\" could not be read"),
+				     path);
+			g_free (path);
+			return FALSE;
+		}
+
+		output->len += bytes;
+		remaining -= bytes;
+
+		if (output->len == REJILLA_ISO_BUFFER_SIZE
+		&& !rejilla_iso_output_flush (output, error))
+			return FALSE;
+	}
+
+	/* pad the last sector */
+	if (node->size % REJILLA_ISO_SECTOR_SIZE)
+		return rejilla_iso_output_append (output,
+						  NULL,
+						  REJILLA_ISO_SECTOR_SIZE - node->size % REJILLA_ISO_SECTOR_SIZE,
+						  error);
+
+	return TRUE;
+}
+
+static gboolean
+rejilla_iso_layout_write_files (RejillaIsoLayout *layout,
+				RejillaIsoOutput *output,
+				GError **error)
+{
+	int next_fd = -1;
+	guint i;
+
+	for (i = 0; i < layout->files->len; i ++) {
+		RejillaIsoNode *node;
+		gboolean result;
+		int fd;
+
+		node = g_ptr_array_index (layout->files, i);
+		if (!rejilla_iso_output_check (layout, output, node->extent, error))
+			break;
+
+		if (!node->size)
+			continue;
+
+		if (next_fd >= 0) {
+			fd = next_fd;
+			next_fd = -1;
+		}
+		else
+			fd = rejilla_iso_layout_open_file (node, FALSE);
+
+		if (fd < 0) {
+			gchar *path;
+
+			path = rejilla_iso_node_get_path (node);
+			g_set_error (error,
+				     REJILLA_BURN_ERROR,
+				     REJILLA_BURN_ERROR_GENERAL,
+				     _("\"%s\" could not be read"),
+				     path);
+			g_free (path);
+			return FALSE;
+		}
+
+		/* Open the next file with data beforehand */
+		if (i + 1 < layout->files->len) {
+			RejillaIsoNode *next;
+
+			next = g_ptr_array_index (layout->files, i + 1);
+			if (next->size)
+				next_fd = rejilla_iso_layout_open_file (next, TRUE);
+		}
+
+		result = rejilla_iso_layout_write_file (layout, output, node, fd, error);
+
+#ifdef POSIX_FADV_DONTNEED
+		/* No need to keep it in cache */
+		posix_fadvise (fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+		close (fd);
+
+		if (!result)
+			break;
+	}
+
+	if (next_fd >= 0)
+		close (next_fd);
+
+	return (i == layout->files->len);
+}
+
+gboolean
+rejilla_iso_layout_write (RejillaIsoLayout *layout,
+			  RejillaIsoLayoutWriteFunc func,
+			  gpointer user_data,
+			  GError **error)
+{
+	guchar descriptor [REJILLA_ISO_SECTOR_SIZE];
+	RejillaIsoOutput output;
+	gboolean result;
+
+	output.func = func;
+	output.user_data = user_data;
+	output.buffer = g_malloc (REJILLA_ISO_BUFFER_SIZE);
+	output.len = 0;
+	output.written = 0;
+
+	/* System area */
+	result = rejilla_iso_output_append (&output, NULL, 16 * REJILLA_ISO_SECTOR_SIZE, error);
+	if (!result)
+		goto end;
+
+	rejilla_iso_layout_volume_descriptor (layout, FALSE, descriptor);
+	result = rejilla_iso_output_append (&output, descriptor, sizeof (descriptor), error);
+	if (!result)
+		goto end;
+
+	if (layout->joliet) {
+		rejilla_iso_layout_volume_descriptor (layout, TRUE, descriptor);
+		result = rejilla_iso_output_append (&output, descriptor, sizeof (descriptor), error);
+		if (!result)
+			goto end;
+	}
+
+	/* 8.3: terminator */
+	memset (descriptor, 0, sizeof (descriptor));
+	descriptor [0] = 255;
+	memcpy (descriptor + 1, "CD001", 5);
+	descriptor [6] = 1;
+	result = rejilla_iso_output_append (&output, descriptor, sizeof (descriptor), error);
+	if (!result)
+		goto end;
+
+	result = rejilla_iso_output_check (layout, &output, layout->pt_l, error)
+	      && rejilla_iso_layout_write_path_table (layout, &output, FALSE, FALSE, error)
+	      && rejilla_iso_layout_write_path_table (layout, &output, FALSE, TRUE, error);
+	if (!result)
+		goto end;
+
+	if (layout->joliet) {
+		result = rejilla_iso_output_check (layout, &output, layout->joliet_pt_l, error)
+		      && rejilla_iso_layout_write_path_table (layout, &output, TRUE, FALSE, error)
+		      && rejilla_iso_layout_write_path_table (layout, &output, TRUE, TRUE, error);
+		if (!result)
+			goto end;
+	}
+
+	result = rejilla_iso_layout_write_directories (layout, &output, FALSE, error);
+	if (!result)
+		goto end;
+
+	if (layout->joliet) {
+		result = rejilla_iso_layout_write_directories (layout, &output, TRUE, error);
+		if (!result)
+			goto end;
+	}
+
+	result = rejilla_iso_layout_write_files (layout, &output, error)
+	      && rejilla_iso_output_check (layout, &output, layout->start + layout->size, error)
+	      && rejilla_iso_output_flush (&output, error);
+
+end:
+
+	g_free (output.buffer);
+	return result;
+}
@@ -0,0 +1,89 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * Librejilla-burn
+ * Copyright (C) Philippe Rouquier 2005-2009 <bonfire-app@wanadoo.fr>
+ *
+ * Librejilla-burn is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The Librejilla-burn authors hereby grant permission for non-GPL compatible
+ * GStreamer plugins to be used and distributed together with GStreamer
+ * and Librejilla-burn. This permission is above and beyond the permissions granted
+ * by the GPL license by which Librejilla-burn is covered. If you modify this code
+ * you may extend this exception to your version of the code, but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version.
+ *
+ * Librejilla-burn is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to:
+ * 	The Free Software Foundation, Inc.,
+ * 	51 Franklin Street, Fifth Floor
+ * 	Boston, MA  02110-1301, USA.
+ */
+
+#ifndef _BURN_ISO_LAYOUT_H_
+#define _BURN_ISO_LAYOUT_H_
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * This builds an ISO9660 image (with Rock Ridge and optionally Joliet
+ * extensions) from grafts. The whole layout is computed before anything
+ * is written so the size of the image is known exactly beforehand.
+ */
+
+typedef struct _RejillaIsoLayout RejillaIsoLayout;
+
+/* Called with blocks of sectors to write; returns FALSE to stop */
+typedef gboolean	(*RejillaIsoLayoutWriteFunc)	(const guchar *buffer,
+							 gsize size,
+							 gpointer user_data,
+							 GError **error);
+
+RejillaIsoLayout *
+rejilla_iso_layout_new (const gchar *label,
+			const gchar *publisher,
+			const gchar *preparer,
+			guint32 start_block,
+			gboolean joliet,
+			gboolean symlinks);
+
+void
+rejilla_iso_layout_free (RejillaIsoLayout *layout);
+
+void
+rejilla_iso_layout_add_excluded (RejillaIsoLayout *layout,
+				 const gchar *path);
+
+gboolean
+rejilla_iso_layout_add_graft (RejillaIsoLayout *layout,
+			      const gchar *disc_path,
+			      const gchar *path,
+			      GError **error);
+
+gboolean
+rejilla_iso_layout_build (RejillaIsoLayout *layout,
+			  volatile gint *cancel,
+			  GError **error);
+
+guint32
+rejilla_iso_layout_get_size (RejillaIsoLayout *layout);
+
+gboolean
+rejilla_iso_layout_write (RejillaIsoLayout *layout,
+			  RejillaIsoLayoutWriteFunc func,
+			  gpointer user_data,
+			  GError **error);
+
+G_END_DECLS
+
+#endif /* _BURN_ISO_LAYOUT_H_ */
@@ -0,0 +1,594 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * Librejilla-burn
+ * Copyright (C) Philippe Rouquier 2005-2009 <bonfire-app@wanadoo.fr>
+ *
+ * Librejilla-burn is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The Librejilla-burn authors hereby grant permission for non-GPL compatible
+ * GStreamer plugins to be used and distributed together with GStreamer
+ * and Librejilla-burn. This permission is above and beyond the permissions granted
+ * by the GPL license by which Librejilla-burn is covered. If you modify this code
+ * you may extend this exception to your version of the code, but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version.
+ *
+ * Librejilla-burn is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to:
+ * 	The Free Software Foundation, Inc.,
+ * 	51 Franklin Street, Fifth Floor
+ * 	Boston, MA  02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <glib.h>
+#include <glib-object.h>
+#include <glib/gstdio.h>
+#include <glib/gi18n-lib.h>
+#include <gmodule.h>
+
+#include "burn-job.h"
+#include "rejilla-units.h"
+#include "rejilla-plugin-registration.h"
+#include "rejilla-track-data.h"
+#include "rejilla-track-image.h"
+#include "burn-iso-layout.h"
+
+
+#define REJILLA_TYPE_ISO_WRITER         (rejilla_iso_writer_get_type ())
+#define REJILLA_ISO_WRITER(o)           (G_TYPE_CHECK_INSTANCE_CAST ((o), REJILLA_TYPE_ISO_WRITER, RejillaIsoWriter))
+#define REJILLA_ISO_WRITER_CLASS(k)     (G_TYPE_CHECK_CLASS_CAST((k), REJILLA_TYPE_ISO_WRITER, RejillaIsoWriterClass))
+#define REJILLA_IS_ISO_WRITER(o)        (G_TYPE_CHECK_INSTANCE_TYPE ((o), REJILLA_TYPE_ISO_WRITER))
+#define REJILLA_IS_ISO_WRITER_CLASS(k)  (G_TYPE_CHECK_CLASS_TYPE ((k), REJILLA_TYPE_ISO_WRITER))
+#define REJILLA_ISO_WRITER_GET_CLASS(o) (G_TYPE_INSTANCE_GET_CLASS ((o), REJILLA_TYPE_ISO_WRITER, RejillaIsoWriterClass))
+
+REJILLA_PLUGIN_BOILERPLATE (RejillaIsoWriter, rejilla_iso_writer, REJILLA_TYPE_JOB, RejillaJob);
+
+struct _RejillaIsoWriterPrivate {
+	/* Kept between the size and the image actions so that the image
+	 * has exactly the size that was reported */
+	RejillaIsoLayout *layout;
+
+	int fd;
+	gint64 written;
+
+	GError *error;
+	GThread *thread;
+	GMutex *mutex;
+	GCond *cond;
+	guint thread_id;
+
+	gint cancel;
+};
+typedef struct _RejillaIsoWriterPrivate RejillaIsoWriterPrivate;
+
+#define REJILLA_ISO_WRITER_PRIVATE(o)  (G_TYPE_INSTANCE_GET_PRIVATE ((o), REJILLA_TYPE_ISO_WRITER, RejillaIsoWriterPrivate))
+
+static GObjectClass *parent_class = NULL;
+
+static gboolean
+rejilla_iso_writer_thread_finished (gpointer data)
+{
+	RejillaIsoWriter *self = data;
+	RejillaIsoWriterPrivate *priv;
+	RejillaJobAction action;
+
+	priv = REJILLA_ISO_WRITER_PRIVATE (self);
+
+	priv->thread_id = 0;
+	if (priv->error) {
+		GError *error;
+
+		error = priv->error;
+		priv->error = NULL;
+		rejilla_job_error (REJILLA_JOB (self), error);
+		return FALSE;
+	}
+
+	rejilla_job_get_action (REJILLA_JOB (self), &action);
+	if (action == REJILLA_JOB_ACTION_IMAGE
+	&&  rejilla_job_get_fd_out (REJILLA_JOB (self), NULL) != REJILLA_BURN_OK) {
+		RejillaTrackImage *track = NULL;
+		gchar *output = NULL;
+
+		/* Let's make a track */
+		track = rejilla_track_image_new ();
+		rejilla_job_get_image_output (REJILLA_JOB (self),
+					      &output,
+					      NULL);
+		rejilla_track_image_set_source (track,
+						output,
+						NULL,
+						REJILLA_IMAGE_FORMAT_BIN);
+		rejilla_track_image_set_block_num (track, rejilla_iso_layout_get_size (priv->layout));
+
+		rejilla_job_add_track (REJILLA_JOB (self), REJILLA_TRACK (track));
+		g_object_unref (track);
+		g_free (output);
+	}
+
+	rejilla_job_finished_track (REJILLA_JOB (self));
+	return FALSE;
+}
+
+static gchar *
+rejilla_iso_writer_get_local_path (const gchar *uri)
+{
+	/* It can be a path or a URI */
+	if (uri [0] == '/')
+		return g_strdup (uri);
+
+	if (g_str_has_prefix (uri, "file://"))
+		return g_filename_from_uri (uri, NULL, NULL);
+
+	return NULL;
+}
+
+static gint
+rejilla_iso_writer_sort_graft_points (gconstpointer a, gconstpointer b)
+{
+	const RejillaGraftPt *graft_a = a;
+	const RejillaGraftPt *graft_b = b;
+
+	/* parents first */
+	return strlen (graft_a->path) - strlen (graft_b->path);
+}
+
+static void
+rejilla_iso_writer_create_layout (RejillaIsoWriter *self)
+{
+	RejillaIsoWriterPrivate *priv;
+	RejillaTrack *track = NULL;
+	RejillaImageFS image_fs;
+	goffset start_block = 0;
+	RejillaIsoLayout *layout;
+	RejillaBurnFlag flags;
+	gchar *label = NULL;
+	gchar *publisher;
+	GSList *grafts;
+	GSList *iter;
+
+	priv = REJILLA_ISO_WRITER_PRIVATE (self);
+
+	REJILLA_JOB_LOG (self, "Creating layout");
+
+	rejilla_job_get_flags (REJILLA_JOB (self), &flags);
+	if (flags & REJILLA_BURN_FLAG_APPEND)
+		rejilla_job_get_next_writable_address (REJILLA_JOB (self), &start_block);
+
+	rejilla_job_get_current_track (REJILLA_JOB (self), &track);
+	image_fs = rejilla_track_data_get_fs (REJILLA_TRACK_DATA (track));
+
+	rejilla_job_get_data_label (REJILLA_JOB (self), &label);
+	publisher = g_strdup_printf ("Rejilla-%i.%i.%i",
+				     REJILLA_MAJOR_VERSION,
+				     REJILLA_MINOR_VERSION,
+				     REJILLA_SUB);
+
+	layout = rejilla_iso_layout_new (label,
+					 publisher,
+					 g_get_real_name (),
+					 start_block,
+					 (image_fs & REJILLA_IMAGE_FS_JOLIET) != 0,
+					 (image_fs & REJILLA_IMAGE_FS_SYMLINK) != 0);
+	g_free (publisher);
+	g_free (label);
+
+	for (iter = rejilla_track_data_get_excluded_list (REJILLA_TRACK_DATA (track)); iter; iter = iter->next) {
+		gchar *local;
+
+		local = g_filename_from_uri (iter->data, NULL, NULL);
+		if (local)
+			rejilla_iso_layout_add_excluded (layout, local);
+		g_free (local);
+	}
+
+	rejilla_job_start_progress (REJILLA_JOB (self), FALSE);
+
+	/* copy the list as we're going to reorder it */
+	grafts = g_slist_copy (rejilla_track_data_get_grafts (REJILLA_TRACK_DATA (track)));
+	grafts = g_slist_sort (grafts, rejilla_iso_writer_sort_graft_points);
+	for (iter = grafts; iter; iter = iter->next) {
+		RejillaGraftPt *graft;
+		gchar *local = NULL;
+
+		if (g_atomic_int_get (&priv->cancel))
+			break;
+
+		graft = iter->data;
+		if (graft->uri) {
+			local = rejilla_iso_writer_get_local_path (graft->uri);
+			if (!local) {
+				priv->error = g_error_new (REJILLA_BURN_ERROR,
+							   REJILLA_BURN_ERROR_FILE_NOT_LOCAL,
+							   _("The file is not stored locally"));
+				break;
+			}
+		}
+
+		if (!rejilla_iso_layout_add_graft (layout, graft->path, local, &priv->error)) {
+			g_free (local);
+			break;
+		}
+
+		g_free (local);
+	}
+	g_slist_free (grafts);
+
+	if (priv->error || g_atomic_int_get (&priv->cancel)) {
+		rejilla_iso_layout_free (layout);
+		return;
+	}
+
+	if (!rejilla_iso_layout_build (layout, &priv->cancel, &priv->error)) {
+		rejilla_iso_layout_free (layout);
+		return;
+	}
+
+	priv->layout = layout;
+	rejilla_job_set_output_size_for_current_track (REJILLA_JOB (self),
+						       rejilla_iso_layout_get_size (layout),
+						       (gint64) rejilla_iso_layout_get_size (layout) * 2048);
+}
+
+static gboolean
+rejilla_iso_writer_write (const guchar *buffer,
+			  gsize size,
+			  gpointer user_data,
+			  GError **error)
+{
+	RejillaIsoWriter *self = user_data;
+	RejillaIsoWriterPrivate *priv;
+
+	priv = REJILLA_ISO_WRITER_PRIVATE (self);
+
+	while (size) {
+		gssize written;
+
+		if (g_atomic_int_get (&priv->cancel))
+			return FALSE;
+
+		written = write (priv->fd, buffer, size);
+		if (written < 0) {
+			int errsv = errno;
+
+			if (errsv == EINTR || errsv == EAGAIN) {
+				g_thread_yield ();
+				continue;
+			}
+
+			/* unrecoverable error */
+			g_set_error (error,
+				     REJILLA_BURN_ERROR,
+				     REJILLA_BURN_ERROR_GENERAL,
+				     _("Data could not be written (%s)"),
+				     g_strerror (errsv));
+			return FALSE;
+		}
+
+		buffer += written;
+		size -= written;
+
+		priv->written += written;
+		rejilla_job_set_written_track (REJILLA_JOB (self), priv->written);
+	}
+
+	return TRUE;
+}
+
+static void
+rejilla_iso_writer_write_image (RejillaIsoWriter *self)
+{
+	RejillaIsoWriterPrivate *priv;
+	gchar *output = NULL;
+
+	priv = REJILLA_ISO_WRITER_PRIVATE (self);
+
+	priv->fd = -1;
+	if (rejilla_job_get_fd_out (REJILLA_JOB (self), NULL) == REJILLA_BURN_OK) {
+		REJILLA_JOB_LOG (self, "Writing to pipe");
+		rejilla_job_get_fd_out (REJILLA_JOB (self), &priv->fd);
+	}
+	else {
+		rejilla_job_get_image_output (REJILLA_JOB (self), &output, NULL);
+		REJILLA_JOB_LOG (self, "Writing to file %s", output);
+
+		priv->fd = g_open (output, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+		if (priv->fd < 0) {
+			int errsv = errno;
+
+			if (errsv == EACCES)
+				priv->error = g_error_new_literal (REJILLA_BURN_ERROR,
+								   REJILLA_BURN_ERROR_PERMISSION,
+								   _("You do not have the required permission to write at this location"));
+			else
+				priv->error = g_error_new_literal (REJILLA_BURN_ERROR,
+								   REJILLA_BURN_ERROR_GENERAL,
+								   g_strerror (errsv));
+			g_free (output);
+			return;
+		}
+	}
+
+	rejilla_job_set_current_action (REJILLA_JOB (self),
+					REJILLA_BURN_ACTION_CREATING_IMAGE,
+					NULL,
+					FALSE);
+	rejilla_job_start_progress (REJILLA_JOB (self), FALSE);
+
+	priv->written = 0;
+	if (!rejilla_iso_layout_write (priv->layout,
+				       rejilla_iso_writer_write,
+				       self,
+				       &priv->error)
+	&& !priv->error
+	&& !g_atomic_int_get (&priv->cancel))
+		priv->error = g_error_new (REJILLA_BURN_ERROR,
+					   REJILLA_BURN_ERROR_GENERAL,
+					   _("Volume could not be created"));
+
+	if (output) {
+		/* the pipe is not ours */
+		close (priv->fd);
+		g_free (output);
+	}
+	priv->fd = -1;
+}
+
+static gpointer
+rejilla_iso_writer_thread (gpointer data)
+{
+	RejillaIsoWriter *self = REJILLA_ISO_WRITER (data);
+	RejillaIsoWriterPrivate *priv;
+	RejillaJobAction action;
+
+	priv = REJILLA_ISO_WRITER_PRIVATE (self);
+
+	REJILLA_JOB_LOG (self, "Entering thread");
+
+	if (!priv->layout)
+		rejilla_iso_writer_create_layout (self);
+
+	rejilla_job_get_action (REJILLA_JOB (self), &action);
+	if (action == REJILLA_JOB_ACTION_IMAGE
+	&&  priv->layout
+	&& !priv->error
+	&& !g_atomic_int_get (&priv->cancel))
+		rejilla_iso_writer_write_image (self);
+
+	REJILLA_JOB_LOG (self, "Getting out thread");
+
+	/* End thread */
+	g_mutex_lock (priv->mutex);
+
+	if (!g_atomic_int_get (&priv->cancel))
+		priv->thread_id = g_idle_add (rejilla_iso_writer_thread_finished, self);
+
+	priv->thread = NULL;
+	g_cond_signal (priv->cond);
+	g_mutex_unlock (priv->mutex);
+
+	g_thread_exit (NULL);
+
+	return NULL;
+}
+
+static void
+rejilla_iso_writer_clean_output (RejillaIsoWriter *self)
+{
+	RejillaIsoWriterPrivate *priv;
+
+	priv = REJILLA_ISO_WRITER_PRIVATE (self);
+
+	if (priv->layout) {
+		rejilla_iso_layout_free (priv->layout);
+		priv->layout = NULL;
+	}
+
+	if (priv->error) {
+		g_error_free (priv->error);
+		priv->error = NULL;
+	}
+}
+
+static RejillaBurnResult
+rejilla_iso_writer_start (RejillaJob *job,
+			  GError **error)
+{
+	RejillaIsoWriterPrivate *priv;
+	GError *thread_error = NULL;
+	RejillaJobAction action;
+
+	priv = REJILLA_ISO_WRITER_PRIVATE (job);
+
+	if (priv->thread)
+		return REJILLA_BURN_RUNNING;
+
+	rejilla_job_get_action (job, &action);
+	if (action == REJILLA_JOB_ACTION_SIZE) {
+		/* Files may have changed since the last time */
+		rejilla_iso_writer_clean_output (REJILLA_ISO_WRITER (job));
+		rejilla_job_set_current_action (job,
+						REJILLA_BURN_ACTION_GETTING_SIZE,
+						NULL,
+						FALSE);
+	}
+	else if (action != REJILLA_JOB_ACTION_IMAGE)
+		return REJILLA_BURN_NOT_SUPPORTED;
+
+	if (priv->error) {
+		g_error_free (priv->error);
+		priv->error = NULL;
+	}
+
+	g_mutex_lock (priv->mutex);
+	priv->thread = g_thread_create (rejilla_iso_writer_thread,
+					job,
+					FALSE,
+					&thread_error);
+	g_mutex_unlock (priv->mutex);
+
+	/* Reminder: this is not necessarily an error as the thread may have finished */
+	if (thread_error) {
+		g_propagate_error (error, thread_error);
+		return REJILLA_BURN_ERR;
+	}
+
+	return REJILLA_BURN_OK;
+}
+
+static void
+rejilla_iso_writer_stop_real (RejillaIsoWriter *self)
+{
+	RejillaIsoWriterPrivate *priv;
+
+	priv = REJILLA_ISO_WRITER_PRIVATE (self);
+
+	/* Check whether we properly shut down or if we were cancelled */
+	g_mutex_lock (priv->mutex);
+	if (priv->thread) {
+		/* A thread is running. In this context we are probably cancelling */
+		g_atomic_int_set (&priv->cancel, 1);
+		g_cond_wait (priv->cond, priv->mutex);
+		g_atomic_int_set (&priv->cancel, 0);
+	}
+	g_mutex_unlock (priv->mutex);
+
+	if (priv->thread_id) {
+		g_source_remove (priv->thread_id);
+		priv->thread_id = 0;
+	}
+}
+
+static RejillaBurnResult
+rejilla_iso_writer_stop (RejillaJob *job,
+			 GError **error)
+{
+	rejilla_iso_writer_stop_real (REJILLA_ISO_WRITER (job));
+	return REJILLA_BURN_OK;
+}
+
+static void
+rejilla_iso_writer_class_init (RejillaIsoWriterClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	RejillaJobClass *job_class = REJILLA_JOB_CLASS (klass);
+
+	g_type_class_add_private (klass, sizeof (RejillaIsoWriterPrivate));
+
+	parent_class = g_type_class_peek_parent (klass);
+	object_class->finalize = rejilla_iso_writer_finalize;
+
+	job_class->start = rejilla_iso_writer_start;
+	job_class->stop = rejilla_iso_writer_stop;
+}
+
+static void
+rejilla_iso_writer_init (RejillaIsoWriter *obj)
+{
+	RejillaIsoWriterPrivate *priv;
+
+	priv = REJILLA_ISO_WRITER_PRIVATE (obj);
+	priv->mutex = g_mutex_new ();
+	priv->cond = g_cond_new ();
+	priv->fd = -1;
+}
+
+static void
+rejilla_iso_writer_finalize (GObject *object)
+{
+	RejillaIsoWriter *cobj;
+	RejillaIsoWriterPrivate *priv;
+
+	cobj = REJILLA_ISO_WRITER (object);
+	priv = REJILLA_ISO_WRITER_PRIVATE (object);
+
+	rejilla_iso_writer_stop_real (cobj);
+	rejilla_iso_writer_clean_output (cobj);
+
+	if (priv->mutex) {
+		g_mutex_free (priv->mutex);
+		priv->mutex = NULL;
+	}
+
+	if (priv->cond) {
+		g_cond_free (priv->cond);
+		priv->cond = NULL;
+	}
+
+	G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+rejilla_iso_writer_export_caps (RejillaPlugin *plugin)
+{
+	GSList *output;
+	GSList *input;
+
+	/* Lowest priority (below genisoimage) until it's been tested more
+	 * widely */
+	rejilla_plugin_define (plugin,
+			       "iso-writer",
+	                       NULL,
+			       _("Creates disc images from a file selection without any external program"),
+			       "The Rejilla developers",
+			       0);
+
+	/* No merging with a previous session (yet) */
+	rejilla_plugin_set_flags (plugin,
+				  REJILLA_MEDIUM_CDR|
+				  REJILLA_MEDIUM_CDRW|
+				  REJILLA_MEDIUM_DVDR|
+				  REJILLA_MEDIUM_DVDRW|
+				  REJILLA_MEDIUM_DUAL_L|
+				  REJILLA_MEDIUM_APPENDABLE|
+				  REJILLA_MEDIUM_HAS_AUDIO|
+				  REJILLA_MEDIUM_HAS_DATA,
+				  REJILLA_BURN_FLAG_APPEND,
+				  REJILLA_BURN_FLAG_NONE);
+
+	rejilla_plugin_set_flags (plugin,
+				  REJILLA_MEDIUM_DVDRW_PLUS|
+				  REJILLA_MEDIUM_RESTRICTED|
+				  REJILLA_MEDIUM_DUAL_L|
+				  REJILLA_MEDIUM_APPENDABLE|
+				  REJILLA_MEDIUM_CLOSED|
+				  REJILLA_MEDIUM_HAS_DATA,
+				  REJILLA_BURN_FLAG_APPEND,
+				  REJILLA_BURN_FLAG_NONE);
+
+	output = rejilla_caps_image_new (REJILLA_PLUGIN_IO_ACCEPT_FILE|
+					 REJILLA_PLUGIN_IO_ACCEPT_PIPE,
+					 REJILLA_IMAGE_FORMAT_BIN);
+
+	/* Files over 4 GiB (ISO9660 level 3) are not supported */
+	input = rejilla_caps_data_new (REJILLA_IMAGE_FS_ISO|
+				       REJILLA_IMAGE_ISO_FS_DEEP_DIRECTORY|
+				       REJILLA_IMAGE_FS_JOLIET);
+	rejilla_plugin_link_caps (plugin, output, input);
+	g_slist_free (input);
+
+	input = rejilla_caps_data_new (REJILLA_IMAGE_FS_ISO|
+				       REJILLA_IMAGE_ISO_FS_DEEP_DIRECTORY|
+				       REJILLA_IMAGE_FS_SYMLINK);
+	rejilla_plugin_link_caps (plugin, output, input);
+	g_slist_free (input);
+
+	g_slist_free (output);
+}
@@ -38,6 +38,7 @@
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <poll.h>
 
 #include <glib.h>
 #include <glib-object.h>
@@ -67,6 +68,23 @@ REJILLA_PLUGIN_BOILERPLATE (RejillaLibburn, rejilla_libburn, REJILLA_TYPE_JOB, R
 
 #define REJILLA_PVD_SIZE	32ULL * 2048ULL
 
+#define REJILLA_SCHEMA_CONFIG		"org.mate.rejilla.config"
+#define REJILLA_KEY_FIFO_SIZE		"libburn-fifo-size"
+
+/* Size (in MiB) of the FIFO put between the imager and the drive */
+#define REJILLA_LIBBURN_FIFO_DEFAULT	64
+#define REJILLA_LIBBURN_FIFO_MIN	4
+#define REJILLA_LIBBURN_FIFO_MAX	512
+
+/* The FIFO reader thread never reads more than that at once so that the
+ * buffer is fed in a steady flow */
+#define REJILLA_LIBBURN_FIFO_CHUNK	(32 * 2048)
+
+/* Writing starts once the FIFO is that full (in %), once the whole input
+ * was read or after REJILLA_LIBBURN_FIFO_PREFILL_TIMEOUT seconds */
+#define REJILLA_LIBBURN_FIFO_PREFILL		90
+#define REJILLA_LIBBURN_FIFO_PREFILL_TIMEOUT	20.0
+
 struct _RejillaLibburnPrivate {
 	RejillaLibburnCtx *ctx;
 
@@ -74,6 +92,13 @@ struct _RejillaLibburnPrivate {
 	 * for overwrite media so as to "grow" the latter. */
 	unsigned char *pvd;
 
+	/* Used when the input comes from a pipe; the write only starts
+	 * (with opts) once the FIFO is filled enough */
+	struct burn_source *fifo;
+	struct burn_write_opts *opts;
+	GTimer *prefill;
+	gsize fifo_size;
+
 	guint sig_handler:1;
 };
 typedef struct _RejillaLibburnPrivate RejillaLibburnPrivate;
@@ -99,16 +124,176 @@ struct _RejillaLibburnSrcData {
 	int pvd_size;						/* in blocks */
 	unsigned char *pvd;
 
+	/* Ring buffer filled from fd by a separate thread. All fields
+	 * below are protected by mutex. */
+	GThread *thread;
+	GMutex *mutex;
+	GCond *cond;
+
+	guchar *fifo;
+	gsize fifo_size;
+	gsize fifo_start;
+	gsize fifo_filled;
+
+	guint fifo_eof:1;
+	guint fifo_stop:1;
+
+	/* NOTE: keeps read_pvd (not protected) out of the bitfield above */
+	gint fifo_errno;
+
 	int read_pvd:1;
 };
 typedef struct _RejillaLibburnSrcData RejillaLibburnSrcData;
 
+static gpointer
+rejilla_libburn_src_fifo_thread (gpointer user_data)
+{
+	RejillaLibburnSrcData *data = user_data;
+
+	g_mutex_lock (data->mutex);
+	while (!data->fifo_stop) {
+		struct pollfd fds;
+		gsize end, len;
+		gssize bytes;
+		int errsv;
+		int res;
+
+		if (data->fifo_filled == data->fifo_size) {
+			g_cond_wait (data->cond, data->mutex);
+			continue;
+		}
+
+		/* Only the free part of the buffer is written to here
+		 * so there is no need to hold the lock while reading */
+		end = (data->fifo_start + data->fifo_filled) % data->fifo_size;
+		len = MIN (data->fifo_size - data->fifo_filled, data->fifo_size - end);
+		len = MIN (len, REJILLA_LIBBURN_FIFO_CHUNK);
+		g_mutex_unlock (data->mutex);
+
+		/* Use a timeout to be able to notice when we're asked to
+		 * stop even if upstream stalls */
+		fds.fd = data->fd;
+		fds.events = POLLIN;
+		res = poll (&fds, 1, 250);
+		if (res > 0)
+			bytes = read (data->fd, data->fifo + end, len);
+		else
+			bytes = res ? -1:-2;
+		errsv = errno;
+
+		g_mutex_lock (data->mutex);
+
+		if (bytes == -2 || (bytes == -1 && errsv == EINTR))
+			continue;
+
+		if (bytes < 0) {
+			data->fifo_errno = errsv;
+			data->fifo_eof = 1;
+			REJILLA_BURN_LOG ("FIFO read error (%s)", g_strerror (data->fifo_errno));
+			break;
+		}
+
+		if (!bytes) {
+			data->fifo_eof = 1;
+			break;
+		}
+
+		data->fifo_filled += bytes;
+		g_cond_broadcast (data->cond);
+	}
+
+	g_cond_broadcast (data->cond);
+	g_mutex_unlock (data->mutex);
+	return NULL;
+}
+
+static int
+rejilla_libburn_src_fifo_read (RejillaLibburnSrcData *data,
+			       unsigned char *buffer,
+			       int size)
+{
+	int total = 0;
+
+	g_mutex_lock (data->mutex);
+	while (total < size) {
+		gsize len;
+
+		if (!data->fifo_filled) {
+			if (data->fifo_eof)
+				break;
+
+			g_cond_wait (data->cond, data->mutex);
+			continue;
+		}
+
+		len = MIN (data->fifo_filled, data->fifo_size - data->fifo_start);
+		len = MIN (len, size - total);
+
+		memcpy (buffer + total, data->fifo + data->fifo_start, len);
+		data->fifo_start = (data->fifo_start + len) % data->fifo_size;
+		data->fifo_filled -= len;
+		total += len;
+
+		g_cond_broadcast (data->cond);
+	}
+
+	/* Report the error once everything that was read before is gone */
+	if (!total && data->fifo_errno) {
+		g_mutex_unlock (data->mutex);
+		return -1;
+	}
+
+	g_mutex_unlock (data->mutex);
+	return total;
+}
+
+/**
+ * Returns how full the FIFO is in % or 100 if the whole input was read
+ */
+
+static gint
+rejilla_libburn_src_get_fifo_fill (struct burn_source *src)
+{
+	RejillaLibburnSrcData *data;
+	gint fill;
+
+	data = src->data;
+	if (!data->fifo)
+		return -1;
+
+	g_mutex_lock (data->mutex);
+	if (data->fifo_eof)
+		fill = 100;
+	else
+		fill = (gint) ((guint64) data->fifo_filled * 100 / data->fifo_size);
+	g_mutex_unlock (data->mutex);
+
+	return fill;
+}
+
 static void
 rejilla_libburn_src_free_data (struct burn_source *src)
 {
 	RejillaLibburnSrcData *data;
 
 	data = src->data;
+
+	if (data->thread) {
+		g_mutex_lock (data->mutex);
+		data->fifo_stop = 1;
+		g_cond_broadcast (data->cond);
+		g_mutex_unlock (data->mutex);
+
+		g_thread_join (data->thread);
+		data->thread = NULL;
+	}
+
+	if (data->mutex) {
+		g_mutex_free (data->mutex);
+		g_cond_free (data->cond);
+	}
+
+	g_free (data->fifo);
 	close (data->fd);
 	g_free (data);
 }
@@ -154,18 +339,25 @@ rejilla_libburn_src_read_xt (struct burn_source *src,
 
 	data = src->data;
 
-	total = 0;
-	while (total < size) {
-		int bytes;
-
-		bytes = read (data->fd, buffer + total, size - total);
-		if (bytes < 0)
+	if (data->fifo) {
+		total = rejilla_libburn_src_fifo_read (data, buffer, size);
+		if (total < 0)
 			return -1;
+	}
+	else {
+		total = 0;
+		while (total < size) {
+			int bytes;
 
-		if (!bytes)
-			break;
+			bytes = read (data->fd, buffer + total, size - total);
+			if (bytes < 0)
+				return -1;
 
-		total += bytes;
+			if (!bytes)
+				break;
+
+			total += bytes;
+		}
 	}
 
 	/* copy the primary volume descriptor if a buffer is provided */
@@ -204,7 +396,8 @@ rejilla_libburn_src_read_xt (struct burn_source *src,
 static struct burn_source *
 rejilla_libburn_create_fd_source (int fd,
 				  gint64 size,
-				  unsigned char *pvd)
+				  unsigned char *pvd,
+				  gsize fifo_size)
 {
 	struct burn_source *src;
 	RejillaLibburnSrcData *data;
@@ -214,8 +407,47 @@ rejilla_libburn_create_fd_source (int fd,
 	data->size = size;
 	data->pvd = pvd;
 
-	/* FIXME: this could be wrapped into a fifo source to get a smoother
-	 * data delivery. But that means another thread ... */
+	/* Put a FIFO between the pipe and libburn so that any hiccup
+	 * upstream doesn't get straight to the drive buffer */
+	if (fifo_size) {
+		GError *error = NULL;
+
+		/* No need for a buffer bigger than what we'll get */
+		if (size > 0)
+			fifo_size = MIN (fifo_size, size);
+
+		data->fifo = g_try_malloc (fifo_size);
+		if (data->fifo) {
+			data->fifo_size = fifo_size;
+			data->mutex = g_mutex_new ();
+			data->cond = g_cond_new ();
+			data->thread = g_thread_create (rejilla_libburn_src_fifo_thread,
+							data,
+							TRUE,
+							&error);
+		}
+
+		if (!data->thread) {
+			REJILLA_BURN_LOG ("FIFO could not be set up (%s)",
+					  error ? error->message:"not enough memory");
+			if (error)
+				g_error_free (error);
+
+			if (data->mutex) {
+				g_mutex_free (data->mutex);
+				g_cond_free (data->cond);
+				data->mutex = NULL;
+				data->cond = NULL;
+			}
+
+			g_free (data->fifo);
+			data->fifo = NULL;
+			data->fifo_size = 0;
+		}
+		else
+			REJILLA_BURN_LOG ("Using a %" G_GSIZE_FORMAT " bytes FIFO", fifo_size);
+	}
+
 	src = g_new0 (struct burn_source, 1);
 	src->version = 1;
 	src->refcount = 1;
@@ -260,6 +492,8 @@ rejilla_libburn_add_fd_track (struct burn_session *session,
 			      gint mode,
 			      gint64 size,
 			      unsigned char *pvd,
+			      gsize fifo_size,
+			      struct burn_source **fifo,
 			      GError **error)
 {
 	struct burn_source *src;
@@ -269,9 +503,16 @@ rejilla_libburn_add_fd_track (struct burn_session *session,
 	track = burn_track_create ();
 	burn_track_define_data (track, 0, 0, 0, mode);
 
-	src = rejilla_libburn_create_fd_source (fd, size, pvd);
+	src = rejilla_libburn_create_fd_source (fd, size, pvd, fifo_size);
 	result = rejilla_libburn_add_track (session, track, src, mode, error);
 
+	/* Keep a reference to be able to report the fill level */
+	if (fifo && result == REJILLA_BURN_OK
+	&&  ((RejillaLibburnSrcData *) src->data)->fifo) {
+		src->refcount ++;
+		*fifo = src;
+	}
+
 	burn_source_free (src);
 	burn_track_free (track);
 
@@ -298,7 +539,7 @@ rejilla_libburn_add_file_track (struct burn_session *session,
 		return REJILLA_BURN_ERR;
 	}
 
-	return rejilla_libburn_add_fd_track (session, fd, mode, size, pvd, error);
+	return rejilla_libburn_add_fd_track (session, fd, mode, size, pvd, 0, NULL, error);
 }
 
 static RejillaBurnResult
@@ -340,6 +581,8 @@ rejilla_libburn_setup_session_fd (RejillaLibburn *self,
 						       mode,
 						       bytes,
 						       priv->pvd,
+						       priv->fifo_size,
+						       &priv->fifo,
 						       error);
 	}
 	else if (rejilla_track_type_get_has_stream (type)) {
@@ -357,12 +600,16 @@ rejilla_libburn_setup_session_fd (RejillaLibburn *self,
 			bytes = REJILLA_DURATION_TO_BYTES (length);
 
 			/* we dup the descriptor so the same 
-			 * will be shared by all tracks */
+			 * will be shared by all tracks.
+			 * NOTE: no FIFO here since a reader thread
+			 * would steal the data of the next tracks. */
 			result = rejilla_libburn_add_fd_track (session,
 							       dup (fd),
 							       BURN_AUDIO,
 							       bytes,
 							       NULL,
+							       0,
+							       NULL,
 							       error);
 			if (result != REJILLA_BURN_OK)
 				return result;
@@ -581,6 +828,14 @@ rejilla_libburn_start_record (RejillaLibburn *self,
 		priv->sig_handler = 1;
 	}
 
+	/* Let the FIFO fill up before writing (see clock_tick) */
+	if (priv->fifo) {
+		REJILLA_JOB_LOG (self, "Waiting for FIFO to fill up");
+		priv->opts = opts;
+		priv->prefill = g_timer_new ();
+		return REJILLA_BURN_OK;
+	}
+
 	burn_disc_write (opts, priv->ctx->disc);
 	burn_write_opts_free (opts);
 
@@ -693,6 +948,8 @@ rejilla_libburn_start_erase (RejillaLibburn *self,
 					       BURN_MODE1,
 					       65536,		/* 32 blocks */
 					       priv->pvd,
+					       0,
+					       NULL,
 					       error);
 	close (fd);
 
@@ -769,7 +1026,7 @@ rejilla_libburn_start (RejillaJob *job,
 
 		rejilla_job_set_current_action (job,
 						REJILLA_BURN_ACTION_START_RECORDING,
-						NULL,
+						priv->opts ? _("Filling buffer"):NULL,
 						FALSE);
 	}
 	else if (action == REJILLA_JOB_ACTION_ERASE) {
@@ -817,6 +1074,21 @@ rejilla_libburn_stop (RejillaJob *job,
 		burn_set_signal_handling (NULL, NULL, 1);
 	}
 
+	if (priv->opts) {
+		burn_write_opts_free (priv->opts);
+		priv->opts = NULL;
+	}
+
+	if (priv->prefill) {
+		g_timer_destroy (priv->prefill);
+		priv->prefill = NULL;
+	}
+
+	if (priv->fifo) {
+		burn_source_free (priv->fifo);
+		priv->fifo = NULL;
+	}
+
 	if (priv->ctx) {
 		rejilla_libburn_common_ctx_free (priv->ctx);
 		priv->ctx = NULL;
@@ -841,6 +1113,35 @@ rejilla_libburn_clock_tick (RejillaJob *job)
 	int ret;
 
 	priv = REJILLA_LIBBURN_PRIVATE (job);
+
+	if (priv->fifo) {
+		gint fill;
+
+		fill = rejilla_libburn_src_get_fifo_fill (priv->fifo);
+		rejilla_job_set_buffer_fill (job, fill);
+
+		/* See if the FIFO is full enough to start writing */
+		if (priv->opts) {
+			if (fill < REJILLA_LIBBURN_FIFO_PREFILL
+			&&  g_timer_elapsed (priv->prefill, NULL) < REJILLA_LIBBURN_FIFO_PREFILL_TIMEOUT)
+				return REJILLA_BURN_OK;
+
+			REJILLA_JOB_LOG (job, "Starting to write (FIFO %i%% full)", fill);
+			g_timer_destroy (priv->prefill);
+			priv->prefill = NULL;
+
+			burn_disc_write (priv->opts, priv->ctx->disc);
+			burn_write_opts_free (priv->opts);
+			priv->opts = NULL;
+
+			rejilla_job_set_current_action (job,
+							REJILLA_BURN_ACTION_START_RECORDING,
+							NULL,
+							TRUE);
+			return REJILLA_BURN_OK;
+		}
+	}
+
 	result = rejilla_libburn_common_status (job, priv->ctx);
 
 	if (result != REJILLA_BURN_OK)
@@ -912,7 +1213,19 @@ rejilla_libburn_class_init (RejillaLibburnClass *klass)
 static void
 rejilla_libburn_init (RejillaLibburn *obj)
 {
+	GSettings *settings;
+	RejillaLibburnPrivate *priv;
+	gint size;
+
+	priv = REJILLA_LIBBURN_PRIVATE (obj);
+
+	settings = g_settings_new (REJILLA_SCHEMA_CONFIG);
+	size = g_settings_get_int (settings, REJILLA_KEY_FIFO_SIZE);
+	if (size < REJILLA_LIBBURN_FIFO_MIN || size > REJILLA_LIBBURN_FIFO_MAX)
+		size = REJILLA_LIBBURN_FIFO_DEFAULT;
 
+	priv->fifo_size = (gsize) size * 1024 * 1024;
+	g_object_unref (settings);
 }
 
 static void
@@ -924,6 +1237,21 @@ rejilla_libburn_finalize (GObject *object)
 	cobj = REJILLA_LIBBURN (object);
 	priv = REJILLA_LIBBURN_PRIVATE (cobj);
 
+	if (priv->opts) {
+		burn_write_opts_free (priv->opts);
+		priv->opts = NULL;
+	}
+
+	if (priv->prefill) {
+		g_timer_destroy (priv->prefill);
+		priv->prefill = NULL;
+	}
+
+	if (priv->fifo) {
+		burn_source_free (priv->fifo);
+		priv->fifo = NULL;
+	}
+
 	if (priv->ctx) {
 		rejilla_libburn_common_ctx_free (priv->ctx);
 		priv->ctx = NULL;
@@ -965,6 +1293,7 @@ rejilla_libburn_export_caps (RejillaPlugin *plugin)
 					       REJILLA_MEDIUM_APPENDABLE|
 					       REJILLA_MEDIUM_CLOSED|
 					       REJILLA_MEDIUM_HAS_DATA;
+	RejillaPluginConfOption *fifo;
 	GSList *output;
 	GSList *input;
 
@@ -1086,5 +1415,14 @@ rejilla_libburn_export_caps (RejillaPlugin *plugin)
 					REJILLA_BURN_FLAG_FAST_BLANK,
 					REJILLA_BURN_FLAG_NONE);
 
+	/* add some configure options */
+	fifo = rejilla_plugin_conf_option_new (REJILLA_KEY_FIFO_SIZE,
+					       _("Size of the buffer used when burning on the fly (in MiB):"),
+					       REJILLA_PLUGIN_OPTION_INT);
+	rejilla_plugin_conf_option_int_set_range (fifo,
+						  REJILLA_LIBBURN_FIFO_MIN,
+						  REJILLA_LIBBURN_FIFO_MAX);
+	rejilla_plugin_add_conf_option (plugin, fifo);
+
 	rejilla_plugin_register_group (plugin, _(LIBBURNIA_DESCRIPTION));
 }
@@ -420,21 +420,55 @@ rejilla_libisofs_sort_graft_points (gconstpointer a, gconstpointer b)
 	return len_a - len_b;
 }
 
+/* The directories of the previous session are read through this source.
+ * Reading them one block at a time means one command round trip per
+ * block, so read ahead: directory extents are contiguous. */
+#define REJILLA_LIBISOFS_READ_AHEAD	32
+
+struct _RejillaLibisofsImportSrc {
+	struct burn_drive *drive;
+
+	uint32_t start;
+	guint blocks;
+	gchar buffer [REJILLA_LIBISOFS_READ_AHEAD * 2048];
+};
+typedef struct _RejillaLibisofsImportSrc RejillaLibisofsImportSrc;
+
 static int 
 rejilla_libisofs_import_read (IsoDataSource *src, uint32_t lba, uint8_t *buffer)
 {
-	struct burn_drive *d;
+	RejillaLibisofsImportSrc *data;
 	off_t data_count;
 	gint result;
 
-	d = (struct burn_drive*)src->data;
+	data = src->data;
+
+	if (lba >= data->start && lba < data->start + data->blocks) {
+		memcpy (buffer, data->buffer + (lba - data->start) * 2048, 2048);
+		return 1;
+	}
+
+	data->blocks = 0;
+	result = burn_read_data (data->drive,
+				 (off_t) lba * (off_t) 2048,
+				 data->buffer,
+				 sizeof (data->buffer),
+				 &data_count,
+				 0);
+	if (result > 0 && data_count >= 2048) {
+		data->start = lba;
+		data->blocks = data_count / 2048;
+		memcpy (buffer, data->buffer, 2048);
+		return 1;
+	}
 
-	result = burn_read_data(d,
-				(off_t) lba * (off_t) 2048,
-				(char*)buffer, 
-				2048,
-				&data_count,
-				0);
+	/* That may have failed because we went past the end of the track */
+	result = burn_read_data (data->drive,
+				 (off_t) lba * (off_t) 2048,
+				 (char*)buffer, 
+				 2048,
+				 &data_count,
+				 0);
 	if (result < 0 )
 		return -1; /* error */
 
@@ -455,7 +489,10 @@ rejilla_libisofs_import_close (IsoDataSource *src)
     
 static void 
 rejilla_libisofs_import_free (IsoDataSource *src)
-{ }
+{
+	g_free (src->data);
+	src->data = NULL;
+}
 
 static RejillaBurnResult
 rejilla_libisofs_import_last_session (RejillaLibisofs *self,
@@ -470,6 +507,7 @@ rejilla_libisofs_import_last_session (RejillaLibisofs *self,
 	goffset start_block;
 	goffset session_block;
 	RejillaLibisofsPrivate *priv;
+	RejillaLibisofsImportSrc *import;
 
 	priv = REJILLA_LIBISOFS_PRIVATE (self);
 
@@ -493,7 +531,9 @@ rejilla_libisofs_import_last_session (RejillaLibisofs *self,
 	src->open = rejilla_libisofs_import_open;
 	src->close = rejilla_libisofs_import_close;
 	src->free_data = rejilla_libisofs_import_free;
-	src->data = priv->ctx->drive;
+	import = g_new0 (RejillaLibisofsImportSrc, 1);
+	import->drive = priv->ctx->drive;
+	src->data = import;
 
 	rejilla_job_get_last_session_address (REJILLA_JOB (self), &session_block);
 	iso_read_opts_set_start_block (opts, session_block);
@@ -37,6 +37,7 @@
 #include <libxml/xmlerror.h>
 #include <libxml/xmlwriter.h>
 #include <libxml/parser.h>
+#include <libxml/xmlreader.h>
 #include <libxml/xmlstring.h>
 #include <libxml/uri.h>
 
@@ -64,46 +65,131 @@ rejilla_project_invalid_project_dialog (const char *reason)
 			   GTK_MESSAGE_ERROR);
 }
 
+static gchar *
+_get_snapshot_path (const gchar *path)
+{
+	gchar *checksum;
+	gchar *snapshot;
+
+	/* The snapshot of a project is kept in the cache directory and named
+	 * after the path of the project */
+	checksum = g_compute_checksum_for_string (G_CHECKSUM_MD5, path, -1);
+	snapshot = g_build_filename (g_get_user_cache_dir (),
+				     "rejilla",
+				     "projects",
+				     checksum,
+				     NULL);
+	g_free (checksum);
+	return snapshot;
+}
+
+/**
+ * The project is read with a xmlTextReader so that it is never loaded
+ * whole in memory. The following functions move the reader from one child
+ * element to the next of the element at @depth. Text and elements nested
+ * deeper are skipped.
+ * Return 1 when the reader is on a child element, 0 at the end of the
+ * element at @depth and -1 on error.
+ */
+
+static gint
+_next_child (xmlTextReaderPtr reader,
+	     gint depth)
+{
+	gint res;
+
+	while ((res = xmlTextReaderRead (reader)) == 1) {
+		gint type;
+
+		type = xmlTextReaderNodeType (reader);
+		if (type == XML_READER_TYPE_END_ELEMENT
+		&&  xmlTextReaderDepth (reader) == depth)
+			return 0;
+
+		if (type == XML_READER_TYPE_ELEMENT
+		&&  xmlTextReaderDepth (reader) == depth + 1)
+			return 1;
+	}
+
+	/* The end of the file can't be reached before the end of the element */
+	return -1;
+}
+
+static gint
+_first_child (xmlTextReaderPtr reader,
+	      gint depth)
+{
+	if (xmlTextReaderIsEmptyElement (reader))
+		return 0;
+
+	return _next_child (reader, depth);
+}
+
+static gboolean
+_is_element (xmlTextReaderPtr reader,
+	     const gchar *name)
+{
+	return !xmlStrcmp (xmlTextReaderConstName (reader), (const xmlChar *) name);
+}
+
+static gchar *
+_read_string (xmlTextReaderPtr reader)
+{
+	xmlChar *string;
+
+	if (xmlTextReaderIsEmptyElement (reader))
+		return NULL;
+
+	/* An element without contents is an error as with a DOM */
+	string = xmlTextReaderReadString (reader);
+	if (string && !string [0]) {
+		xmlFree (string);
+		return NULL;
+	}
+
+	return (gchar *) string;
+}
+
 static GSList *
-_read_graft_point (xmlDocPtr project,
-		   xmlNodePtr graft,
+_read_graft_point (xmlTextReaderPtr reader,
 		   GSList *grafts)
 {
 	RejillaGraftPt *retval;
+	gint depth;
+	gint res;
 
 	retval = g_new0 (RejillaGraftPt, 1);
         grafts = g_slist_prepend (grafts, retval);
-	while (graft) {
-		if (!xmlStrcmp (graft->name, (const xmlChar *) "uri")) {
-			xmlChar *uri;
+
+	depth = xmlTextReaderDepth (reader);
+	for (res = _first_child (reader, depth); res > 0; res = _next_child (reader, depth)) {
+		if (_is_element (reader, "uri")) {
+			gchar *uri;
 
 			if (retval->uri)
 				goto error;
 
-			uri = xmlNodeListGetString (project,
-						    graft->xmlChildrenNode,
-						    1);
-			retval->uri = g_uri_unescape_string ((char *)uri, NULL);
-			g_free (uri);
+			uri = _read_string (reader);
+			retval->uri = g_uri_unescape_string (uri, NULL);
+			xmlFree (uri);
 			if (!retval->uri)
 				goto error;
 		}
-		else if (!xmlStrcmp (graft->name, (const xmlChar *) "path")) {
+		else if (_is_element (reader, "path")) {
 			if (retval->path)
 				goto error;
 
-			retval->path = (char *) xmlNodeListGetString (project,
-								      graft->xmlChildrenNode,
-								      1);
+			retval->path = _read_string (reader);
 			if (!retval->path)
 				goto error;
 		}
-		else if (graft->type == XML_ELEMENT_NODE)
+		else
 			goto error;
-
-		graft = graft->next;
 	}
 
+	if (res < 0)
+		goto error;
+
 	return grafts;
 
 error:
@@ -115,62 +201,65 @@ error:
 }
 
 static RejillaTrack *
-_read_data_track (xmlDocPtr project,
-		  xmlNodePtr item)
+_read_data_track (xmlTextReaderPtr reader,
+		  const gchar *snapshot)
 {
 	RejillaTrackDataCfg *track;
         GSList *grafts= NULL;
         GSList *excluded = NULL;
+	gint depth;
+	gint res;
 
 	track = rejilla_track_data_cfg_new ();
 
-	while (item) {
-		if (!xmlStrcmp (item->name, (const xmlChar *) "graft")) {
-			if (!(grafts = _read_graft_point (project, item->xmlChildrenNode, grafts)))
+	depth = xmlTextReaderDepth (reader);
+	for (res = _first_child (reader, depth); res > 0; res = _next_child (reader, depth)) {
+		if (_is_element (reader, "graft")) {
+			if (!(grafts = _read_graft_point (reader, grafts)))
 				goto error;
 		}
-		else if (!xmlStrcmp (item->name, (const xmlChar *) "icon")) {
-			xmlChar *icon_path;
+		else if (_is_element (reader, "icon")) {
+			gchar *icon_path;
 
-			icon_path = xmlNodeListGetString (project,
-							  item->xmlChildrenNode,
-							  1);
+			icon_path = _read_string (reader);
 			if (!icon_path)
 				goto error;
 
-			rejilla_track_data_cfg_set_icon (track, (gchar *) icon_path, NULL);
-                        g_free (icon_path);
+			rejilla_track_data_cfg_set_icon (track, icon_path, NULL);
+                        xmlFree (icon_path);
 		}
-		else if (!xmlStrcmp (item->name, (const xmlChar *) "restored")) {
-			xmlChar *restored;
+		else if (_is_element (reader, "restored")) {
+			gchar *restored;
 
-			restored = xmlNodeListGetString (project,
-							 item->xmlChildrenNode,
-							 1);
+			restored = _read_string (reader);
 			if (!restored)
 				goto error;
 
-                        rejilla_track_data_cfg_dont_filter_uri (track, (gchar *) restored);
-                        g_free (restored);
+                        rejilla_track_data_cfg_dont_filter_uri (track, restored);
+                        xmlFree (restored);
 		}
-		else if (!xmlStrcmp (item->name, (const xmlChar *) "excluded")) {
-			xmlChar *excluded_uri;
+		else if (_is_element (reader, "excluded")) {
+			gchar *excluded_uri;
 
-			excluded_uri = xmlNodeListGetString (project,
-							     item->xmlChildrenNode,
-							     1);
+			excluded_uri = _read_string (reader);
 			if (!excluded_uri)
 				goto error;
 
-			excluded = g_slist_prepend (excluded, xmlURIUnescapeString ((char*) excluded_uri, 0, NULL));
-			g_free (excluded_uri);
+			excluded = g_slist_prepend (excluded, xmlURIUnescapeString (excluded_uri, 0, NULL));
+			xmlFree (excluded_uri);
 		}
-		else if (item->type == XML_ELEMENT_NODE)
+		else
 			goto error;
-
-		item = item->next;
 	}
 
+	if (res < 0)
+		goto error;
+
+	/* Directories that didn't change since the project was saved won't
+	 * need to be explored again */
+	if (snapshot)
+		rejilla_track_data_cfg_load_snapshot (track, snapshot);
+
         grafts = g_slist_reverse (grafts);
         excluded = g_slist_reverse (excluded);
         rejilla_track_data_set_source (REJILLA_TRACK_DATA (track),
@@ -192,27 +281,27 @@ error:
 }
 
 static RejillaTrack *
-_read_audio_track (xmlDocPtr project,
-		   xmlNodePtr uris,
+_read_audio_track (xmlTextReaderPtr reader,
                    gboolean is_video)
 {
 	RejillaTrackStreamCfg *track;
+	gint depth;
+	gint res;
 
 	track = rejilla_track_stream_cfg_new ();
 
-	while (uris) {
-		if (!xmlStrcmp (uris->name, (const xmlChar *) "uri")) {
-			xmlChar *uri;
+	depth = xmlTextReaderDepth (reader);
+	for (res = _first_child (reader, depth); res > 0; res = _next_child (reader, depth)) {
+		if (_is_element (reader, "uri")) {
+			gchar *uri;
                         gchar *unescaped_uri;
 
-			uri = xmlNodeListGetString (project,
-						    uris->xmlChildrenNode,
-						    1);
+			uri = _read_string (reader);
 			if (!uri)
 				goto error;
 
-                        unescaped_uri = g_uri_unescape_string ((char *) uri, NULL);
-                        g_free (uri);
+                        unescaped_uri = g_uri_unescape_string (uri, NULL);
+                        xmlFree (uri);
 
 			/* Note: this must come before rejilla_track_stream_set_boundaries ()
 			 * or we will reset the end point to 0 */
@@ -226,16 +315,14 @@ _read_audio_track (xmlDocPtr project,
 
                         g_free (unescaped_uri);
 		}
-		else if (!xmlStrcmp (uris->name, (const xmlChar *) "silence")) {
+		else if (_is_element (reader, "silence")) {
 			gchar *silence;
 
 			/* impossible to have two gaps in a row */
 			if (rejilla_track_stream_get_gap (REJILLA_TRACK_STREAM (track)) > 0)
 				goto error;
 
-			silence = (gchar *) xmlNodeListGetString (project,
-								  uris->xmlChildrenNode,
-								  1);
+			silence = _read_string (reader);
 			if (!silence)
 				goto error;
 
@@ -243,14 +330,12 @@ _read_audio_track (xmlDocPtr project,
                                                              -1,
                                                              -1,
                                                              g_ascii_strtoull (silence, NULL, 10));
-			g_free (silence);
+			xmlFree (silence);
 		}
-		else if (!xmlStrcmp (uris->name, (const xmlChar *) "start")) {
+		else if (_is_element (reader, "start")) {
 			gchar *start;
 
-			start = (gchar *) xmlNodeListGetString (project,
-								uris->xmlChildrenNode,
-								1);
+			start = _read_string (reader);
 			if (!start)
 				goto error;
 
@@ -258,14 +343,12 @@ _read_audio_track (xmlDocPtr project,
                                                              g_ascii_strtoull (start, NULL, 10),
                                                              -1,
                                                              -1);
-			g_free (start);
+			xmlFree (start);
 		}
-		else if (!xmlStrcmp (uris->name, (const xmlChar *) "end")) {
+		else if (_is_element (reader, "end")) {
 			gchar *end;
 
-			end = (gchar *) xmlNodeListGetString (project,
-							      uris->xmlChildrenNode,
-							      1);
+			end = _read_string (reader);
 			if (!end)
 				goto error;
 
@@ -273,82 +356,75 @@ _read_audio_track (xmlDocPtr project,
                                                              -1,
                                                              g_ascii_strtoull (end, NULL, 10),
                                                              -1);
-			g_free (end);
+			xmlFree (end);
 		}
-		else if (!xmlStrcmp (uris->name, (const xmlChar *) "title")) {
-			xmlChar *title;
+		else if (_is_element (reader, "title")) {
+			gchar *title;
 			gchar *unescaped_title;
 
-			title = xmlNodeListGetString (project,
-						      uris->xmlChildrenNode,
-						      1);
+			title = _read_string (reader);
 			if (!title)
 				goto error;
 
-                        unescaped_title = g_uri_unescape_string ((char *) title, NULL);
-                        g_free (title);
+                        unescaped_title = g_uri_unescape_string (title, NULL);
+                        xmlFree (title);
 
                         rejilla_track_tag_add_string (REJILLA_TRACK (track),
                                                       REJILLA_TRACK_STREAM_TITLE_TAG,
                                                       unescaped_title);
         		g_free (unescaped_title);
 		}
-		else if (!xmlStrcmp (uris->name, (const xmlChar *) "artist")) {
-			xmlChar *artist;
+		else if (_is_element (reader, "artist")) {
+			gchar *artist;
                         gchar *unescaped_artist;
 
-			artist = xmlNodeListGetString (project,
-						      uris->xmlChildrenNode,
-						      1);
+			artist = _read_string (reader);
 			if (!artist)
 				goto error;
 
-			unescaped_artist = g_uri_unescape_string ((char *) artist, NULL);
-			g_free (artist);
+			unescaped_artist = g_uri_unescape_string (artist, NULL);
+			xmlFree (artist);
 
                         rejilla_track_tag_add_string (REJILLA_TRACK (track),
                                                       REJILLA_TRACK_STREAM_ARTIST_TAG,
                                                       unescaped_artist);
         		g_free (unescaped_artist);
 		}
-		else if (!xmlStrcmp (uris->name, (const xmlChar *) "composer")) {
-			xmlChar *composer;
+		else if (_is_element (reader, "composer")) {
+			gchar *composer;
                         gchar *unescaped_composer;
 
-			composer = xmlNodeListGetString (project,
-							 uris->xmlChildrenNode,
-							 1);
+			composer = _read_string (reader);
 			if (!composer)
 				goto error;
 
-			unescaped_composer = g_uri_unescape_string ((char *) composer, NULL);
-			g_free (composer);
+			unescaped_composer = g_uri_unescape_string (composer, NULL);
+			xmlFree (composer);
 
                         rejilla_track_tag_add_string (REJILLA_TRACK (track),
                                                       REJILLA_TRACK_STREAM_COMPOSER_TAG,
                                                       unescaped_composer);
         		g_free (unescaped_composer);
 		}
-		else if (!xmlStrcmp (uris->name, (const xmlChar *) "isrc")) {
+		else if (_is_element (reader, "isrc")) {
 			gchar *isrc;
 
-			isrc = (gchar *) xmlNodeListGetString (project,
-							       uris->xmlChildrenNode,
-							       1);
+			isrc = _read_string (reader);
 			if (!isrc)
 				goto error;
 
                         rejilla_track_tag_add_int (REJILLA_TRACK (track),
                                                    REJILLA_TRACK_STREAM_ISRC_TAG,
                                                    (gint) g_ascii_strtod (isrc, NULL));
-			g_free (isrc);
+			xmlFree (isrc);
 		}
-		else if (uris->type == XML_ELEMENT_NODE)
+		else
 			goto error;
-
-		uris = uris->next;
 	}
 
+	if (res < 0)
+		goto error;
+
 	return REJILLA_TRACK (track);
 
 error:
@@ -358,62 +434,37 @@ error:
 	return NULL;
 }
 
-static gboolean
-_get_tracks (xmlDocPtr project,
-	     xmlNodePtr track_node,
-	     RejillaBurnSession *session)
+static GSList *
+_get_tracks (xmlTextReaderPtr reader,
+	     const gchar *snapshot)
 {
 	GSList *tracks = NULL;
-	GSList *iter;
-
-	track_node = track_node->xmlChildrenNode;
+	gint depth;
+	gint res;
 
-	while (track_node) {
+	depth = xmlTextReaderDepth (reader);
+	for (res = _first_child (reader, depth); res > 0; res = _next_child (reader, depth)) {
 		RejillaTrack *newtrack;
 
-		if (!xmlStrcmp (track_node->name, (const xmlChar *) "audio")) {
-			newtrack = _read_audio_track (project, track_node->xmlChildrenNode, FALSE);
-			if (!newtrack)
-				goto error;
-
-			tracks = g_slist_append (tracks, newtrack);
-		}
-		else if (!xmlStrcmp (track_node->name, (const xmlChar *) "data")) {
-			newtrack = _read_data_track (project, track_node->xmlChildrenNode);
-
-			if (!newtrack)
-				goto error;
-
-			tracks = g_slist_append (tracks, newtrack);
-		}
-		else if (!xmlStrcmp (track_node->name, (const xmlChar *) "video")) {
-			newtrack = _read_audio_track (project, track_node->xmlChildrenNode, TRUE);
-
-			if (!newtrack)
-				goto error;
+		if (_is_element (reader, "audio"))
+			newtrack = _read_audio_track (reader, FALSE);
+		else if (_is_element (reader, "data"))
+			newtrack = _read_data_track (reader, snapshot);
+		else if (_is_element (reader, "video"))
+			newtrack = _read_audio_track (reader, TRUE);
+		else
+			goto error;
 
-			tracks = g_slist_append (tracks, newtrack);
-		}
-		else if (track_node->type == XML_ELEMENT_NODE)
+		if (!newtrack)
 			goto error;
 
-		track_node = track_node->next;
+		tracks = g_slist_prepend (tracks, newtrack);
 	}
 
-	if (!tracks)
+	if (res < 0 || !tracks)
 		goto error;
 
-	for (iter = tracks; iter; iter = iter->next) {
-		RejillaTrack *newtrack;
-
-		newtrack = iter->data;
-		rejilla_burn_session_add_track (session, newtrack, NULL);
-		g_object_unref (newtrack);
-	}
-
-	g_slist_free (tracks);
-
-	return TRUE;
+	return g_slist_reverse (tracks);
 
 error :
 
@@ -422,7 +473,7 @@ error :
 		g_slist_free (tracks);
 	}
 
-	return FALSE;
+	return NULL;
 }
 
 gboolean
@@ -430,14 +481,16 @@ rejilla_project_open_project_xml (const gchar *uri,
 				  RejillaBurnSession *session,
 				  gboolean warn_user)
 {
-	xmlNodePtr track_node = NULL;
+	xmlTextReaderPtr reader;
+	GSList *tracks = NULL;
+	gboolean has_track = FALSE;
+	gchar *snapshot = NULL;
 	gchar *label = NULL;
 	gchar *cover = NULL;
-	xmlDocPtr project;
-	xmlNodePtr item;
-	gboolean retval;
+	GSList *iter;
 	GFile *file;
 	gchar *path;
+	gint res;
 
 	file = g_file_new_for_commandline_arg (uri);
 	path = g_file_get_path (file);
@@ -446,10 +499,9 @@ rejilla_project_open_project_xml (const gchar *uri,
 		return FALSE;
 
 	/* start parsing xml doc */
-	project = xmlParseFile (path);
-    	g_free (path);
-
-	if (!project) {
+	reader = xmlReaderForFile (path, NULL, 0);
+	if (!reader) {
+		g_free (path);
 	    	if (warn_user)
 			rejilla_project_invalid_project_dialog (_("The project could not be opened"));
 
@@ -457,63 +509,77 @@ rejilla_project_open_project_xml (const gchar *uri,
 	}
 
 	/* parses the "header" */
-	item = xmlDocGetRootElement (project);
-	if (!item) {
+	res = _next_child (reader, -1);
+	if (res <= 0) {
+		g_free (path);
+		xmlFreeTextReader (reader);
+
 	    	if (warn_user)
 			rejilla_project_invalid_project_dialog (_("The file is empty"));
 
-		xmlFreeDoc (project);
 		return FALSE;
 	}
 
-	if (xmlStrcmp (item->name, (const xmlChar *) "rejillaproject")
-	||  item->next)
+	if (!_is_element (reader, "rejillaproject"))
 		goto error;
 
-	item = item->children;
-	while (item) {
-		if (!xmlStrcmp (item->name, (const xmlChar *) "version")) {
+	snapshot = _get_snapshot_path (path);
+
+	for (res = _first_child (reader, 0); res > 0; res = _next_child (reader, 0)) {
+		if (_is_element (reader, "version")) {
 			/* simply ignore it */
 		}
-		else if (!xmlStrcmp (item->name, (const xmlChar *) "label")) {
-			label = (gchar *) xmlNodeListGetString (project,
-								item->xmlChildrenNode,
-								1);
-			if (!(label))
+		else if (_is_element (reader, "label")) {
+			if (label)
+				xmlFree (label);
+
+			label = _read_string (reader);
+			if (!label)
 				goto error;
 		}
-		else if (!xmlStrcmp (item->name, (const xmlChar *) "cover")) {
-			xmlChar *escaped;
+		else if (_is_element (reader, "cover")) {
+			gchar *escaped;
 
-			escaped = xmlNodeListGetString (project,
-							item->xmlChildrenNode,
-							1);
+			escaped = _read_string (reader);
 			if (!escaped)
 				goto error;
 
-			cover = g_uri_unescape_string ((char *) escaped, NULL);
-			g_free (escaped);
+			g_free (cover);
+			cover = g_uri_unescape_string (escaped, NULL);
+			xmlFree (escaped);
 		}
-		else if (!xmlStrcmp (item->name, (const xmlChar *) "track")) {
-			if (track_node)
+		else if (_is_element (reader, "track")) {
+			if (has_track)
 				goto error;
 
-			track_node = item;
+			has_track = TRUE;
+			tracks = _get_tracks (reader, snapshot);
+			if (!tracks)
+				goto error;
 		}
-		else if (item->type == XML_ELEMENT_NODE)
+		else
 			goto error;
-
-		item = item->next;
 	}
 
-	retval = _get_tracks (project, track_node, session);
-	if (!retval)
+	/* Make sure there is nothing after the root element */
+	if (res < 0 || !has_track || _next_child (reader, -1) != -1)
 		goto error;
 
-	xmlFreeDoc (project);
+	xmlFreeTextReader (reader);
+	g_free (snapshot);
+	g_free (path);
+
+	for (iter = tracks; iter; iter = iter->next) {
+		RejillaTrack *newtrack;
+
+		newtrack = iter->data;
+		rejilla_burn_session_add_track (session, newtrack, NULL);
+		g_object_unref (newtrack);
+	}
+	g_slist_free (tracks);
 
         rejilla_burn_session_set_label (session, label);
-        g_free (label);
+        xmlFree (label);
 
         if (cover) {
                 GValue *value;
@@ -528,16 +594,22 @@ rejilla_project_open_project_xml (const gchar *uri,
                 g_free (cover);
         }
 
-        return retval;
+        return TRUE;
 
 error:
 
+	g_slist_foreach (tracks, (GFunc) g_object_unref, NULL);
+	g_slist_free (tracks);
+
 	if (cover)
 		g_free (cover);
 	if (label)
-		g_free (label);
+		xmlFree (label);
+
+	xmlFreeTextReader (reader);
+	g_free (snapshot);
+	g_free (path);
 
-	xmlFreeDoc (project);
     	if (warn_user)
 		rejilla_project_invalid_project_dialog (_("It does not seem to be a valid Rejilla project"));
 
@@ -806,6 +878,7 @@ rejilla_project_save_project_xml (RejillaBurnSession *session,
 				  const gchar *uri)
 {
 	RejillaTrackType *track_type = NULL;
+	RejillaTrack *data_track = NULL;
 	xmlTextWriter *project;
 	gboolean retval;
 	GSList *tracks;
@@ -909,6 +982,8 @@ rejilla_project_save_project_xml (RejillaBurnSession *session,
 			if (!retval)
 				goto error;
 
+			data_track = track;
+
 			success = xmlTextWriterEndElement (project); /* data */
 			if (success < 0)
 				goto error;
@@ -929,6 +1004,19 @@ rejilla_project_save_project_xml (RejillaBurnSession *session,
 
 	xmlTextWriterEndDocument (project);
 	xmlFreeTextWriter (project);
+
+	if (data_track) {
+		gchar *snapshot;
+
+		/* Not being able to save it is not a problem; the directories
+		 * will simply be explored again when the project is opened */
+		snapshot = _get_snapshot_path (path);
+		rejilla_track_data_cfg_save_snapshot (REJILLA_TRACK_DATA_CFG (data_track),
+						      snapshot,
+						      NULL);
+		g_free (snapshot);
+	}
+
 	g_free (path);
 	return TRUE;
 
@@ -1615,12 +1615,67 @@ rejilla_project_image_properties (RejillaProject *project)
 	return (answer == GTK_RESPONSE_OK) ? REJILLA_BURN_OK:REJILLA_BURN_ERR;
 }
 
+static void
+rejilla_project_missing_files_dialog (RejillaProject *project,
+				      GSList *missing)
+{
+	GString *list;
+	GSList *iter;
+	guint num;
+
+	list = g_string_new (NULL);
+	for (num = 0, iter = missing; iter && num < 10; iter = iter->next, num ++) {
+		gchar *name;
+		gchar *path;
+
+		path = g_filename_from_uri (iter->data, NULL, NULL);
+		name = g_filename_display_name (path ? path:iter->data);
+		g_free (path);
+
+		g_string_append_printf (list, "\n%s", name);
+		g_free (name);
+	}
+
+	if (iter)
+		g_string_append (list, "\n…");
+
+	g_string_prepend (list, _("They were removed from the project since they no longer exist:"));
+	rejilla_app_alert (rejilla_app_get_default (),
+			   _("Some files changed since they were added"),
+			   list->str,
+			   GTK_MESSAGE_WARNING);
+	g_string_free (list, TRUE);
+}
+
 static void
 rejilla_project_burn (RejillaProject *project)
 {
 	RejillaBurnResult res;
 	RejillaDisc *current_disc;
 	RejillaDriveSettings *settings;
+	GSList *missing;
+	GSList *tracks;
+
+	/* Make sure the files are still as they were when added since
+	 * monitoring may have missed some changes. Better tell the user
+	 * now than fail while writing. */
+	missing = NULL;
+	rejilla_session_cfg_revalidate (project->priv->session, &missing, NULL);
+	if (missing) {
+		rejilla_project_missing_files_dialog (project, missing);
+		g_slist_foreach (missing, (GFunc) g_free, NULL);
+		g_slist_free (missing);
+		return;
+	}
+
+	/* Directories whose exploration was put off must be explored now so
+	 * that all files are known and checked; the status dialog below
+	 * waits for it. */
+	tracks = rejilla_burn_session_get_tracks (REJILLA_BURN_SESSION (project->priv->session));
+	for (; tracks; tracks = tracks->next) {
+		if (REJILLA_IS_TRACK_DATA_CFG (tracks->data))
+			rejilla_track_data_cfg_explore_all (REJILLA_TRACK_DATA_CFG (tracks->data));
+	}
 
 	/* Check that we are ready */
 	if (rejilla_project_check_status (project) != REJILLA_BURN_OK)